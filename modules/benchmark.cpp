@@ -0,0 +1,394 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+
+#include <EASTL/algorithm.h>
+#include <EASTL/allocator.h>
+#include <EASTL/fixed_vector.h>
+#include <EASTL/sort.h>
+#include <EASTL/vector.h>
+
+#include "ArraySize.h"
+#include "Culling.h"
+#include "HandlePool.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "RadixSort.h"
+#include "VectorMath.h"
+
+// Microbenchmarks of the engine's hot primitives. Only links EngineCore, so it runs without a display
+// or GPU. Each benchmark is timed over several samples of at least SampleSeconds and reported as the
+// median and fastest time per operation. An argument only runs the benchmarks whose name contains it.
+
+static const double SampleSeconds = 0.02;
+static const uint32_t NumSamples = 15;
+
+// items a feature collects into a temporary array during a frame
+static const uint32_t FrameTempCount = 48;
+static const uint32_t NumAllocations = 256;
+static const uint32_t NumJobs = 256;
+static const uint32_t NumSortKeys = 16 * 1024;
+static const uint32_t NumSpheres = 16 * 1024;
+
+struct KeyValue
+{
+	uint64_t key;
+	uint32_t value;
+};
+
+struct BenchmarkData
+{
+	JobSystem* jobSystem;
+	eastl::vector<uint32_t> reusedVector;
+	HandlePool<uint64_t> handlePool;
+	eastl::vector<Handle<uint64_t>> handles;
+
+	eastl::vector<uint64_t> sourceKeys;
+	eastl::vector<uint64_t> keys;
+	eastl::vector<uint32_t> values;
+	eastl::vector<uint64_t> scratchKeys;
+	eastl::vector<uint32_t> scratchValues;
+	eastl::vector<KeyValue> pairs;
+
+	Plane frustumPlanes[6];
+	eastl::vector<float> centerX;
+	eastl::vector<float> centerY;
+	eastl::vector<float> centerZ;
+	eastl::vector<float> radii;
+	eastl::vector<uint8_t> visible;
+
+	// results are folded into this so the work can't be optimized away
+	uint64_t sink;
+};
+
+struct Benchmark
+{
+	const char* name;
+	// operations done by one call of run, the reported time is per operation
+	uint32_t opsPerRun;
+	void (*run)(BenchmarkData& data);
+};
+
+static uint32_t nextRandom(uint32_t& state)
+{
+	// xorshift32, deterministic so runs compare
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+static float randomFloat(uint32_t& state, float min, float max)
+{
+	return min + (max - min) * (nextRandom(state) & 0xffffff) / static_cast<float>(0xffffff);
+}
+
+// Vectors a feature fills and throws away every frame
+
+static void runVectorPerFrame(BenchmarkData& data)
+{
+	eastl::vector<uint32_t> items;
+	for (uint32_t i = 0; i < FrameTempCount; ++i)
+	{
+		items.push_back(i);
+	}
+	data.sink += items.back() + items.size();
+}
+
+static void runVectorReserved(BenchmarkData& data)
+{
+	eastl::vector<uint32_t> items;
+	items.reserve(FrameTempCount);
+	for (uint32_t i = 0; i < FrameTempCount; ++i)
+	{
+		items.push_back(i);
+	}
+	data.sink += items.back() + items.size();
+}
+
+static void runVectorReused(BenchmarkData& data)
+{
+	eastl::vector<uint32_t>& items = data.reusedVector;
+	items.clear();
+	for (uint32_t i = 0; i < FrameTempCount; ++i)
+	{
+		items.push_back(i);
+	}
+	data.sink += items.back() + items.size();
+}
+
+static void runFixedVector(BenchmarkData& data)
+{
+	eastl::fixed_vector<uint32_t, 64, true> items;
+	for (uint32_t i = 0; i < FrameTempCount; ++i)
+	{
+		items.push_back(i);
+	}
+	data.sink += items.back() + items.size();
+}
+
+static void runFixedVectorOverflow(BenchmarkData& data)
+{
+	// capacity below the count, so it spills to the heap like a badly sized fixed_vector does
+	eastl::fixed_vector<uint32_t, 16, true> items;
+	for (uint32_t i = 0; i < FrameTempCount; ++i)
+	{
+		items.push_back(i);
+	}
+	data.sink += items.back() + items.size();
+}
+
+// Allocators
+
+static void runEastlAllocator(BenchmarkData& data)
+{
+	eastl::allocator allocator;
+	void* blocks[NumAllocations];
+	for (uint32_t i = 0; i < NumAllocations; ++i)
+	{
+		// 16 to 256 bytes, the sizes of small containers
+		blocks[i] = allocator.allocate(16 + (i % 16) * 16);
+	}
+	for (uint32_t i = 0; i < NumAllocations; ++i)
+	{
+		data.sink += reinterpret_cast<uintptr_t>(blocks[i]) & 0xff;
+		allocator.deallocate(blocks[i], 16 + (i % 16) * 16);
+	}
+}
+
+static void runHandlePool(BenchmarkData& data)
+{
+	data.handles.clear();
+	for (uint32_t i = 0; i < NumAllocations; ++i)
+	{
+		data.handles.push_back(addToPool(data.handlePool, static_cast<uint64_t>(i)));
+	}
+	// every other one first, so removals move objects around like they do in use
+	for (uint32_t i = 0; i < NumAllocations; i += 2)
+	{
+		removeFromPool(data.handlePool, data.handles[i]);
+	}
+	for (uint32_t i = 1; i < NumAllocations; i += 2)
+	{
+		data.sink += getFromPool(data.handlePool, data.handles[i]);
+		removeFromPool(data.handlePool, data.handles[i]);
+	}
+}
+
+// Job system
+
+static void emptyJob(void* data)
+{
+	(void)data;
+}
+
+static void runJobBatch(BenchmarkData& data)
+{
+	JobCounter counter = {};
+	for (uint32_t i = 0; i < NumJobs; ++i)
+	{
+		submitJob(data.jobSystem, emptyJob, nullptr, &counter);
+	}
+	waitForCounter(data.jobSystem, &counter);
+}
+
+static void runJobRoundTrip(BenchmarkData& data)
+{
+	JobCounter counter = {};
+	submitJob(data.jobSystem, emptyJob, nullptr, &counter);
+	waitForCounter(data.jobSystem, &counter);
+}
+
+// Sort keys, laid out like makeDrawSortKey's
+
+static void resetSortKeys(BenchmarkData& data)
+{
+	memcpy(data.keys.data(), data.sourceKeys.data(), NumSortKeys * sizeof(uint64_t));
+	for (uint32_t i = 0; i < NumSortKeys; ++i)
+	{
+		data.values[i] = i;
+	}
+}
+
+static void runCopyKeys(BenchmarkData& data)
+{
+	resetSortKeys(data);
+	data.sink += data.keys[0];
+}
+
+static void runRadixSort(BenchmarkData& data)
+{
+	resetSortKeys(data);
+	radixSort64(data.keys.data(), data.values.data(), data.scratchKeys.data(), data.scratchValues.data(), NumSortKeys);
+	data.sink += data.values[0];
+}
+
+static void runComparisonSort(BenchmarkData& data)
+{
+	eastl::vector<KeyValue>& pairs = data.pairs;
+	for (uint32_t i = 0; i < NumSortKeys; ++i)
+	{
+		pairs[i].key = data.sourceKeys[i];
+		pairs[i].value = i;
+	}
+	eastl::stable_sort(pairs.begin(), pairs.end(), [](const KeyValue& a, const KeyValue& b) { return a.key < b.key; });
+	data.sink += pairs[0].value;
+}
+
+// Culling
+
+static void runCullScalar(BenchmarkData& data)
+{
+	cullSpheresScalar(data.frustumPlanes, data.centerX.data(), data.centerY.data(), data.centerZ.data(), data.radii.data(), NumSpheres, data.visible.data());
+	data.sink += data.visible[NumSpheres / 2];
+}
+
+static void runCullSimd(BenchmarkData& data)
+{
+	cullSpheres(data.frustumPlanes, data.centerX.data(), data.centerY.data(), data.centerZ.data(), data.radii.data(), NumSpheres, data.visible.data());
+	data.sink += data.visible[NumSpheres / 2];
+}
+
+static const Benchmark Benchmarks[] =
+{
+	{ "vector/new per frame", FrameTempCount, runVectorPerFrame },
+	{ "vector/reserved per frame", FrameTempCount, runVectorReserved },
+	{ "vector/reused", FrameTempCount, runVectorReused },
+	{ "fixed_vector/fits", FrameTempCount, runFixedVector },
+	{ "fixed_vector/overflows", FrameTempCount, runFixedVectorOverflow },
+	{ "allocator/eastl 16-256 bytes", NumAllocations, runEastlAllocator },
+	{ "allocator/handle pool add+remove", NumAllocations, runHandlePool },
+	{ "jobs/batch of 256 empty", NumJobs, runJobBatch },
+	{ "jobs/single round trip", 1, runJobRoundTrip },
+	{ "sort/copy keys only", NumSortKeys, runCopyKeys },
+	{ "sort/radixSort64", NumSortKeys, runRadixSort },
+	{ "sort/eastl stable_sort", NumSortKeys, runComparisonSort },
+	{ "cull/scalar", NumSpheres, runCullScalar },
+	{ "cull/simd", NumSpheres, runCullSimd },
+};
+
+static void initBenchmarkData(BenchmarkData& data)
+{
+	data.jobSystem = createJobSystem(0);
+	data.handlePool = {};
+	data.sink = 0;
+
+	uint32_t random = 0x12345678;
+
+	// few passes, a few dozen pipelines and materials, and depth in the low bits
+	data.sourceKeys.resize(NumSortKeys);
+	for (uint32_t i = 0; i < NumSortKeys; ++i)
+	{
+		uint64_t pass = nextRandom(random) % 3;
+		uint64_t pipeline = nextRandom(random) % 24;
+		uint64_t material = nextRandom(random) % 64;
+		uint64_t depth = nextRandom(random) & 0xffffff;
+		data.sourceKeys[i] = (pass << 60) | ((pipeline * 2654435761u) & 0xffff) << 44 | (material << 24) | depth;
+	}
+	data.keys.resize(NumSortKeys);
+	data.values.resize(NumSortKeys);
+	data.scratchKeys.resize(NumSortKeys);
+	data.scratchValues.resize(NumSortKeys);
+	data.pairs.resize(NumSortKeys);
+
+	// a camera at the origin looking down +z, spheres scattered around it so about a quarter is visible
+	Mat4 view = makeViewMatrix(makeVec3(0.0f, 0.0f, 0.0f), makeVec3(1.0f, 0.0f, 0.0f), makeVec3(0.0f, 1.0f, 0.0f), makeVec3(0.0f, 0.0f, 1.0f));
+	Mat4 projection = makePerspective(tanf(0.5f), 16.0f / 9.0f, 0.1f, 500.0f);
+	extractFrustumPlanes(multiply(projection, view), data.frustumPlanes);
+
+	data.centerX.resize(NumSpheres);
+	data.centerY.resize(NumSpheres);
+	data.centerZ.resize(NumSpheres);
+	data.radii.resize(NumSpheres);
+	data.visible.resize(NumSpheres);
+	for (uint32_t i = 0; i < NumSpheres; ++i)
+	{
+		data.centerX[i] = randomFloat(random, -200.0f, 200.0f);
+		data.centerY[i] = randomFloat(random, -20.0f, 20.0f);
+		data.centerZ[i] = randomFloat(random, -200.0f, 200.0f);
+		data.radii[i] = randomFloat(random, 0.5f, 4.0f);
+	}
+}
+
+static void checkCullingKernels(BenchmarkData& data)
+{
+	eastl::vector<uint8_t> expected(NumSpheres);
+	cullSpheresScalar(data.frustumPlanes, data.centerX.data(), data.centerY.data(), data.centerZ.data(), data.radii.data(), NumSpheres, expected.data());
+	cullSpheres(data.frustumPlanes, data.centerX.data(), data.centerY.data(), data.centerZ.data(), data.radii.data(), NumSpheres, data.visible.data());
+
+	uint32_t numVisible = 0;
+	for (uint32_t i = 0; i < NumSpheres; ++i)
+	{
+		if (expected[i] != data.visible[i])
+		{
+			Log::fatal("cullSpheres disagrees with the scalar test on sphere %u\n", i);
+		}
+		numVisible += expected[i];
+	}
+	Log::log("%u of %u spheres visible\n", numVisible, NumSpheres);
+}
+
+static double getSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void runBenchmark(const Benchmark& benchmark, BenchmarkData& data)
+{
+	// warms caches and the allocator up, and finds how many runs fill a sample
+	uint32_t runsPerSample = 1;
+	for (;;)
+	{
+		double start = getSeconds();
+		for (uint32_t i = 0; i < runsPerSample; ++i)
+		{
+			benchmark.run(data);
+		}
+		if (getSeconds() - start >= SampleSeconds || runsPerSample >= (1u << 30))
+		{
+			break;
+		}
+		runsPerSample *= 2;
+	}
+
+	double nanosecondsPerOp[NumSamples];
+	for (uint32_t sample = 0; sample < NumSamples; ++sample)
+	{
+		double start = getSeconds();
+		for (uint32_t i = 0; i < runsPerSample; ++i)
+		{
+			benchmark.run(data);
+		}
+		double seconds = getSeconds() - start;
+		nanosecondsPerOp[sample] = seconds * 1e9 / (static_cast<double>(runsPerSample) * benchmark.opsPerRun);
+	}
+
+	eastl::sort(nanosecondsPerOp, nanosecondsPerOp + NumSamples);
+	printf("%-36s %10.2f ns/op median %10.2f ns/op min\n", benchmark.name, nanosecondsPerOp[NumSamples / 2], nanosecondsPerOp[0]);
+}
+
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+
+	BenchmarkData data;
+	initBenchmarkData(data);
+	Log::log("%u job workers\n", getNumJobWorkers(data.jobSystem));
+	checkCullingKernels(data);
+
+	for (uint32_t i = 0; i < ARRAY_SIZE(Benchmarks); ++i)
+	{
+		if (!filter || strstr(Benchmarks[i].name, filter))
+		{
+			runBenchmark(Benchmarks[i], data);
+		}
+	}
+
+	destroyJobSystem(data.jobSystem);
+
+	// printed so the compiler has to keep every benchmark's work
+	Log::log("checksum %llu\n", static_cast<unsigned long long>(data.sink));
+	return 0;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <EASTL/vector.h>
+
+#include "VectorMath.h"
+
+struct JobSystem;
+
+// Skeletal animation: clips are compressed to quantized, key-reduced tracks, sampled and blended
+// four joints at a time with SIMD, and turned into skinning matrices for many characters in
+// parallel jobs. Skinning the vertices themselves is left to the GPU, see SkinningSample.h.
+
+static const uint32_t MaxSkeletonJoints = 64;
+
+struct Quat
+{
+	float x;
+	float y;
+	float z;
+	float w;
+};
+
+struct JointTransform
+{
+	Quat rotation;
+	Vec3 translation;
+};
+
+struct Skeleton
+{
+	uint32_t numJoints;
+	// parents come before their children, -1 for the root
+	int32_t parents[MaxSkeletonJoints];
+	// inverse of each joint's model space bind pose
+	Mat4 inverseBindMatrices[MaxSkeletonJoints];
+};
+
+// Every joint's local transform at every frame, as authored. Looping clips repeat the first frame
+// at the end.
+struct RawAnimationClip
+{
+	float frameRate;
+	uint32_t numFrames;
+	uint32_t numJoints;
+	// numFrames * numJoints, frame major
+	eastl::vector<JointTransform> transforms;
+};
+
+struct AnimationCompressionSettings
+{
+	// largest angle in radians and largest distance that removing keys may add to a joint's
+	// local transform, on top of the quantization error
+	float rotationTolerance;
+	float translationTolerance;
+};
+
+// Smallest three quaternion: the largest component is dropped and rebuilt from the unit length,
+// the other three are stored with 15 bits each. The dropped component's index is in the top bits
+// of the first two values.
+struct PackedQuat
+{
+	uint16_t values[3];
+};
+
+// A range of keys. Tracks that don't change have a single key.
+struct AnimationTrack
+{
+	uint32_t firstKey;
+	uint32_t numKeys;
+};
+
+// Keys are only kept where interpolating their neighbours would be off by more than the tolerance,
+// so the curve through the remaining keys fits the authored one.
+struct AnimationClip
+{
+	float frameRate;
+	float duration;
+	uint32_t numJoints;
+
+	AnimationTrack rotationTracks[MaxSkeletonJoints];
+	AnimationTrack translationTracks[MaxSkeletonJoints];
+
+	// frame of every key, ascending within a track
+	eastl::vector<uint16_t> rotationKeyFrames;
+	eastl::vector<PackedQuat> rotationKeys;
+	eastl::vector<uint16_t> translationKeyFrames;
+	// three 16-bit values per key, scaled into the clip's translation bounds
+	eastl::vector<uint16_t> translationKeys;
+	float translationMin[3];
+	float translationScale[3];
+};
+
+// Structure of arrays, so that sampling and blending work on four joints at once. Joints past the
+// skeleton's count are padding.
+struct AnimationPose
+{
+	alignas(16) float rotationX[MaxSkeletonJoints];
+	alignas(16) float rotationY[MaxSkeletonJoints];
+	alignas(16) float rotationZ[MaxSkeletonJoints];
+	alignas(16) float rotationW[MaxSkeletonJoints];
+	alignas(16) float translationX[MaxSkeletonJoints];
+	alignas(16) float translationY[MaxSkeletonJoints];
+	alignas(16) float translationZ[MaxSkeletonJoints];
+};
+
+// A skinned instance, playing two clips blended by blendWeight
+struct AnimatedCharacter
+{
+	Mat4 world;
+	uint32_t clips[2];
+	float times[2];
+	// 0 is only the first clip, 1 only the second
+	float blendWeight;
+};
+
+// 12 floats per joint: the rows of a 3x4 matrix, the layout skinning.comp reads
+static const uint32_t SkinningMatrixFloats = 12;
+
+Quat makeQuatFromAxisAngle(const Vec3& axis, float angle);
+Quat multiply(const Quat& a, const Quat& b);
+
+PackedQuat packQuat(const Quat& q);
+Quat unpackQuat(const PackedQuat& packed);
+
+void compressAnimationClip(const RawAnimationClip& raw, const AnimationCompressionSettings& settings, AnimationClip& clip);
+size_t getAnimationClipSize(const AnimationClip& clip);
+
+// time wraps around the clip's duration
+void sampleAnimationClip(const AnimationClip& clip, float time, AnimationPose& pose);
+// Normalized lerp of the rotations along the shortest arc and lerp of the translations
+void blendAnimationPoses(const AnimationPose& a, const AnimationPose& b, float weight, uint32_t numJoints, AnimationPose& result);
+
+// world * model space pose * inverse bind pose for every joint, numJoints * SkinningMatrixFloats floats
+void computeSkinningMatrices(const Skeleton& skeleton, const AnimationPose& pose, const Mat4& world, float* matrices);
+
+// Samples, blends and skins every character, spread over the job system in batches. Writes the
+// skinning matrices of character i at matrices + i * numJoints * SkinningMatrixFloats. Returns
+// once all of them are written.
+void animateCharacters(JobSystem* jobSystem, const Skeleton& skeleton, const AnimationClip* clips, const AnimatedCharacter* characters, uint32_t numCharacters, float* matrices);
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+
+#include <EASTL/string.h>
+#include <EASTL/vector.h>
+
+struct AssetPipeline;
+struct JobSystem;
+
+// Loads assets and everything they reference as a graph. Every asset is a coroutine that reads the file
+// through AsyncFileIo, decompresses chunked files (see Compression.h) with one job per chunk, asks its
+// type's handler what it references, waits for those and is then handed to the handler's finish
+// callback. Independent assets are read in the same batch and decompressed in parallel.
+
+enum AssetType : uint32_t
+{
+	AssetType_Raw,
+	// "<type> <path>" per line, see parseAssetManifest
+	AssetType_Manifest,
+	AssetType_Mesh,
+	AssetType_Material,
+	AssetType_Texture,
+	AssetType_Shader,
+	NumAssetTypes,
+};
+
+typedef uint32_t AssetId;
+
+struct AssetReference
+{
+	AssetType type;
+	// relative to the pipeline's root folder
+	eastl::string path;
+};
+
+struct AssetTypeHandler
+{
+	// On a job worker once the asset was read and decompressed. Appends the assets it references, which
+	// are loaded in parallel. The asset completes after all of them and fails if any of them does.
+	// References must not form a cycle.
+	void (*findDependencies)(const eastl::vector<uint8_t>& data, eastl::vector<AssetReference>& dependencies, void* userData);
+	// On the thread in waitForAssets, after the finish callbacks of the asset's dependencies, which makes
+	// it the place for GPU uploads. May take the data.
+	void (*finish)(AssetId id, const char* path, eastl::vector<uint8_t>& data, void* userData);
+	void* userData;
+};
+
+struct AssetPipelineStats
+{
+	uint32_t numAssets;
+	uint32_t numFailed;
+	uint64_t bytesRead;
+	uint64_t bytesDecompressed;
+};
+
+// rootFolder is prepended to every path as is, so it needs its trailing slash
+AssetPipeline* createAssetPipeline(JobSystem* jobSystem, const char* rootFolder);
+// Call when nothing is loading, i.e. after waitForAssets
+void destroyAssetPipeline(AssetPipeline* pipeline);
+
+// Only manifests have a handler by default. Set handlers before requesting assets of the type.
+void setAssetTypeHandler(AssetPipeline* pipeline, AssetType type, const AssetTypeHandler& handler);
+
+// Starts loading, or returns the asset loaded or loading from the same path. Reads are batched until
+// waitForAssets.
+AssetId requestAsset(AssetPipeline* pipeline, AssetType type, const char* path);
+
+// Runs jobs and finish callbacks on the calling thread until every requested asset and its dependencies
+// completed. False if any of them failed.
+bool waitForAssets(AssetPipeline* pipeline);
+
+bool isAssetLoaded(AssetPipeline* pipeline, AssetId id);
+const char* getAssetPath(AssetPipeline* pipeline, AssetId id);
+// Empty when the finish callback took it
+const eastl::vector<uint8_t>& getAssetData(AssetPipeline* pipeline, AssetId id);
+
+AssetPipelineStats getAssetPipelineStats(AssetPipeline* pipeline);
+const char* getAssetPipelineIoBackend(AssetPipeline* pipeline);
+
+// Lines are "<type> <path>" with type one of raw, manifest, mesh, material, texture or shader. Empty lines
+// and lines starting with # are skipped.
+void parseAssetManifest(const eastl::vector<uint8_t>& data, eastl::vector<AssetReference>& references);
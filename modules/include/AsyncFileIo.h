@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+#include <EASTL/vector.h>
+
+struct AsyncFileIo;
+struct JobSystem;
+
+// Called once per request, on an io or job worker thread
+typedef void (*FileReadCallback)(void* userData, bool succeeded);
+
+struct FileReadRequest
+{
+	// absolute, or relative to the working directory
+	const char* path;
+	// resized to the file size, must stay alive until the callback
+	eastl::vector<uint8_t>* data;
+	FileReadCallback callback;
+	void* userData;
+};
+
+// Whole-file reads that don't block the caller. On Linux they go through io_uring, large files split into
+// pieces that are read in parallel. Elsewhere, or when io_uring isn't available or ENGINE_IO_URING=0,
+// every file is read by a job on the job system.
+AsyncFileIo* createAsyncFileIo(JobSystem* jobSystem);
+// Waits for the reads in flight
+void destroyAsyncFileIo(AsyncFileIo* io);
+
+// "io_uring" or "job system"
+const char* getAsyncFileIoBackend(AsyncFileIo* io);
+
+// Thread-safe. The requests are copied, path only has to live until this returns.
+// Reads submitted together go to the kernel together.
+void submitFileReads(AsyncFileIo* io, const FileReadRequest* requests, uint32_t numRequests);
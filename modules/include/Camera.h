@@ -0,0 +1,27 @@
+#pragma once
+
+#include "VectorMath.h"
+
+struct EngineContext;
+
+// The camera the 3D samples are drawn with, updated once per frame
+struct Camera
+{
+	Vec3 position;
+	Vec3 right;
+	Vec3 up;
+	Vec3 forward;
+
+	float tanHalfFovY;
+	float aspect;
+	float nearPlane;
+	float farPlane;
+
+	Mat4 view;
+	Mat4 projection;
+	Mat4 viewProjection;
+	Plane frustumPlanes[6];
+};
+
+// Slowly orbits the origin, looking at it from above
+void updateSceneCamera(EngineContext& context);
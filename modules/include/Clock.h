@@ -0,0 +1,6 @@
+#pragma once
+
+// Seconds since the process started, from a monotonic clock. Everything that times frames or animates
+// reads this rather than glfwGetTime, which only runs once GLFW is initialized and so not in a
+// headless replay.
+double getEngineTime();
@@ -0,0 +1,25 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+struct ClusteredLighting;
+
+// Clustered forward lighting sample: a compute pass bins point and spot lights into a froxel grid,
+// then a lit ground plane is shaded using only the lights of each pixel's cluster.
+// Each cluster holds up to 256 lights, a warning is logged the first time culling drops any.
+// ENGINE_LIGHT_COUNT sets the number of lights (1024 by default). ENGINE_LIGHT_BENCHMARK=1 instead
+// sweeps 16 to 16k lights, logs the GPU time of the culling and shading passes, the frame time and
+// the lights dropped from full clusters for each count and closes the window.
+void createClusteredLighting(EngineContext& context);
+void destroyClusteredLighting(EngineContext& context);
+
+// Animates the lights and records the culling pass into the frame's compute command buffer
+void cullClusteredLights(EngineContext& context, VkCommandBuffer commandBuffer);
+void emitClusteredLighting(EngineContext& context);
+
+// Time the shading pass for the benchmark. Reset outside of rendering, then mark the start and end of
+// the DrawPass_Background draws, the lit ground plane is the only one.
+void resetClusteredShadingTimer(EngineContext& context, VkCommandBuffer commandBuffer);
+void markClusteredShading(EngineContext& context, VkCommandBuffer commandBuffer, bool end);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <EASTL/vector.h>
+
+// Chunked asset files: a header, a chunk table and the chunks, each compressed on its own so they can be
+// decompressed in parallel. Files without the magic are plain, uncompressed data.
+// Zstd chunks need the engine built with ENGINE_ZSTD, which links libzstd. LZ4 is implemented here.
+
+enum CompressionCodec : uint32_t
+{
+	CompressionCodec_None,
+	CompressionCodec_Lz4,
+	CompressionCodec_Zstd,
+};
+
+// "ECHK" in a little endian file
+static const uint32_t ChunkedAssetMagic = 0x4b484345;
+static const uint32_t ChunkedAssetVersion = 1;
+static const uint32_t DefaultAssetChunkSize = 256 * 1024;
+
+struct ChunkedAssetHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t numChunks;
+	uint32_t reserved;
+	uint64_t rawSize;
+};
+
+struct ChunkedAssetChunk
+{
+	CompressionCodec codec;
+	uint32_t compressedSize;
+	uint32_t rawSize;
+	uint32_t reserved;
+	// from the start of the file
+	uint64_t fileOffset;
+	// from the start of the decompressed data
+	uint64_t rawOffset;
+};
+
+bool isChunkedAsset(const uint8_t* file, size_t fileSize);
+
+// Validates the header and that every chunk lies inside the file and the decompressed data.
+// chunks points into file.
+bool parseChunkedAsset(const uint8_t* file, size_t fileSize, ChunkedAssetHeader& header, const ChunkedAssetChunk*& chunks);
+
+// Thread-safe, raw must have room for chunk.rawSize bytes
+bool decompressAssetChunk(const uint8_t* file, const ChunkedAssetChunk& chunk, uint8_t* raw);
+
+// Chunks that don't get smaller are stored uncompressed. Zstd falls back to LZ4 without ENGINE_ZSTD.
+void writeChunkedAsset(const uint8_t* data, size_t size, CompressionCodec codec, uint32_t chunkSize, eastl::vector<uint8_t>& file);
+
+// LZ4 block format, without the frame around it. Decompression fails unless exactly dstSize bytes come out.
+bool decompressLz4(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+// Appends the compressed block to dst
+void compressLz4(const uint8_t* src, size_t srcSize, eastl::vector<uint8_t>& dst);
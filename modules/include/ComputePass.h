@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+
+struct ComputePipeline
+{
+	VkDescriptorSetLayout descriptorSetLayout;
+	VkPipelineLayout layout;
+	VkPipeline pipeline;
+	uint32_t pushConstantSize;
+	// kept for shader hot reload, which rebuilds the pipeline with the same layout
+	const char* shaderFile;
+};
+
+// Command pool, per-frame command buffers and semaphores for the compute queue. When the device has
+// no dedicated compute family the compute queue is the graphics queue and the same code path is used.
+void createComputeResources(EngineContext& context);
+void destroyComputeResources(EngineContext& context);
+
+// shaderFile is the compiled .spv, relative to the shaders folder. It must outlive the pipeline, e.g. a string literal.
+// The pipeline is registered for shader hot reload, so it must not be moved until it is destroyed.
+void createComputePipeline(EngineContext& context, const char* shaderFile, const VkDescriptorSetLayoutBinding* bindings, uint32_t numBindings, uint32_t pushConstantSize, ComputePipeline& pipeline);
+void destroyComputePipeline(EngineContext& context, ComputePipeline& pipeline);
+VkDescriptorSet allocateDescriptorSet(EngineContext& context, VkDescriptorSetLayout layout);
+
+// Returns the current frame's compute command buffer, reset and begun. Work recorded into it is
+// ordered after the previous frame's compute work. Called once per frame, all compute work of the
+// frame is recorded into it.
+VkCommandBuffer beginComputePass(EngineContext& context);
+void dispatchCompute(VkCommandBuffer commandBuffer, const ComputePipeline& pipeline, VkDescriptorSet descriptorSet, const void* pushConstants, uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ);
+// Same as dispatchCompute with the group counts read from a VkDispatchIndirectCommand in buffer
+void dispatchComputeIndirect(VkCommandBuffer commandBuffer, const ComputePipeline& pipeline, VkDescriptorSet descriptorSet, const void* pushConstants, VkBuffer buffer, VkDeviceSize offset);
+// Submits the compute work. The current frame's graphics submission waits for it at waitStage.
+void submitComputePass(EngineContext& context, VkCommandBuffer commandBuffer, VkPipelineStageFlags waitStage);
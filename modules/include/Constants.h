@@ -1,3 +1,9 @@
 #pragma once
 
 static const int MAX_FRAMES_IN_FLIGHT = 2;
+
+#ifdef ENGINE_SHADERS_FOLDER
+static const char ShadersFolder[] = ENGINE_SHADERS_FOLDER;
+#else
+static const char ShadersFolder[] = "D:\\Projects\\Engine\\shaders\\";
+#endif
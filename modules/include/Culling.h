@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+#include "VectorMath.h"
+
+// Frustum culling of many bounding spheres at once. The spheres are passed as separate arrays of
+// center coordinates and radii, so four of them are tested against a plane with one SIMD operation.
+
+// visible[i] is 1 when sphere i is at least partly inside all six planes, 0 otherwise. Same results
+// as isSphereInFrustum on each sphere.
+void cullSpheres(const Plane planes[6], const float* centerX, const float* centerY, const float* centerZ, const float* radii, uint32_t count, uint8_t* visible);
+// isSphereInFrustum on each sphere, the reference the SIMD kernel is measured against
+void cullSpheresScalar(const Plane planes[6], const float* centerX, const float* centerY, const float* centerZ, const float* radii, uint32_t count, uint8_t* visible);
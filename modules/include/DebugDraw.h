@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "VectorMath.h"
+
+struct EngineContext;
+struct DebugDraw;
+
+// Immediate mode debug drawing: world space lines, boxes and spheres and screen space text, added
+// from any thread during the frame and drawn over the swapchain image at its end. Each thread adds to
+// its own buffers, which the render thread copies into one persistently mapped vertex buffer, so all
+// of it is two draws: a line list and a list of quads. Glyphs come from a built-in 3x5 pixel font,
+// each packed into the bits of one integer carried by its vertices, so there is no texture to bind.
+// The stats overlay uses the same calls to show CPU and GPU frame time graphs, the GPU time of the
+// passes marked with markDebugGpuPass and the GPU allocator's stats. ENGINE_DEBUG_OVERLAY=1 shows it.
+// Built with the ENGINE_DEBUG_DRAW option, without it every call below is an empty inline function.
+
+// R8G8B8A8
+inline uint32_t makeDebugColor(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+{
+	return r | (g << 8) | (b << 16) | (static_cast<uint32_t>(a) << 24);
+}
+
+#ifdef ENGINE_DEBUG_DRAW
+
+// After the swapchain render pass and the pipeline cache
+void createDebugDraw(EngineContext& context);
+void destroyDebugDraw(EngineContext& context);
+
+// Can be called from any thread. A frame draws the calls made before the render thread records it,
+// calls made meanwhile are handed over whole to the next frame. Shapes are drawn with context.camera
+// and without depth testing. Text is positioned in swapchain pixels from the top left, supports '\n'
+// and only has upper case letters.
+void debugDrawLine(EngineContext& context, Vec3 from, Vec3 to, uint32_t color);
+void debugDrawBox(EngineContext& context, Vec3 min, Vec3 max, uint32_t color);
+void debugDrawSphere(EngineContext& context, Vec3 center, float radius, uint32_t color);
+void debugDrawText(EngineContext& context, float x, float y, uint32_t color, const char* format, ...);
+// Screen space, for backgrounds and graphs
+void debugDrawRect(EngineContext& context, float x, float y, float width, float height, uint32_t color);
+
+// Call after waiting on the frame's fence. Reads the GPU pass times the frame slot wrote last time
+// and adds the overlay's text and graphs when it's shown.
+void updateDebugOverlay(EngineContext& context);
+
+// Bracket the frame's graphics commands, outside of rendering. Each mark ends a pass that started at
+// the previous mark, name must be a string literal.
+void beginDebugGpuPasses(EngineContext& context, VkCommandBuffer commandBuffer);
+void markDebugGpuPass(EngineContext& context, VkCommandBuffer commandBuffer, const char* name);
+
+// Draws everything added this frame, last thing between beginSwapchainRendering and endSwapchainRendering
+void recordDebugDraw(EngineContext& context, VkCommandBuffer commandBuffer);
+
+#else
+
+inline void createDebugDraw(EngineContext&) {}
+inline void destroyDebugDraw(EngineContext&) {}
+
+inline void debugDrawLine(EngineContext&, Vec3, Vec3, uint32_t) {}
+inline void debugDrawBox(EngineContext&, Vec3, Vec3, uint32_t) {}
+inline void debugDrawSphere(EngineContext&, Vec3, float, uint32_t) {}
+inline void debugDrawText(EngineContext&, float, float, uint32_t, const char*, ...) {}
+inline void debugDrawRect(EngineContext&, float, float, float, float, uint32_t) {}
+
+inline void updateDebugOverlay(EngineContext&) {}
+
+inline void beginDebugGpuPasses(EngineContext&, VkCommandBuffer) {}
+inline void markDebugGpuPass(EngineContext&, VkCommandBuffer, const char*) {}
+
+inline void recordDebugDraw(EngineContext&, VkCommandBuffer) {}
+
+#endif
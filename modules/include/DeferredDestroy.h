@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+
+// Objects still referenced by frames in flight can't be destroyed right away. They are queued
+// here and released once every frame that could have used them has retired.
+struct DeferredDestroy
+{
+	VkObjectType type;
+	uint64_t handle;
+	uint64_t frameNumber;
+};
+
+void deferDestroy(EngineContext& context, VkPipeline pipeline);
+
+// Call after waiting for the current frame's fence
+void processDeferredDestroys(EngineContext& context);
+// Call once the device is idle
+void flushDeferredDestroys(EngineContext& context);
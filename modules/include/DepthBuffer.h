@@ -0,0 +1,16 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+
+// Depth buffer shared by every pass that draws into the swapchain. It is sampled too, by the depth
+// pyramid build, so the format is the first one that supports both.
+void createDepthBuffer(EngineContext& context);
+void destroyDepthBuffer(EngineContext& context);
+
+// Barriers need the stencil aspect too when the format has one
+VkImageAspectFlags getDepthBarrierAspect(VkFormat format);
+void transitionDepthBuffer(EngineContext& context, VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout,
+	VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
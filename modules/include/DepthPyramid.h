@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+
+// Hierarchical depth for occlusion culling: a mip chain where every texel holds the min (x) and max (y)
+// depth of the depth buffer texels it covers. Level 0 is the depth buffer's size rounded down to powers
+// of two, so each further level halves the one before. An object is hidden when the nearest depth of
+// its screen rectangle is farther than the max depth of the level where that rectangle spans at most
+// 2x2 texels. The pyramid stays in GENERAL layout.
+static const uint32_t MaxDepthPyramidLevels = 16;
+
+void createDepthPyramid(EngineContext& context);
+void destroyDepthPyramid(EngineContext& context);
+
+// Reduces the depth buffer into the pyramid with one compute dispatch per level. Recorded outside of
+// rendering with the depth buffer in DEPTH_STENCIL_ATTACHMENT_OPTIMAL, which is left in
+// SHADER_READ_ONLY_OPTIMAL. Compute shaders recorded afterwards see the new pyramid.
+void buildDepthPyramid(EngineContext& context, VkCommandBuffer commandBuffer);
+
+// Sampler and view for a combined image sampler descriptor, read with texelFetch
+VkDescriptorImageInfo getDepthPyramidDescriptor(EngineContext& context);
+void getDepthPyramidSize(EngineContext& context, uint32_t& width, uint32_t& height, uint32_t& numLevels);
+// false until the first build is recorded, the pyramid's contents are undefined before
+bool isDepthPyramidBuilt(EngineContext& context);
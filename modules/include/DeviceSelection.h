@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <EASTL/vector.h>
+
+struct EngineContext;
+struct HeadlessDevices;
+
+// Everything the selection policy looks at, queried once per physical device
+struct DeviceInfo
+{
+	VkPhysicalDevice device;
+	// position in vkEnumeratePhysicalDevices order, what ENGINE_DEVICE=<index> refers to
+	uint32_t index;
+	VkPhysicalDeviceProperties properties;
+	// VkPhysicalDeviceIDProperties::deviceUUID, only queried with Vulkan 1.1
+	bool hasUuid;
+	uint8_t uuid[VK_UUID_SIZE];
+	// size of the largest device local heap
+	VkDeviceSize deviceLocalBytes;
+	// queue families that let compute and transfers run beside graphics
+	bool dedicatedCompute;
+	bool dedicatedTransfer;
+	bool graphicsTimestamps;
+	// number of the optional features the renderer uses, see scoreDevice
+	uint32_t numOptionalFeatures;
+};
+
+eastl::vector<DeviceInfo> queryDeviceInfos(VkInstance instance, uint32_t instanceApiVersion);
+
+// Higher is better. Device type dominates (discrete, integrated, virtual, other, CPU), then the number
+// of optional features, then VRAM. Queue capabilities count as features.
+uint64_t scoreDevice(const DeviceInfo& info);
+
+// Indices into infos, best score first. Ties keep the enumeration order.
+eastl::vector<uint32_t> rankDevices(const eastl::vector<DeviceInfo>& infos);
+
+// ENGINE_DEVICE picks the device instead of the scores, either by its index in enumeration order or by
+// its UUID as 32 hex digits, dashes allowed. Returns false when the variable isn't set.
+// Logs and exits when it is malformed.
+struct DeviceOverride
+{
+	bool byUuid;
+	uint32_t index;
+	uint8_t uuid[VK_UUID_SIZE];
+};
+
+bool readDeviceOverride(DeviceOverride& deviceOverride);
+bool matchesDeviceOverride(const DeviceOverride& deviceOverride, const DeviceInfo& info);
+
+void formatDeviceUuid(const uint8_t* uuid, char* text, size_t textSize);
+
+// One line per device with its index, UUID, type, VRAM and score, so overrides can be copied from the log
+void logDeviceInfos(const eastl::vector<DeviceInfo>& infos);
+
+// ENGINE_HEADLESS_DEVICES=<n> additionally opens up to n other devices with a graphics queue, without a
+// surface, for independent offscreen work. "all" opens every other device. Each is checked with a fill
+// and readback job when opened. That check is all the engine itself runs on them so far, other work
+// is handed to them with runHeadlessJobs.
+void createHeadlessDevices(EngineContext& context);
+void destroyHeadlessDevices(EngineContext& context);
+
+// What a headless job gets to record into and allocate from
+struct HeadlessDevice
+{
+	VkPhysicalDevice physicalDevice;
+	VkDevice device;
+	uint32_t queueFamily;
+	VkQueue queue;
+	VkCommandPool commandPool;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	char name[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE];
+};
+
+typedef void (*HeadlessRecordFunc)(HeadlessDevice& device, VkCommandBuffer commandBuffer, void* data);
+
+uint32_t getNumHeadlessDevices(EngineContext& context);
+
+// Records one command buffer per headless device, with data[i] for device i, submits them and waits
+// for all of them. Devices are recorded and waited on in parallel on the job system.
+void runHeadlessJobs(EngineContext& context, HeadlessRecordFunc record, void** data);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+
+enum DynamicRenderingSupport
+{
+	DynamicRenderingSupport_None,
+	// core in Vulkan 1.3
+	DynamicRenderingSupport_Core,
+	// VK_KHR_dynamic_rendering on a 1.2 device
+	DynamicRenderingSupport_Extension,
+};
+
+// Highest API version the loader offers, capped at what the engine knows how to use
+uint32_t queryInstanceApiVersion();
+
+// Setting ENGINE_DYNAMIC_RENDERING=0 forces the render pass path, e.g. to compare the two
+// Uses the physical device properties and extensions cached in the context
+DynamicRenderingSupport queryDynamicRenderingSupport(EngineContext& context);
+
+// Call after the device was created with the feature enabled
+void loadDynamicRenderingFunctions(EngineContext& context);
+
+// Begins drawing the scene into the scene color target and the depth buffer, cleared to clearColor and
+// the far plane. Only context.renderExtent of them is drawn. Uses vkCmdBeginRendering with explicit
+// layout transitions when dynamic rendering is enabled, otherwise the render passes and framebuffers.
+// Either way the color target is in SHADER_READ_ONLY layout after endSceneRendering.
+void beginSceneRendering(EngineContext& context, VkCommandBuffer commandBuffer, const VkClearValue& clearColor);
+void endSceneRendering(EngineContext& context, VkCommandBuffer commandBuffer);
+
+// Interrupts drawing so compute work can read what was drawn so far. The depth buffer is left in
+// DEPTH_STENCIL_ATTACHMENT_OPTIMAL, as it is after endSceneRendering. Resuming keeps both attachments'
+// contents and expects the depth buffer in SHADER_READ_ONLY_OPTIMAL, where buildDepthPyramid leaves it.
+void suspendSceneRendering(EngineContext& context, VkCommandBuffer commandBuffer);
+void resumeSceneRendering(EngineContext& context, VkCommandBuffer commandBuffer);
+
+// Begins drawing into the whole swapchain image without clearing it, the first draw has to cover it.
+// The image is in context.presentLayout after endSwapchainRendering.
+void beginSwapchainRendering(EngineContext& context, VkCommandBuffer commandBuffer, uint32_t imageIndex);
+void endSwapchainRendering(EngineContext& context, VkCommandBuffer commandBuffer, uint32_t imageIndex);
@@ -0,0 +1,41 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+struct DynamicResolution;
+
+// The scene is drawn into an offscreen color target the size of the swapchain, but only into its
+// top left context.renderExtent. The extent follows the GPU time of the frames in flight, measured
+// with timestamp queries and fed to a ResolutionController, and an upscale pass stretches the
+// rendered part over the swapchain image.
+// ENGINE_DYNAMIC_RESOLUTION=0 always renders at full resolution, ENGINE_GPU_BUDGET_MS sets the target
+// GPU time, ENGINE_MIN_RESOLUTION_SCALE the smallest linear scale and ENGINE_RESOLUTION_STATS=1 logs
+// the scale and GPU time every few seconds.
+
+// The offscreen target, created with the depth buffer before any pipeline. It holds HDR values when
+// context.postProcessing is set, see PostProcess.h.
+void createSceneColorTarget(EngineContext& context);
+void destroySceneColorTarget(EngineContext& context);
+
+void createDynamicResolution(EngineContext& context);
+void destroyDynamicResolution(EngineContext& context);
+
+// Call after waiting on the frame's fence. Reads the timestamps the frame slot wrote last time and
+// picks context.renderExtent for the frame about to be recorded.
+void updateDynamicResolution(EngineContext& context);
+
+// Bracket the frame's graphics commands, outside of rendering
+void beginGpuFrameTiming(EngineContext& context, VkCommandBuffer commandBuffer);
+void endGpuFrameTiming(EngineContext& context, VkCommandBuffer commandBuffer);
+// GPU time of the frame that last used the current frame slot, as read by updateDynamicResolution.
+// Negative when that frame wasn't timed.
+float getGpuFrameMilliseconds(EngineContext& context);
+
+// Draws the rendered part of the scene target over the swapchain image, between
+// beginSwapchainRendering and endSwapchainRendering
+void recordUpscale(EngineContext& context, VkCommandBuffer commandBuffer);
+// Maps the swapchain's uv to the rendered part of the scene target, and the last texel centers inside it
+// so bilinear filtering doesn't pick up stale pixels. For passes that replace the upscale pass.
+void getUpscaleUvTransform(EngineContext& context, float uvScale[2], float uvMax[2]);
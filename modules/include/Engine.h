@@ -4,4 +4,6 @@ struct EngineContext;
 
 void init(EngineContext& engineContext);
 void run(EngineContext& engineContext);
+// Instead of run, after openTraceReplay. Returns false when the replay didn't match, see FrameTrace.h.
+bool replay(EngineContext& engineContext);
 void cleanup(EngineContext& engineContext);
@@ -5,20 +5,85 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <EASTL/hash_map.h>
 #include <EASTL/vector.h>
 
+#include "Camera.h"
 #include "Constants.h"
+#include "DeferredDestroy.h"
+#include "DynamicRendering.h"
+#include "GpuMemory.h"
+#include "ResourceRegistry.h"
+#include "ShaderVariants.h"
+#include "StringId.h"
+
+struct ClusteredLighting;
+struct DebugDraw;
+struct DepthPyramid;
+struct DynamicResolution;
+struct FrameCapture;
+struct FrameTrace;
+struct HeadlessDevices;
+struct JobSystem;
+struct LodSample;
+struct MeshletSample;
+struct ParticleSample;
+struct PipelineCache;
+struct PostProcess;
+struct RenderCommands;
+struct ResourceRegistry;
+struct ShaderFileCache;
+struct ShaderHotReload;
+struct ShadowMaps;
+struct Simulation;
+struct SkinningSample;
+struct StartupTimings;
+struct Telemetry;
+
+struct SwapChainSupportDetails
+{
+	VkSurfaceCapabilitiesKHR capabilities;
+	eastl::vector<VkSurfaceFormatKHR> formats;
+	eastl::vector<VkPresentModeKHR> presentModes;
+};
 
 struct EngineContext
 {
+	// nullptr when headless
 	GLFWwindow* window;
+	// trace replays run without a window, surface or swapchain: the device is picked and created
+	// without presentation and frames end in offscreenImages
+	bool headless;
+	// leaves run or replay after the current frame, e.g. once a benchmark is done
+	bool quitRequested;
+
+	JobSystem* jobSystem;
+	StartupTimings* startupTimings;
+	// names the long lived images and buffers, see ResourceRegistry.h
+	ResourceRegistry* resourceRegistry;
 
 	VkInstance instance;
 	VkPhysicalDevice physicalDevice;
 	VkDevice device;
 
+	// queried once when the physical device is picked. The window isn't resizable, so the surface
+	// capabilities stay valid too.
+	VkPhysicalDeviceProperties physicalDeviceProperties;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	eastl::vector<VkExtensionProperties> deviceExtensions;
+	// ids of deviceExtensions' names, sorted, for hasDeviceExtension
+	eastl::vector<StringId> deviceExtensionIds;
+	SwapChainSupportDetails swapChainSupport;
+
 	VkQueue graphicsQueue;
 	VkQueue presentQueue;
+	// same as graphicsQueue when the device has no dedicated compute family
+	VkQueue computeQueue;
+	uint32_t graphicsQueueFamily;
+	uint32_t presentQueueFamily;
+	uint32_t computeQueueFamily;
+	// indexed by the family indices above, e.g. for their timestampValidBits
+	eastl::vector<VkQueueFamilyProperties> queueFamilyProperties;
 
 	VkDebugUtilsMessengerEXT debugMessenger;
 
@@ -30,17 +95,106 @@ struct EngineContext
 	VkExtent2D swapchainExtent;
 	eastl::vector<VkImageView> swapchainImageViews;
 	eastl::vector<VkFramebuffer> swapchainFramebuffers;
+	// the layout swapchain images are left in at the end of a frame. PRESENT_SRC_KHR, or TRANSFER_SRC
+	// for offscreen images, which have nothing to present them.
+	VkImageLayout presentLayout;
+	// stand in for the swapchain when headless, one per frame in flight, swapchainImages point at them
+	eastl::vector<GpuImage> offscreenImages;
+
+	// one depth buffer is enough, frames in flight are serialized on the graphics queue
+	VkFormat depthFormat;
+	GpuImage depthImage;
+	ImageHandle depthImageHandle;
+
+	// the scene is drawn into the top left renderExtent of this swapchain-sized target and upscaled,
+	// the extent is picked every frame by updateDynamicResolution
+	VkFormat sceneColorFormat;
+	GpuImage sceneColor;
+	ImageHandle sceneColorHandle;
+	VkExtent2D renderExtent;
+	// the scene target is HDR and tonemapped on its way to the swapchain, see PostProcess.h
+	bool postProcessing;
+
+	// instance API version, the device may support less
+	uint32_t apiVersion;
+	DynamicRenderingSupport dynamicRendering;
+	PFN_vkCmdBeginRenderingKHR cmdBeginRendering;
+	PFN_vkCmdEndRenderingKHR cmdEndRendering;
+
+	// VK_EXT_mesh_shader with task and mesh shaders
+	bool meshShaders;
+	PFN_vkCmdDrawMeshTasksIndirectEXT cmdDrawMeshTasksIndirect;
 
+	// VK_NULL_HANDLE with dynamic rendering, pipelines are then created against attachment formats
 	VkRenderPass renderPass;
+	// loads the attachments instead of clearing them, see resumeSceneRendering
+	VkRenderPass resumeRenderPass;
+	// draws into the swapchain image alone, used by the upscale pass
+	VkRenderPass swapchainRenderPass;
+	VkFramebuffer sceneFramebuffer;
 	VkPipelineLayout pipelineLayout;
-	VkPipeline pipeline;
+	PipelineCache* pipelineCache;
+
+	// ShaderFeature bits the scene is drawn with
+	uint32_t shaderFeatures;
+	eastl::hash_map<uint64_t, ShaderVariant> shaderVariants;
 
 	VkCommandPool commandPool;
 	VkCommandBuffer commandBuffers[MAX_FRAMES_IN_FLIGHT];
 
+	VkCommandPool computeCommandPool;
+	VkCommandBuffer computeCommandBuffers[MAX_FRAMES_IN_FLIGHT];
+	VkSemaphore computeFinishedSemaphores[MAX_FRAMES_IN_FLIGHT];
+	// non-zero when compute work was submitted this frame and graphics has to wait for it
+	VkPipelineStageFlags computeWaitStage;
+
+	VkDescriptorPool descriptorPool;
+
+	RenderCommands* renderCommands;
+
+	GpuMemoryStats gpuMemoryStats;
+
 	VkSemaphore imageAvailableSemaphores[MAX_FRAMES_IN_FLIGHT];
 	VkSemaphore renderFinishedSemaphores[MAX_FRAMES_IN_FLIGHT];
 	VkFence inFlightFences[MAX_FRAMES_IN_FLIGHT];
 
 	uint32_t currentFrame;
+	uint64_t frameNumber;
+	// getEngineTime() when the frame started, 0 before the first one. Animation reads this instead of
+	// the clock so a trace replay reproduces it, see FrameTrace.h.
+	double frameTime;
+
+	eastl::vector<DeferredDestroy> deferredDestroys;
+
+	// updated at the start of every frame
+	Camera camera;
+
+	// compiled shaders read ahead at startup, see preloadShaderFiles
+	ShaderFileCache* shaderFileCache;
+	ShaderHotReload* shaderHotReload;
+	// created before the samples, which register their shadow casters with it
+	ShadowMaps* shadowMaps;
+	ParticleSample* particleSample;
+	ClusteredLighting* clusteredLighting;
+	LodSample* lodSample;
+	MeshletSample* meshletSample;
+	SkinningSample* skinningSample;
+	// only created when something culls against it
+	DepthPyramid* depthPyramid;
+	DynamicResolution* dynamicResolution;
+	// only created when context.postProcessing is set
+	PostProcess* postProcess;
+	Simulation* simulation;
+	FrameCapture* frameCapture;
+	// only created when recording or replaying a trace
+	FrameTrace* frameTrace;
+	// stays null unless built with ENGINE_DEBUG_DRAW, see DebugDraw.h
+	DebugDraw* debugDraw;
+	// other devices opened for offscreen work, see createHeadlessDevices
+	HeadlessDevices* headlessDevices;
+	// only created when ENGINE_TELEMETRY is set, see Telemetry.h
+	Telemetry* telemetry;
 };
+
+// Looks up the extensions cached when the physical device was picked, pass makeStringId(VK_..._EXTENSION_NAME)
+bool hasDeviceExtension(const EngineContext& context, StringId name);
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <EASTL/string.h>
+#include <EASTL/vector.h>
+
+struct FileWatcher;
+
+FileWatcher* createFileWatcher(const char* directory);
+void destroyFileWatcher(FileWatcher* watcher);
+
+// Waits up to timeoutMs for files in the watched directory to be written. Names of changed files
+// (relative to the directory) are appended to changedFiles. Returns true if anything changed.
+bool waitForFileChanges(FileWatcher* watcher, int timeoutMs, eastl::vector<eastl::string>& changedFiles);
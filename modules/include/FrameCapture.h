@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+struct FrameCapture;
+
+// Captures every rendered frame. Enabled with ENGINE_CAPTURE:
+//   png    - numbered PNG files in ENGINE_CAPTURE_DIR (default: working directory)
+//   raw    - numbered .rgba files in ENGINE_CAPTURE_DIR
+//   stdout - raw RGBA frames piped to stdout for an external encoder, logging moves to stderr
+//   hash   - only a 64-bit hash of each frame's pixels, for comparing trace replays, see FrameTrace.h
+// The swapchain image is copied into a ring of host-visible buffers, one per frame in flight, and
+// read back once that frame's fence has been waited on anyway. Encoding happens on job workers.
+bool isFrameCaptureRequested();
+
+void createFrameCapture(EngineContext& context);
+// Flushes the capture first. Device must be idle.
+void destroyFrameCapture(EngineContext& context);
+// Reads back the frames still in flight and waits for encoding to finish. Device must be idle.
+void flushFrameCapture(EngineContext& context);
+
+// Call after the current frame's fence was waited on, hands the finished readback to the encoders
+void collectFrameCapture(EngineContext& context);
+// Call after the render pass ends, copies the swapchain image into the current frame's readback buffer
+void recordFrameCapture(EngineContext& context, VkCommandBuffer commandBuffer, uint32_t imageIndex);
+
+// Hash of a frame captured in hash mode, the first captured frame has index 0. False when the
+// frame wasn't hashed (yet).
+bool getCapturedFrameHash(EngineContext& context, uint64_t frameIndex, uint64_t& hash);
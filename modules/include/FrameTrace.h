@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "PipelineCache.h"
+#include "Simulation.h"
+
+struct EngineContext;
+struct FrameTrace;
+
+// Records what the engine submits into a compact binary trace and replays it as a repeatable
+// performance workload. ENGINE_TRACE=<path> records every frame's inputs (frame time, simulation
+// snapshot, render extent and shader features), its draw packets and the uploads and pipeline builds
+// made during it. Handles differ from run to run, so packets are stored with their pipeline as a hash
+// of its description and without the other handles.
+// The EngineReplay tool runs a trace without the simulation: each frame gets the recorded inputs,
+// the render features emit their packets from them and the result is checked against the recorded
+// packets. It reports each frame's CPU and GPU time, and with ENGINE_CAPTURE=hash a hash of each
+// frame's image that can be compared against the report of another build.
+// A replay is headless. There is no window, surface or swapchain, and the device is created without
+// presentation. Frames render into offscreen images of the recorded swapchain's size and format,
+// so it also runs without a display, e.g. on CI or on lavapipe.
+
+// The replay tool's entry, before init. Reads the whole trace, reportPath and referencePath may be nullptr.
+void openTraceReplay(EngineContext& context, const char* tracePath, const char* reportPath, const char* referencePath);
+bool isTraceReplay(const EngineContext& context);
+bool isTraceReplayFinished(const EngineContext& context);
+// The swapchain format and extent the trace was recorded with, what a headless replay renders at
+void getTraceSwapchain(const EngineContext& context, VkFormat& format, VkExtent2D& extent);
+
+// After the swapchain and before the pipeline cache. Starts a recording when ENGINE_TRACE is set,
+// a replay checks the swapchain matches the recorded one.
+void createFrameTrace(EngineContext& context);
+void destroyFrameTrace(EngineContext& context);
+
+// Any thread, counted towards the frame being built or towards startup before the first frame
+void traceUpload(EngineContext& context, const void* data, VkDeviceSize size);
+void tracePipelineBuild(EngineContext& context, const PipelineDesc& desc, VkPipeline pipeline);
+
+// Render thread, after updateDynamicResolution. A replay sets context.frameTime, renderExtent and
+// shaderFeatures to the recorded ones.
+void beginTraceFrame(EngineContext& context);
+// The snapshot the recorded frame was drawn with, for the replay, which has no simulation
+SimulationSnapshot getReplaySnapshot(EngineContext& context);
+void traceSnapshot(EngineContext& context, const SimulationSnapshot& snapshot);
+// Render thread, right after the frame's submit. CPU time is measured from the end of the fence
+// wait up to here, so it includes acquiring the swapchain image but not presenting it.
+void endTraceFrame(EngineContext& context);
+
+// Device must be idle. Writes the report, compares it against the reference and logs a summary.
+// Returns false when the replay diverged from the recording or its images from the reference.
+bool finishTraceReplay(EngineContext& context);
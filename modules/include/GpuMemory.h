@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+
+struct GpuBuffer
+{
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	VkDeviceSize allocationSize;
+	uint32_t heapIndex;
+	// persistently mapped when the memory is host visible
+	void* mapped;
+};
+
+// Device local image with a view over all of its mip levels
+struct GpuImage
+{
+	VkImage image;
+	VkDeviceMemory memory;
+	VkImageView view;
+	VkFormat format;
+	VkExtent2D extent;
+	uint32_t mipLevels;
+	VkDeviceSize allocationSize;
+	uint32_t heapIndex;
+};
+
+struct GpuMemoryStats
+{
+	uint64_t bytesPerHeap[VK_MAX_MEMORY_HEAPS];
+	uint32_t numLiveAllocations;
+	uint64_t numAllocationsTotal;
+};
+
+uint32_t findMemoryType(EngineContext& context, uint32_t typeBits, VkMemoryPropertyFlags properties);
+
+// The bits a timestamp written on queueFamily holds, for wrapping differences. 0 when the family can't
+// write timestamps.
+uint64_t getTimestampMask(EngineContext& context, uint32_t queueFamily);
+
+// Buffers are shared between the graphics and compute queue families, so no ownership transfers are needed
+void createGpuBuffer(EngineContext& context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, GpuBuffer& buffer);
+void destroyGpuBuffer(EngineContext& context, GpuBuffer& buffer);
+
+// Images are only used on the graphics queue, unlike buffers they are created exclusive to its family
+void createGpuImage(EngineContext& context, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags viewAspect, GpuImage& image);
+void destroyGpuImage(EngineContext& context, GpuImage& image);
+
+// Layout transition and memory dependency for the given mip levels of an image
+void recordImageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect, uint32_t baseMipLevel, uint32_t levelCount,
+	VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+// Blocking upload through a staging buffer, meant for load time. dst needs VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+void uploadToGpuBuffer(EngineContext& context, GpuBuffer& dst, const void* data, VkDeviceSize size);
+
+// Blocking transition of all mip levels out of UNDEFINED, meant for load time
+void initializeGpuImageLayout(EngineContext& context, GpuImage& image, VkImageAspectFlags aspect, VkImageLayout layout);
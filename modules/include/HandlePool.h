@@ -0,0 +1,137 @@
+#pragma once
+
+#include <assert.h>
+#include <cstdint>
+
+#include <EASTL/vector.h>
+
+#include "Log.h"
+
+// 32-bit handles into a HandlePool: the low bits pick a slot, the high bits are the slot's
+// generation when the handle was made. Removing an object bumps its slot's generation, so old
+// handles stop resolving even once the slot is reused, until the generation wraps around.
+static const uint32_t HandleIndexBits = 20;
+static const uint32_t HandleIndexMask = (1u << HandleIndexBits) - 1;
+static const uint32_t HandleGenerationMask = (1u << (32 - HandleIndexBits)) - 1;
+
+// T only tags the handle so handles of different pools don't mix. Generations start at 1, so a zero
+// initialized handle is never valid.
+template<typename T>
+struct Handle
+{
+	uint32_t value;
+};
+
+template<typename T>
+inline bool isNullHandle(Handle<T> handle)
+{
+	return handle.value == 0;
+}
+
+struct HandleSlot
+{
+	uint32_t generation;
+	// position of the object in the dense array, or the next free slot + 1 while the slot is free
+	uint32_t denseIndex;
+};
+
+// Objects are kept packed so iterating over them is a linear walk; removing one moves the last into
+// its place and fixes up that object's slot. Zero initialize before use. Not thread-safe.
+template<typename T>
+struct HandlePool
+{
+	eastl::vector<T> objects;
+	// slot of every object, parallel to objects
+	eastl::vector<uint32_t> objectSlots;
+	eastl::vector<HandleSlot> slots;
+	// first free slot + 1, 0 when none is free
+	uint32_t freeSlots;
+};
+
+template<typename T>
+Handle<T> addToPool(HandlePool<T>& pool, const T& object)
+{
+	uint32_t slotIndex;
+	if (pool.freeSlots != 0)
+	{
+		slotIndex = pool.freeSlots - 1;
+		pool.freeSlots = pool.slots[slotIndex].denseIndex;
+	}
+	else
+	{
+		slotIndex = static_cast<uint32_t>(pool.slots.size());
+		if (slotIndex > HandleIndexMask)
+		{
+			Log::fatal("Handle pool is out of slots\n");
+		}
+
+		HandleSlot slot = {};
+		slot.generation = 1;
+		pool.slots.push_back(slot);
+	}
+
+	HandleSlot& slot = pool.slots[slotIndex];
+	slot.denseIndex = static_cast<uint32_t>(pool.objects.size());
+	pool.objects.push_back(object);
+	pool.objectSlots.push_back(slotIndex);
+
+	Handle<T> handle = { (slot.generation << HandleIndexBits) | slotIndex };
+	return handle;
+}
+
+template<typename T>
+bool isHandleValid(const HandlePool<T>& pool, Handle<T> handle)
+{
+	uint32_t slotIndex = handle.value & HandleIndexMask;
+	return handle.value != 0 && slotIndex < pool.slots.size() && pool.slots[slotIndex].generation == handle.value >> HandleIndexBits;
+}
+
+// nullptr when the handle is stale, for handles that may legitimately outlive their object
+template<typename T>
+T* lookupInPool(HandlePool<T>& pool, Handle<T> handle)
+{
+	if (!isHandleValid(pool, handle))
+	{
+		return nullptr;
+	}
+
+	return &pool.objects[pool.slots[handle.value & HandleIndexMask].denseIndex];
+}
+
+// For handles that are known to be alive. Only debug builds check the generation, release builds just index.
+template<typename T>
+T& getFromPool(HandlePool<T>& pool, Handle<T> handle)
+{
+	assert(isHandleValid(pool, handle) && "stale or null handle");
+	return pool.objects[pool.slots[handle.value & HandleIndexMask].denseIndex];
+}
+
+// Returns false if the handle was already stale
+template<typename T>
+bool removeFromPool(HandlePool<T>& pool, Handle<T> handle)
+{
+	if (!isHandleValid(pool, handle))
+	{
+		return false;
+	}
+
+	uint32_t slotIndex = handle.value & HandleIndexMask;
+	HandleSlot& slot = pool.slots[slotIndex];
+
+	uint32_t lastIndex = static_cast<uint32_t>(pool.objects.size()) - 1;
+	if (slot.denseIndex != lastIndex)
+	{
+		pool.objects[slot.denseIndex] = pool.objects[lastIndex];
+		pool.objectSlots[slot.denseIndex] = pool.objectSlots[lastIndex];
+		pool.slots[pool.objectSlots[slot.denseIndex]].denseIndex = slot.denseIndex;
+	}
+	pool.objects.pop_back();
+	pool.objectSlots.pop_back();
+
+	// generation 0 is skipped when it wraps, it would let zeroed handles through
+	slot.generation = (slot.generation + 1) & HandleGenerationMask;
+	slot.generation = slot.generation ? slot.generation : 1;
+	slot.denseIndex = pool.freeSlots;
+	pool.freeSlots = slotIndex + 1;
+	return true;
+}
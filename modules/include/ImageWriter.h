@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+#include <stdio.h>
+
+// Pixels are tightly packed 8-bit RGBA rows, top to bottom.
+// PNGs are written with stored (uncompressed) deflate blocks, trading file size for encode speed.
+bool writePng(const char* path, const uint8_t* rgba, uint32_t width, uint32_t height);
+bool writeRawRgba(FILE* file, const uint8_t* rgba, uint32_t width, uint32_t height);
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// Reads through io_uring without liburing, only on Linux. AsyncFileIo falls back to reading on the job
+// system when createIoUring returns nullptr, e.g. on old kernels or when a seccomp profile blocks it.
+
+struct IoUring;
+
+// Bytes read, which may be fewer than asked for, or a negative errno. Called on the completion thread.
+typedef void (*IoUringCompletion)(void* userData, int32_t result);
+
+struct IoUringRead
+{
+	int fd;
+	void* buffer;
+	uint32_t size;
+	uint64_t offset;
+	IoUringCompletion completion;
+	void* userData;
+};
+
+IoUring* createIoUring(uint32_t numEntries);
+// Waits for the reads in flight
+void destroyIoUring(IoUring* ring);
+
+// Thread-safe. Queues the reads and submits them with as few system calls as the ring size allows.
+// Blocks while as many reads as the completion queue holds are in flight.
+void submitIoUringReads(IoUring* ring, const IoUringRead* reads, uint32_t numReads);
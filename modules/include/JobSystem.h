@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#include <atomic>
+
+struct JobSystem;
+
+typedef void (*JobFunc)(void* data);
+
+// Counts unfinished jobs. Zero-initialize before use, a counter can be reused once it reaches zero.
+struct JobCounter
+{
+	std::atomic<uint32_t> pending;
+};
+
+// numWorkers 0 means one worker per hardware thread, minus the calling thread
+JobSystem* createJobSystem(uint32_t numWorkers);
+// Finishes all queued jobs before returning
+void destroyJobSystem(JobSystem* jobSystem);
+
+void submitJob(JobSystem* jobSystem, JobFunc func, void* data, JobCounter* counter);
+// Background jobs only run on the workers, once no regular job is queued. For long jobs that must stay
+// off the threads waiting below, e.g. encoding captured frames while the render thread waits on animation.
+void submitBackgroundJob(JobSystem* jobSystem, JobFunc func, void* data, JobCounter* counter);
+// Runs queued regular jobs on the calling thread until the counter reaches zero
+void waitForCounter(JobSystem* jobSystem, JobCounter* counter);
+// Same as waitForCounter, but returns as soon as fewer than limit jobs are pending
+void waitForCounterBelow(JobSystem* jobSystem, JobCounter* counter, uint32_t limit);
+// Runs one queued regular job on the calling thread, false if there was none
+bool runPendingJob(JobSystem* jobSystem);
+
+uint32_t getNumJobWorkers(JobSystem* jobSystem);
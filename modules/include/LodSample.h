@@ -0,0 +1,15 @@
+#pragma once
+
+struct EngineContext;
+struct LodSample;
+
+// Level of detail sample: a field of instanced meshes, each drawn at the coarsest level whose
+// projected error stays under a pixel threshold, dithering between levels when they switch.
+// ENGINE_LOD_PIXEL_ERROR sets the threshold (1 by default), ENGINE_LOD_TRIANGLE_BUDGET caps the
+// triangles drawn, ENGINE_LOD_CROSSFADE sets the fade time in seconds (0 disables it) and
+// ENGINE_LOD_STATS=1 logs the selection every few seconds.
+void createLodSample(EngineContext& context);
+void destroyLodSample(EngineContext& context);
+
+// Selects levels of detail against context.camera and emits one instanced draw per level
+void emitLodSample(EngineContext& context);
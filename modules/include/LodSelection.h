@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+
+#include <EASTL/vector.h>
+
+#include "Mesh.h"
+
+struct Camera;
+
+struct LodSettings
+{
+	// largest on screen error, in pixels, a level of detail may have
+	float pixelErrorThreshold;
+	// a coarser level is only picked once its error is this fraction below the threshold, so
+	// instances near a switching distance don't flip back and forth
+	float hysteresis;
+	// triangles drawn per frame, both levels of a cross-fade included. The threshold is raised until the
+	// selection fits or every visible instance is at its coarsest level. 0 is unlimited.
+	uint32_t triangleBudget;
+	// seconds to dither between the old and new level. 0 switches immediately.
+	float crossFadeSeconds;
+};
+
+// An instance of the mesh, placed at position and uniformly scaled
+struct LodInstance
+{
+	float position[3];
+	float scale;
+};
+
+struct LodInstanceState
+{
+	uint32_t lod;
+	// level being faded out while fade is below 1
+	uint32_t previousLod;
+	float fade;
+};
+
+struct LodDraw
+{
+	uint32_t instance;
+	// dithered coverage in [0, 1]. The outgoing level of a cross-fade uses the complementary pattern,
+	// so the two levels together cover every pixel once.
+	float fade;
+	bool fadingOut;
+	float distance;
+};
+
+struct LodSelectionStats
+{
+	uint32_t numVisible;
+	uint32_t numCulled;
+	uint32_t numFading;
+	uint32_t numTriangles;
+	// threshold after fitting the triangle budget
+	float pixelErrorThreshold;
+	uint32_t numDrawsPerLod[MaxMeshLods];
+};
+
+struct LodSelection
+{
+	eastl::vector<LodInstanceState> states;
+
+	// grouped by level of detail, the draws of level i are draws[lodOffsets[i], lodOffsets[i + 1]).
+	// Sorted far to near within a level.
+	eastl::vector<LodDraw> draws;
+	uint32_t lodOffsets[MaxMeshLods + 1];
+
+	LodSelectionStats stats;
+
+	// scratch, reused every frame
+	// bounding spheres as separate arrays for cullSpheres
+	eastl::vector<float> centerX;
+	eastl::vector<float> centerY;
+	eastl::vector<float> centerZ;
+	eastl::vector<float> radii;
+	eastl::vector<uint8_t> visible;
+	eastl::vector<float> distances;
+	eastl::vector<float> pixelsPerUnit;
+	eastl::vector<uint32_t> targetLods;
+	eastl::vector<LodDraw> ungroupedDraws;
+};
+
+void initLodSelection(LodSelection& selection, uint32_t numInstances);
+
+// Picks the level of detail of every instance from its projected error, culls instances outside
+// the camera frustum and advances cross-fades by deltaTime.
+void selectLods(LodSelection& selection, const LodSettings& settings, const Mesh& mesh, const LodInstance* instances, uint32_t numInstances, const Camera& camera, float screenHeight, float deltaTime);
@@ -9,13 +9,19 @@
 class Log
 {
 public:
+	// stdout by default. Moved to stderr when stdout carries other data, e.g. captured frames.
+	static void setOutput(FILE* file)
+	{
+		output() = file;
+	}
+
 	static void log(const char* format, ...)
 	{
 		printPrefix("log");
 
 		va_list argptr;
 		va_start(argptr, format);
-		vfprintf(stdout, format, argptr);
+		vfprintf(output(), format, argptr);
 		va_end(argptr);
 	}
 
@@ -25,7 +31,7 @@ public:
 
 		va_list argptr;
 		va_start(argptr, format);
-		vfprintf(stdout, format, argptr);
+		vfprintf(output(), format, argptr);
 		va_end(argptr);
 	}
 
@@ -35,7 +41,7 @@ public:
 
 		va_list argptr;
 		va_start(argptr, format);
-		vfprintf(stdout, format, argptr);
+		vfprintf(output(), format, argptr);
 		va_end(argptr);
 	}
 
@@ -45,7 +51,7 @@ public:
 
 		va_list argptr;
 		va_start(argptr, format);
-		vfprintf(stdout, format, argptr);
+		vfprintf(output(), format, argptr);
 		va_end(argptr);
 
 		DEBUG_BREAK();
@@ -54,8 +60,14 @@ public:
 	}
 
 private:
+	static FILE*& output()
+	{
+		static FILE* file = stdout;
+		return file;
+	}
+
 	static void printPrefix(const char* prefix)
 	{
-		printf("[%s] ", prefix);
+		fprintf(output(), "[%s] ", prefix);
 	}
 };
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+#include <EASTL/vector.h>
+
+static const uint32_t MaxMeshLods = 8;
+
+struct MeshVertex
+{
+	float position[3];
+	float normal[3];
+};
+
+// A range of mesh indices drawing the whole mesh at one level of detail
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t numIndices;
+	// largest object space distance between this level's surface and the original one
+	float error;
+};
+
+// Indexed triangle mesh. All levels of detail share the vertices; lods[0] is the full detail mesh
+// and every level's indices follow the previous one's.
+struct Mesh
+{
+	eastl::vector<MeshVertex> vertices;
+	eastl::vector<uint32_t> indices;
+
+	MeshLod lods[MaxMeshLods];
+	uint32_t numLods;
+
+	float boundsCenter[3];
+	float boundsRadius;
+};
+
+// Unit icosphere subdivided numSubdivisions times, with its radius modulated by a few sine waves
+// so that simplification has detail to remove. Has a single level of detail.
+void makeBumpySphereMesh(uint32_t numSubdivisions, float bumpiness, Mesh& mesh);
+
+// Smooth vertex normals from the first level of detail's triangles
+void computeMeshNormals(Mesh& mesh);
+void computeMeshBounds(Mesh& mesh);
@@ -0,0 +1,19 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+
+// True when both the instance and the device are Vulkan 1.2 or newer (mesh shaders are SPIR-V 1.4) and
+// the device has VK_EXT_mesh_shader with the task and mesh shader features. That includes CPU devices:
+// lavapipe takes the mesh path too when its Mesa is recent enough to expose the extension.
+// Setting ENGINE_MESH_SHADERS=0 forces the vertex shader path on any device, any other value is ignored.
+// Uses the physical device properties and extensions cached in the context
+bool queryMeshShaderSupport(EngineContext& context);
+
+// Adds the features to enable to the device create info's pNext chain
+void chainMeshShaderFeatures(EngineContext& context, VkPhysicalDeviceMeshShaderFeaturesEXT& features, const void*& pNext);
+
+// Call after the device was created with the features enabled
+void loadMeshShaderFunctions(EngineContext& context);
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+#include <EASTL/vector.h>
+
+struct Mesh;
+
+// Quadric error edge collapse. Collapses move a vertex onto one of its neighbours, so the result
+// indexes the same vertices as the input. Collapses that would flip a triangle are skipped and
+// open borders are kept in place. Returns the largest error introduced, as an object space distance.
+float simplifyMesh(const Mesh& mesh, const uint32_t* indices, uint32_t numIndices, uint32_t targetNumIndices, eastl::vector<uint32_t>& result);
+
+// Replaces mesh's levels of detail with a chain generated from lods[0], each level having about
+// reduction times the triangles of the previous one. Stops at MaxMeshLods, at minTriangles, or when
+// simplification stops making progress.
+void generateMeshLods(Mesh& mesh, float reduction, uint32_t minTriangles);
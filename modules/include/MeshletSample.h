@@ -0,0 +1,30 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+struct MeshletSample;
+
+// Meshlet sample, enabled with ENGINE_MESHLETS=1 in place of the level of detail sample. The same
+// field of meshes is drawn at full detail, split into meshlets that a compute pass culls against
+// the frustum, by their normal cones and against the depth pyramid. The visible meshlets are drawn
+// with task and mesh shaders when the device has them, otherwise with one indirect instanced draw
+// through the vertex shader.
+// Occlusion culling has two phases so nothing pops in when the camera moves: the early phase tests
+// against the previous frame's depth and draws what passes in DrawPass_Opaque. The pyramid is then
+// rebuilt from that depth and the late phase re-tests only the meshlets the early phase rejected,
+// drawing the ones that became visible in DrawPass_OpaqueLate.
+// ENGINE_MESHLET_STATS=1 logs the meshlet counts of both phases every few seconds.
+bool isMeshletSampleRequested();
+
+// Needs the depth pyramid
+void createMeshletSample(EngineContext& context);
+void destroyMeshletSample(EngineContext& context);
+
+// Both phases are recorded into the frame's graphics command buffer outside of rendering, since
+// they depend on the depth the graphics queue produces. The early phase goes before rendering
+// begins, the late phase after the depth pyramid was built from DrawPass_Opaque.
+void cullMeshletSampleEarly(EngineContext& context, VkCommandBuffer commandBuffer);
+void cullMeshletSampleLate(EngineContext& context, VkCommandBuffer commandBuffer);
+void emitMeshletSample(EngineContext& context);
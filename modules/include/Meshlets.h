@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+#include <EASTL/vector.h>
+
+struct Mesh;
+
+// Limits that suit both the mesh shader path (one workgroup per meshlet) and the vertex path (one
+// instance per meshlet, drawn with MaxMeshletTriangles * 3 vertices)
+static const uint32_t MaxMeshletVertices = 64;
+static const uint32_t MaxMeshletTriangles = 124;
+
+// A small cluster of connected triangles. Matches the std430 layout of Meshlet in meshlet.glsl.
+struct Meshlet
+{
+	// into MeshletMesh::vertices and MeshletMesh::triangles
+	uint32_t vertexOffset;
+	uint32_t triangleOffset;
+	uint32_t numVertices;
+	uint32_t numTriangles;
+
+	float center[3];
+	float radius;
+
+	// Every triangle faces away from a viewer at position p when
+	// dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius.
+	// coneCutoff is 1 when the normals spread too far for the test to ever pass.
+	float coneAxis[3];
+	float coneCutoff;
+};
+
+struct MeshletMesh
+{
+	eastl::vector<Meshlet> meshlets;
+	// mesh vertex index of each meshlet vertex
+	eastl::vector<uint32_t> vertices;
+	// one entry per triangle, three meshlet-local vertex indices packed in the low 24 bits
+	eastl::vector<uint32_t> triangles;
+};
+
+// Splits one level of detail of mesh into meshlets. Triangles are added greedily, preferring the
+// ones that bring the fewest new vertices along, so meshlets stay connected and compact.
+void buildMeshlets(const Mesh& mesh, uint32_t lod, MeshletMesh& result);
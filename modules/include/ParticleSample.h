@@ -0,0 +1,21 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+struct ParticleSample;
+
+// GPU particle system on the async compute queue. Every frame a fountain emits into free slots taken
+// from a dead list, the update integrates the alive particles and compacts the survivors into the
+// other of two alive lists, and a bitonic sort orders them back to front for alpha blending. Counts
+// only ever live on the GPU: single thread passes turn them into indirect dispatch and draw
+// arguments, so the CPU does no per-particle work and reads nothing back.
+// ENGINE_PARTICLES sets the capacity, 1M by default and 64K on a CPU implementation. All buffers come
+// from createGpuBuffer.
+void createParticleSample(EngineContext& context);
+void destroyParticleSample(EngineContext& context);
+
+// Records the simulation into the frame's compute command buffer
+void simulateParticleSample(EngineContext& context, VkCommandBuffer commandBuffer);
+void emitParticleSample(EngineContext& context);
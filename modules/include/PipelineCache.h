@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+struct PipelineCache;
+
+enum BlendMode : uint32_t
+{
+	BlendMode_Opaque,
+	BlendMode_Additive,
+	BlendMode_Alpha,
+};
+
+static const uint32_t MaxPipelineVertexBindings = 4;
+static const uint32_t MaxPipelineVertexAttributes = 8;
+
+// Everything that identifies a graphics pipeline. Viewport and scissor are always dynamic.
+// Shader names are sources relative to the shaders folder ("shader.vert"), the compiled ".spv"
+// next to them is loaded, and they must be string literals or otherwise outlive the cache.
+struct PipelineDesc
+{
+	const char* vertexShader;
+	// nullptr for depth-only pipelines
+	const char* fragmentShader;
+	// set meshShader instead of vertexShader for a mesh shading pipeline, taskShader is optional.
+	// Vertex input and topology are ignored then.
+	const char* taskShader;
+	const char* meshShader;
+	// ShaderFeature bits, see ShaderVariants.h
+	uint32_t shaderFeatures;
+
+	VkPipelineLayout layout;
+
+	uint32_t numVertexBindings;
+	VkVertexInputBindingDescription vertexBindings[MaxPipelineVertexBindings];
+	uint32_t numVertexAttributes;
+	VkVertexInputAttributeDescription vertexAttributes[MaxPipelineVertexAttributes];
+	VkPrimitiveTopology topology;
+
+	VkPolygonMode polygonMode;
+	VkCullModeFlags cullMode;
+	VkFrontFace frontFace;
+
+	VkBool32 depthTestEnable;
+	VkBool32 depthWriteEnable;
+	VkCompareOp depthCompareOp;
+	// depth bias is enabled when either is non-zero, meant for shadow map passes
+	float depthBiasConstant;
+	float depthBiasSlope;
+
+	BlendMode blendMode;
+
+	// VK_NULL_HANDLE for dynamic rendering, the formats are used instead
+	VkRenderPass renderPass;
+	VkFormat colorFormat;
+	VkFormat depthFormat;
+	VkSampleCountFlagBits samples;
+};
+
+struct PipelineCacheStats
+{
+	uint64_t numHits;
+	uint64_t numMisses;
+	// lookups that found another thread already building the same pipeline and waited for it
+	uint64_t numWaitedForBuild;
+	uint64_t numDerivatives;
+};
+
+// Same state as the engine's original triangle pipeline: triangle list, back face culling, no depth, opaque
+PipelineDesc makeDefaultPipelineDesc();
+uint64_t hashPipelineDesc(const PipelineDesc& desc);
+// Leaves out the layout and render pass handles, so the same description hashes the same in every run
+uint64_t hashPipelineDescContents(const PipelineDesc& desc);
+
+void createPipelineCache(EngineContext& context);
+void destroyPipelineCache(EngineContext& context);
+
+// Thread-safe lookup-or-create. Concurrent requests for the same description build it only once.
+// The cache owns the pipeline. Hot reload may replace it at a frame boundary, so don't hold on to
+// the handle across frames.
+VkPipeline getPipeline(EngineContext& context, const PipelineDesc& desc);
+
+PipelineCacheStats getPipelineCacheStats(EngineContext& context);
+void reportPipelineCacheStats(EngineContext& context);
@@ -0,0 +1,36 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+struct PostProcess;
+
+// The scene is drawn into an HDR target and brought to the swapchain by two passes instead of one
+// full screen pass per effect:
+// - one compute dispatch reads the rendered part of the target once. Each workgroup prefilters a
+//   64x64 tile into the first bloom level, reduces it to the next four in shared memory and adds the
+//   tile's luminance to a histogram, binned with subgroup ballots. The last workgroup to finish turns
+//   the histogram into the exposure, adapted over time, and clears it for the next frame.
+// - the upscale pass exposes, adds the bloom levels, color grades and tonemaps while it stretches
+//   the scene over the swapchain image, so no intermediate LDR target is written.
+// ENGINE_POST_PROCESS=0 keeps the scene target in the swapchain format and skips all of it.
+// ENGINE_AUTO_EXPOSURE=0 fixes the exposure, ENGINE_EXPOSURE offsets it in stops either way,
+// ENGINE_BLOOM sets the bloom strength (0.5 by default) and ENGINE_POST_STATS=1 logs the dispatch's
+// GPU time every few seconds, with an analytic estimate of its memory traffic next to that of a chain
+// of separate passes. ENGINE_POST_COMPARE=1 also runs the dispatch's work as separate passes each
+// frame, into a target of their own, and logs their measured GPU time next to it.
+
+// Checks the setting and whether the device has the subgroup operations the chain needs. The result
+// goes into context.postProcessing when the scene target is created and decides its format.
+bool queryPostProcessSupport(EngineContext& context);
+VkFormat chooseHdrSceneColorFormat(EngineContext& context);
+
+// Only created when context.postProcessing is set, after the scene target and dynamic resolution
+void createPostProcess(EngineContext& context);
+void destroyPostProcess(EngineContext& context);
+
+// Records the compute part after endSceneRendering, outside of any rendering
+void recordPostProcess(EngineContext& context, VkCommandBuffer commandBuffer);
+// Replaces recordUpscale between beginSwapchainRendering and endSwapchainRendering
+void recordTonemap(EngineContext& context, VkCommandBuffer commandBuffer);
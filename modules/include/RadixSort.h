@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string.h>
+
+// LSD radix sort of 64-bit keys with 8-bit digits, carrying a 32-bit value along with each key.
+// Stable. Passes where every key has the same digit are skipped, which is the common case for
+// the high bits of sort keys. scratchKeys/scratchValues must hold count elements; the result
+// ends up in keys/values.
+inline void radixSort64(uint64_t* keys, uint32_t* values, uint64_t* scratchKeys, uint32_t* scratchValues, uint32_t count)
+{
+	uint32_t histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint64_t key = keys[i];
+		for (int pass = 0; pass < 8; ++pass)
+		{
+			++histograms[pass][(key >> (pass * 8)) & 0xff];
+		}
+	}
+
+	uint64_t* srcKeys = keys;
+	uint32_t* srcValues = values;
+	uint64_t* dstKeys = scratchKeys;
+	uint32_t* dstValues = scratchValues;
+
+	for (int pass = 0; pass < 8; ++pass)
+	{
+		uint32_t* histogram = histograms[pass];
+		if (count == 0 || histogram[(srcKeys[0] >> (pass * 8)) & 0xff] == count)
+		{
+			continue;
+		}
+
+		uint32_t offset = 0;
+		for (int digit = 0; digit < 256; ++digit)
+		{
+			uint32_t digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			uint32_t destination = histogram[(srcKeys[i] >> (pass * 8)) & 0xff]++;
+			dstKeys[destination] = srcKeys[i];
+			dstValues[destination] = srcValues[i];
+		}
+
+		uint64_t* tempKeys = srcKeys;
+		srcKeys = dstKeys;
+		dstKeys = tempKeys;
+		uint32_t* tempValues = srcValues;
+		srcValues = dstValues;
+		dstValues = tempValues;
+	}
+
+	if (srcKeys != keys)
+	{
+		memcpy(keys, srcKeys, count * sizeof(uint64_t));
+		memcpy(values, srcValues, count * sizeof(uint32_t));
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+struct RenderCommands;
+
+// Passes are drawn in enum order
+enum DrawPass : uint32_t
+{
+	// full screen passes that everything else is drawn over
+	DrawPass_Background,
+	DrawPass_Opaque,
+	// opaque draws culled against the depth of DrawPass_Opaque, recorded after the depth pyramid is built
+	DrawPass_OpaqueLate,
+	DrawPass_Additive,
+};
+
+static const uint32_t MaxDrawPushConstantSize = 32;
+
+enum DrawType : uint32_t
+{
+	// vkCmdDraw with the packet's counts
+	DrawType_Direct,
+	// one VkDrawIndirectCommand read from indirectBuffer
+	DrawType_Indirect,
+	// one VkDrawMeshTasksIndirectCommandEXT read from indirectBuffer, needs context.meshShaders
+	DrawType_MeshTasksIndirect,
+};
+
+// Everything needed to issue one draw. The sort key decides the order draws are recorded in.
+struct DrawPacket
+{
+	uint64_t sortKey;
+
+	VkPipeline pipeline;
+	VkPipelineLayout pipelineLayout;
+	VkDescriptorSet descriptorSet;
+
+	DrawType drawType;
+	uint32_t vertexCount;
+	uint32_t instanceCount;
+	uint32_t firstVertex;
+	uint32_t firstInstance;
+	VkBuffer indirectBuffer;
+	VkDeviceSize indirectOffset;
+
+	VkShaderStageFlags pushConstantStages;
+	uint32_t pushConstantSize;
+	uint8_t pushConstants[MaxDrawPushConstantSize];
+};
+
+struct RenderCommandStats
+{
+	uint32_t numDraws;
+	uint32_t numPipelineBinds;
+	uint32_t numDescriptorSetBinds;
+	// binds skipped because the state was already set
+	uint32_t numRedundantBindsSkipped;
+};
+
+// Key layout, most significant first: pass (4 bits), pipeline (16 bits), material (20 bits), depth (24 bits).
+// depth is in [0, 1]; draws that need back-to-front order should pass 1 - depth.
+uint64_t makeDrawSortKey(DrawPass pass, VkPipeline pipeline, uint32_t material, float depth);
+
+void createRenderCommands(EngineContext& context);
+void destroyRenderCommands(EngineContext& context);
+
+// Can be called from any thread. Each thread appends to its own buffer, so no locks are taken
+// after a thread's first packet. Packets emitted while sortRenderCommands runs are safe and go to
+// the next frame, a frame's emission should still finish before its sort to be drawn with it.
+void emitDrawPacket(EngineContext& context, const DrawPacket& packet);
+
+// Render thread only. Gathers the packets of every thread and sorts them by key.
+void sortRenderCommands(EngineContext& context);
+// Render thread only. The packets the last sortRenderCommands gathered, in no particular order.
+const DrawPacket* getGatheredDrawPackets(EngineContext& context, uint32_t& numPackets);
+// Render thread only. Records the sorted packets of passes firstPass to lastPass into commandBuffer,
+// binding pipelines and descriptor sets only when they change. Called once per range of passes
+// so other work can be recorded in between, e.g. DrawPass_OpaqueLate needs the depth pyramid.
+void executeRenderCommands(EngineContext& context, VkCommandBuffer commandBuffer, DrawPass firstPass, DrawPass lastPass);
+
+// Totals of all executeRenderCommands calls since the last sort
+const RenderCommandStats& getRenderCommandStats(EngineContext& context);
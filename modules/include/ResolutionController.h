@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+struct ResolutionSettings
+{
+	// GPU time per frame the controller steers towards, in milliseconds
+	float budgetMilliseconds;
+	// bounds of the linear scale, 1 is full resolution
+	float minScale;
+	float maxScale;
+	// gains of the PID controller on the budget error, which is normalized by the budget
+	float proportionalGain;
+	float integralGain;
+	float derivativeGain;
+	// weight of a new measurement in the smoothed frame time, lower is smoother but slower to react
+	float smoothing;
+};
+
+// PID controller in velocity form: every measurement scales the rendered pixel area by
+// 1 + Kp * (e - e1) + Ki * e + Kd * (e - 2 e1 + e2), where e is the fraction of the budget left over.
+// GPU time is roughly proportional to the area, so the relative change keeps the loop's response the
+// same for light and heavy scenes. Clamping the area is all the anti-windup the velocity form needs.
+struct ResolutionController
+{
+	ResolutionSettings settings;
+	// fraction of the full resolution's pixels that are rendered
+	float area;
+	float smoothedMilliseconds;
+	float errors[2];
+	uint32_t numMeasurements;
+};
+
+ResolutionSettings makeDefaultResolutionSettings();
+void initResolutionController(ResolutionController& controller, const ResolutionSettings& settings);
+
+// Feeds the GPU time of one frame and returns the linear scale the next frame renders at
+float updateResolutionController(ResolutionController& controller, float gpuMilliseconds);
+float getResolutionScale(const ResolutionController& controller);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "HandlePool.h"
+#include "StringId.h"
+
+struct EngineContext;
+struct GpuBuffer;
+struct GpuImage;
+struct ResourceRegistry;
+
+// Names the engine's long lived GPU resources so other subsystems and tools can use them without
+// reaching into the subsystem that owns them. The registry doesn't own anything: owners register
+// what they create and unregister it before destroying it. Names are string literals, their ids
+// must be unique, which registration checks. Lookups by handle don't allocate or touch strings.
+// Registration isn't thread-safe, it happens while the engine is created or between frames.
+
+struct RegisteredImage
+{
+	const char* name;
+	StringId id;
+	VkImage image;
+	VkImageView view;
+	VkFormat format;
+	VkExtent2D extent;
+	uint32_t mipLevels;
+	VkImageAspectFlags aspect;
+	// the layout the owner leaves it in between frames
+	VkImageLayout layout;
+	VkDeviceSize allocationSize;
+};
+
+struct RegisteredBuffer
+{
+	const char* name;
+	StringId id;
+	VkBuffer buffer;
+	VkDeviceSize size;
+	// nullptr unless host visible
+	void* mapped;
+};
+
+typedef Handle<RegisteredImage> ImageHandle;
+typedef Handle<RegisteredBuffer> BufferHandle;
+
+void createResourceRegistry(EngineContext& context);
+// Warns about anything still registered
+void destroyResourceRegistry(EngineContext& context);
+
+ImageHandle registerImage(EngineContext& context, const char* name, const GpuImage& image, VkImageAspectFlags aspect, VkImageLayout layout);
+BufferHandle registerBuffer(EngineContext& context, const char* name, const GpuBuffer& buffer);
+void unregisterImage(EngineContext& context, ImageHandle handle);
+void unregisterBuffer(EngineContext& context, BufferHandle handle);
+// For owners whose image ends frames in another layout than it was registered with
+void setRegisteredImageLayout(EngineContext& context, ImageHandle handle, VkImageLayout layout);
+
+// For handles that are known to be alive, only debug builds check the generation
+const RegisteredImage& getRegisteredImage(EngineContext& context, ImageHandle handle);
+
+// Packed arrays, for walking over everything registered, see the debug overlay. Valid until the next
+// registration.
+const RegisteredImage* getRegisteredImages(EngineContext& context, uint32_t& numImages);
+const RegisteredBuffer* getRegisteredBuffers(EngineContext& context, uint32_t& numBuffers);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+struct ShaderHotReload;
+
+// Builds a pipeline from the current .spv files. userData is what was passed at registration. Called from
+// the hot reload thread, so it must only read state that stays constant while the engine runs.
+// Returns VK_NULL_HANDLE on failure.
+typedef VkPipeline (*PipelineBuildFunc)(EngineContext& context, const void* userData);
+// Writes pipeline to target and returns the pipeline it replaced, for targets other threads read under
+// their own lock. Called by applyShaderHotReload. Without one target is assigned directly.
+typedef VkPipeline (*PipelineSwapFunc)(VkPipeline* target, VkPipeline pipeline, const void* userData);
+
+// Development mode: watches shader sources, recompiles them on a background thread and rebuilds
+// the pipelines that use them. New pipelines are swapped in by applyShaderHotReload at a frame boundary.
+// The sources and their glslc arguments come from shaders/sources.list, which compile.py reads too.
+// A changed .glsl recompiles every source that includes it, directly or through other includes.
+void startShaderHotReload(EngineContext& context);
+void stopShaderHotReload(EngineContext& context);
+
+// shaderSources are source names relative to the shaders folder, e.g. "shader.vert". swap may be nullptr.
+void registerHotReloadPipeline(EngineContext& context, VkPipeline* pipeline, const char* const* shaderSources, uint32_t numShaderSources, PipelineBuildFunc build, PipelineSwapFunc swap, const void* userData);
+// Waits for a rebuild in progress, after that the build function isn't called for this pipeline anymore.
+// Pipelines built but not swapped in yet are destroyed.
+void unregisterHotReloadPipeline(EngineContext& context, VkPipeline* pipeline);
+
+// Call at the start of a frame, after its fence was waited on. Never blocks.
+void applyShaderHotReload(EngineContext& context);
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "PipelineCache.h"
+
+struct EngineContext;
+
+// Each feature bit maps to the specialization constant with constant_id equal to the bit index,
+// declared in the shaders as `layout(constant_id = N) const bool ...`. Branches on them are
+// folded away when the pipeline is compiled.
+enum ShaderFeature : uint32_t
+{
+	ShaderFeature_Grayscale = 1 << 0,
+	ShaderFeature_Invert = 1 << 1,
+};
+
+static const uint32_t NUM_SHADER_FEATURES = 2;
+
+// A set of shaders that can be specialized into variants
+struct ShaderProgram
+{
+	const char* name;
+	const char* vertexShader;
+	const char* fragmentShader;
+	// features the program's shaders actually read, others are masked out of the variant key
+	uint32_t supportedFeatures;
+};
+
+struct ShaderVariant
+{
+	const ShaderProgram* program;
+	uint32_t features;
+	VkPipeline pipeline;
+	uint64_t numUses;
+};
+
+struct ShaderSpecialization
+{
+	VkSpecializationMapEntry entries[NUM_SHADER_FEATURES];
+	VkBool32 values[NUM_SHADER_FEATURES];
+	VkSpecializationInfo info;
+};
+
+uint64_t makeShaderVariantKey(const ShaderProgram& program, uint32_t features);
+// The returned info points into specialization, which must outlive pipeline creation
+const VkSpecializationInfo* makeShaderSpecialization(uint32_t features, ShaderSpecialization& specialization);
+
+// Returns the pipeline for the variant, building it through the pipeline cache on first use.
+// stateDesc supplies the fixed function state; its shaders and features are overridden by the variant.
+VkPipeline getShaderVariant(EngineContext& context, const ShaderProgram& program, uint32_t features, const PipelineDesc& stateDesc);
+// Builds variants ahead of time so their first use doesn't hitch
+void prewarmShaderVariants(EngineContext& context, const ShaderProgram& program, const uint32_t* features, uint32_t numFeatures, const PipelineDesc& stateDesc);
+
+void reportShaderVariantUsage(EngineContext& context);
+// The pipelines themselves are owned by the pipeline cache
+void destroyShaderVariants(EngineContext& context);
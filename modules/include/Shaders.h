@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include <EASTL/vector.h>
+
+struct EngineContext;
+struct ShaderFileCache;
+
+// Written by compile.py, lists every compiled shader
+static const char ShaderManifest[] = "shaders.manifest";
+
+// filename is relative to the shaders folder. Returns an empty vector if the file can't be read.
+eastl::vector<uint8_t> readShaderFile(const char* filename);
+VkShaderModule createShaderModule(VkDevice device, const eastl::vector<uint8_t>& code);
+
+// Reads every shader in the manifest through the asset pipeline in one batch and keeps them in memory
+void preloadShaderFiles(EngineContext& context);
+void destroyShaderFileCache(EngineContext& context);
+
+// Preloaded code when there is some, otherwise the same as readShaderFile. Thread-safe.
+eastl::vector<uint8_t> loadShaderFile(EngineContext& context, const char* filename);
+// Drops the preloaded copy of a file that was recompiled
+void evictShaderFile(EngineContext& context, const char* filename);
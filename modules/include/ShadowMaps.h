@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "Constants.h"
+#include "VectorMath.h"
+
+struct EngineContext;
+struct GpuBuffer;
+struct MeshVertex;
+struct ShadowMaps;
+
+// Cascaded shadow maps for a directional light. The camera's view range is split into cascades,
+// each rendered into its own square of one depth atlas. Cascades are fitted to a bounding sphere
+// of their slice of the view frustum and snapped to whole texels, so shadow edges don't shimmer as
+// the camera moves. Distant cascades are fitted with some margin and their contents kept across
+// frames as long as they only hold static casters: they are redrawn when the light moves, static
+// casters change, a dynamic caster enters them or the camera leaves the area they cover.
+// ENGINE_SHADOWS=0 turns shadows off, ENGINE_SHADOW_MAP_SIZE sets the size of a cascade (2048 by
+// default), ENGINE_SHADOW_DISTANCE how far they reach (the camera's far plane by default),
+// ENGINE_SHADOW_CACHE=0 redraws every cascade every frame, ENGINE_SHADOW_LIGHT_SPEED rotates the
+// light in radians per second and ENGINE_SHADOW_STATS=1 logs cascade redraws every few seconds.
+
+static const uint32_t MaxShadowCascades = 4;
+
+// Receivers add these many bindings to their descriptor set, see shadows.glsl
+static const uint32_t NumShadowReceiverBindings = 2;
+
+// Geometry drawn into the shadow maps, pulled by shadow.vert like the samples pull their vertices
+struct ShadowCasterDesc
+{
+	// Positions only, three floats per vertex, so depth passes read half as much as they would
+	// from MeshVertex. Geometry rewritten every frame has one buffer per frame in flight,
+	// otherwise every slot holds the same buffer.
+	VkBuffer positionBuffers[MAX_FRAMES_IN_FLIGHT];
+	// uint32 indices, drawn without an index buffer
+	VkBuffer indexBuffer;
+	// indices drawn in each cascade, distant cascades can use coarser levels of detail
+	uint32_t firstIndex[MaxShadowCascades];
+	uint32_t numIndices[MaxShadowCascades];
+	// static casters only change through setShadowCasterInstances, cascades holding nothing else are cached
+	bool isStatic;
+};
+
+struct ShadowInstance
+{
+	// world position of a vertex is position + vertex * scale
+	Vec3 position;
+	float scale;
+	// added to every index, e.g. to pick one character out of a buffer of many
+	uint32_t vertexOffset;
+	// world space bounding sphere, for culling
+	Vec3 boundsCenter;
+	float boundsRadius;
+};
+
+// Created before the samples, which register their casters and receivers while they are created
+void createShadowMaps(EngineContext& context);
+void destroyShadowMaps(EngineContext& context);
+
+// Converts a mesh's vertices into the position-only stream casters are drawn from
+void createShadowPositionBuffer(EngineContext& context, const MeshVertex* vertices, uint32_t numVertices, GpuBuffer& buffer);
+
+// Returns the caster's index for setShadowCasterInstances
+uint32_t addShadowCaster(EngineContext& context, const ShadowCasterDesc& desc);
+// Replaces the caster's instances, they are kept until the next call. Dynamic casters can move them
+// every frame before updateShadowMaps, calling this for a static caster invalidates every cached cascade.
+void setShadowCasterInstances(EngineContext& context, uint32_t caster, const ShadowInstance* instances, uint32_t numInstances);
+
+// Fits the cascades to context.camera, decides which ones are redrawn and culls the casters of
+// those into them. Call after the frame's instances were set.
+void updateShadowMaps(EngineContext& context);
+// Records the depth passes of the cascades updateShadowMaps picked, outside of any other rendering.
+// The atlas is left in SHADER_READ_ONLY_OPTIMAL.
+void recordShadowMaps(EngineContext& context, VkCommandBuffer commandBuffer);
+
+// The cascades uniform at firstBinding and the atlas with its comparison sampler at firstBinding + 1
+void makeShadowReceiverBindings(uint32_t firstBinding, VkShaderStageFlags stages, VkDescriptorSetLayoutBinding* bindings);
+void writeShadowReceiverDescriptors(EngineContext& context, VkDescriptorSet set, uint32_t firstBinding, uint32_t slot);
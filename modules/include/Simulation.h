@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+struct EngineContext;
+struct Simulation;
+
+static const double SimulationTickRate = 60.0;
+
+// Everything the render thread needs from one simulation tick
+struct SimulationSnapshot
+{
+	uint64_t tick;
+	double time;
+
+	float position[2];
+	float rotation;
+};
+
+// Runs the simulation at a fixed tick on its own thread. Snapshots are handed to the render thread
+// through a lock-free triple buffer, so neither side ever waits for the other.
+void startSimulation(EngineContext& context);
+void stopSimulation(EngineContext& context);
+
+// Render thread only. Returns the state at the current render time, interpolated between the two
+// latest snapshots. Rendering runs one tick behind the simulation so there's always something to
+// interpolate towards.
+SimulationSnapshot getInterpolatedSnapshot(EngineContext& context);
@@ -0,0 +1,23 @@
+#pragma once
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+struct EngineContext;
+struct SkinningSample;
+
+// Skinned crowd sample, enabled with ENGINE_SKINNING=1 in place of the level of detail sample. Every
+// character plays two compressed clips blended by a changing weight. Their poses are sampled,
+// blended and turned into skinning matrices in parallel jobs, then a compute pass skins every
+// vertex of every character into a world space vertex buffer once per frame. Draws only read that
+// buffer, so any number of passes can draw the crowd without skinning it again.
+// ENGINE_SKINNING_CHARACTERS sets the crowd size (1024 by default) and ENGINE_SKINNING_STATS=1 logs
+// the time spent animating every few seconds.
+bool isSkinningSampleRequested();
+
+void createSkinningSample(EngineContext& context);
+void destroySkinningSample(EngineContext& context);
+
+// Animates the crowd on the job system and records the skinning into the frame's compute command buffer
+void skinSkinningSample(EngineContext& context, VkCommandBuffer commandBuffer);
+void emitSkinningSample(EngineContext& context);
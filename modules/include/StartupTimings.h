@@ -0,0 +1,15 @@
+#pragma once
+
+struct EngineContext;
+struct StartupTimings;
+
+typedef void (*StartupStageFunc)(EngineContext& context);
+
+// Collects how long each init stage took, and on which thread, until the first frame is presented
+void beginStartupTimings(EngineContext& context);
+
+// Runs and times one stage. Safe to call from job workers for stages that run in parallel.
+void runStartupStage(EngineContext& context, const char* name, StartupStageFunc stage);
+
+// Call once the first frame was presented. Logs the breakdown and the time to first frame.
+void finishStartupTimings(EngineContext& context);
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+
+// 32-bit FNV-1a hash of a name, so lookups compare integers instead of strings. makeStringId is
+// constexpr: the ids of literals are computed at compile time when assigned to a constexpr,
+//   static constexpr StringId SceneColorId = makeStringId("sceneColor");
+// and the same function hashes names only known at runtime, without allocating.
+struct StringId
+{
+	uint32_t value;
+};
+
+static constexpr uint32_t FnvOffsetBasis = 2166136261u;
+static constexpr uint32_t FnvPrime = 16777619u;
+
+constexpr StringId makeStringId(const char* name)
+{
+	uint32_t hash = FnvOffsetBasis;
+	for (; *name; ++name)
+	{
+		hash = (hash ^ static_cast<uint8_t>(*name)) * FnvPrime;
+	}
+
+	StringId id = { hash };
+	return id;
+}
+
+constexpr bool operator==(StringId a, StringId b)
+{
+	return a.value == b.value;
+}
+
+constexpr bool operator!=(StringId a, StringId b)
+{
+	return a.value != b.value;
+}
+
+// for sorted tables of ids
+constexpr bool operator<(StringId a, StringId b)
+{
+	return a.value < b.value;
+}
+
+static_assert(makeStringId("").value == FnvOffsetBasis, "FNV-1a of the empty string is the offset basis");
+static_assert(makeStringId("a").value == 0xe40c292cu, "FNV-1a reference value");
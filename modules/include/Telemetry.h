@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+struct EngineContext;
+struct Telemetry;
+
+// Publishes rolling frame, queue and GPU memory metrics in the Prometheus text format, for runs
+// without a window to show an overlay in. ENGINE_TELEMETRY=<port> serves them over HTTP on
+// 127.0.0.1, ENGINE_TELEMETRY=unix:<path> on a Unix socket; without it nothing is created.
+// The hot path only does relaxed atomic adds and stores and pushes one sample per frame into a
+// single producer ring. A background thread drains the ring into histograms and answers scrapes.
+
+enum TelemetryCounter : uint32_t
+{
+	TelemetryCounter_GraphicsSubmits,
+	TelemetryCounter_ComputeSubmits,
+	TelemetryCounter_Presents,
+	TelemetryCounter_Count,
+};
+
+// After the logical device, so uploads made while the engine starts are counted
+void createTelemetry(EngineContext& context);
+void destroyTelemetry(EngineContext& context);
+
+// Any thread, lock-free
+void countTelemetryEvent(EngineContext& context, TelemetryCounter counter);
+// Render thread, once per frame right after waiting on the frame's fence
+void recordTelemetryFrame(EngineContext& context, double fenceWaitSeconds);
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <EASTL/string.h>
+
+// A listening socket that answers every client with the current metrics and closes the connection,
+// for the telemetry thread. Clients that start with an HTTP GET get an HTTP response, others, e.g.
+// socat or nc on the Unix socket, just the text.
+
+struct TelemetryServer;
+
+// Called on the polling thread when a client connected, returns the response body
+typedef const eastl::string& (*TelemetryResponder)(void* userData);
+
+// "unix:<path>" listens on a Unix socket (Linux only), otherwise address is a TCP port on 127.0.0.1.
+// nullptr when the socket can't be opened.
+TelemetryServer* openTelemetryServer(const char* address);
+void closeTelemetryServer(TelemetryServer* server);
+
+// Waits up to timeoutMs for a client and answers it. Returns true if one was served.
+bool pollTelemetryServer(TelemetryServer* server, int timeoutMs, TelemetryResponder respond, void* userData);
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <math.h>
+
+// Minimal vector math for the samples. View space is left-handed: +x right, +y up, +z forward.
+// Projections map to Vulkan clip space, y pointing down and depth from 0 at near to 1 at far.
+
+struct Vec3
+{
+	float x;
+	float y;
+	float z;
+};
+
+// Column-major, m[column * 4 + row], the layout GLSL expects for a mat4
+struct Mat4
+{
+	float m[16];
+};
+
+// normal pointing to the inside, dot(normal, p) + d >= 0 for points in front of the plane
+struct Plane
+{
+	Vec3 normal;
+	float d;
+};
+
+inline Vec3 makeVec3(float x, float y, float z)
+{
+	Vec3 v = { x, y, z };
+	return v;
+}
+
+inline Vec3 operator+(const Vec3& a, const Vec3& b)
+{
+	return makeVec3(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+
+inline Vec3 operator-(const Vec3& a, const Vec3& b)
+{
+	return makeVec3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+
+inline Vec3 operator*(const Vec3& v, float s)
+{
+	return makeVec3(v.x * s, v.y * s, v.z * s);
+}
+
+inline float dot(const Vec3& a, const Vec3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+inline Vec3 cross(const Vec3& a, const Vec3& b)
+{
+	return makeVec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+inline float length(const Vec3& v)
+{
+	return sqrtf(dot(v, v));
+}
+
+inline Vec3 normalize(const Vec3& v)
+{
+	float len = length(v);
+	return len > 0.0f ? v * (1.0f / len) : v;
+}
+
+inline Mat4 multiply(const Mat4& a, const Mat4& b)
+{
+	Mat4 result;
+	for (int column = 0; column < 4; ++column)
+	{
+		for (int row = 0; row < 4; ++row)
+		{
+			float sum = 0.0f;
+			for (int k = 0; k < 4; ++k)
+			{
+				sum += a.m[k * 4 + row] * b.m[column * 4 + k];
+			}
+			result.m[column * 4 + row] = sum;
+		}
+	}
+	return result;
+}
+
+inline Mat4 makeViewMatrix(const Vec3& eye, const Vec3& right, const Vec3& up, const Vec3& forward)
+{
+	Mat4 view = {};
+	view.m[0] = right.x;
+	view.m[4] = right.y;
+	view.m[8] = right.z;
+	view.m[12] = -dot(right, eye);
+	view.m[1] = up.x;
+	view.m[5] = up.y;
+	view.m[9] = up.z;
+	view.m[13] = -dot(up, eye);
+	view.m[2] = forward.x;
+	view.m[6] = forward.y;
+	view.m[10] = forward.z;
+	view.m[14] = -dot(forward, eye);
+	view.m[15] = 1.0f;
+	return view;
+}
+
+inline Mat4 makePerspective(float tanHalfFovY, float aspect, float nearPlane, float farPlane)
+{
+	Mat4 projection = {};
+	projection.m[0] = 1.0f / (tanHalfFovY * aspect);
+	projection.m[5] = -1.0f / tanHalfFovY;
+	projection.m[10] = farPlane / (farPlane - nearPlane);
+	projection.m[11] = 1.0f;
+	projection.m[14] = -nearPlane * farPlane / (farPlane - nearPlane);
+	return projection;
+}
+
+// Maps the view space box to clip space, depth from 0 at nearPlane to 1 at farPlane
+inline Mat4 makeOrthographic(float left, float right, float bottom, float top, float nearPlane, float farPlane)
+{
+	Mat4 projection = {};
+	projection.m[0] = 2.0f / (right - left);
+	projection.m[5] = -2.0f / (top - bottom);
+	projection.m[10] = 1.0f / (farPlane - nearPlane);
+	projection.m[12] = -(right + left) / (right - left);
+	projection.m[13] = (top + bottom) / (top - bottom);
+	projection.m[14] = -nearPlane / (farPlane - nearPlane);
+	projection.m[15] = 1.0f;
+	return projection;
+}
+
+inline Plane normalizePlane(float a, float b, float c, float d)
+{
+	float len = sqrtf(a * a + b * b + c * c);
+	Plane plane = { makeVec3(a / len, b / len, c / len), d / len };
+	return plane;
+}
+
+// Left, right, top, bottom, near, far planes of a Vulkan clip space view projection
+inline void extractFrustumPlanes(const Mat4& viewProjection, Plane planes[6])
+{
+	const float* m = viewProjection.m;
+	float row0[4] = { m[0], m[4], m[8], m[12] };
+	float row1[4] = { m[1], m[5], m[9], m[13] };
+	float row2[4] = { m[2], m[6], m[10], m[14] };
+	float row3[4] = { m[3], m[7], m[11], m[15] };
+
+	planes[0] = normalizePlane(row3[0] + row0[0], row3[1] + row0[1], row3[2] + row0[2], row3[3] + row0[3]);
+	planes[1] = normalizePlane(row3[0] - row0[0], row3[1] - row0[1], row3[2] - row0[2], row3[3] - row0[3]);
+	planes[2] = normalizePlane(row3[0] + row1[0], row3[1] + row1[1], row3[2] + row1[2], row3[3] + row1[3]);
+	planes[3] = normalizePlane(row3[0] - row1[0], row3[1] - row1[1], row3[2] - row1[2], row3[3] - row1[3]);
+	planes[4] = normalizePlane(row2[0], row2[1], row2[2], row2[3]);
+	planes[5] = normalizePlane(row3[0] - row2[0], row3[1] - row2[1], row3[2] - row2[2], row3[3] - row2[3]);
+}
+
+inline bool isSphereInFrustum(const Plane planes[6], const Vec3& center, float radius)
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		if (dot(planes[i].normal, center) + planes[i].d < -radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
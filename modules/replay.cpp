@@ -0,0 +1,25 @@
+#include <cstdio>
+
+#include "Engine.h"
+#include "EngineContext.h"
+#include "FrameTrace.h"
+
+// Plays back a trace recorded with ENGINE_TRACE=<path>, see FrameTrace.h. Exits with 1 when the
+// replay diverged from the recording or its image hashes from the reference report.
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 4)
+	{
+		fprintf(stderr, "Usage: %s <trace> [report.csv] [reference report.csv]\n", argv[0]);
+		return 2;
+	}
+
+	EngineContext context = {};
+	openTraceReplay(context, argv[1], argc > 2 ? argv[2] : nullptr, argc > 3 ? argv[3] : nullptr);
+
+	init(context);
+	bool matched = replay(context);
+	cleanup(context);
+
+	return matched ? 0 : 1;
+}
@@ -0,0 +1,549 @@
+#include "Animation.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <EASTL/algorithm.h>
+
+#include "JobSystem.h"
+#include "Log.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANIMATION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+static const float Sqrt2 = 1.41421356f;
+static const uint32_t QuatComponentMax = 0x7fff;
+static const uint32_t TranslationMax = 0xffff;
+
+// a batch is a few microseconds of work, enough to outweigh the job overhead
+static const uint32_t CharactersPerJob = 16;
+
+Quat makeQuatFromAxisAngle(const Vec3& axis, float angle)
+{
+	Vec3 n = normalize(axis);
+	float s = sinf(angle * 0.5f);
+	Quat q = { n.x * s, n.y * s, n.z * s, cosf(angle * 0.5f) };
+	return q;
+}
+
+Quat multiply(const Quat& a, const Quat& b)
+{
+	Quat q;
+	q.x = a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y;
+	q.y = a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x;
+	q.z = a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w;
+	q.w = a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z;
+	return q;
+}
+
+static float dot(const Quat& a, const Quat& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+// The same interpolation the pose kernels run, so compression measures the error playback will have
+static Quat nlerp(const Quat& a, const Quat& b, float t)
+{
+	float sign = dot(a, b) < 0.0f ? -1.0f : 1.0f;
+	Quat q;
+	q.x = a.x + (b.x * sign - a.x) * t;
+	q.y = a.y + (b.y * sign - a.y) * t;
+	q.z = a.z + (b.z * sign - a.z) * t;
+	q.w = a.w + (b.w * sign - a.w) * t;
+
+	float invLength = 1.0f / sqrtf(dot(q, q));
+	q.x *= invLength;
+	q.y *= invLength;
+	q.z *= invLength;
+	q.w *= invLength;
+	return q;
+}
+
+static float angleBetween(const Quat& a, const Quat& b)
+{
+	float d = fabsf(dot(a, b));
+	return 2.0f * acosf(d < 1.0f ? d : 1.0f);
+}
+
+PackedQuat packQuat(const Quat& q)
+{
+	float components[4] = { q.x, q.y, q.z, q.w };
+
+	uint32_t largest = 0;
+	for (uint32_t i = 1; i < 4; ++i)
+	{
+		if (fabsf(components[i]) > fabsf(components[largest]))
+		{
+			largest = i;
+		}
+	}
+
+	// q and -q are the same rotation, flipping makes the dropped component positive
+	float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+
+	PackedQuat packed = {};
+	uint32_t k = 0;
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+		{
+			continue;
+		}
+
+		// the other components are at most 1/sqrt(2) in magnitude
+		float normalized = (components[i] * sign * Sqrt2 + 1.0f) * 0.5f;
+		normalized = normalized < 0.0f ? 0.0f : (normalized > 1.0f ? 1.0f : normalized);
+		packed.values[k++] = static_cast<uint16_t>(lroundf(normalized * QuatComponentMax));
+	}
+
+	packed.values[0] |= static_cast<uint16_t>((largest & 1) << 15);
+	packed.values[1] |= static_cast<uint16_t>((largest >> 1) << 15);
+	return packed;
+}
+
+Quat unpackQuat(const PackedQuat& packed)
+{
+	uint32_t largest = (packed.values[0] >> 15) | ((packed.values[1] >> 15) << 1);
+
+	float components[4];
+	float sumSquares = 0.0f;
+	uint32_t k = 0;
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		if (i == largest)
+		{
+			continue;
+		}
+
+		float normalized = static_cast<float>(packed.values[k++] & QuatComponentMax) / QuatComponentMax;
+		components[i] = (normalized * 2.0f - 1.0f) / Sqrt2;
+		sumSquares += components[i] * components[i];
+	}
+	components[largest] = sqrtf(sumSquares < 1.0f ? 1.0f - sumSquares : 0.0f);
+
+	Quat q = { components[0], components[1], components[2], components[3] };
+	return q;
+}
+
+// Greedy key reduction: from every kept key, the next one is the furthest frame the whole span to
+// which interpolates within the tolerance. error(i, j, k) is the error at frame k when interpolating
+// from key i to key j, with i == j meaning key i held.
+template <typename ErrorFunc>
+static void reduceKeys(uint32_t numFrames, float tolerance, ErrorFunc error, eastl::vector<uint32_t>& keys)
+{
+	keys.clear();
+	keys.push_back(0);
+
+	bool constant = true;
+	for (uint32_t k = 1; k < numFrames && constant; ++k)
+	{
+		constant = error(0, 0, k) <= tolerance;
+	}
+	if (constant)
+	{
+		return;
+	}
+
+	uint32_t last = numFrames - 1;
+	uint32_t start = 0;
+	while (start < last)
+	{
+		uint32_t end = start + 1;
+		while (end < last)
+		{
+			bool fits = true;
+			for (uint32_t k = start + 1; k <= end && fits; ++k)
+			{
+				fits = error(start, end + 1, k) <= tolerance;
+			}
+			if (!fits)
+			{
+				break;
+			}
+			++end;
+		}
+
+		keys.push_back(end);
+		start = end;
+	}
+}
+
+static float quantizeTranslation(float value, float min, float scale, uint16_t& quantized)
+{
+	float steps = scale > 0.0f ? (value - min) / scale : 0.0f;
+	steps = steps < 0.0f ? 0.0f : (steps > TranslationMax ? static_cast<float>(TranslationMax) : steps);
+	quantized = static_cast<uint16_t>(lroundf(steps));
+	return min + quantized * scale;
+}
+
+void compressAnimationClip(const RawAnimationClip& raw, const AnimationCompressionSettings& settings, AnimationClip& clip)
+{
+	// key frames are stored in 16 bits
+	if (raw.numFrames == 0 || raw.numFrames > 0x10000 || raw.numJoints > MaxSkeletonJoints)
+	{
+		Log::fatal("Can't compress an animation clip with %u frames and %u joints\n", raw.numFrames, raw.numJoints);
+	}
+
+	clip = {};
+	clip.frameRate = raw.frameRate;
+	clip.duration = (raw.numFrames - 1) / raw.frameRate;
+	clip.numJoints = raw.numJoints;
+
+	float translationMax[3];
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		clip.translationMin[axis] = INFINITY;
+		translationMax[axis] = -INFINITY;
+	}
+	for (const JointTransform& transform : raw.transforms)
+	{
+		const float* t = &transform.translation.x;
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			clip.translationMin[axis] = t[axis] < clip.translationMin[axis] ? t[axis] : clip.translationMin[axis];
+			translationMax[axis] = t[axis] > translationMax[axis] ? t[axis] : translationMax[axis];
+		}
+	}
+	for (uint32_t axis = 0; axis < 3; ++axis)
+	{
+		clip.translationScale[axis] = (translationMax[axis] - clip.translationMin[axis]) / TranslationMax;
+	}
+
+	uint32_t numFrames = raw.numFrames;
+	eastl::vector<Quat> rotations(numFrames);
+	eastl::vector<PackedQuat> packedRotations(numFrames);
+	eastl::vector<Quat> decodedRotations(numFrames);
+	eastl::vector<Vec3> translations(numFrames);
+	eastl::vector<uint16_t> packedTranslations(numFrames * 3);
+	eastl::vector<Vec3> decodedTranslations(numFrames);
+	eastl::vector<uint32_t> keys;
+
+	for (uint32_t joint = 0; joint < raw.numJoints; ++joint)
+	{
+		for (uint32_t frame = 0; frame < numFrames; ++frame)
+		{
+			const JointTransform& transform = raw.transforms[frame * raw.numJoints + joint];
+
+			rotations[frame] = transform.rotation;
+			packedRotations[frame] = packQuat(transform.rotation);
+			decodedRotations[frame] = unpackQuat(packedRotations[frame]);
+
+			translations[frame] = transform.translation;
+			float* decoded = &decodedTranslations[frame].x;
+			const float* t = &transform.translation.x;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				decoded[axis] = quantizeTranslation(t[axis], clip.translationMin[axis], clip.translationScale[axis], packedTranslations[frame * 3 + axis]);
+			}
+		}
+
+		auto rotationError = [&](uint32_t i, uint32_t j, uint32_t k)
+		{
+			float t = i == j ? 0.0f : static_cast<float>(k - i) / (j - i);
+			return angleBetween(nlerp(decodedRotations[i], decodedRotations[j], t), rotations[k]);
+		};
+		reduceKeys(numFrames, settings.rotationTolerance, rotationError, keys);
+
+		clip.rotationTracks[joint].firstKey = static_cast<uint32_t>(clip.rotationKeys.size());
+		clip.rotationTracks[joint].numKeys = static_cast<uint32_t>(keys.size());
+		for (uint32_t key : keys)
+		{
+			clip.rotationKeyFrames.push_back(static_cast<uint16_t>(key));
+			clip.rotationKeys.push_back(packedRotations[key]);
+		}
+
+		auto translationError = [&](uint32_t i, uint32_t j, uint32_t k)
+		{
+			float t = i == j ? 0.0f : static_cast<float>(k - i) / (j - i);
+			Vec3 interpolated = decodedTranslations[i] + (decodedTranslations[j] - decodedTranslations[i]) * t;
+			return length(interpolated - translations[k]);
+		};
+		reduceKeys(numFrames, settings.translationTolerance, translationError, keys);
+
+		clip.translationTracks[joint].firstKey = static_cast<uint32_t>(clip.translationKeyFrames.size());
+		clip.translationTracks[joint].numKeys = static_cast<uint32_t>(keys.size());
+		for (uint32_t key : keys)
+		{
+			clip.translationKeyFrames.push_back(static_cast<uint16_t>(key));
+			clip.translationKeys.push_back(packedTranslations[key * 3 + 0]);
+			clip.translationKeys.push_back(packedTranslations[key * 3 + 1]);
+			clip.translationKeys.push_back(packedTranslations[key * 3 + 2]);
+		}
+	}
+}
+
+size_t getAnimationClipSize(const AnimationClip& clip)
+{
+	return sizeof(AnimationClip)
+		+ clip.rotationKeyFrames.size() * sizeof(uint16_t)
+		+ clip.rotationKeys.size() * sizeof(PackedQuat)
+		+ clip.translationKeyFrames.size() * sizeof(uint16_t)
+		+ clip.translationKeys.size() * sizeof(uint16_t);
+}
+
+// Per joint: rotations and translations interpolated from a towards b by their own weights, since a
+// joint's rotation and translation keys fall on different frames. Works on groups of four joints,
+// padding included.
+static void lerpPoses(const AnimationPose& a, const AnimationPose& b, const float* rotationWeights, const float* translationWeights, uint32_t numJoints, AnimationPose& result)
+{
+#ifdef ANIMATION_SSE2
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	for (uint32_t j = 0; j < numJoints; j += 4)
+	{
+		__m128 ax = _mm_load_ps(a.rotationX + j);
+		__m128 ay = _mm_load_ps(a.rotationY + j);
+		__m128 az = _mm_load_ps(a.rotationZ + j);
+		__m128 aw = _mm_load_ps(a.rotationW + j);
+		__m128 bx = _mm_load_ps(b.rotationX + j);
+		__m128 by = _mm_load_ps(b.rotationY + j);
+		__m128 bz = _mm_load_ps(b.rotationZ + j);
+		__m128 bw = _mm_load_ps(b.rotationW + j);
+
+		// shortest arc: negate b where it points away from a
+		__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+		__m128 flip = _mm_and_ps(_mm_cmplt_ps(d, _mm_setzero_ps()), signBit);
+		bx = _mm_xor_ps(bx, flip);
+		by = _mm_xor_ps(by, flip);
+		bz = _mm_xor_ps(bz, flip);
+		bw = _mm_xor_ps(bw, flip);
+
+		__m128 t = _mm_load_ps(rotationWeights + j);
+		__m128 x = _mm_add_ps(ax, _mm_mul_ps(_mm_sub_ps(bx, ax), t));
+		__m128 y = _mm_add_ps(ay, _mm_mul_ps(_mm_sub_ps(by, ay), t));
+		__m128 z = _mm_add_ps(az, _mm_mul_ps(_mm_sub_ps(bz, az), t));
+		__m128 w = _mm_add_ps(aw, _mm_mul_ps(_mm_sub_ps(bw, aw), t));
+
+		__m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+		__m128 invLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+		_mm_store_ps(result.rotationX + j, _mm_mul_ps(x, invLength));
+		_mm_store_ps(result.rotationY + j, _mm_mul_ps(y, invLength));
+		_mm_store_ps(result.rotationZ + j, _mm_mul_ps(z, invLength));
+		_mm_store_ps(result.rotationW + j, _mm_mul_ps(w, invLength));
+
+		t = _mm_load_ps(translationWeights + j);
+		__m128 tx = _mm_load_ps(a.translationX + j);
+		__m128 ty = _mm_load_ps(a.translationY + j);
+		__m128 tz = _mm_load_ps(a.translationZ + j);
+		_mm_store_ps(result.translationX + j, _mm_add_ps(tx, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.translationX + j), tx), t)));
+		_mm_store_ps(result.translationY + j, _mm_add_ps(ty, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.translationY + j), ty), t)));
+		_mm_store_ps(result.translationZ + j, _mm_add_ps(tz, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(b.translationZ + j), tz), t)));
+	}
+#else
+	uint32_t numPadded = (numJoints + 3) & ~3u;
+	for (uint32_t j = 0; j < numPadded; ++j)
+	{
+		Quat qa = { a.rotationX[j], a.rotationY[j], a.rotationZ[j], a.rotationW[j] };
+		Quat qb = { b.rotationX[j], b.rotationY[j], b.rotationZ[j], b.rotationW[j] };
+		Quat q = nlerp(qa, qb, rotationWeights[j]);
+		result.rotationX[j] = q.x;
+		result.rotationY[j] = q.y;
+		result.rotationZ[j] = q.z;
+		result.rotationW[j] = q.w;
+
+		float t = translationWeights[j];
+		result.translationX[j] = a.translationX[j] + (b.translationX[j] - a.translationX[j]) * t;
+		result.translationY[j] = a.translationY[j] + (b.translationY[j] - a.translationY[j]) * t;
+		result.translationZ[j] = a.translationZ[j] + (b.translationZ[j] - a.translationZ[j]) * t;
+	}
+#endif
+}
+
+static void setPoseJoint(AnimationPose& pose, uint32_t joint, const Quat& rotation, const float* translation)
+{
+	pose.rotationX[joint] = rotation.x;
+	pose.rotationY[joint] = rotation.y;
+	pose.rotationZ[joint] = rotation.z;
+	pose.rotationW[joint] = rotation.w;
+	pose.translationX[joint] = translation[0];
+	pose.translationY[joint] = translation[1];
+	pose.translationZ[joint] = translation[2];
+}
+
+// Index of the last key at or before frame, and the weight of the key after it
+static uint32_t findKey(const uint16_t* keyFrames, uint32_t numKeys, float frame, float& weight)
+{
+	const uint16_t* next = eastl::upper_bound(keyFrames, keyFrames + numKeys, frame);
+	uint32_t key = next == keyFrames ? 0 : static_cast<uint32_t>(next - keyFrames) - 1;
+	if (key + 1 >= numKeys)
+	{
+		weight = 0.0f;
+		return key;
+	}
+
+	weight = (frame - keyFrames[key]) / (keyFrames[key + 1] - keyFrames[key]);
+	weight = weight < 0.0f ? 0.0f : (weight > 1.0f ? 1.0f : weight);
+	return key;
+}
+
+void sampleAnimationClip(const AnimationClip& clip, float time, AnimationPose& pose)
+{
+	float clipTime = clip.duration > 0.0f ? fmodf(time, clip.duration) : 0.0f;
+	if (clipTime < 0.0f)
+	{
+		clipTime += clip.duration;
+	}
+	float frame = clipTime * clip.frameRate;
+
+	// the keys either side of the frame are decoded into two poses, then interpolated together
+	AnimationPose next;
+	alignas(16) float rotationWeights[MaxSkeletonJoints];
+	alignas(16) float translationWeights[MaxSkeletonJoints];
+
+	for (uint32_t joint = 0; joint < clip.numJoints; ++joint)
+	{
+		const AnimationTrack& rotationTrack = clip.rotationTracks[joint];
+		uint32_t rotationKey = rotationTrack.firstKey + findKey(&clip.rotationKeyFrames[rotationTrack.firstKey], rotationTrack.numKeys, frame, rotationWeights[joint]);
+		uint32_t nextRotationKey = rotationWeights[joint] > 0.0f ? rotationKey + 1 : rotationKey;
+
+		const AnimationTrack& translationTrack = clip.translationTracks[joint];
+		uint32_t translationKey = translationTrack.firstKey + findKey(&clip.translationKeyFrames[translationTrack.firstKey], translationTrack.numKeys, frame, translationWeights[joint]);
+		uint32_t nextTranslationKey = translationWeights[joint] > 0.0f ? translationKey + 1 : translationKey;
+
+		float translation[3];
+		float nextTranslation[3];
+		for (uint32_t axis = 0; axis < 3; ++axis)
+		{
+			translation[axis] = clip.translationMin[axis] + clip.translationKeys[translationKey * 3 + axis] * clip.translationScale[axis];
+			nextTranslation[axis] = clip.translationMin[axis] + clip.translationKeys[nextTranslationKey * 3 + axis] * clip.translationScale[axis];
+		}
+
+		setPoseJoint(pose, joint, unpackQuat(clip.rotationKeys[rotationKey]), translation);
+		setPoseJoint(next, joint, unpackQuat(clip.rotationKeys[nextRotationKey]), nextTranslation);
+	}
+
+	// identity padding keeps the kernels away from zero length quaternions
+	static const Quat identity = { 0.0f, 0.0f, 0.0f, 1.0f };
+	static const float zero[3] = {};
+	uint32_t numPadded = (clip.numJoints + 3) & ~3u;
+	for (uint32_t joint = clip.numJoints; joint < numPadded; ++joint)
+	{
+		setPoseJoint(pose, joint, identity, zero);
+		setPoseJoint(next, joint, identity, zero);
+		rotationWeights[joint] = 0.0f;
+		translationWeights[joint] = 0.0f;
+	}
+
+	lerpPoses(pose, next, rotationWeights, translationWeights, clip.numJoints, pose);
+}
+
+void blendAnimationPoses(const AnimationPose& a, const AnimationPose& b, float weight, uint32_t numJoints, AnimationPose& result)
+{
+	alignas(16) float weights[MaxSkeletonJoints];
+	for (float& w : weights)
+	{
+		w = weight;
+	}
+
+	lerpPoses(a, b, weights, weights, numJoints, result);
+}
+
+static Mat4 makeJointMatrix(const AnimationPose& pose, uint32_t joint)
+{
+	float x = pose.rotationX[joint];
+	float y = pose.rotationY[joint];
+	float z = pose.rotationZ[joint];
+	float w = pose.rotationW[joint];
+
+	Mat4 m = {};
+	m.m[0] = 1.0f - 2.0f * (y * y + z * z);
+	m.m[1] = 2.0f * (x * y + w * z);
+	m.m[2] = 2.0f * (x * z - w * y);
+	m.m[4] = 2.0f * (x * y - w * z);
+	m.m[5] = 1.0f - 2.0f * (x * x + z * z);
+	m.m[6] = 2.0f * (y * z + w * x);
+	m.m[8] = 2.0f * (x * z + w * y);
+	m.m[9] = 2.0f * (y * z - w * x);
+	m.m[10] = 1.0f - 2.0f * (x * x + y * y);
+	m.m[12] = pose.translationX[joint];
+	m.m[13] = pose.translationY[joint];
+	m.m[14] = pose.translationZ[joint];
+	m.m[15] = 1.0f;
+	return m;
+}
+
+void computeSkinningMatrices(const Skeleton& skeleton, const AnimationPose& pose, const Mat4& world, float* matrices)
+{
+	// world is folded into the roots, so every joint's matrix ends up in world space
+	Mat4 jointMatrices[MaxSkeletonJoints];
+	for (uint32_t joint = 0; joint < skeleton.numJoints; ++joint)
+	{
+		int32_t parent = skeleton.parents[joint];
+		const Mat4& parentMatrix = parent < 0 ? world : jointMatrices[parent];
+		jointMatrices[joint] = multiply(parentMatrix, makeJointMatrix(pose, joint));
+
+		Mat4 skin = multiply(jointMatrices[joint], skeleton.inverseBindMatrices[joint]);
+		float* rows = matrices + joint * SkinningMatrixFloats;
+		for (uint32_t row = 0; row < 3; ++row)
+		{
+			for (uint32_t column = 0; column < 4; ++column)
+			{
+				rows[row * 4 + column] = skin.m[column * 4 + row];
+			}
+		}
+	}
+}
+
+struct AnimateJob
+{
+	const Skeleton* skeleton;
+	const AnimationClip* clips;
+	const AnimatedCharacter* characters;
+	uint32_t numCharacters;
+	float* matrices;
+};
+
+static void animateJob(void* data)
+{
+	const AnimateJob& job = *static_cast<AnimateJob*>(data);
+	uint32_t numJoints = job.skeleton->numJoints;
+
+	AnimationPose poses[2];
+	AnimationPose blended;
+
+	for (uint32_t i = 0; i < job.numCharacters; ++i)
+	{
+		const AnimatedCharacter& character = job.characters[i];
+		float* matrices = job.matrices + i * numJoints * SkinningMatrixFloats;
+
+		// a clip that doesn't contribute isn't sampled at all
+		if (character.blendWeight <= 0.0f || character.blendWeight >= 1.0f)
+		{
+			uint32_t clip = character.blendWeight <= 0.0f ? 0 : 1;
+			sampleAnimationClip(job.clips[character.clips[clip]], character.times[clip], poses[0]);
+			computeSkinningMatrices(*job.skeleton, poses[0], character.world, matrices);
+			continue;
+		}
+
+		sampleAnimationClip(job.clips[character.clips[0]], character.times[0], poses[0]);
+		sampleAnimationClip(job.clips[character.clips[1]], character.times[1], poses[1]);
+		blendAnimationPoses(poses[0], poses[1], character.blendWeight, numJoints, blended);
+		computeSkinningMatrices(*job.skeleton, blended, character.world, matrices);
+	}
+}
+
+void animateCharacters(JobSystem* jobSystem, const Skeleton& skeleton, const AnimationClip* clips, const AnimatedCharacter* characters, uint32_t numCharacters, float* matrices)
+{
+	uint32_t numJobs = (numCharacters + CharactersPerJob - 1) / CharactersPerJob;
+	eastl::vector<AnimateJob> jobs(numJobs);
+
+	JobCounter counter = {};
+	for (uint32_t i = 0; i < numJobs; ++i)
+	{
+		uint32_t first = i * CharactersPerJob;
+
+		AnimateJob& job = jobs[i];
+		job.skeleton = &skeleton;
+		job.clips = clips;
+		job.characters = characters + first;
+		job.numCharacters = numCharacters - first < CharactersPerJob ? numCharacters - first : CharactersPerJob;
+		job.matrices = matrices + first * skeleton.numJoints * SkinningMatrixFloats;
+		submitJob(jobSystem, animateJob, &job, &counter);
+	}
+
+	// helps with the queued regular jobs only, long ones like frame encodes are background jobs
+	waitForCounter(jobSystem, &counter);
+}
@@ -0,0 +1,634 @@
+#include "AssetPipeline.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <coroutine>
+#include <mutex>
+#include <thread>
+
+#include <EASTL/hash_map.h>
+
+#include "AsyncFileIo.h"
+#include "Compression.h"
+#include "JobSystem.h"
+#include "Log.h"
+
+static const char* const AssetTypeNames[NumAssetTypes] = {
+	"raw",
+	"manifest",
+	"mesh",
+	"material",
+	"texture",
+	"shader",
+};
+
+struct DependencyWait;
+
+struct AssetNode
+{
+	AssetId id;
+	AssetType type;
+	eastl::string path;
+	eastl::vector<uint8_t> data;
+
+	// guards done and waiters, failed is only written before done
+	std::mutex mutex;
+	bool done;
+	bool failed;
+	eastl::vector<DependencyWait*> waiters;
+};
+
+struct PendingRead
+{
+	eastl::string path;
+	eastl::vector<uint8_t>* data;
+	FileReadCallback callback;
+	void* userData;
+};
+
+struct AssetPipeline
+{
+	JobSystem* jobSystem;
+	AsyncFileIo* io;
+	eastl::string rootFolder;
+	AssetTypeHandler handlers[NumAssetTypes];
+
+	std::mutex nodesMutex;
+	eastl::vector<AssetNode*> nodes;
+	eastl::hash_map<eastl::string, AssetId> nodeIds;
+
+	// reads queued by coroutines until the next flush, so they reach the kernel together
+	std::mutex readsMutex;
+	eastl::vector<PendingRead> pendingReads;
+
+	// completed assets in completion order, waiting for their finish callback
+	std::mutex finishedMutex;
+	eastl::vector<AssetId> finished;
+
+	std::atomic<uint32_t> numLoading;
+	std::atomic<uint32_t> numFailed;
+	std::atomic<uint64_t> bytesRead;
+	std::atomic<uint64_t> bytesDecompressed;
+};
+
+// Fire and forget coroutine that starts suspended. Its frame is freed when it returns, before it
+// stops counting as loading, so nothing touches the frame once waitForAssets sees the pipeline idle.
+struct AssetLoad
+{
+	struct promise_type
+	{
+		AssetPipeline& pipeline;
+
+		// gets the coroutine's arguments
+		promise_type(AssetPipeline& pipeline, AssetNode& node) : pipeline(pipeline) { (void)node; }
+
+		struct FinalAwaitable
+		{
+			bool await_ready() noexcept { return false; }
+
+			void await_suspend(std::coroutine_handle<promise_type> coroutine) noexcept
+			{
+				AssetPipeline& pipeline = coroutine.promise().pipeline;
+				coroutine.destroy();
+
+				// after the finished queue, waitForAssets relies on it being filled once nothing is loading
+				pipeline.numLoading.fetch_sub(1, std::memory_order_release);
+			}
+
+			void await_resume() noexcept {}
+		};
+
+		AssetLoad get_return_object()
+		{
+			return AssetLoad{ std::coroutine_handle<promise_type>::from_promise(*this) };
+		}
+
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		FinalAwaitable final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { abort(); }
+	};
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+static void resumeCoroutineJob(void* address)
+{
+	std::coroutine_handle<>::from_address(address).resume();
+}
+
+static void flushReads(AssetPipeline& pipeline)
+{
+	eastl::vector<PendingRead> reads;
+	{
+		std::lock_guard<std::mutex> lock(pipeline.readsMutex);
+		reads.swap(pipeline.pendingReads);
+	}
+
+	if (reads.empty())
+	{
+		return;
+	}
+
+	eastl::vector<FileReadRequest> requests(reads.size());
+	for (size_t i = 0; i < reads.size(); ++i)
+	{
+		requests[i].path = reads[i].path.c_str();
+		requests[i].data = reads[i].data;
+		requests[i].callback = reads[i].callback;
+		requests[i].userData = reads[i].userData;
+	}
+
+	submitFileReads(pipeline.io, requests.data(), static_cast<uint32_t>(requests.size()));
+}
+
+// Queues the node's file for the next flush and resumes on a job worker once it was read
+struct ReadFileAwaitable
+{
+	AssetPipeline& pipeline;
+	AssetNode& node;
+	bool succeeded;
+	std::coroutine_handle<> handle;
+
+	static void onRead(void* userData, bool succeeded)
+	{
+		ReadFileAwaitable& awaitable = *static_cast<ReadFileAwaitable*>(userData);
+		awaitable.succeeded = succeeded;
+		if (succeeded)
+		{
+			awaitable.pipeline.bytesRead.fetch_add(awaitable.node.data.size(), std::memory_order_relaxed);
+		}
+
+		// io_uring completions arrive on its single completion thread, which shouldn't decompress
+		submitJob(awaitable.pipeline.jobSystem, resumeCoroutineJob, awaitable.handle.address(), nullptr);
+	}
+
+	bool await_ready() { return false; }
+
+	void await_suspend(std::coroutine_handle<> coroutine)
+	{
+		handle = coroutine;
+
+		PendingRead read;
+		read.path = pipeline.rootFolder + node.path;
+		read.data = &node.data;
+		read.callback = onRead;
+		read.userData = this;
+
+		std::lock_guard<std::mutex> lock(pipeline.readsMutex);
+		pipeline.pendingReads.push_back(eastl::move(read));
+	}
+
+	bool await_resume() { return succeeded; }
+};
+
+struct DecompressAwaitable;
+
+struct ChunkJob
+{
+	DecompressAwaitable* awaitable;
+	uint32_t chunk;
+};
+
+// Decompresses every chunk in its own job, the last one to finish resumes the coroutine
+struct DecompressAwaitable
+{
+	AssetPipeline& pipeline;
+	const eastl::vector<uint8_t>& file;
+	eastl::vector<uint8_t>& raw;
+
+	ChunkedAssetHeader header;
+	const ChunkedAssetChunk* chunks;
+	eastl::vector<ChunkJob> jobs;
+	std::atomic<uint32_t> numLeft;
+	std::atomic<bool> failed;
+	std::coroutine_handle<> handle;
+
+	DecompressAwaitable(AssetPipeline& pipeline, const eastl::vector<uint8_t>& file, eastl::vector<uint8_t>& raw)
+		: pipeline(pipeline), file(file), raw(raw), header(), chunks(nullptr), numLeft(0), failed(false)
+	{
+	}
+
+	static void decompressChunkJob(void* data)
+	{
+		ChunkJob& job = *static_cast<ChunkJob*>(data);
+		DecompressAwaitable& awaitable = *job.awaitable;
+
+		const ChunkedAssetChunk& chunk = awaitable.chunks[job.chunk];
+		if (!decompressAssetChunk(awaitable.file.data(), chunk, awaitable.raw.data() + chunk.rawOffset))
+		{
+			awaitable.failed.store(true, std::memory_order_relaxed);
+		}
+
+		awaitable.finishChunk();
+	}
+
+	// true for the call that finished the last chunk
+	bool releaseChunk()
+	{
+		return numLeft.fetch_sub(1, std::memory_order_acq_rel) == 1;
+	}
+
+	void finishChunk()
+	{
+		if (releaseChunk())
+		{
+			handle.resume();
+		}
+	}
+
+	bool await_ready()
+	{
+		if (!parseChunkedAsset(file.data(), file.size(), header, chunks))
+		{
+			failed = true;
+			return true;
+		}
+
+		raw.resize(static_cast<size_t>(header.rawSize));
+		return header.numChunks == 0;
+	}
+
+	bool await_suspend(std::coroutine_handle<> coroutine)
+	{
+		handle = coroutine;
+
+		// one extra count so no job can resume the coroutine before every job was submitted
+		numLeft.store(header.numChunks + 1, std::memory_order_relaxed);
+		jobs.resize(header.numChunks);
+		for (uint32_t i = 0; i < header.numChunks; ++i)
+		{
+			jobs[i].awaitable = this;
+			jobs[i].chunk = i;
+			submitJob(pipeline.jobSystem, decompressChunkJob, &jobs[i], nullptr);
+		}
+
+		return !releaseChunk();
+	}
+
+	bool await_resume()
+	{
+		bool succeeded = !failed.load(std::memory_order_relaxed);
+		if (succeeded)
+		{
+			pipeline.bytesDecompressed.fetch_add(raw.size(), std::memory_order_relaxed);
+		}
+		return succeeded;
+	}
+};
+
+struct DependencyWait
+{
+	JobSystem* jobSystem;
+	std::atomic<uint32_t> numLeft;
+	std::coroutine_handle<> handle;
+
+	bool release()
+	{
+		return numLeft.fetch_sub(1, std::memory_order_acq_rel) == 1;
+	}
+};
+
+// Resumes once every dependency completed, false if any of them failed
+struct DependenciesAwaitable
+{
+	const eastl::vector<AssetNode*>& dependencies;
+	DependencyWait wait;
+
+	bool await_ready() { return dependencies.empty(); }
+
+	bool await_suspend(std::coroutine_handle<> coroutine)
+	{
+		wait.handle = coroutine;
+		wait.numLeft.store(static_cast<uint32_t>(dependencies.size()) + 1, std::memory_order_relaxed);
+
+		for (AssetNode* dependency : dependencies)
+		{
+			std::lock_guard<std::mutex> lock(dependency->mutex);
+			if (dependency->done)
+			{
+				wait.release();
+			}
+			else
+			{
+				dependency->waiters.push_back(&wait);
+			}
+		}
+
+		return !wait.release();
+	}
+
+	bool await_resume()
+	{
+		for (AssetNode* dependency : dependencies)
+		{
+			if (dependency->failed)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+static AssetNode* findOrStartAsset(AssetPipeline& pipeline, AssetType type, const eastl::string& path);
+
+static void finishAsset(AssetPipeline& pipeline, AssetNode& node, bool failed)
+{
+	node.failed = failed;
+	if (failed)
+	{
+		pipeline.numFailed.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(pipeline.finishedMutex);
+		pipeline.finished.push_back(node.id);
+	}
+
+	eastl::vector<DependencyWait*> waiters;
+	{
+		std::lock_guard<std::mutex> lock(node.mutex);
+		node.done = true;
+		waiters.swap(node.waiters);
+	}
+
+	for (DependencyWait* wait : waiters)
+	{
+		if (wait->release())
+		{
+			submitJob(wait->jobSystem, resumeCoroutineJob, wait->handle.address(), nullptr);
+		}
+	}
+}
+
+static AssetLoad loadAsset(AssetPipeline& pipeline, AssetNode& node)
+{
+	bool loaded = co_await ReadFileAwaitable{ pipeline, node, false, {} };
+	if (!loaded)
+	{
+		Log::error("Couldn't read asset %s\n", node.path.c_str());
+	}
+
+	if (loaded && isChunkedAsset(node.data.data(), node.data.size()))
+	{
+		eastl::vector<uint8_t> raw;
+		loaded = co_await DecompressAwaitable(pipeline, node.data, raw);
+		if (loaded)
+		{
+			node.data = eastl::move(raw);
+		}
+		else
+		{
+			Log::error("Asset %s is corrupt or compressed with an unsupported codec\n", node.path.c_str());
+		}
+	}
+
+	const AssetTypeHandler& handler = pipeline.handlers[node.type];
+	if (loaded && handler.findDependencies)
+	{
+		eastl::vector<AssetReference> references;
+		handler.findDependencies(node.data, references, handler.userData);
+
+		eastl::vector<AssetNode*> dependencies;
+		for (const AssetReference& reference : references)
+		{
+			dependencies.push_back(findOrStartAsset(pipeline, reference.type, reference.path));
+		}
+		flushReads(pipeline);
+
+		loaded = co_await DependenciesAwaitable{ dependencies, { pipeline.jobSystem, {}, {} } };
+	}
+
+	finishAsset(pipeline, node, !loaded);
+}
+
+static AssetNode* findOrStartAsset(AssetPipeline& pipeline, AssetType type, const eastl::string& path)
+{
+	AssetNode* node = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(pipeline.nodesMutex);
+		auto found = pipeline.nodeIds.find(path);
+		if (found != pipeline.nodeIds.end())
+		{
+			return pipeline.nodes[found->second];
+		}
+
+		node = new AssetNode;
+		node->id = static_cast<AssetId>(pipeline.nodes.size());
+		node->type = type;
+		node->path = path;
+		node->done = false;
+		node->failed = false;
+
+		pipeline.nodes.push_back(node);
+		pipeline.nodeIds[path] = node->id;
+	}
+
+	pipeline.numLoading.fetch_add(1, std::memory_order_relaxed);
+
+	// runs up to queueing its read
+	loadAsset(pipeline, *node).handle.resume();
+	return node;
+}
+
+static void findManifestDependencies(const eastl::vector<uint8_t>& data, eastl::vector<AssetReference>& dependencies, void* userData)
+{
+	(void)userData;
+	parseAssetManifest(data, dependencies);
+}
+
+AssetPipeline* createAssetPipeline(JobSystem* jobSystem, const char* rootFolder)
+{
+	AssetPipeline* pipeline = new AssetPipeline;
+	pipeline->jobSystem = jobSystem;
+	pipeline->io = createAsyncFileIo(jobSystem);
+	pipeline->rootFolder = rootFolder;
+	memset(pipeline->handlers, 0, sizeof(pipeline->handlers));
+	pipeline->handlers[AssetType_Manifest].findDependencies = findManifestDependencies;
+	pipeline->numLoading = 0;
+	pipeline->numFailed = 0;
+	pipeline->bytesRead = 0;
+	pipeline->bytesDecompressed = 0;
+
+	return pipeline;
+}
+
+void destroyAssetPipeline(AssetPipeline* pipeline)
+{
+	if (!pipeline)
+	{
+		return;
+	}
+
+	destroyAsyncFileIo(pipeline->io);
+	for (AssetNode* node : pipeline->nodes)
+	{
+		delete node;
+	}
+
+	delete pipeline;
+}
+
+void setAssetTypeHandler(AssetPipeline* pipeline, AssetType type, const AssetTypeHandler& handler)
+{
+	pipeline->handlers[type] = handler;
+}
+
+AssetId requestAsset(AssetPipeline* pipeline, AssetType type, const char* path)
+{
+	return findOrStartAsset(*pipeline, type, path)->id;
+}
+
+bool waitForAssets(AssetPipeline* pipeline)
+{
+	flushReads(*pipeline);
+
+	bool allLoaded = true;
+	eastl::vector<AssetId> finished;
+	for (;;)
+	{
+		bool idle = pipeline->numLoading.load(std::memory_order_acquire) == 0;
+
+		finished.clear();
+		{
+			std::lock_guard<std::mutex> lock(pipeline->finishedMutex);
+			finished.swap(pipeline->finished);
+		}
+
+		for (AssetId id : finished)
+		{
+			AssetNode& node = *pipeline->nodes[id];
+			const AssetTypeHandler& handler = pipeline->handlers[node.type];
+			if (!node.failed && handler.finish)
+			{
+				handler.finish(id, node.path.c_str(), node.data, handler.userData);
+			}
+			allLoaded &= !node.failed;
+		}
+
+		if (!finished.empty())
+		{
+			continue;
+		}
+		if (idle)
+		{
+			break;
+		}
+
+		if (!runPendingJob(pipeline->jobSystem))
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	return allLoaded;
+}
+
+static AssetNode& getNode(AssetPipeline* pipeline, AssetId id)
+{
+	std::lock_guard<std::mutex> lock(pipeline->nodesMutex);
+	return *pipeline->nodes[id];
+}
+
+bool isAssetLoaded(AssetPipeline* pipeline, AssetId id)
+{
+	AssetNode& node = getNode(pipeline, id);
+
+	std::lock_guard<std::mutex> lock(node.mutex);
+	return node.done && !node.failed;
+}
+
+const char* getAssetPath(AssetPipeline* pipeline, AssetId id)
+{
+	return getNode(pipeline, id).path.c_str();
+}
+
+const eastl::vector<uint8_t>& getAssetData(AssetPipeline* pipeline, AssetId id)
+{
+	return getNode(pipeline, id).data;
+}
+
+AssetPipelineStats getAssetPipelineStats(AssetPipeline* pipeline)
+{
+	AssetPipelineStats stats = {};
+	{
+		std::lock_guard<std::mutex> lock(pipeline->nodesMutex);
+		stats.numAssets = static_cast<uint32_t>(pipeline->nodes.size());
+	}
+	stats.numFailed = pipeline->numFailed.load(std::memory_order_relaxed);
+	stats.bytesRead = pipeline->bytesRead.load(std::memory_order_relaxed);
+	stats.bytesDecompressed = pipeline->bytesDecompressed.load(std::memory_order_relaxed);
+
+	return stats;
+}
+
+const char* getAssetPipelineIoBackend(AssetPipeline* pipeline)
+{
+	return getAsyncFileIoBackend(pipeline->io);
+}
+
+static bool isSpace(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+void parseAssetManifest(const eastl::vector<uint8_t>& data, eastl::vector<AssetReference>& references)
+{
+	const char* text = reinterpret_cast<const char*>(data.data());
+	const char* end = text + data.size();
+
+	while (text < end)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(text, '\n', end - text));
+		lineEnd = lineEnd ? lineEnd : end;
+
+		const char* begin = text;
+		text = lineEnd + 1;
+
+		while (begin < lineEnd && isSpace(*begin))
+		{
+			++begin;
+		}
+		const char* last = lineEnd;
+		while (last > begin && isSpace(last[-1]))
+		{
+			--last;
+		}
+		if (begin == last || *begin == '#')
+		{
+			continue;
+		}
+
+		const char* typeEnd = begin;
+		while (typeEnd < last && !isSpace(*typeEnd))
+		{
+			++typeEnd;
+		}
+		const char* path = typeEnd;
+		while (path < last && isSpace(*path))
+		{
+			++path;
+		}
+
+		eastl::string typeName(begin, typeEnd);
+		uint32_t type = 0;
+		while (type < NumAssetTypes && typeName != AssetTypeNames[type])
+		{
+			++type;
+		}
+
+		if (type == NumAssetTypes || path == last)
+		{
+			Log::error("Skipping manifest line \"%s\"\n", eastl::string(begin, last).c_str());
+			continue;
+		}
+
+		AssetReference reference;
+		reference.type = static_cast<AssetType>(type);
+		reference.path.assign(path, last);
+		references.push_back(reference);
+	}
+}
@@ -0,0 +1,286 @@
+#include "AsyncFileIo.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <thread>
+
+#include <EASTL/string.h>
+
+#include "IoUring.h"
+#include "JobSystem.h"
+#include "Log.h"
+
+static const uint32_t IoUringEntries = 64;
+// large files are split so one file keeps several requests in flight
+static const uint32_t MaxReadPieceSize = 2 * 1024 * 1024;
+
+struct AsyncFileIo
+{
+	JobSystem* jobSystem;
+	// nullptr when reads run on the job system
+	IoUring* ring;
+	std::atomic<uint32_t> numPending;
+};
+
+struct FileRead;
+
+struct FileReadPiece
+{
+	FileRead* file;
+	uint8_t* buffer;
+	uint32_t size;
+	uint64_t offset;
+};
+
+struct FileRead
+{
+	AsyncFileIo* io;
+	eastl::string path;
+	eastl::vector<uint8_t>* data;
+	FileReadCallback callback;
+	void* userData;
+
+	int fd;
+	eastl::vector<FileReadPiece> pieces;
+	std::atomic<uint32_t> numPiecesLeft;
+	std::atomic<bool> failed;
+};
+
+static void finishFileRead(FileRead* file, bool succeeded)
+{
+	AsyncFileIo* io = file->io;
+	file->callback(file->userData, succeeded);
+	delete file;
+
+	io->numPending.fetch_sub(1, std::memory_order_release);
+}
+
+static void readFileJob(void* data)
+{
+	FileRead* file = static_cast<FileRead*>(data);
+
+	FILE* f = fopen(file->path.c_str(), "rb");
+	if (!f)
+	{
+		finishFileRead(file, false);
+		return;
+	}
+
+	fseek(f, 0, SEEK_END);
+	long length = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	bool succeeded = length >= 0;
+	if (succeeded)
+	{
+		file->data->resize(static_cast<size_t>(length));
+		succeeded = fread(file->data->data(), 1, file->data->size(), f) == file->data->size();
+	}
+	fclose(f);
+
+	finishFileRead(file, succeeded);
+}
+
+#ifdef __linux__
+
+static void onPieceRead(void* userData, int32_t result);
+
+static IoUringRead makePieceRead(FileReadPiece& piece)
+{
+	IoUringRead read = {};
+	read.fd = piece.file->fd;
+	read.buffer = piece.buffer;
+	read.size = piece.size;
+	read.offset = piece.offset;
+	read.completion = onPieceRead;
+	read.userData = &piece;
+	return read;
+}
+
+static void onPieceRead(void* userData, int32_t result)
+{
+	FileReadPiece& piece = *static_cast<FileReadPiece*>(userData);
+	FileRead* file = piece.file;
+
+	bool retry = result == -EAGAIN || result == -EINTR;
+	bool shortRead = result > 0 && static_cast<uint32_t>(result) < piece.size;
+	if (retry || shortRead)
+	{
+		uint32_t numRead = shortRead ? static_cast<uint32_t>(result) : 0;
+		piece.buffer += numRead;
+		piece.size -= numRead;
+		piece.offset += numRead;
+
+		IoUringRead read = makePieceRead(piece);
+		submitIoUringReads(file->io->ring, &read, 1);
+		return;
+	}
+
+	// zero bytes means the file got shorter since it was opened
+	if (result <= 0)
+	{
+		file->failed.store(true, std::memory_order_relaxed);
+	}
+
+	if (file->numPiecesLeft.fetch_sub(1, std::memory_order_acq_rel) == 1)
+	{
+		close(file->fd);
+		finishFileRead(file, !file->failed.load(std::memory_order_relaxed));
+	}
+}
+
+// Opens the file and splits it into pieces. False if it can't be read, true with no pieces for empty files.
+static bool prepareRingRead(FileRead& file)
+{
+	file.fd = open(file.path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (file.fd < 0)
+	{
+		return false;
+	}
+
+	struct stat status;
+	if (fstat(file.fd, &status) != 0)
+	{
+		close(file.fd);
+		return false;
+	}
+
+	uint64_t size = static_cast<uint64_t>(status.st_size);
+	file.data->resize(static_cast<size_t>(size));
+
+	uint32_t numPieces = static_cast<uint32_t>((size + MaxReadPieceSize - 1) / MaxReadPieceSize);
+	file.pieces.resize(numPieces);
+	file.numPiecesLeft.store(numPieces, std::memory_order_relaxed);
+
+	for (uint32_t i = 0; i < numPieces; ++i)
+	{
+		uint64_t offset = static_cast<uint64_t>(i) * MaxReadPieceSize;
+
+		FileReadPiece& piece = file.pieces[i];
+		piece.file = &file;
+		piece.buffer = file.data->data() + offset;
+		piece.size = static_cast<uint32_t>(size - offset < MaxReadPieceSize ? size - offset : MaxReadPieceSize);
+		piece.offset = offset;
+	}
+
+	return true;
+}
+
+static void submitRingReads(AsyncFileIo& io, eastl::vector<FileRead*>& files)
+{
+	eastl::vector<IoUringRead> reads;
+	for (FileRead* file : files)
+	{
+		if (!prepareRingRead(*file))
+		{
+			finishFileRead(file, false);
+			continue;
+		}
+
+		if (file->pieces.empty())
+		{
+			close(file->fd);
+			finishFileRead(file, true);
+			continue;
+		}
+
+		for (FileReadPiece& piece : file->pieces)
+		{
+			reads.push_back(makePieceRead(piece));
+		}
+	}
+
+	// completions can finish and free a file before this returns, so nothing is touched afterwards
+	submitIoUringReads(io.ring, reads.data(), static_cast<uint32_t>(reads.size()));
+}
+
+#endif
+
+AsyncFileIo* createAsyncFileIo(JobSystem* jobSystem)
+{
+	AsyncFileIo* io = new AsyncFileIo;
+	io->jobSystem = jobSystem;
+	io->ring = nullptr;
+	io->numPending = 0;
+
+#ifdef __linux__
+	const char* setting = getenv("ENGINE_IO_URING");
+	if (!setting || strcmp(setting, "0") != 0)
+	{
+		io->ring = createIoUring(IoUringEntries);
+		if (!io->ring)
+		{
+			Log::warning("io_uring isn't available, errno %d, files are read on the job system\n", errno);
+		}
+	}
+#endif
+
+	return io;
+}
+
+void destroyAsyncFileIo(AsyncFileIo* io)
+{
+	if (!io)
+	{
+		return;
+	}
+
+	while (io->numPending.load(std::memory_order_acquire) != 0)
+	{
+		std::this_thread::yield();
+	}
+
+#ifdef __linux__
+	destroyIoUring(io->ring);
+#endif
+
+	delete io;
+}
+
+const char* getAsyncFileIoBackend(AsyncFileIo* io)
+{
+	return io->ring ? "io_uring" : "job system";
+}
+
+void submitFileReads(AsyncFileIo* io, const FileReadRequest* requests, uint32_t numRequests)
+{
+	eastl::vector<FileRead*> files(numRequests);
+	for (uint32_t i = 0; i < numRequests; ++i)
+	{
+		FileRead* file = new FileRead;
+		file->io = io;
+		file->path = requests[i].path;
+		file->data = requests[i].data;
+		file->callback = requests[i].callback;
+		file->userData = requests[i].userData;
+		file->fd = -1;
+		file->numPiecesLeft = 0;
+		file->failed = false;
+		files[i] = file;
+	}
+
+	io->numPending.fetch_add(numRequests, std::memory_order_relaxed);
+
+#ifdef __linux__
+	if (io->ring)
+	{
+		submitRingReads(*io, files);
+		return;
+	}
+#endif
+
+	for (FileRead* file : files)
+	{
+		submitJob(io->jobSystem, readFileJob, file, nullptr);
+	}
+}
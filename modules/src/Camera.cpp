@@ -0,0 +1,32 @@
+#include "Camera.h"
+
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+
+#include "EngineContext.h"
+
+static const float OrbitRadius = 18.0f;
+static const float OrbitHeight = 8.0f;
+static const float OrbitSpeed = 0.1f;
+
+void updateSceneCamera(EngineContext& context)
+{
+	Camera& camera = context.camera;
+
+	float angle = static_cast<float>(context.frameTime) * OrbitSpeed;
+	camera.position = makeVec3(sinf(angle) * OrbitRadius, OrbitHeight, -cosf(angle) * OrbitRadius);
+
+	camera.forward = normalize(camera.position * -1.0f);
+	camera.right = normalize(cross(makeVec3(0.0f, 1.0f, 0.0f), camera.forward));
+	camera.up = cross(camera.forward, camera.right);
+
+	camera.tanHalfFovY = tanf(30.0f * 3.1415927f / 180.0f);
+	camera.aspect = static_cast<float>(context.swapchainExtent.width) / static_cast<float>(context.swapchainExtent.height);
+	camera.nearPlane = 0.5f;
+	camera.farPlane = 60.0f;
+
+	camera.view = makeViewMatrix(camera.position, camera.right, camera.up, camera.forward);
+	camera.projection = makePerspective(camera.tanHalfFovY, camera.aspect, camera.nearPlane, camera.farPlane);
+	camera.viewProjection = multiply(camera.projection, camera.view);
+	extractFrustumPlanes(camera.viewProjection, camera.frustumPlanes);
+}
@@ -0,0 +1,10 @@
+#include "Clock.h"
+
+#include <chrono>
+
+static const std::chrono::steady_clock::time_point s_startTime = std::chrono::steady_clock::now();
+
+double getEngineTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - s_startTime).count();
+}
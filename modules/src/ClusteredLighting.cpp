@@ -0,0 +1,594 @@
+#include "ClusteredLighting.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <EASTL/vector.h>
+
+#include "ArraySize.h"
+#include "Clock.h"
+#include "ComputePass.h"
+#include "EngineContext.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "PipelineCache.h"
+#include "RenderCommands.h"
+#include "ShadowMaps.h"
+
+static const uint32_t ClusterGridX = 16;
+static const uint32_t ClusterGridY = 9;
+static const uint32_t ClusterGridZ = 24;
+static const uint32_t NumClusters = ClusterGridX * ClusterGridY * ClusterGridZ;
+// must match MAX_LIGHTS_PER_CLUSTER in clustered.glsl
+static const uint32_t MaxLightsPerCluster = 256;
+
+static const uint32_t MaxLights = 16 * 1024;
+static const uint32_t DefaultNumLights = 1024;
+
+static const float LightRadius = 2.5f;
+static const float LightFieldSize = 40.0f;
+
+static const uint32_t BenchmarkLightCounts[] = { 16, 64, 256, 1024, 4096, 16 * 1024 };
+static const uint32_t BenchmarkWarmupFrames = 60;
+static const uint32_t BenchmarkMeasuredFrames = 240;
+
+// std430 layout of Light in clustered.glsl
+struct GpuLight
+{
+	float positionRadius[4];
+	float color[4];
+	float spotDirection[4];
+};
+
+// std140 layout of Camera in clustered.glsl
+struct CameraUniforms
+{
+	float eye[4];
+	float right[4];
+	float up[4];
+	float forward[4];
+	float projection[4];
+	uint32_t grid[4];
+	float screen[4];
+};
+
+// std430 layout of CullStats in lightcull.comp
+struct GpuCullStats
+{
+	uint32_t numOverflowedClusters;
+	uint32_t numDroppedLights;
+};
+
+struct LightAnimation
+{
+	float center[2];
+	float orbitRadius;
+	float angularSpeed;
+	float phase;
+	float height;
+};
+
+struct LightBenchmarkResult
+{
+	uint32_t numLights;
+	double frameMs;
+	double cullMs;
+	double shadingMs;
+	// the most lights dropped from full clusters in any measured frame
+	uint32_t maxDroppedLights;
+};
+
+struct ClusteredLighting
+{
+	uint32_t numLights;
+	eastl::vector<LightAnimation> animations;
+	// everything but the animated positions
+	eastl::vector<GpuLight> lights;
+
+	// one set per frame in flight, the CPU rewrites the lights and camera of a frame once its fence was waited on
+	GpuBuffer lightBuffers[MAX_FRAMES_IN_FLIGHT];
+	GpuBuffer cameraBuffers[MAX_FRAMES_IN_FLIGHT];
+	GpuBuffer clusterCountBuffers[MAX_FRAMES_IN_FLIGHT];
+	GpuBuffer clusterIndexBuffers[MAX_FRAMES_IN_FLIGHT];
+	// host visible GpuCullStats
+	GpuBuffer cullStatsBuffers[MAX_FRAMES_IN_FLIGHT];
+	bool warnedOverflow;
+
+	ComputePipeline cullPipeline;
+	VkDescriptorSet cullSets[MAX_FRAMES_IN_FLIGHT];
+
+	VkDescriptorSetLayout drawSetLayout;
+	VkPipelineLayout drawPipelineLayout;
+	PipelineDesc drawPipelineDesc;
+	VkDescriptorSet drawSets[MAX_FRAMES_IN_FLIGHT];
+
+	// timestamps around the culling dispatch, two per frame in flight. VK_NULL_HANDLE when the compute queue has none.
+	VkQueryPool queryPool;
+	bool queriesWritten[MAX_FRAMES_IN_FLIGHT];
+	uint64_t timestampMask;
+	double lastCullMs;
+
+	// graphics timestamps around the shading pass, two per frame in flight. Only created for the
+	// benchmark, VK_NULL_HANDLE when the graphics queue has none.
+	VkQueryPool shadingQueryPool;
+	bool shadingQueriesWritten[MAX_FRAMES_IN_FLIGHT];
+	uint64_t shadingTimestampMask;
+
+	// frame times include whatever else the engine draws, the GPU times of the two passes don't
+	bool benchmark;
+	uint32_t benchmarkStep;
+	uint32_t benchmarkFrame;
+	double benchmarkFrameMs;
+	double benchmarkCullMs;
+	uint32_t numBenchmarkCullSamples;
+	double benchmarkShadingMs;
+	uint32_t numBenchmarkShadingSamples;
+	uint32_t benchmarkMaxDroppedLights;
+	double lastFrameTime;
+	eastl::vector<LightBenchmarkResult> benchmarkResults;
+};
+
+static float randomFloat(float min, float max)
+{
+	return min + (static_cast<float>(rand()) / RAND_MAX) * (max - min);
+}
+
+static void setVector(float* out, float x, float y, float z, float w)
+{
+	out[0] = x;
+	out[1] = y;
+	out[2] = z;
+	out[3] = w;
+}
+
+static void writeBufferDescriptor(EngineContext& context, VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const GpuBuffer& buffer)
+{
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer.buffer;
+	bufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+	write.pBufferInfo = &bufferInfo;
+
+	vkUpdateDescriptorSets(context.device, 1, &write, 0, nullptr);
+}
+
+static void makeBindings(VkDescriptorSetLayoutBinding* bindings, VkShaderStageFlags stages)
+{
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		bindings[i] = {};
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = stages;
+	}
+}
+
+static void createLights(ClusteredLighting& lighting)
+{
+	lighting.animations.resize(MaxLights);
+	lighting.lights.resize(MaxLights);
+
+	for (uint32_t i = 0; i < MaxLights; ++i)
+	{
+		LightAnimation& animation = lighting.animations[i];
+		animation.center[0] = randomFloat(-LightFieldSize * 0.5f, LightFieldSize * 0.5f);
+		animation.center[1] = randomFloat(-LightFieldSize * 0.5f, LightFieldSize * 0.5f);
+		animation.orbitRadius = randomFloat(0.5f, 2.0f);
+		animation.angularSpeed = randomFloat(-1.0f, 1.0f);
+		animation.phase = randomFloat(0.0f, 6.2831853f);
+		animation.height = randomFloat(0.5f, 2.0f);
+
+		GpuLight& light = lighting.lights[i];
+		float intensity = 1.5f;
+		setVector(light.color, randomFloat(0.2f, 1.0f) * intensity, randomFloat(0.2f, 1.0f) * intensity, randomFloat(0.2f, 1.0f) * intensity, 0.0f);
+
+		// every fourth light is a spot pointing down, the rest are point lights
+		if (i % 4 == 3)
+		{
+			setVector(light.spotDirection, 0.0f, -1.0f, 0.0f, cosf(35.0f * 3.1415927f / 180.0f));
+		}
+		else
+		{
+			setVector(light.spotDirection, 0.0f, 0.0f, 0.0f, -2.0f);
+		}
+	}
+}
+
+static void setLightCount(ClusteredLighting& lighting, uint32_t numLights)
+{
+	lighting.numLights = numLights < MaxLights ? numLights : MaxLights;
+}
+
+void createClusteredLighting(EngineContext& context)
+{
+	ClusteredLighting* lighting = new ClusteredLighting;
+	*lighting = {};
+
+	createLights(*lighting);
+
+	const char* benchmark = getenv("ENGINE_LIGHT_BENCHMARK");
+	lighting->benchmark = benchmark && strcmp(benchmark, "0") != 0;
+
+	const char* lightCount = getenv("ENGINE_LIGHT_COUNT");
+	setLightCount(*lighting, lightCount ? static_cast<uint32_t>(strtoul(lightCount, nullptr, 0)) : DefaultNumLights);
+	if (lighting->benchmark)
+	{
+		setLightCount(*lighting, BenchmarkLightCounts[0]);
+	}
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		createGpuBuffer(context, MaxLights * sizeof(GpuLight), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, lighting->lightBuffers[i]);
+		createGpuBuffer(context, sizeof(CameraUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, lighting->cameraBuffers[i]);
+		createGpuBuffer(context, NumClusters * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, lighting->clusterCountBuffers[i]);
+		createGpuBuffer(context, NumClusters * MaxLightsPerCluster * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, lighting->clusterIndexBuffers[i]);
+		createGpuBuffer(context, sizeof(GpuCullStats), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, lighting->cullStatsBuffers[i]);
+		memset(lighting->cullStatsBuffers[i].mapped, 0, sizeof(GpuCullStats));
+	}
+
+	// culling also writes its stats
+	VkDescriptorSetLayoutBinding bindings[5];
+	makeBindings(bindings, VK_SHADER_STAGE_COMPUTE_BIT);
+	bindings[4] = {};
+	bindings[4].binding = 4;
+	bindings[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[4].descriptorCount = 1;
+	bindings[4].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	createComputePipeline(context, "lightcull.comp.spv", bindings, ARRAY_SIZE(bindings), 0, lighting->cullPipeline);
+
+	// the ground plane receives the sun's shadows too
+	VkDescriptorSetLayoutBinding drawBindings[4 + NumShadowReceiverBindings];
+	makeBindings(drawBindings, VK_SHADER_STAGE_FRAGMENT_BIT);
+	makeShadowReceiverBindings(4, VK_SHADER_STAGE_FRAGMENT_BIT, drawBindings + 4);
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = ARRAY_SIZE(drawBindings);
+	setLayoutInfo.pBindings = drawBindings;
+
+	VkResult result = vkCreateDescriptorSetLayout(context.device, &setLayoutInfo, nullptr, &lighting->drawSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create clustered lighting descriptor set layout");
+	}
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &lighting->drawSetLayout;
+
+	result = vkCreatePipelineLayout(context.device, &layoutInfo, nullptr, &lighting->drawPipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create clustered lighting pipeline layout");
+	}
+
+	lighting->drawPipelineDesc = makeDefaultPipelineDesc();
+	lighting->drawPipelineDesc.vertexShader = "clustered.vert";
+	lighting->drawPipelineDesc.fragmentShader = "clustered.frag";
+	lighting->drawPipelineDesc.layout = lighting->drawPipelineLayout;
+	lighting->drawPipelineDesc.cullMode = VK_CULL_MODE_NONE;
+	lighting->drawPipelineDesc.renderPass = context.renderPass;
+	lighting->drawPipelineDesc.colorFormat = context.sceneColorFormat;
+	lighting->drawPipelineDesc.depthFormat = context.depthFormat;
+	getPipeline(context, lighting->drawPipelineDesc);
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		lighting->cullSets[i] = allocateDescriptorSet(context, lighting->cullPipeline.descriptorSetLayout);
+		lighting->drawSets[i] = allocateDescriptorSet(context, lighting->drawSetLayout);
+
+		VkDescriptorSet sets[] = { lighting->cullSets[i], lighting->drawSets[i] };
+		for (VkDescriptorSet set : sets)
+		{
+			writeBufferDescriptor(context, set, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, lighting->cameraBuffers[i]);
+			writeBufferDescriptor(context, set, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, lighting->lightBuffers[i]);
+			writeBufferDescriptor(context, set, 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, lighting->clusterCountBuffers[i]);
+			writeBufferDescriptor(context, set, 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, lighting->clusterIndexBuffers[i]);
+		}
+
+		writeBufferDescriptor(context, lighting->cullSets[i], 4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, lighting->cullStatsBuffers[i]);
+		writeShadowReceiverDescriptors(context, lighting->drawSets[i], 4, i);
+	}
+
+	lighting->timestampMask = getTimestampMask(context, context.computeQueueFamily);
+	if (lighting->timestampMask != 0)
+	{
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+
+		result = vkCreateQueryPool(context.device, &queryPoolInfo, nullptr, &lighting->queryPool);
+		if (result != VK_SUCCESS)
+		{
+			Log::fatal("Couldn't create clustered lighting query pool");
+		}
+	}
+
+	lighting->shadingTimestampMask = getTimestampMask(context, context.graphicsQueueFamily);
+	if (lighting->benchmark && lighting->shadingTimestampMask != 0)
+	{
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = 2 * MAX_FRAMES_IN_FLIGHT;
+
+		result = vkCreateQueryPool(context.device, &queryPoolInfo, nullptr, &lighting->shadingQueryPool);
+		if (result != VK_SUCCESS)
+		{
+			Log::fatal("Couldn't create clustered shading query pool");
+		}
+	}
+
+	lighting->lastFrameTime = getEngineTime();
+
+	context.clusteredLighting = lighting;
+}
+
+void destroyClusteredLighting(EngineContext& context)
+{
+	ClusteredLighting* lighting = context.clusteredLighting;
+	if (!lighting)
+	{
+		return;
+	}
+
+	if (lighting->queryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(context.device, lighting->queryPool, nullptr);
+	}
+	if (lighting->shadingQueryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(context.device, lighting->shadingQueryPool, nullptr);
+	}
+
+	vkDestroyPipelineLayout(context.device, lighting->drawPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(context.device, lighting->drawSetLayout, nullptr);
+	destroyComputePipeline(context, lighting->cullPipeline);
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		destroyGpuBuffer(context, lighting->lightBuffers[i]);
+		destroyGpuBuffer(context, lighting->cameraBuffers[i]);
+		destroyGpuBuffer(context, lighting->clusterCountBuffers[i]);
+		destroyGpuBuffer(context, lighting->clusterIndexBuffers[i]);
+		destroyGpuBuffer(context, lighting->cullStatsBuffers[i]);
+	}
+
+	delete lighting;
+	context.clusteredLighting = nullptr;
+}
+
+// The time between the slot's two timestamps. The frame's fence was waited on, so its work is done.
+static bool readPassTime(EngineContext& context, VkQueryPool queryPool, uint32_t slot, uint64_t timestampMask, double& milliseconds)
+{
+	uint64_t timestamps[2] = {};
+	VkResult result = vkGetQueryPoolResults(context.device, queryPool, slot * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+	{
+		return false;
+	}
+
+	milliseconds = static_cast<double>((timestamps[1] - timestamps[0]) & timestampMask) * context.physicalDeviceProperties.limits.timestampPeriod * 1e-6;
+	return true;
+}
+
+static void readPassTimes(EngineContext& context, ClusteredLighting& lighting)
+{
+	uint32_t slot = context.currentFrame;
+	if (lighting.queryPool != VK_NULL_HANDLE && lighting.queriesWritten[slot] &&
+		readPassTime(context, lighting.queryPool, slot, lighting.timestampMask, lighting.lastCullMs))
+	{
+		++lighting.numBenchmarkCullSamples;
+		lighting.benchmarkCullMs += lighting.lastCullMs;
+	}
+
+	double shadingMs = 0.0;
+	if (lighting.shadingQueryPool != VK_NULL_HANDLE && lighting.shadingQueriesWritten[slot] &&
+		readPassTime(context, lighting.shadingQueryPool, slot, lighting.shadingTimestampMask, shadingMs))
+	{
+		++lighting.numBenchmarkShadingSamples;
+		lighting.benchmarkShadingMs += shadingMs;
+	}
+}
+
+// Reads what the slot's last culling pass dropped and clears it for this frame's
+static void readCullStats(ClusteredLighting& lighting, uint32_t slot)
+{
+	GpuCullStats* mapped = static_cast<GpuCullStats*>(lighting.cullStatsBuffers[slot].mapped);
+	GpuCullStats stats = *mapped;
+	*mapped = {};
+
+	if (stats.numDroppedLights == 0)
+	{
+		return;
+	}
+
+	if (lighting.benchmark)
+	{
+		lighting.benchmarkMaxDroppedLights = stats.numDroppedLights > lighting.benchmarkMaxDroppedLights ? stats.numDroppedLights : lighting.benchmarkMaxDroppedLights;
+	}
+	else if (!lighting.warnedOverflow)
+	{
+		Log::warning("Clustered lighting: %u clusters have more than %u lights, %u lights aren't shaded in them\n",
+			stats.numOverflowedClusters, MaxLightsPerCluster, stats.numDroppedLights);
+		lighting.warnedOverflow = true;
+	}
+}
+
+static void advanceBenchmark(EngineContext& context, ClusteredLighting& lighting, double frameMs)
+{
+	++lighting.benchmarkFrame;
+	if (lighting.benchmarkFrame <= BenchmarkWarmupFrames)
+	{
+		lighting.benchmarkFrameMs = 0.0;
+		lighting.benchmarkCullMs = 0.0;
+		lighting.numBenchmarkCullSamples = 0;
+		lighting.benchmarkShadingMs = 0.0;
+		lighting.numBenchmarkShadingSamples = 0;
+		lighting.benchmarkMaxDroppedLights = 0;
+		return;
+	}
+
+	lighting.benchmarkFrameMs += frameMs;
+	if (lighting.benchmarkFrame < BenchmarkWarmupFrames + BenchmarkMeasuredFrames)
+	{
+		return;
+	}
+
+	LightBenchmarkResult benchmarkResult;
+	benchmarkResult.numLights = lighting.numLights;
+	benchmarkResult.frameMs = lighting.benchmarkFrameMs / BenchmarkMeasuredFrames;
+	benchmarkResult.cullMs = lighting.numBenchmarkCullSamples ? lighting.benchmarkCullMs / lighting.numBenchmarkCullSamples : 0.0;
+	benchmarkResult.shadingMs = lighting.numBenchmarkShadingSamples ? lighting.benchmarkShadingMs / lighting.numBenchmarkShadingSamples : 0.0;
+	benchmarkResult.maxDroppedLights = lighting.benchmarkMaxDroppedLights;
+	lighting.benchmarkResults.push_back(benchmarkResult);
+
+	Log::log("Clustered lighting: %5u lights, culling %.3f ms, shading %.3f ms of GPU time, frame %.3f ms, up to %u lights dropped from full clusters\n",
+		benchmarkResult.numLights, benchmarkResult.cullMs, benchmarkResult.shadingMs, benchmarkResult.frameMs, benchmarkResult.maxDroppedLights);
+
+	lighting.benchmarkFrame = 0;
+	++lighting.benchmarkStep;
+	if (lighting.benchmarkStep < ARRAY_SIZE(BenchmarkLightCounts))
+	{
+		setLightCount(lighting, BenchmarkLightCounts[lighting.benchmarkStep]);
+		return;
+	}
+
+	Log::log("Clustered lighting benchmark done\n");
+	lighting.benchmark = false;
+	context.quitRequested = true;
+}
+
+static void updateLights(ClusteredLighting& lighting, GpuBuffer& buffer, float time)
+{
+	GpuLight* mapped = static_cast<GpuLight*>(buffer.mapped);
+	for (uint32_t i = 0; i < lighting.numLights; ++i)
+	{
+		const LightAnimation& animation = lighting.animations[i];
+		float angle = animation.phase + animation.angularSpeed * time;
+
+		GpuLight light = lighting.lights[i];
+		setVector(light.positionRadius, animation.center[0] + cosf(angle) * animation.orbitRadius, animation.height, animation.center[1] + sinf(angle) * animation.orbitRadius, LightRadius);
+		mapped[i] = light;
+	}
+}
+
+static void updateCamera(EngineContext& context, ClusteredLighting& lighting, GpuBuffer& buffer)
+{
+	const Camera& sceneCamera = context.camera;
+
+	float width = static_cast<float>(context.renderExtent.width);
+	float height = static_cast<float>(context.renderExtent.height);
+
+	CameraUniforms camera = {};
+	setVector(camera.eye, sceneCamera.position.x, sceneCamera.position.y, sceneCamera.position.z, 1.0f);
+	setVector(camera.right, sceneCamera.right.x, sceneCamera.right.y, sceneCamera.right.z, 0.0f);
+	setVector(camera.up, sceneCamera.up.x, sceneCamera.up.y, sceneCamera.up.z, 0.0f);
+	setVector(camera.forward, sceneCamera.forward.x, sceneCamera.forward.y, sceneCamera.forward.z, 0.0f);
+	setVector(camera.projection, sceneCamera.tanHalfFovY * sceneCamera.aspect, sceneCamera.tanHalfFovY, sceneCamera.nearPlane, sceneCamera.farPlane);
+	camera.grid[0] = ClusterGridX;
+	camera.grid[1] = ClusterGridY;
+	camera.grid[2] = ClusterGridZ;
+	camera.grid[3] = lighting.numLights;
+	setVector(camera.screen, width, height, 0.0f, 0.0f);
+
+	memcpy(buffer.mapped, &camera, sizeof(camera));
+}
+
+void cullClusteredLights(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	ClusteredLighting* lighting = context.clusteredLighting;
+	if (!lighting)
+	{
+		return;
+	}
+
+	uint32_t slot = context.currentFrame;
+
+	readPassTimes(context, *lighting);
+	readCullStats(*lighting, slot);
+
+	double time = getEngineTime();
+	if (lighting->benchmark)
+	{
+		advanceBenchmark(context, *lighting, (time - lighting->lastFrameTime) * 1000.0);
+	}
+	lighting->lastFrameTime = time;
+
+	updateLights(*lighting, lighting->lightBuffers[slot], static_cast<float>(context.frameTime));
+	updateCamera(context, *lighting, lighting->cameraBuffers[slot]);
+
+	if (lighting->queryPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, lighting->queryPool, slot * 2, 2);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, lighting->queryPool, slot * 2);
+	}
+
+	dispatchCompute(commandBuffer, lighting->cullPipeline, lighting->cullSets[slot], nullptr, ClusterGridX, ClusterGridY, ClusterGridZ);
+
+	if (lighting->queryPool != VK_NULL_HANDLE)
+	{
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, lighting->queryPool, slot * 2 + 1);
+		lighting->queriesWritten[slot] = true;
+	}
+
+	// the stats are read on the CPU after the frame's fence
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void resetClusteredShadingTimer(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	ClusteredLighting* lighting = context.clusteredLighting;
+	if (lighting && lighting->shadingQueryPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, lighting->shadingQueryPool, context.currentFrame * 2, 2);
+	}
+}
+
+void markClusteredShading(EngineContext& context, VkCommandBuffer commandBuffer, bool end)
+{
+	ClusteredLighting* lighting = context.clusteredLighting;
+	if (!lighting || lighting->shadingQueryPool == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	uint32_t slot = context.currentFrame;
+	VkPipelineStageFlagBits stage = end ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	vkCmdWriteTimestamp(commandBuffer, stage, lighting->shadingQueryPool, slot * 2 + (end ? 1 : 0));
+	lighting->shadingQueriesWritten[slot] = end;
+}
+
+void emitClusteredLighting(EngineContext& context)
+{
+	ClusteredLighting* lighting = context.clusteredLighting;
+	if (!lighting)
+	{
+		return;
+	}
+
+	DrawPacket packet = {};
+	packet.pipeline = getPipeline(context, lighting->drawPipelineDesc);
+	packet.pipelineLayout = lighting->drawPipelineLayout;
+	packet.descriptorSet = lighting->drawSets[context.currentFrame];
+	packet.sortKey = makeDrawSortKey(DrawPass_Background, packet.pipeline, 0, 0.0f);
+	packet.vertexCount = 3;
+	packet.instanceCount = 1;
+
+	emitDrawPacket(context, packet);
+}
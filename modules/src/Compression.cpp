@@ -0,0 +1,349 @@
+#include "Compression.h"
+
+#include <string.h>
+
+#ifdef ENGINE_ZSTD
+#include <zstd.h>
+#endif
+
+// LZ4 matches are at least 4 bytes, the last 5 bytes are always literals and the last match starts
+// at least 12 bytes before the end of the block
+static const size_t Lz4MinMatch = 4;
+static const size_t Lz4LastLiterals = 5;
+static const size_t Lz4MatchSearchEnd = 12;
+static const size_t Lz4MaxOffset = 65535;
+static const uint32_t Lz4HashBits = 14;
+
+#ifdef ENGINE_ZSTD
+static const int ZstdLevel = 9;
+#endif
+
+static uint32_t read32(const uint8_t* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static bool readLz4Length(const uint8_t*& ip, const uint8_t* end, size_t& length)
+{
+	uint8_t byte;
+	do
+	{
+		if (ip >= end)
+		{
+			return false;
+		}
+		byte = *ip++;
+		length += byte;
+	} while (byte == 255);
+
+	return true;
+}
+
+bool decompressLz4(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+	const uint8_t* ip = src;
+	const uint8_t* ipEnd = src + srcSize;
+	uint8_t* op = dst;
+	uint8_t* opEnd = dst + dstSize;
+
+	while (ip < ipEnd)
+	{
+		uint8_t token = *ip++;
+
+		size_t numLiterals = token >> 4;
+		if (numLiterals == 15 && !readLz4Length(ip, ipEnd, numLiterals))
+		{
+			return false;
+		}
+		if (numLiterals > static_cast<size_t>(ipEnd - ip) || numLiterals > static_cast<size_t>(opEnd - op))
+		{
+			return false;
+		}
+		// empty output may come with a null dst, which memcpy mustn't get even for zero bytes
+		if (numLiterals)
+		{
+			memcpy(op, ip, numLiterals);
+		}
+		ip += numLiterals;
+		op += numLiterals;
+
+		// the last sequence has no match
+		if (ip == ipEnd)
+		{
+			break;
+		}
+
+		if (ipEnd - ip < 2)
+		{
+			return false;
+		}
+		size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > static_cast<size_t>(op - dst))
+		{
+			return false;
+		}
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLz4Length(ip, ipEnd, matchLength))
+		{
+			return false;
+		}
+		matchLength += Lz4MinMatch;
+		if (matchLength > static_cast<size_t>(opEnd - op))
+		{
+			return false;
+		}
+
+		// matches may overlap what they write, which repeats the last offset bytes
+		const uint8_t* match = op - offset;
+		if (offset >= matchLength)
+		{
+			memcpy(op, match, matchLength);
+			op += matchLength;
+		}
+		else
+		{
+			for (size_t i = 0; i < matchLength; ++i)
+			{
+				*op++ = *match++;
+			}
+		}
+	}
+
+	return op == opEnd;
+}
+
+static void writeLz4Length(eastl::vector<uint8_t>& dst, size_t length)
+{
+	for (; length >= 255; length -= 255)
+	{
+		dst.push_back(255);
+	}
+	dst.push_back(static_cast<uint8_t>(length));
+}
+
+static void writeLz4Sequence(eastl::vector<uint8_t>& dst, const uint8_t* literals, size_t numLiterals, size_t offset, size_t matchLength)
+{
+	size_t matchCode = matchLength - Lz4MinMatch;
+	uint8_t token = static_cast<uint8_t>(((numLiterals < 15 ? numLiterals : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+	dst.push_back(token);
+
+	if (numLiterals >= 15)
+	{
+		writeLz4Length(dst, numLiterals - 15);
+	}
+	dst.insert(dst.end(), literals, literals + numLiterals);
+
+	dst.push_back(static_cast<uint8_t>(offset));
+	dst.push_back(static_cast<uint8_t>(offset >> 8));
+
+	if (matchCode >= 15)
+	{
+		writeLz4Length(dst, matchCode - 15);
+	}
+}
+
+void compressLz4(const uint8_t* src, size_t srcSize, eastl::vector<uint8_t>& dst)
+{
+	// greedy matching against the last position of each hashed 4 byte sequence, fast rather than small
+	eastl::vector<uint32_t> lastPositions(1u << Lz4HashBits, UINT32_MAX);
+
+	size_t anchor = 0;
+	size_t position = 0;
+
+	if (srcSize > Lz4MatchSearchEnd)
+	{
+		size_t searchEnd = srcSize - Lz4MatchSearchEnd;
+		size_t matchEnd = srcSize - Lz4LastLiterals;
+
+		while (position < searchEnd)
+		{
+			uint32_t sequence = read32(src + position);
+			uint32_t hash = (sequence * 2654435761u) >> (32 - Lz4HashBits);
+			uint32_t candidate = lastPositions[hash];
+			lastPositions[hash] = static_cast<uint32_t>(position);
+
+			if (candidate == UINT32_MAX || position - candidate > Lz4MaxOffset || read32(src + candidate) != sequence)
+			{
+				++position;
+				continue;
+			}
+
+			size_t matchLength = Lz4MinMatch;
+			while (position + matchLength < matchEnd && src[candidate + matchLength] == src[position + matchLength])
+			{
+				++matchLength;
+			}
+
+			writeLz4Sequence(dst, src + anchor, position - anchor, position - candidate, matchLength);
+			position += matchLength;
+			anchor = position;
+		}
+	}
+
+	size_t numLiterals = srcSize - anchor;
+	dst.push_back(static_cast<uint8_t>((numLiterals < 15 ? numLiterals : 15) << 4));
+	if (numLiterals >= 15)
+	{
+		writeLz4Length(dst, numLiterals - 15);
+	}
+	dst.insert(dst.end(), src + anchor, src + srcSize);
+}
+
+bool isChunkedAsset(const uint8_t* file, size_t fileSize)
+{
+	return fileSize >= sizeof(ChunkedAssetHeader) && read32(file) == ChunkedAssetMagic;
+}
+
+bool parseChunkedAsset(const uint8_t* file, size_t fileSize, ChunkedAssetHeader& header, const ChunkedAssetChunk*& chunks)
+{
+	if (!isChunkedAsset(file, fileSize))
+	{
+		return false;
+	}
+
+	memcpy(&header, file, sizeof(header));
+	if (header.version != ChunkedAssetVersion)
+	{
+		return false;
+	}
+
+	uint64_t tableEnd = sizeof(ChunkedAssetHeader) + static_cast<uint64_t>(header.numChunks) * sizeof(ChunkedAssetChunk);
+	if (tableEnd > fileSize)
+	{
+		return false;
+	}
+
+	// the table starts 24 bytes in, so it keeps the 8 byte alignment of the buffer the file was read into
+	chunks = reinterpret_cast<const ChunkedAssetChunk*>(file + sizeof(ChunkedAssetHeader));
+
+	uint64_t rawEnd = 0;
+	for (uint32_t i = 0; i < header.numChunks; ++i)
+	{
+		const ChunkedAssetChunk& chunk = chunks[i];
+		// written so a huge offset or size can't wrap around and pass
+		bool inFile = chunk.fileOffset >= tableEnd && chunk.fileOffset <= fileSize && chunk.compressedSize <= fileSize - chunk.fileOffset;
+		bool contiguous = chunk.rawOffset == rawEnd;
+		bool knownCodec = chunk.codec <= CompressionCodec_Zstd;
+		if (!inFile || !contiguous || !knownCodec)
+		{
+			return false;
+		}
+		rawEnd += chunk.rawSize;
+	}
+
+	return rawEnd == header.rawSize;
+}
+
+bool decompressAssetChunk(const uint8_t* file, const ChunkedAssetChunk& chunk, uint8_t* raw)
+{
+	const uint8_t* compressed = file + chunk.fileOffset;
+
+	switch (chunk.codec)
+	{
+	case CompressionCodec_None:
+		if (chunk.compressedSize != chunk.rawSize)
+		{
+			return false;
+		}
+		if (chunk.rawSize)
+		{
+			memcpy(raw, compressed, chunk.rawSize);
+		}
+		return true;
+
+	case CompressionCodec_Lz4:
+		return decompressLz4(compressed, chunk.compressedSize, raw, chunk.rawSize);
+
+	case CompressionCodec_Zstd:
+#ifdef ENGINE_ZSTD
+		return ZSTD_decompress(raw, chunk.rawSize, compressed, chunk.compressedSize) == chunk.rawSize;
+#else
+		return false;
+#endif
+	}
+
+	return false;
+}
+
+static void compressChunk(const uint8_t* data, size_t size, CompressionCodec codec, eastl::vector<uint8_t>& compressed)
+{
+	compressed.clear();
+
+#ifdef ENGINE_ZSTD
+	if (codec == CompressionCodec_Zstd)
+	{
+		compressed.resize(ZSTD_compressBound(size));
+		size_t compressedSize = ZSTD_compress(compressed.data(), compressed.size(), data, size, ZstdLevel);
+		compressed.resize(ZSTD_isError(compressedSize) ? 0 : compressedSize);
+		return;
+	}
+#else
+	// writeChunkedAsset already turned Zstd into LZ4
+	(void)codec;
+#endif
+
+	compressLz4(data, size, compressed);
+}
+
+void writeChunkedAsset(const uint8_t* data, size_t size, CompressionCodec codec, uint32_t chunkSize, eastl::vector<uint8_t>& file)
+{
+#ifndef ENGINE_ZSTD
+	codec = codec == CompressionCodec_Zstd ? CompressionCodec_Lz4 : codec;
+#endif
+
+	uint32_t numChunks = static_cast<uint32_t>((size + chunkSize - 1) / chunkSize);
+
+	ChunkedAssetHeader header = {};
+	header.magic = ChunkedAssetMagic;
+	header.version = ChunkedAssetVersion;
+	header.numChunks = numChunks;
+	header.rawSize = size;
+
+	eastl::vector<ChunkedAssetChunk> chunks(numChunks);
+	eastl::vector<uint8_t> payload;
+	eastl::vector<uint8_t> compressed;
+	uint64_t payloadOffset = sizeof(ChunkedAssetHeader) + static_cast<uint64_t>(numChunks) * sizeof(ChunkedAssetChunk);
+
+	for (uint32_t i = 0; i < numChunks; ++i)
+	{
+		size_t rawOffset = static_cast<size_t>(i) * chunkSize;
+		size_t rawSize = size - rawOffset < chunkSize ? size - rawOffset : chunkSize;
+
+		if (codec != CompressionCodec_None)
+		{
+			compressChunk(data + rawOffset, rawSize, codec, compressed);
+		}
+
+		ChunkedAssetChunk& chunk = chunks[i];
+		chunk = {};
+		chunk.rawSize = static_cast<uint32_t>(rawSize);
+		chunk.rawOffset = rawOffset;
+		chunk.fileOffset = payloadOffset + payload.size();
+
+		bool smaller = codec != CompressionCodec_None && !compressed.empty() && compressed.size() < rawSize;
+		if (smaller)
+		{
+			chunk.codec = codec;
+			chunk.compressedSize = static_cast<uint32_t>(compressed.size());
+			payload.insert(payload.end(), compressed.begin(), compressed.end());
+		}
+		else
+		{
+			chunk.codec = CompressionCodec_None;
+			chunk.compressedSize = static_cast<uint32_t>(rawSize);
+			payload.insert(payload.end(), data + rawOffset, data + rawOffset + rawSize);
+		}
+	}
+
+	const uint8_t* headerBytes = reinterpret_cast<const uint8_t*>(&header);
+	const uint8_t* chunkBytes = reinterpret_cast<const uint8_t*>(chunks.data());
+
+	file.clear();
+	file.insert(file.end(), headerBytes, headerBytes + sizeof(header));
+	file.insert(file.end(), chunkBytes, chunkBytes + chunks.size() * sizeof(ChunkedAssetChunk));
+	file.insert(file.end(), payload.begin(), payload.end());
+}
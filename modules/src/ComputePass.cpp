@@ -0,0 +1,266 @@
+#include "ComputePass.h"
+
+#include <string.h>
+
+#include <EASTL/string.h>
+#include <EASTL/vector.h>
+
+#include "EngineContext.h"
+#include "Log.h"
+#include "ShaderHotReload.h"
+#include "Shaders.h"
+#include "Telemetry.h"
+
+static const char CompiledShaderExtension[] = ".spv";
+
+void createComputeResources(EngineContext& context)
+{
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	poolInfo.queueFamilyIndex = context.computeQueueFamily;
+
+	VkResult result = vkCreateCommandPool(context.device, &poolInfo, nullptr, &context.computeCommandPool);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Cannot create compute command pool");
+	}
+
+	VkCommandBufferAllocateInfo bufferAllocationInfo = {};
+	bufferAllocationInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	bufferAllocationInfo.commandPool = context.computeCommandPool;
+	bufferAllocationInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	bufferAllocationInfo.commandBufferCount = MAX_FRAMES_IN_FLIGHT;
+
+	result = vkAllocateCommandBuffers(context.device, &bufferAllocationInfo, context.computeCommandBuffers);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Cannot allocate compute command buffers");
+	}
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		result = vkCreateSemaphore(context.device, &semaphoreInfo, nullptr, &context.computeFinishedSemaphores[i]);
+		if (result != VK_SUCCESS)
+		{
+			Log::fatal("Couldn't create compute finished semaphore");
+		}
+	}
+
+	if (context.computeQueueFamily != context.graphicsQueueFamily)
+	{
+		Log::log("Async compute on queue family %u\n", context.computeQueueFamily);
+	}
+	else
+	{
+		Log::log("No dedicated compute queue family, compute runs on the graphics queue\n");
+	}
+}
+
+void destroyComputeResources(EngineContext& context)
+{
+	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		vkDestroySemaphore(context.device, context.computeFinishedSemaphores[i], nullptr);
+	}
+
+	vkDestroyCommandPool(context.device, context.computeCommandPool, nullptr);
+}
+
+// Returns VK_NULL_HANDLE on failure
+static VkPipeline buildComputePipeline(EngineContext& context, const char* shaderFile, VkPipelineLayout layout)
+{
+	eastl::vector<uint8_t> shaderCode = loadShaderFile(context, shaderFile);
+	if (shaderCode.empty())
+	{
+		Log::error("Missing compute shader %s\n", shaderFile);
+		return VK_NULL_HANDLE;
+	}
+
+	VkShaderModule shaderModule = createShaderModule(context.device, shaderCode);
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = layout;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult result = vkCreateComputePipelines(context.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+	if (result != VK_SUCCESS)
+	{
+		Log::error("Couldn't create compute pipeline %s, result is %d\n", shaderFile, result);
+		pipeline = VK_NULL_HANDLE;
+	}
+
+	vkDestroyShaderModule(context.device, shaderModule, nullptr);
+	return pipeline;
+}
+
+// only reads the shader name and the layout, which don't change until the pipeline is unregistered
+static VkPipeline rebuildComputePipeline(EngineContext& context, const void* userData)
+{
+	const ComputePipeline& pipeline = *static_cast<const ComputePipeline*>(userData);
+	return buildComputePipeline(context, pipeline.shaderFile, pipeline.layout);
+}
+
+void createComputePipeline(EngineContext& context, const char* shaderFile, const VkDescriptorSetLayoutBinding* bindings, uint32_t numBindings, uint32_t pushConstantSize, ComputePipeline& pipeline)
+{
+	pipeline = {};
+	pipeline.pushConstantSize = pushConstantSize;
+	pipeline.shaderFile = shaderFile;
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = numBindings;
+	setLayoutInfo.pBindings = bindings;
+
+	VkResult result = vkCreateDescriptorSetLayout(context.device, &setLayoutInfo, nullptr, &pipeline.descriptorSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create descriptor set layout for %s\n", shaderFile);
+	}
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.size = pushConstantSize;
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &pipeline.descriptorSetLayout;
+	layoutInfo.pushConstantRangeCount = pushConstantSize ? 1 : 0;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	result = vkCreatePipelineLayout(context.device, &layoutInfo, nullptr, &pipeline.layout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create pipeline layout for %s\n", shaderFile);
+	}
+
+	pipeline.pipeline = buildComputePipeline(context, shaderFile, pipeline.layout);
+	if (pipeline.pipeline == VK_NULL_HANDLE)
+	{
+		Log::fatal("Couldn't create compute pipeline %s\n", shaderFile);
+	}
+
+	// the source is the .spv name without its extension, e.g. "skinning.comp"
+	eastl::string source(shaderFile);
+	size_t extensionLength = strlen(CompiledShaderExtension);
+	if (source.size() > extensionLength && source.compare(source.size() - extensionLength, extensionLength, CompiledShaderExtension) == 0)
+	{
+		source.resize(source.size() - extensionLength);
+	}
+	const char* shaderSources[] = { source.c_str() };
+	registerHotReloadPipeline(context, &pipeline.pipeline, shaderSources, 1, rebuildComputePipeline, nullptr, &pipeline);
+}
+
+void destroyComputePipeline(EngineContext& context, ComputePipeline& pipeline)
+{
+	unregisterHotReloadPipeline(context, &pipeline.pipeline);
+
+	vkDestroyPipeline(context.device, pipeline.pipeline, nullptr);
+	vkDestroyPipelineLayout(context.device, pipeline.layout, nullptr);
+	vkDestroyDescriptorSetLayout(context.device, pipeline.descriptorSetLayout, nullptr);
+
+	pipeline = {};
+}
+
+VkDescriptorSet allocateDescriptorSet(EngineContext& context, VkDescriptorSetLayout layout)
+{
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = context.descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	VkDescriptorSet descriptorSet;
+	VkResult result = vkAllocateDescriptorSets(context.device, &allocInfo, &descriptorSet);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't allocate descriptor set, result is %d\n", result);
+	}
+
+	return descriptorSet;
+}
+
+VkCommandBuffer beginComputePass(EngineContext& context)
+{
+	VkCommandBuffer commandBuffer = context.computeCommandBuffers[context.currentFrame];
+	vkResetCommandBuffer(commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	VkResult result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Cannot begin compute command buffer");
+	}
+
+	// results of the previous frame's compute work are inputs to this one
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	return commandBuffer;
+}
+
+void dispatchCompute(VkCommandBuffer commandBuffer, const ComputePipeline& pipeline, VkDescriptorSet descriptorSet, const void* pushConstants, uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout, 0, 1, &descriptorSet, 0, nullptr);
+
+	if (pipeline.pushConstantSize)
+	{
+		vkCmdPushConstants(commandBuffer, pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pipeline.pushConstantSize, pushConstants);
+	}
+
+	vkCmdDispatch(commandBuffer, groupsX, groupsY, groupsZ);
+}
+
+void dispatchComputeIndirect(VkCommandBuffer commandBuffer, const ComputePipeline& pipeline, VkDescriptorSet descriptorSet, const void* pushConstants, VkBuffer buffer, VkDeviceSize offset)
+{
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout, 0, 1, &descriptorSet, 0, nullptr);
+
+	if (pipeline.pushConstantSize)
+	{
+		vkCmdPushConstants(commandBuffer, pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, pipeline.pushConstantSize, pushConstants);
+	}
+
+	vkCmdDispatchIndirect(commandBuffer, buffer, offset);
+}
+
+void submitComputePass(EngineContext& context, VkCommandBuffer commandBuffer, VkPipelineStageFlags waitStage)
+{
+	VkResult result = vkEndCommandBuffer(commandBuffer);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Failed to record compute command buffer");
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &context.computeFinishedSemaphores[context.currentFrame];
+
+	result = vkQueueSubmit(context.computeQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't submit compute commandlist");
+	}
+	countTelemetryEvent(context, TelemetryCounter_ComputeSubmits);
+
+	context.computeWaitStage = waitStage;
+}
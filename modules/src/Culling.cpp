@@ -0,0 +1,59 @@
+#include "Culling.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CULLING_SSE2 1
+#include <emmintrin.h>
+#endif
+
+void cullSpheresScalar(const Plane planes[6], const float* centerX, const float* centerY, const float* centerZ, const float* radii, uint32_t count, uint8_t* visible)
+{
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		visible[i] = isSphereInFrustum(planes, makeVec3(centerX[i], centerY[i], centerZ[i]), radii[i]) ? 1 : 0;
+	}
+}
+
+void cullSpheres(const Plane planes[6], const float* centerX, const float* centerY, const float* centerZ, const float* radii, uint32_t count, uint8_t* visible)
+{
+	uint32_t i = 0;
+
+#ifdef CULLING_SSE2
+	__m128 planeX[6];
+	__m128 planeY[6];
+	__m128 planeZ[6];
+	__m128 planeD[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		planeX[p] = _mm_set1_ps(planes[p].normal.x);
+		planeY[p] = _mm_set1_ps(planes[p].normal.y);
+		planeZ[p] = _mm_set1_ps(planes[p].normal.z);
+		planeD[p] = _mm_set1_ps(planes[p].d);
+	}
+
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(centerX + i);
+		__m128 y = _mm_loadu_ps(centerY + i);
+		__m128 z = _mm_loadu_ps(centerZ + i);
+		__m128 negativeRadius = _mm_xor_ps(_mm_loadu_ps(radii + i), signBit);
+
+		// same operation order as dot() + d in the scalar test
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; ++p)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)), _mm_mul_ps(planeZ[p], z)), planeD[p]);
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+		}
+
+		int outsideMask = _mm_movemask_ps(outside);
+		visible[i + 0] = (outsideMask & 1) ? 0 : 1;
+		visible[i + 1] = (outsideMask & 2) ? 0 : 1;
+		visible[i + 2] = (outsideMask & 4) ? 0 : 1;
+		visible[i + 3] = (outsideMask & 8) ? 0 : 1;
+	}
+#endif
+
+	cullSpheresScalar(planes, centerX + i, centerY + i, centerZ + i, radii + i, count - i, visible + i);
+}
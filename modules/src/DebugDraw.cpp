@@ -0,0 +1,868 @@
+#include "DebugDraw.h"
+
+#ifdef ENGINE_DEBUG_DRAW
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <EASTL/vector.h>
+
+#include "Clock.h"
+#include "Constants.h"
+#include "EngineContext.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "PipelineCache.h"
+#include "ResourceRegistry.h"
+
+// per frame in flight, lines first and quads after them
+static const uint32_t MaxDebugVertices = 1 << 16;
+static const uint32_t MaxDebugGpuPasses = 8;
+static const uint32_t NumQueriesPerFrame = MaxDebugGpuPasses + 1;
+
+static const uint32_t GlyphWidth = 3;
+static const uint32_t GlyphHeight = 5;
+static const uint32_t SolidGlyph = (1u << (GlyphWidth * GlyphHeight)) - 1;
+// screen pixels per font pixel
+static const float TextScale = 2.0f;
+static const float GlyphAdvance = (GlyphWidth + 1) * TextScale;
+static const float LineHeight = (GlyphHeight + 2) * TextScale;
+
+static const uint32_t FrameHistoryLength = 120;
+static const float GraphBarWidth = 2.0f;
+static const float GraphHeight = 40.0f;
+// the graphs' full height, with a line marking the target
+static const float GraphMaxMilliseconds = 33.3f;
+static const float TargetMilliseconds = 16.7f;
+static const float OverlayPadding = 8.0f;
+// how quickly the overlay's numbers follow the measured ones, per frame
+static const float DisplaySmoothing = 0.1f;
+
+// Rows top to bottom, three bits each with the leftmost column highest, for ASCII 32 to 95. Lower
+// case letters use the upper case glyphs, anything else shows as '?'. Must match debugdraw.frag.
+static const uint16_t FontGlyphs[64] = {
+	0b000'000'000'000'000, // space
+	0b010'010'010'000'010, // !
+	0b101'101'000'000'000, // "
+	0b101'111'101'111'101, // #
+	0b011'110'010'011'110, // $
+	0b101'001'010'100'101, // %
+	0b010'101'010'101'011, // &
+	0b010'010'000'000'000, // '
+	0b010'100'100'100'010, // (
+	0b010'001'001'001'010, // )
+	0b000'101'010'101'000, // *
+	0b000'010'111'010'000, // +
+	0b000'000'000'010'100, // ,
+	0b000'000'111'000'000, // -
+	0b000'000'000'000'010, // .
+	0b001'001'010'100'100, // /
+	0b111'101'101'101'111, // 0
+	0b010'110'010'010'111, // 1
+	0b111'001'111'100'111, // 2
+	0b111'001'011'001'111, // 3
+	0b101'101'111'001'001, // 4
+	0b111'100'111'001'111, // 5
+	0b111'100'111'101'111, // 6
+	0b111'001'001'010'010, // 7
+	0b111'101'111'101'111, // 8
+	0b111'101'111'001'111, // 9
+	0b000'010'000'010'000, // :
+	0b000'010'000'010'100, // ;
+	0b001'010'100'010'001, // <
+	0b000'111'000'111'000, // =
+	0b100'010'001'010'100, // >
+	0b111'001'010'000'010, // ?
+	0b111'101'101'100'011, // @
+	0b010'101'111'101'101, // A
+	0b110'101'110'101'110, // B
+	0b011'100'100'100'011, // C
+	0b110'101'101'101'110, // D
+	0b111'100'110'100'111, // E
+	0b111'100'110'100'100, // F
+	0b011'100'101'101'011, // G
+	0b101'101'111'101'101, // H
+	0b111'010'010'010'111, // I
+	0b001'001'001'101'010, // J
+	0b101'101'110'101'101, // K
+	0b100'100'100'100'111, // L
+	0b101'111'111'101'101, // M
+	0b110'101'101'101'101, // N
+	0b010'101'101'101'010, // O
+	0b110'101'110'100'100, // P
+	0b010'101'101'110'011, // Q
+	0b110'101'110'101'101, // R
+	0b011'100'010'001'110, // S
+	0b111'010'010'010'010, // T
+	0b101'101'101'101'011, // U
+	0b101'101'101'010'010, // V
+	0b101'101'111'111'101, // W
+	0b101'101'010'101'101, // X
+	0b101'101'010'010'010, // Y
+	0b111'001'010'100'111, // Z
+	0b110'100'100'100'110, // [
+	0b100'100'010'001'001, // backslash
+	0b011'001'001'001'011, // ]
+	0b010'101'000'000'000, // ^
+	0b000'000'000'000'111, // _
+};
+
+struct DebugVertex
+{
+	float position[3];
+	uint32_t color;
+	// position within the glyph in font pixels, 0 to 3 across and 0 to 5 down
+	float glyphPixel[2];
+	uint32_t glyph;
+};
+
+struct DebugDrawPushConstants
+{
+	Mat4 viewProjection;
+	float invScreenSize[2];
+	// positions are in screen pixels instead of world space
+	uint32_t screenSpace;
+};
+
+struct DebugVertexLists
+{
+	eastl::vector<DebugVertex> lines;
+	// two triangles per quad
+	eastl::vector<DebugVertex> quads;
+};
+
+// A thread adds to lists[writeIndex], recordDebugDraw flips writeIndex and reads the other half once
+// the thread isn't inside a call that may still use it. Each call's shapes are handed over whole, and
+// the owning thread and the render thread never touch the same half, like RenderCommands.
+struct ThreadDebugBuffer
+{
+	DebugVertexLists lists[2];
+	// set while the owning thread is inside a debugDraw call
+	std::atomic<uint32_t> writing;
+};
+
+struct GpuPassMarkers
+{
+	const char* names[MaxDebugGpuPasses];
+	uint32_t numPasses;
+	bool written;
+};
+
+struct DebugOverlay
+{
+	bool shown;
+
+	VkQueryPool queryPool;
+	// nanoseconds per timestamp tick
+	float timestampPeriod;
+	uint64_t timestampMask;
+	GpuPassMarkers markers[MAX_FRAMES_IN_FLIGHT];
+
+	// smoothed, of the passes the last read markers named
+	const char* passNames[MaxDebugGpuPasses];
+	float passMilliseconds[MaxDebugGpuPasses];
+	uint32_t numPasses;
+
+	// ring buffers, historyIndex is the oldest entry
+	float cpuFrameHistory[FrameHistoryLength];
+	float gpuFrameHistory[FrameHistoryLength];
+	uint32_t historyIndex;
+
+	double lastFrameTime;
+	float cpuFrameMilliseconds;
+	float gpuFrameMilliseconds;
+	// the render thread's own cost: building the overlay and copying and recording everything
+	float updateMilliseconds;
+	float costMilliseconds;
+};
+
+struct DebugDraw
+{
+	// never reused, so a thread's cached buffer can't be mistaken for one of a later instance
+	// allocated at the same address
+	uint64_t generation;
+	std::atomic<uint32_t> writeIndex;
+
+	// guards threadBuffers, only taken the first time a thread draws and when the render thread gathers
+	std::mutex registrationMutex;
+	eastl::vector<ThreadDebugBuffer*> threadBuffers;
+
+	// MAX_FRAMES_IN_FLIGHT regions of MaxDebugVertices, persistently mapped
+	GpuBuffer vertexBuffer;
+	BufferHandle vertexBufferHandle;
+	VkPipelineLayout pipelineLayout;
+	PipelineDesc linePipelineDesc;
+	PipelineDesc quadPipelineDesc;
+	bool warnedFull;
+
+	DebugOverlay overlay;
+};
+
+static std::atomic<uint64_t> s_nextGeneration(1);
+
+static thread_local uint64_t t_generation = 0;
+static thread_local ThreadDebugBuffer* t_buffer = nullptr;
+
+static bool isEnvSet(const char* name, bool defaultValue)
+{
+	const char* value = getenv(name);
+	return value ? strcmp(value, "0") != 0 : defaultValue;
+}
+
+// The calling thread's lists to add to until endThreadWrite. nullptr before the debug draw is created
+// or after it's destroyed, then endThreadWrite isn't needed.
+static DebugVertexLists* beginThreadWrite(EngineContext& context)
+{
+	DebugDraw* draw = context.debugDraw;
+	if (!draw)
+	{
+		return nullptr;
+	}
+
+	if (t_generation != draw->generation)
+	{
+		t_buffer = new ThreadDebugBuffer;
+		t_buffer->writing = 0;
+		t_generation = draw->generation;
+
+		std::lock_guard<std::mutex> lock(draw->registrationMutex);
+		draw->threadBuffers.push_back(t_buffer);
+	}
+
+	// pairs with the flip in recordDebugDraw: either it sees this flag and waits, or this load sees
+	// the flipped index
+	t_buffer->writing.store(1, std::memory_order_seq_cst);
+	return &t_buffer->lists[draw->writeIndex.load(std::memory_order_seq_cst)];
+}
+
+static void endThreadWrite()
+{
+	t_buffer->writing.store(0, std::memory_order_release);
+}
+
+static DebugVertex makeDebugVertex(float x, float y, float z, uint32_t color, float glyphX, float glyphY, uint32_t glyph)
+{
+	DebugVertex vertex = {};
+	vertex.position[0] = x;
+	vertex.position[1] = y;
+	vertex.position[2] = z;
+	vertex.color = color;
+	vertex.glyphPixel[0] = glyphX;
+	vertex.glyphPixel[1] = glyphY;
+	vertex.glyph = glyph;
+	return vertex;
+}
+
+static void addLine(DebugVertexLists& buffer, Vec3 from, Vec3 to, uint32_t color)
+{
+	buffer.lines.push_back(makeDebugVertex(from.x, from.y, from.z, color, 0.0f, 0.0f, SolidGlyph));
+	buffer.lines.push_back(makeDebugVertex(to.x, to.y, to.z, color, 0.0f, 0.0f, SolidGlyph));
+}
+
+static void addQuad(DebugVertexLists& buffer, float x, float y, float width, float height, uint32_t color, uint32_t glyph)
+{
+	float right = x + width;
+	float bottom = y + height;
+	float glyphRight = static_cast<float>(GlyphWidth);
+	float glyphBottom = static_cast<float>(GlyphHeight);
+
+	buffer.quads.push_back(makeDebugVertex(x, y, 0.0f, color, 0.0f, 0.0f, glyph));
+	buffer.quads.push_back(makeDebugVertex(right, y, 0.0f, color, glyphRight, 0.0f, glyph));
+	buffer.quads.push_back(makeDebugVertex(right, bottom, 0.0f, color, glyphRight, glyphBottom, glyph));
+	buffer.quads.push_back(makeDebugVertex(x, y, 0.0f, color, 0.0f, 0.0f, glyph));
+	buffer.quads.push_back(makeDebugVertex(right, bottom, 0.0f, color, glyphRight, glyphBottom, glyph));
+	buffer.quads.push_back(makeDebugVertex(x, bottom, 0.0f, color, 0.0f, glyphBottom, glyph));
+}
+
+static uint32_t getGlyph(char c)
+{
+	if (c >= 'a' && c <= 'z')
+	{
+		c = c - 'a' + 'A';
+	}
+
+	if (c < ' ' || c > '_')
+	{
+		c = '?';
+	}
+
+	return FontGlyphs[c - ' '];
+}
+
+static void addText(DebugVertexLists& buffer, float x, float y, uint32_t color, const char* text)
+{
+	float penX = x;
+	for (const char* c = text; *c; ++c)
+	{
+		if (*c == '\n')
+		{
+			penX = x;
+			y += LineHeight;
+			continue;
+		}
+
+		uint32_t glyph = getGlyph(*c);
+		if (glyph != 0)
+		{
+			addQuad(buffer, penX, y, GlyphWidth * TextScale, GlyphHeight * TextScale, color, glyph);
+		}
+		penX += GlyphAdvance;
+	}
+}
+
+void debugDrawLine(EngineContext& context, Vec3 from, Vec3 to, uint32_t color)
+{
+	DebugVertexLists* buffer = beginThreadWrite(context);
+	if (buffer)
+	{
+		addLine(*buffer, from, to, color);
+		endThreadWrite();
+	}
+}
+
+void debugDrawBox(EngineContext& context, Vec3 min, Vec3 max, uint32_t color)
+{
+	DebugVertexLists* buffer = beginThreadWrite(context);
+	if (!buffer)
+	{
+		return;
+	}
+
+	// corner i takes max on the axes whose bit is set
+	Vec3 corners[8];
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		corners[i] = makeVec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+	}
+
+	// every edge joins two corners that differ in one bit
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		for (uint32_t axis = 1; axis < 8; axis <<= 1)
+		{
+			if (!(i & axis))
+			{
+				addLine(*buffer, corners[i], corners[i | axis], color);
+			}
+		}
+	}
+
+	endThreadWrite();
+}
+
+void debugDrawSphere(EngineContext& context, Vec3 center, float radius, uint32_t color)
+{
+	DebugVertexLists* buffer = beginThreadWrite(context);
+	if (!buffer)
+	{
+		return;
+	}
+
+	// a circle around each axis
+	const uint32_t numSegments = 24;
+	Vec3 previous[3];
+	for (uint32_t i = 0; i <= numSegments; ++i)
+	{
+		float angle = 6.2831853f * i / numSegments;
+		float c = cosf(angle) * radius;
+		float s = sinf(angle) * radius;
+		Vec3 points[3] = {
+			center + makeVec3(0.0f, c, s),
+			center + makeVec3(c, 0.0f, s),
+			center + makeVec3(c, s, 0.0f),
+		};
+
+		for (uint32_t circle = 0; circle < 3; ++circle)
+		{
+			if (i > 0)
+			{
+				addLine(*buffer, previous[circle], points[circle], color);
+			}
+			previous[circle] = points[circle];
+		}
+	}
+
+	endThreadWrite();
+}
+
+void debugDrawText(EngineContext& context, float x, float y, uint32_t color, const char* format, ...)
+{
+	DebugVertexLists* buffer = beginThreadWrite(context);
+	if (!buffer)
+	{
+		return;
+	}
+
+	char text[256];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+
+	addText(*buffer, x, y, color, text);
+	endThreadWrite();
+}
+
+void debugDrawRect(EngineContext& context, float x, float y, float width, float height, uint32_t color)
+{
+	DebugVertexLists* buffer = beginThreadWrite(context);
+	if (buffer)
+	{
+		addQuad(*buffer, x, y, width, height, color, SolidGlyph);
+		endThreadWrite();
+	}
+}
+
+static void createTimestampQueries(EngineContext& context, DebugOverlay& overlay)
+{
+	uint64_t timestampMask = getTimestampMask(context, context.graphicsQueueFamily);
+	if (timestampMask == 0)
+	{
+		Log::warning("The graphics queue has no timestamps, the overlay only shows CPU times\n");
+		return;
+	}
+
+	overlay.timestampMask = timestampMask;
+	overlay.timestampPeriod = context.physicalDeviceProperties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo queryPoolInfo = {};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = NumQueriesPerFrame * MAX_FRAMES_IN_FLIGHT;
+
+	VkResult result = vkCreateQueryPool(context.device, &queryPoolInfo, nullptr, &overlay.queryPool);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create debug overlay query pool\n");
+	}
+}
+
+static void createPipelines(EngineContext& context, DebugDraw& draw)
+{
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.size = sizeof(DebugDrawPushConstants);
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	VkResult result = vkCreatePipelineLayout(context.device, &layoutInfo, nullptr, &draw.pipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create debug draw pipeline layout\n");
+	}
+
+	PipelineDesc desc = makeDefaultPipelineDesc();
+	desc.vertexShader = "debugdraw.vert";
+	desc.fragmentShader = "debugdraw.frag";
+	desc.layout = draw.pipelineLayout;
+	desc.cullMode = VK_CULL_MODE_NONE;
+	desc.blendMode = BlendMode_Alpha;
+	desc.renderPass = context.swapchainRenderPass;
+	desc.colorFormat = context.swapchainFormat;
+
+	desc.numVertexBindings = 1;
+	desc.vertexBindings[0].binding = 0;
+	desc.vertexBindings[0].stride = sizeof(DebugVertex);
+	desc.vertexBindings[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	const VkFormat formats[] = { VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32_UINT };
+	const uint32_t offsets[] = { offsetof(DebugVertex, position), offsetof(DebugVertex, color), offsetof(DebugVertex, glyphPixel), offsetof(DebugVertex, glyph) };
+	desc.numVertexAttributes = 4;
+	for (uint32_t i = 0; i < desc.numVertexAttributes; ++i)
+	{
+		desc.vertexAttributes[i].location = i;
+		desc.vertexAttributes[i].binding = 0;
+		desc.vertexAttributes[i].format = formats[i];
+		desc.vertexAttributes[i].offset = offsets[i];
+	}
+
+	draw.linePipelineDesc = desc;
+	draw.linePipelineDesc.topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+	draw.quadPipelineDesc = desc;
+
+	getPipeline(context, draw.linePipelineDesc);
+	getPipeline(context, draw.quadPipelineDesc);
+}
+
+void createDebugDraw(EngineContext& context)
+{
+	DebugDraw* draw = new DebugDraw;
+	draw->generation = s_nextGeneration.fetch_add(1, std::memory_order_relaxed);
+	draw->writeIndex = 0;
+	draw->vertexBuffer = {};
+	draw->warnedFull = false;
+	draw->overlay = {};
+
+	createGpuBuffer(context, MaxDebugVertices * MAX_FRAMES_IN_FLIGHT * sizeof(DebugVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, draw->vertexBuffer);
+	draw->vertexBufferHandle = registerBuffer(context, "debugVertices", draw->vertexBuffer);
+
+	createPipelines(context, *draw);
+
+	DebugOverlay& overlay = draw->overlay;
+	overlay.shown = isEnvSet("ENGINE_DEBUG_OVERLAY", false);
+	if (overlay.shown)
+	{
+		createTimestampQueries(context, overlay);
+	}
+	overlay.lastFrameTime = getEngineTime();
+
+	context.debugDraw = draw;
+}
+
+void destroyDebugDraw(EngineContext& context)
+{
+	DebugDraw* draw = context.debugDraw;
+	if (!draw)
+	{
+		return;
+	}
+
+	if (draw->overlay.queryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(context.device, draw->overlay.queryPool, nullptr);
+	}
+	vkDestroyPipelineLayout(context.device, draw->pipelineLayout, nullptr);
+	unregisterBuffer(context, draw->vertexBufferHandle);
+	destroyGpuBuffer(context, draw->vertexBuffer);
+
+	for (ThreadDebugBuffer* buffer : draw->threadBuffers)
+	{
+		delete buffer;
+	}
+
+	delete draw;
+	context.debugDraw = nullptr;
+}
+
+static void readGpuPassTimes(EngineContext& context, DebugOverlay& overlay)
+{
+	GpuPassMarkers& markers = overlay.markers[context.currentFrame];
+	if (overlay.queryPool == VK_NULL_HANDLE || !markers.written || markers.numPasses == 0)
+	{
+		return;
+	}
+	markers.written = false;
+
+	// each result is followed by its availability
+	uint64_t results[NumQueriesPerFrame * 2] = {};
+	uint32_t numQueries = markers.numPasses + 1;
+	VkResult result = vkGetQueryPoolResults(context.device, overlay.queryPool, context.currentFrame * NumQueriesPerFrame, numQueries,
+		numQueries * 2 * sizeof(uint64_t), results, 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (result != VK_SUCCESS)
+	{
+		return;
+	}
+
+	for (uint32_t i = 0; i < numQueries; ++i)
+	{
+		if (!results[i * 2 + 1])
+		{
+			return;
+		}
+	}
+
+	float tickMilliseconds = overlay.timestampPeriod * 1e-6f;
+	for (uint32_t i = 0; i < markers.numPasses; ++i)
+	{
+		uint64_t ticks = (results[(i + 1) * 2] - results[i * 2]) & overlay.timestampMask;
+		float milliseconds = ticks * tickMilliseconds;
+
+		// a pass that wasn't in the same place last frame starts over
+		if (i >= overlay.numPasses || overlay.passNames[i] != markers.names[i])
+		{
+			overlay.passNames[i] = markers.names[i];
+			overlay.passMilliseconds[i] = milliseconds;
+		}
+		overlay.passMilliseconds[i] += (milliseconds - overlay.passMilliseconds[i]) * DisplaySmoothing;
+	}
+	overlay.numPasses = markers.numPasses;
+
+	uint64_t frameTicks = (results[markers.numPasses * 2] - results[0]) & overlay.timestampMask;
+	overlay.gpuFrameHistory[overlay.historyIndex] = frameTicks * tickMilliseconds;
+}
+
+static uint32_t getFrameTimeColor(float milliseconds)
+{
+	if (milliseconds <= TargetMilliseconds)
+	{
+		return makeDebugColor(80, 220, 80, 255);
+	}
+
+	return milliseconds <= GraphMaxMilliseconds ? makeDebugColor(240, 200, 60, 255) : makeDebugColor(240, 70, 60, 255);
+}
+
+static void drawFrameGraph(EngineContext& context, const DebugOverlay& overlay, const float* history, float x, float y)
+{
+	debugDrawRect(context, x, y, FrameHistoryLength * GraphBarWidth, GraphHeight, makeDebugColor(255, 255, 255, 24));
+
+	// oldest on the left
+	for (uint32_t i = 0; i < FrameHistoryLength; ++i)
+	{
+		float milliseconds = history[(overlay.historyIndex + 1 + i) % FrameHistoryLength];
+		float height = milliseconds < GraphMaxMilliseconds ? milliseconds / GraphMaxMilliseconds * GraphHeight : GraphHeight;
+		debugDrawRect(context, x + i * GraphBarWidth, y + GraphHeight - height, GraphBarWidth, height, getFrameTimeColor(milliseconds));
+	}
+
+	float targetY = y + GraphHeight - TargetMilliseconds / GraphMaxMilliseconds * GraphHeight;
+	debugDrawRect(context, x, targetY, FrameHistoryLength * GraphBarWidth, 1.0f, makeDebugColor(255, 255, 255, 160));
+}
+
+static void drawOverlay(EngineContext& context, DebugOverlay& overlay)
+{
+	const VkPhysicalDeviceMemoryProperties& memory = context.memoryProperties;
+	const GpuMemoryStats& memoryStats = context.gpuMemoryStats;
+	uint32_t numUsedHeaps = 0;
+	for (uint32_t i = 0; i < memory.memoryHeapCount; ++i)
+	{
+		numUsedHeaps += memoryStats.bytesPerHeap[i] != 0;
+	}
+
+	uint32_t numImages = 0;
+	uint32_t numBuffers = 0;
+	const RegisteredImage* images = getRegisteredImages(context, numImages);
+	const RegisteredBuffer* buffers = getRegisteredBuffers(context, numBuffers);
+
+	bool hasGpuTimes = overlay.queryPool != VK_NULL_HANDLE;
+	uint32_t numGraphs = hasGpuTimes ? 2 : 1;
+	uint32_t numLines = numGraphs + (hasGpuTimes ? overlay.numPasses : 0) + 1 + numUsedHeaps + 1 + numImages + numBuffers + 2;
+
+	// the background goes first, everything is drawn in the order it was added
+	float width = FrameHistoryLength * GraphBarWidth + 2.0f * OverlayPadding;
+	float height = numLines * LineHeight + numGraphs * (GraphHeight + OverlayPadding) + 2.0f * OverlayPadding;
+	debugDrawRect(context, OverlayPadding, OverlayPadding, width, height, makeDebugColor(0, 0, 0, 176));
+
+	uint32_t white = makeDebugColor(255, 255, 255, 255);
+	uint32_t gray = makeDebugColor(170, 170, 170, 255);
+	float x = 2.0f * OverlayPadding;
+	float y = 2.0f * OverlayPadding;
+
+	debugDrawText(context, x, y, white, "CPU FRAME %6.2f MS", overlay.cpuFrameMilliseconds);
+	y += LineHeight;
+	drawFrameGraph(context, overlay, overlay.cpuFrameHistory, x, y);
+	y += GraphHeight + OverlayPadding;
+
+	if (hasGpuTimes)
+	{
+		debugDrawText(context, x, y, white, "GPU FRAME %6.2f MS", overlay.gpuFrameMilliseconds);
+		y += LineHeight;
+		drawFrameGraph(context, overlay, overlay.gpuFrameHistory, x, y);
+		y += GraphHeight + OverlayPadding;
+
+		for (uint32_t i = 0; i < overlay.numPasses; ++i)
+		{
+			debugDrawText(context, x, y, gray, "  %-14s %6.2f MS", overlay.passNames[i], overlay.passMilliseconds[i]);
+			y += LineHeight;
+		}
+	}
+
+	debugDrawText(context, x, y, white, "GPU MEMORY %u LIVE, %llu TOTAL", memoryStats.numLiveAllocations,
+		static_cast<unsigned long long>(memoryStats.numAllocationsTotal));
+	y += LineHeight;
+	for (uint32_t i = 0; i < memory.memoryHeapCount; ++i)
+	{
+		if (memoryStats.bytesPerHeap[i] == 0)
+		{
+			continue;
+		}
+
+		bool deviceLocal = (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		debugDrawText(context, x, y, gray, "  HEAP %u %-6s %8.1f MIB", i, deviceLocal ? "DEVICE" : "HOST",
+			memoryStats.bytesPerHeap[i] / (1024.0 * 1024.0));
+		y += LineHeight;
+	}
+
+	// everything named in the resource registry
+	debugDrawText(context, x, y, white, "NAMED %u IMAGES, %u BUFFERS", numImages, numBuffers);
+	y += LineHeight;
+	for (uint32_t i = 0; i < numImages; ++i)
+	{
+		debugDrawText(context, x, y, gray, "  %-13s %6.1f MIB", images[i].name, images[i].allocationSize / (1024.0 * 1024.0));
+		y += LineHeight;
+	}
+	for (uint32_t i = 0; i < numBuffers; ++i)
+	{
+		debugDrawText(context, x, y, gray, "  %-13s %6.1f MIB", buffers[i].name, buffers[i].size / (1024.0 * 1024.0));
+		y += LineHeight;
+	}
+
+	debugDrawText(context, x, y, white, "RENDER %ux%u OF %ux%u", context.renderExtent.width, context.renderExtent.height,
+		context.swapchainExtent.width, context.swapchainExtent.height);
+	y += LineHeight;
+	debugDrawText(context, x, y, gray, "OVERLAY %.3f MS CPU", overlay.costMilliseconds);
+}
+
+void updateDebugOverlay(EngineContext& context)
+{
+	DebugDraw* draw = context.debugDraw;
+	if (!draw || !draw->overlay.shown)
+	{
+		return;
+	}
+
+	DebugOverlay& overlay = draw->overlay;
+	double time = getEngineTime();
+	float frameMilliseconds = static_cast<float>((time - overlay.lastFrameTime) * 1000.0);
+	overlay.lastFrameTime = time;
+
+	overlay.historyIndex = (overlay.historyIndex + 1) % FrameHistoryLength;
+	overlay.cpuFrameHistory[overlay.historyIndex] = frameMilliseconds;
+	overlay.gpuFrameHistory[overlay.historyIndex] = 0.0f;
+	readGpuPassTimes(context, overlay);
+
+	overlay.cpuFrameMilliseconds += (frameMilliseconds - overlay.cpuFrameMilliseconds) * DisplaySmoothing;
+	overlay.gpuFrameMilliseconds += (overlay.gpuFrameHistory[overlay.historyIndex] - overlay.gpuFrameMilliseconds) * DisplaySmoothing;
+
+	drawOverlay(context, overlay);
+
+	overlay.updateMilliseconds = static_cast<float>((getEngineTime() - time) * 1000.0);
+}
+
+void beginDebugGpuPasses(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	DebugDraw* draw = context.debugDraw;
+	if (!draw || draw->overlay.queryPool == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	DebugOverlay& overlay = draw->overlay;
+	uint32_t firstQuery = context.currentFrame * NumQueriesPerFrame;
+	vkCmdResetQueryPool(commandBuffer, overlay.queryPool, firstQuery, NumQueriesPerFrame);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, overlay.queryPool, firstQuery);
+
+	overlay.markers[context.currentFrame].numPasses = 0;
+	overlay.markers[context.currentFrame].written = true;
+}
+
+void markDebugGpuPass(EngineContext& context, VkCommandBuffer commandBuffer, const char* name)
+{
+	DebugDraw* draw = context.debugDraw;
+	if (!draw || draw->overlay.queryPool == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	DebugOverlay& overlay = draw->overlay;
+	GpuPassMarkers& markers = overlay.markers[context.currentFrame];
+	if (markers.numPasses == MaxDebugGpuPasses)
+	{
+		return;
+	}
+
+	uint32_t query = context.currentFrame * NumQueriesPerFrame + markers.numPasses + 1;
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, overlay.queryPool, query);
+	markers.names[markers.numPasses] = name;
+	++markers.numPasses;
+}
+
+// Whole primitives only, what doesn't fit is dropped
+static void appendVertices(DebugVertex* vertices, uint32_t& numVertices, const eastl::vector<DebugVertex>& source, uint32_t primitiveSize, uint32_t& numDropped)
+{
+	uint32_t count = static_cast<uint32_t>(source.size());
+	uint32_t space = MaxDebugVertices - numVertices;
+	if (count > space)
+	{
+		numDropped += count - space;
+		count = space - space % primitiveSize;
+	}
+
+	memcpy(vertices + numVertices, source.data(), count * sizeof(DebugVertex));
+	numVertices += count;
+}
+
+void recordDebugDraw(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	DebugDraw* draw = context.debugDraw;
+	if (!draw)
+	{
+		return;
+	}
+
+	double startTime = getEngineTime();
+
+	// written straight into this frame's region, the fence wait made sure the GPU is done with it
+	DebugVertex* vertices = static_cast<DebugVertex*>(draw->vertexBuffer.mapped) + context.currentFrame * MaxDebugVertices;
+	uint32_t numLineVertices = 0;
+	uint32_t numVertices = 0;
+	uint32_t numDropped = 0;
+	{
+		// later calls go to the other half and are drawn next frame
+		uint32_t readIndex = draw->writeIndex.load(std::memory_order_relaxed);
+		draw->writeIndex.store(readIndex ^ 1, std::memory_order_seq_cst);
+
+		std::lock_guard<std::mutex> lock(draw->registrationMutex);
+		for (ThreadDebugBuffer* buffer : draw->threadBuffers)
+		{
+			// a call that picked the old half before the flip finishes first, calls are short
+			while (buffer->writing.load(std::memory_order_acquire))
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		for (ThreadDebugBuffer* buffer : draw->threadBuffers)
+		{
+			DebugVertexLists& lists = buffer->lists[readIndex];
+			appendVertices(vertices, numVertices, lists.lines, 2, numDropped);
+			lists.lines.clear();
+		}
+		numLineVertices = numVertices;
+
+		for (ThreadDebugBuffer* buffer : draw->threadBuffers)
+		{
+			DebugVertexLists& lists = buffer->lists[readIndex];
+			appendVertices(vertices, numVertices, lists.quads, 6, numDropped);
+			lists.quads.clear();
+		}
+	}
+
+	if (numDropped > 0 && !draw->warnedFull)
+	{
+		Log::warning("Debug draw dropped %u vertices, only %u fit in a frame\n", numDropped, MaxDebugVertices);
+		draw->warnedFull = true;
+	}
+
+	if (numVertices > 0)
+	{
+		DebugDrawPushConstants pushConstants = {};
+		pushConstants.viewProjection = context.camera.viewProjection;
+		pushConstants.invScreenSize[0] = 1.0f / context.swapchainExtent.width;
+		pushConstants.invScreenSize[1] = 1.0f / context.swapchainExtent.height;
+
+		VkDeviceSize offset = context.currentFrame * MaxDebugVertices * sizeof(DebugVertex);
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &draw->vertexBuffer.buffer, &offset);
+
+		if (numLineVertices > 0)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(context, draw->linePipelineDesc));
+			vkCmdPushConstants(commandBuffer, draw->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+			vkCmdDraw(commandBuffer, numLineVertices, 1, 0, 0);
+		}
+
+		if (numVertices > numLineVertices)
+		{
+			pushConstants.screenSpace = 1;
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(context, draw->quadPipelineDesc));
+			vkCmdPushConstants(commandBuffer, draw->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(pushConstants), &pushConstants);
+			vkCmdDraw(commandBuffer, numVertices - numLineVertices, 1, numLineVertices, 0);
+		}
+	}
+
+	DebugOverlay& overlay = draw->overlay;
+	float recordMilliseconds = static_cast<float>((getEngineTime() - startTime) * 1000.0);
+	overlay.costMilliseconds += (overlay.updateMilliseconds + recordMilliseconds - overlay.costMilliseconds) * DisplaySmoothing;
+}
+
+#endif
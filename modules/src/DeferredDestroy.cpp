@@ -0,0 +1,73 @@
+#include "DeferredDestroy.h"
+
+#include "EngineContext.h"
+#include "Log.h"
+
+template<typename T>
+static uint64_t handleToU64(T handle)
+{
+	return (uint64_t)(handle);
+}
+
+template<typename T>
+static T u64ToHandle(uint64_t handle)
+{
+	return (T)(handle);
+}
+
+static void destroyObject(EngineContext& context, const DeferredDestroy& object)
+{
+	switch (object.type)
+	{
+	case VK_OBJECT_TYPE_PIPELINE:
+		vkDestroyPipeline(context.device, u64ToHandle<VkPipeline>(object.handle), nullptr);
+		break;
+	default:
+		Log::fatal("Unsupported deferred destroy object type %d\n", object.type);
+	}
+}
+
+void deferDestroy(EngineContext& context, VkPipeline pipeline)
+{
+	if (pipeline == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	DeferredDestroy object = {};
+	object.type = VK_OBJECT_TYPE_PIPELINE;
+	object.handle = handleToU64(pipeline);
+	object.frameNumber = context.frameNumber;
+
+	context.deferredDestroys.push_back(object);
+}
+
+void processDeferredDestroys(EngineContext& context)
+{
+	// frame N's slot is reused (and its fence waited on) at frame N + MAX_FRAMES_IN_FLIGHT
+	size_t numKept = 0;
+	for (size_t i = 0; i < context.deferredDestroys.size(); ++i)
+	{
+		const DeferredDestroy& object = context.deferredDestroys[i];
+		if (context.frameNumber >= object.frameNumber + MAX_FRAMES_IN_FLIGHT)
+		{
+			destroyObject(context, object);
+		}
+		else
+		{
+			context.deferredDestroys[numKept++] = object;
+		}
+	}
+
+	context.deferredDestroys.resize(numKept);
+}
+
+void flushDeferredDestroys(EngineContext& context)
+{
+	for (const DeferredDestroy& object : context.deferredDestroys)
+	{
+		destroyObject(context, object);
+	}
+
+	context.deferredDestroys.clear();
+}
@@ -0,0 +1,58 @@
+#include "DepthBuffer.h"
+
+#include "ArraySize.h"
+#include "EngineContext.h"
+#include "Log.h"
+#include "ResourceRegistry.h"
+
+static VkFormat chooseDepthFormat(EngineContext& context)
+{
+	const VkFormat candidates[] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT };
+	const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+
+	for (size_t i = 0; i < ARRAY_SIZE(candidates); ++i)
+	{
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(context.physicalDevice, candidates[i], &properties);
+		if ((properties.optimalTilingFeatures & required) == required)
+		{
+			return candidates[i];
+		}
+	}
+
+	Log::fatal("No sampleable depth format");
+}
+
+void createDepthBuffer(EngineContext& context)
+{
+	context.depthFormat = chooseDepthFormat(context);
+
+	createGpuImage(context, context.swapchainExtent.width, context.swapchainExtent.height, 1, context.depthFormat,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, context.depthImage);
+	// the depth pyramid leaves it shader readable instead when there is one
+	context.depthImageHandle = registerImage(context, "depth", context.depthImage, getDepthBarrierAspect(context.depthFormat),
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+}
+
+void destroyDepthBuffer(EngineContext& context)
+{
+	unregisterImage(context, context.depthImageHandle);
+	destroyGpuImage(context, context.depthImage);
+}
+
+VkImageAspectFlags getDepthBarrierAspect(VkFormat format)
+{
+	if (format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT)
+	{
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	}
+
+	return VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+
+void transitionDepthBuffer(EngineContext& context, VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout,
+	VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	recordImageBarrier(commandBuffer, context.depthImage.image, getDepthBarrierAspect(context.depthFormat), 0, 1,
+		oldLayout, newLayout, srcStage, srcAccess, dstStage, dstAccess);
+}
@@ -0,0 +1,253 @@
+#include "DepthPyramid.h"
+
+#include "ComputePass.h"
+#include "DepthBuffer.h"
+#include "EngineContext.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "ResourceRegistry.h"
+
+// must match the local size in depthpyramid.comp
+static const uint32_t ReduceGroupSize = 8;
+
+struct DepthPyramidPushConstants
+{
+	uint32_t sourceSize[2];
+	uint32_t destinationSize[2];
+	// the depth buffer only has one channel, the pyramid's levels have min and max
+	uint32_t fromDepth;
+};
+
+struct DepthPyramid
+{
+	GpuImage image;
+	ImageHandle imageHandle;
+	VkImageView levelViews[MaxDepthPyramidLevels];
+	uint32_t numLevels;
+	VkSampler sampler;
+
+	ComputePipeline reducePipeline;
+	// level i reads level i - 1, or the depth buffer for level 0
+	VkDescriptorSet reduceSets[MaxDepthPyramidLevels];
+
+	uint64_t numBuilds;
+};
+
+static uint32_t previousPowerOfTwo(uint32_t value)
+{
+	uint32_t result = 1;
+	while (result * 2 <= value)
+	{
+		result *= 2;
+	}
+	return result;
+}
+
+static uint32_t getLevelSize(uint32_t size, uint32_t level)
+{
+	size >>= level;
+	return size ? size : 1;
+}
+
+static void writeReduceDescriptors(EngineContext& context, DepthPyramid& pyramid, uint32_t level)
+{
+	VkDescriptorImageInfo sourceInfo = {};
+	sourceInfo.sampler = pyramid.sampler;
+	if (level == 0)
+	{
+		sourceInfo.imageView = getRegisteredImage(context, context.depthImageHandle).view;
+		sourceInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+	else
+	{
+		sourceInfo.imageView = pyramid.levelViews[level - 1];
+		sourceInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	}
+
+	VkDescriptorImageInfo destinationInfo = {};
+	destinationInfo.imageView = pyramid.levelViews[level];
+	destinationInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkWriteDescriptorSet writes[2] = {};
+	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet = pyramid.reduceSets[level];
+	writes[0].dstBinding = 0;
+	writes[0].descriptorCount = 1;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writes[0].pImageInfo = &sourceInfo;
+
+	writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[1].dstSet = pyramid.reduceSets[level];
+	writes[1].dstBinding = 1;
+	writes[1].descriptorCount = 1;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	writes[1].pImageInfo = &destinationInfo;
+
+	vkUpdateDescriptorSets(context.device, 2, writes, 0, nullptr);
+}
+
+void createDepthPyramid(EngineContext& context)
+{
+	// enabled with the device whenever it's supported
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(context.physicalDevice, &features);
+	if (!features.shaderStorageImageExtendedFormats)
+	{
+		Log::fatal("The depth pyramid needs shaderStorageImageExtendedFormats for rg32f storage images\n");
+	}
+
+	DepthPyramid* pyramid = new DepthPyramid;
+	*pyramid = {};
+
+	uint32_t width = previousPowerOfTwo(context.swapchainExtent.width);
+	uint32_t height = previousPowerOfTwo(context.swapchainExtent.height);
+	pyramid->numLevels = 1;
+	while (pyramid->numLevels < MaxDepthPyramidLevels && (getLevelSize(width, pyramid->numLevels - 1) > 1 || getLevelSize(height, pyramid->numLevels - 1) > 1))
+	{
+		++pyramid->numLevels;
+	}
+
+	createGpuImage(context, width, height, pyramid->numLevels, VK_FORMAT_R32G32_SFLOAT,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT, pyramid->image);
+	initializeGpuImageLayout(context, pyramid->image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL);
+	pyramid->imageHandle = registerImage(context, "depthPyramid", pyramid->image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL);
+	// buildDepthPyramid leaves the depth buffer readable
+	setRegisteredImageLayout(context, context.depthImageHandle, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	for (uint32_t i = 0; i < pyramid->numLevels; ++i)
+	{
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = pyramid->image.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32G32_SFLOAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = i;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		VkResult result = vkCreateImageView(context.device, &viewInfo, nullptr, &pyramid->levelViews[i]);
+		if (result != VK_SUCCESS)
+		{
+			Log::fatal("Couldn't create view of depth pyramid level %u\n", i);
+		}
+	}
+
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = static_cast<float>(pyramid->numLevels);
+
+	VkResult result = vkCreateSampler(context.device, &samplerInfo, nullptr, &pyramid->sampler);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create depth pyramid sampler");
+	}
+
+	VkDescriptorSetLayoutBinding bindings[2] = {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	createComputePipeline(context, "depthpyramid.comp.spv", bindings, 2, sizeof(DepthPyramidPushConstants), pyramid->reducePipeline);
+
+	for (uint32_t i = 0; i < pyramid->numLevels; ++i)
+	{
+		pyramid->reduceSets[i] = allocateDescriptorSet(context, pyramid->reducePipeline.descriptorSetLayout);
+		writeReduceDescriptors(context, *pyramid, i);
+	}
+
+	Log::log("Depth pyramid %ux%u with %u levels\n", width, height, pyramid->numLevels);
+
+	context.depthPyramid = pyramid;
+}
+
+void destroyDepthPyramid(EngineContext& context)
+{
+	DepthPyramid* pyramid = context.depthPyramid;
+	if (!pyramid)
+	{
+		return;
+	}
+
+	destroyComputePipeline(context, pyramid->reducePipeline);
+	vkDestroySampler(context.device, pyramid->sampler, nullptr);
+	for (uint32_t i = 0; i < pyramid->numLevels; ++i)
+	{
+		vkDestroyImageView(context.device, pyramid->levelViews[i], nullptr);
+	}
+	setRegisteredImageLayout(context, context.depthImageHandle, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+	unregisterImage(context, pyramid->imageHandle);
+	destroyGpuImage(context, pyramid->image);
+
+	delete pyramid;
+	context.depthPyramid = nullptr;
+}
+
+void buildDepthPyramid(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	DepthPyramid& pyramid = *context.depthPyramid;
+
+	transitionDepthBuffer(context, commandBuffer, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+	// culling recorded earlier may still be reading the previous pyramid
+	recordImageBarrier(commandBuffer, pyramid.image.image, VK_IMAGE_ASPECT_COLOR_BIT, 0, pyramid.numLevels, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+	// only the rendered part of the depth buffer, so uvs stay relative to what was drawn
+	DepthPyramidPushConstants pushConstants = {};
+	pushConstants.sourceSize[0] = context.renderExtent.width;
+	pushConstants.sourceSize[1] = context.renderExtent.height;
+	pushConstants.fromDepth = 1;
+
+	for (uint32_t i = 0; i < pyramid.numLevels; ++i)
+	{
+		pushConstants.destinationSize[0] = getLevelSize(pyramid.image.extent.width, i);
+		pushConstants.destinationSize[1] = getLevelSize(pyramid.image.extent.height, i);
+
+		uint32_t groupsX = (pushConstants.destinationSize[0] + ReduceGroupSize - 1) / ReduceGroupSize;
+		uint32_t groupsY = (pushConstants.destinationSize[1] + ReduceGroupSize - 1) / ReduceGroupSize;
+		dispatchCompute(commandBuffer, pyramid.reducePipeline, pyramid.reduceSets[i], &pushConstants, groupsX, groupsY, 1);
+
+		// the next level and later culling read this one
+		recordImageBarrier(commandBuffer, pyramid.image.image, VK_IMAGE_ASPECT_COLOR_BIT, i, 1, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+		pushConstants.sourceSize[0] = pushConstants.destinationSize[0];
+		pushConstants.sourceSize[1] = pushConstants.destinationSize[1];
+		pushConstants.fromDepth = 0;
+	}
+
+	++pyramid.numBuilds;
+}
+
+VkDescriptorImageInfo getDepthPyramidDescriptor(EngineContext& context)
+{
+	VkDescriptorImageInfo info = {};
+	info.sampler = context.depthPyramid->sampler;
+	info.imageView = context.depthPyramid->image.view;
+	info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	return info;
+}
+
+void getDepthPyramidSize(EngineContext& context, uint32_t& width, uint32_t& height, uint32_t& numLevels)
+{
+	width = context.depthPyramid->image.extent.width;
+	height = context.depthPyramid->image.extent.height;
+	numLevels = context.depthPyramid->numLevels;
+}
+
+bool isDepthPyramidBuilt(EngineContext& context)
+{
+	return context.depthPyramid->numBuilds > 0;
+}
@@ -0,0 +1,624 @@
+#include "DeviceSelection.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <EASTL/algorithm.h>
+
+#include "EngineContext.h"
+#include "JobSystem.h"
+#include "Log.h"
+
+// bytes written and read back by the job every headless device is checked with
+static const VkDeviceSize SmokeTestSize = 1 << 20;
+static const uint32_t SmokeTestPattern = 0x5eed1e55;
+
+struct HeadlessDevices
+{
+	eastl::vector<HeadlessDevice> devices;
+};
+
+static bool hasExtension(const eastl::vector<VkExtensionProperties>& extensions, const char* name)
+{
+	for (const VkExtensionProperties& extension : extensions)
+	{
+		if (strcmp(extension.extensionName, name) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void queryQueueCapabilities(DeviceInfo& info)
+{
+	uint32_t numFamilies = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(info.device, &numFamilies, nullptr);
+	eastl::vector<VkQueueFamilyProperties> families(numFamilies);
+	vkGetPhysicalDeviceQueueFamilyProperties(info.device, &numFamilies, families.data());
+
+	for (const VkQueueFamilyProperties& family : families)
+	{
+		bool graphics = (family.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+		bool compute = (family.queueFlags & VK_QUEUE_COMPUTE_BIT) != 0;
+		bool transfer = (family.queueFlags & VK_QUEUE_TRANSFER_BIT) != 0;
+
+		info.dedicatedCompute |= compute && !graphics;
+		info.dedicatedTransfer |= transfer && !compute && !graphics;
+		info.graphicsTimestamps |= graphics && family.timestampValidBits > 0;
+	}
+}
+
+static uint32_t countOptionalFeatures(const DeviceInfo& info)
+{
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(info.device, &features);
+
+	uint32_t numExtensions = 0;
+	vkEnumerateDeviceExtensionProperties(info.device, nullptr, &numExtensions, nullptr);
+	eastl::vector<VkExtensionProperties> extensions(numExtensions);
+	vkEnumerateDeviceExtensionProperties(info.device, nullptr, &numExtensions, extensions.data());
+
+	bool dynamicRendering = info.properties.apiVersion >= VK_API_VERSION_1_3 || hasExtension(extensions, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+
+	uint32_t count = 0;
+	count += features.shaderStorageImageExtendedFormats ? 1 : 0;
+	count += features.multiDrawIndirect ? 1 : 0;
+	count += features.drawIndirectFirstInstance ? 1 : 0;
+	count += features.samplerAnisotropy ? 1 : 0;
+	count += dynamicRendering ? 1 : 0;
+	count += hasExtension(extensions, VK_EXT_MESH_SHADER_EXTENSION_NAME) ? 1 : 0;
+
+	return count;
+}
+
+eastl::vector<DeviceInfo> queryDeviceInfos(VkInstance instance, uint32_t instanceApiVersion)
+{
+	uint32_t numDevices = 0;
+	vkEnumeratePhysicalDevices(instance, &numDevices, nullptr);
+	eastl::vector<VkPhysicalDevice> devices(numDevices);
+	vkEnumeratePhysicalDevices(instance, &numDevices, devices.data());
+
+	eastl::vector<DeviceInfo> infos(numDevices);
+	for (uint32_t i = 0; i < numDevices; ++i)
+	{
+		DeviceInfo& info = infos[i];
+		info = {};
+		info.device = devices[i];
+		info.index = i;
+		vkGetPhysicalDeviceProperties(info.device, &info.properties);
+
+		if (instanceApiVersion >= VK_API_VERSION_1_1 && info.properties.apiVersion >= VK_API_VERSION_1_1)
+		{
+			VkPhysicalDeviceIDProperties idProperties = {};
+			idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+			VkPhysicalDeviceProperties2 properties = {};
+			properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+			properties.pNext = &idProperties;
+			vkGetPhysicalDeviceProperties2(info.device, &properties);
+
+			info.hasUuid = true;
+			memcpy(info.uuid, idProperties.deviceUUID, VK_UUID_SIZE);
+		}
+
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(info.device, &memoryProperties);
+		for (uint32_t heap = 0; heap < memoryProperties.memoryHeapCount; ++heap)
+		{
+			const VkMemoryHeap& memoryHeap = memoryProperties.memoryHeaps[heap];
+			if ((memoryHeap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && memoryHeap.size > info.deviceLocalBytes)
+			{
+				info.deviceLocalBytes = memoryHeap.size;
+			}
+		}
+
+		queryQueueCapabilities(info);
+		info.numOptionalFeatures = countOptionalFeatures(info);
+	}
+
+	return infos;
+}
+
+static uint64_t getDeviceTypeRank(VkPhysicalDeviceType type)
+{
+	switch (type)
+	{
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		return 4;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		return 3;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		return 2;
+	case VK_PHYSICAL_DEVICE_TYPE_OTHER:
+		return 1;
+	default:
+		// CPU implementations like lavapipe or SwiftShader, only when nothing else is there
+		return 0;
+	}
+}
+
+static const char* getDeviceTypeName(VkPhysicalDeviceType type)
+{
+	switch (type)
+	{
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+		return "discrete";
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+		return "integrated";
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+		return "virtual";
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:
+		return "cpu";
+	default:
+		return "other";
+	}
+}
+
+uint64_t scoreDevice(const DeviceInfo& info)
+{
+	uint64_t numFeatures = info.numOptionalFeatures;
+	numFeatures += info.dedicatedCompute ? 1 : 0;
+	numFeatures += info.dedicatedTransfer ? 1 : 0;
+	numFeatures += info.graphicsTimestamps ? 1 : 0;
+
+	// integrated GPUs report shared system memory as device local, so VRAM only breaks ties within a type.
+	// In MiB it fits the low 48 bits with room to spare.
+	uint64_t vramMegabytes = info.deviceLocalBytes >> 20;
+	vramMegabytes = vramMegabytes < (1ull << 48) ? vramMegabytes : (1ull << 48) - 1;
+
+	return (getDeviceTypeRank(info.properties.deviceType) << 56) | (eastl::min<uint64_t>(numFeatures, 255) << 48) | vramMegabytes;
+}
+
+eastl::vector<uint32_t> rankDevices(const eastl::vector<DeviceInfo>& infos)
+{
+	eastl::vector<uint32_t> order(infos.size());
+	for (uint32_t i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+
+	eastl::stable_sort(order.begin(), order.end(), [&infos](uint32_t a, uint32_t b)
+	{
+		return scoreDevice(infos[a]) > scoreDevice(infos[b]);
+	});
+
+	return order;
+}
+
+static int parseHexDigit(char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		return c - '0';
+	}
+	if (c >= 'a' && c <= 'f')
+	{
+		return c - 'a' + 10;
+	}
+	if (c >= 'A' && c <= 'F')
+	{
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+bool readDeviceOverride(DeviceOverride& deviceOverride)
+{
+	const char* setting = getenv("ENGINE_DEVICE");
+	if (!setting || !*setting)
+	{
+		return false;
+	}
+
+	deviceOverride = {};
+
+	// indices are short, UUIDs are 32 digits
+	char* end = nullptr;
+	unsigned long index = strtoul(setting, &end, 10);
+	if (*end == '\0' && strlen(setting) < 8)
+	{
+		deviceOverride.index = static_cast<uint32_t>(index);
+		return true;
+	}
+
+	deviceOverride.byUuid = true;
+	uint32_t numDigits = 0;
+	for (const char* c = setting; *c; ++c)
+	{
+		if (*c == '-')
+		{
+			continue;
+		}
+
+		int digit = parseHexDigit(*c);
+		if (digit < 0 || numDigits >= 2 * VK_UUID_SIZE)
+		{
+			Log::fatal("ENGINE_DEVICE=%s is neither a device index nor a UUID\n", setting);
+		}
+
+		deviceOverride.uuid[numDigits / 2] |= static_cast<uint8_t>(digit << (numDigits % 2 == 0 ? 4 : 0));
+		++numDigits;
+	}
+
+	if (numDigits != 2 * VK_UUID_SIZE)
+	{
+		Log::fatal("ENGINE_DEVICE=%s is neither a device index nor a UUID\n", setting);
+	}
+
+	return true;
+}
+
+bool matchesDeviceOverride(const DeviceOverride& deviceOverride, const DeviceInfo& info)
+{
+	if (!deviceOverride.byUuid)
+	{
+		return info.index == deviceOverride.index;
+	}
+
+	return info.hasUuid && memcmp(info.uuid, deviceOverride.uuid, VK_UUID_SIZE) == 0;
+}
+
+void formatDeviceUuid(const uint8_t* uuid, char* text, size_t textSize)
+{
+	// the usual 8-4-4-4-12 grouping
+	size_t length = 0;
+	for (uint32_t i = 0; i < VK_UUID_SIZE && length + 3 < textSize; ++i)
+	{
+		bool dash = i == 4 || i == 6 || i == 8 || i == 10;
+		length += snprintf(text + length, textSize - length, dash ? "-%02x" : "%02x", uuid[i]);
+	}
+}
+
+void logDeviceInfos(const eastl::vector<DeviceInfo>& infos)
+{
+	for (const DeviceInfo& info : infos)
+	{
+		char uuid[2 * VK_UUID_SIZE + 8] = "unknown";
+		if (info.hasUuid)
+		{
+			formatDeviceUuid(info.uuid, uuid, sizeof(uuid));
+		}
+
+		Log::log("Device %u: %s (%s, %llu MiB, %u optional features), uuid %s, score %016llx\n", info.index, info.properties.deviceName,
+			getDeviceTypeName(info.properties.deviceType), static_cast<unsigned long long>(info.deviceLocalBytes >> 20), info.numOptionalFeatures,
+			uuid, static_cast<unsigned long long>(scoreDevice(info)));
+	}
+}
+
+static bool findGraphicsQueueFamily(VkPhysicalDevice device, uint32_t& family)
+{
+	uint32_t numFamilies = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &numFamilies, nullptr);
+	eastl::vector<VkQueueFamilyProperties> families(numFamilies);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &numFamilies, families.data());
+
+	for (uint32_t i = 0; i < numFamilies; ++i)
+	{
+		if (families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		{
+			family = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool openHeadlessDevice(const DeviceInfo& info, HeadlessDevice& headless)
+{
+	headless = {};
+	headless.physicalDevice = info.device;
+	strncpy(headless.name, info.properties.deviceName, sizeof(headless.name) - 1);
+	vkGetPhysicalDeviceMemoryProperties(info.device, &headless.memoryProperties);
+
+	if (!findGraphicsQueueFamily(info.device, headless.queueFamily))
+	{
+		return false;
+	}
+
+	float queuePriority = 1.0f;
+	VkDeviceQueueCreateInfo queueCreateInfo = {};
+	queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queueCreateInfo.queueFamilyIndex = headless.queueFamily;
+	queueCreateInfo.queueCount = 1;
+	queueCreateInfo.pQueuePriorities = &queuePriority;
+
+	// no swapchain, so no extensions
+	VkDeviceCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.queueCreateInfoCount = 1;
+	createInfo.pQueueCreateInfos = &queueCreateInfo;
+
+	if (vkCreateDevice(info.device, &createInfo, nullptr, &headless.device) != VK_SUCCESS)
+	{
+		return false;
+	}
+
+	vkGetDeviceQueue(headless.device, headless.queueFamily, 0, &headless.queue);
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = headless.queueFamily;
+
+	if (vkCreateCommandPool(headless.device, &poolInfo, nullptr, &headless.commandPool) != VK_SUCCESS)
+	{
+		vkDestroyDevice(headless.device, nullptr);
+		return false;
+	}
+
+	return true;
+}
+
+static void closeHeadlessDevice(HeadlessDevice& headless)
+{
+	vkDestroyCommandPool(headless.device, headless.commandPool, nullptr);
+	vkDestroyDevice(headless.device, nullptr);
+}
+
+struct SmokeTestBuffer
+{
+	VkBuffer buffer;
+	VkDeviceMemory memory;
+};
+
+static bool createSmokeTestBuffer(HeadlessDevice& headless, SmokeTestBuffer& smokeTest)
+{
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = SmokeTestSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(headless.device, &bufferInfo, nullptr, &smokeTest.buffer) != VK_SUCCESS)
+	{
+		return false;
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(headless.device, smokeTest.buffer, &requirements);
+
+	VkMemoryPropertyFlags wanted = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	for (uint32_t i = 0; i < headless.memoryProperties.memoryTypeCount; ++i)
+	{
+		if ((requirements.memoryTypeBits & (1u << i)) && (headless.memoryProperties.memoryTypes[i].propertyFlags & wanted) == wanted)
+		{
+			VkMemoryAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = requirements.size;
+			allocInfo.memoryTypeIndex = i;
+
+			if (vkAllocateMemory(headless.device, &allocInfo, nullptr, &smokeTest.memory) != VK_SUCCESS)
+			{
+				break;
+			}
+
+			vkBindBufferMemory(headless.device, smokeTest.buffer, smokeTest.memory, 0);
+			return true;
+		}
+	}
+
+	vkDestroyBuffer(headless.device, smokeTest.buffer, nullptr);
+	return false;
+}
+
+static void recordSmokeTest(HeadlessDevice& headless, VkCommandBuffer commandBuffer, void* data)
+{
+	SmokeTestBuffer& smokeTest = *static_cast<SmokeTestBuffer*>(data);
+
+	vkCmdFillBuffer(commandBuffer, smokeTest.buffer, 0, SmokeTestSize, SmokeTestPattern);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+static bool checkSmokeTest(HeadlessDevice& headless, SmokeTestBuffer& smokeTest)
+{
+	void* mapped = nullptr;
+	if (vkMapMemory(headless.device, smokeTest.memory, 0, SmokeTestSize, 0, &mapped) != VK_SUCCESS)
+	{
+		return false;
+	}
+
+	const uint32_t* words = static_cast<const uint32_t*>(mapped);
+	bool matches = true;
+	for (VkDeviceSize i = 0; i < SmokeTestSize / sizeof(uint32_t) && matches; ++i)
+	{
+		matches = words[i] == SmokeTestPattern;
+	}
+
+	vkUnmapMemory(headless.device, smokeTest.memory);
+	return matches;
+}
+
+static void runSmokeTests(EngineContext& context, HeadlessDevices& headless)
+{
+	uint32_t numDevices = static_cast<uint32_t>(headless.devices.size());
+	eastl::vector<SmokeTestBuffer> buffers(numDevices);
+	eastl::vector<void*> data(numDevices);
+	for (uint32_t i = 0; i < numDevices; ++i)
+	{
+		buffers[i] = {};
+		if (!createSmokeTestBuffer(headless.devices[i], buffers[i]))
+		{
+			Log::fatal("Couldn't create a host visible buffer on headless device %s\n", headless.devices[i].name);
+		}
+		data[i] = &buffers[i];
+	}
+
+	runHeadlessJobs(context, recordSmokeTest, data.data());
+
+	for (uint32_t i = 0; i < numDevices; ++i)
+	{
+		HeadlessDevice& device = headless.devices[i];
+		if (!checkSmokeTest(device, buffers[i]))
+		{
+			Log::fatal("Headless device %s returned wrong data\n", device.name);
+		}
+
+		vkDestroyBuffer(device.device, buffers[i].buffer, nullptr);
+		vkFreeMemory(device.device, buffers[i].memory, nullptr);
+		Log::log("Headless device %s is ready\n", device.name);
+	}
+}
+
+void createHeadlessDevices(EngineContext& context)
+{
+	HeadlessDevices* headless = new HeadlessDevices;
+	context.headlessDevices = headless;
+
+	const char* setting = getenv("ENGINE_HEADLESS_DEVICES");
+	if (!setting)
+	{
+		return;
+	}
+
+	uint32_t maxDevices = strcmp(setting, "all") == 0 ? UINT32_MAX : static_cast<uint32_t>(atoi(setting));
+	if (maxDevices == 0)
+	{
+		return;
+	}
+
+	// the best devices first, like the presenting one was picked
+	eastl::vector<DeviceInfo> infos = queryDeviceInfos(context.instance, context.apiVersion);
+	for (uint32_t index : rankDevices(infos))
+	{
+		if (headless->devices.size() >= maxDevices)
+		{
+			break;
+		}
+
+		const DeviceInfo& info = infos[index];
+		if (info.device == context.physicalDevice)
+		{
+			continue;
+		}
+
+		HeadlessDevice device;
+		if (openHeadlessDevice(info, device))
+		{
+			headless->devices.push_back(device);
+		}
+		else
+		{
+			Log::warning("Couldn't open %s as a headless device\n", info.properties.deviceName);
+		}
+	}
+
+	if (headless->devices.size() < maxDevices && maxDevices != UINT32_MAX)
+	{
+		Log::warning("Asked for %u headless devices, %u are available\n", maxDevices, static_cast<uint32_t>(headless->devices.size()));
+	}
+
+	if (!headless->devices.empty())
+	{
+		runSmokeTests(context, *headless);
+	}
+}
+
+void destroyHeadlessDevices(EngineContext& context)
+{
+	HeadlessDevices* headless = context.headlessDevices;
+	if (!headless)
+	{
+		return;
+	}
+
+	for (HeadlessDevice& device : headless->devices)
+	{
+		vkDeviceWaitIdle(device.device);
+		closeHeadlessDevice(device);
+	}
+
+	delete headless;
+	context.headlessDevices = nullptr;
+}
+
+uint32_t getNumHeadlessDevices(EngineContext& context)
+{
+	return static_cast<uint32_t>(context.headlessDevices->devices.size());
+}
+
+struct HeadlessJob
+{
+	HeadlessDevice* device;
+	HeadlessRecordFunc record;
+	void* data;
+};
+
+static void runHeadlessJob(void* data)
+{
+	HeadlessJob& job = *static_cast<HeadlessJob*>(data);
+	HeadlessDevice& device = *job.device;
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = device.commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(device.device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't allocate a command buffer on headless device %s\n", device.name);
+	}
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	job.record(device, commandBuffer, job.data);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't record a command buffer on headless device %s\n", device.name);
+	}
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	VkFence fence;
+	if (vkCreateFence(device.device, &fenceInfo, nullptr, &fence) != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create a fence on headless device %s\n", device.name);
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	if (vkQueueSubmit(device.queue, 1, &submitInfo, fence) != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't submit to headless device %s\n", device.name);
+	}
+
+	vkWaitForFences(device.device, 1, &fence, VK_TRUE, UINT64_MAX);
+	vkDestroyFence(device.device, fence, nullptr);
+	vkFreeCommandBuffers(device.device, device.commandPool, 1, &commandBuffer);
+}
+
+void runHeadlessJobs(EngineContext& context, HeadlessRecordFunc record, void** data)
+{
+	HeadlessDevices& headless = *context.headlessDevices;
+
+	// each device is only touched by its own job, so nothing needs a lock
+	eastl::vector<HeadlessJob> jobs(headless.devices.size());
+	JobCounter counter = {};
+	for (uint32_t i = 0; i < jobs.size(); ++i)
+	{
+		jobs[i].device = &headless.devices[i];
+		jobs[i].record = record;
+		jobs[i].data = data[i];
+		submitJob(context.jobSystem, runHeadlessJob, &jobs[i], &counter);
+	}
+
+	waitForCounter(context.jobSystem, &counter);
+}
@@ -0,0 +1,263 @@
+#include "DynamicRendering.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "DepthBuffer.h"
+#include "EngineContext.h"
+#include "Log.h"
+
+uint32_t queryInstanceApiVersion()
+{
+	// vkEnumerateInstanceVersion doesn't exist in 1.0 loaders
+	PFN_vkEnumerateInstanceVersion enumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+	if (!enumerateInstanceVersion)
+	{
+		return VK_API_VERSION_1_0;
+	}
+
+	uint32_t version = VK_API_VERSION_1_0;
+	enumerateInstanceVersion(&version);
+
+	return version < VK_API_VERSION_1_3 ? version : VK_API_VERSION_1_3;
+}
+
+DynamicRenderingSupport queryDynamicRenderingSupport(EngineContext& context)
+{
+	const char* setting = getenv("ENGINE_DYNAMIC_RENDERING");
+	if (setting && strcmp(setting, "0") == 0)
+	{
+		return DynamicRenderingSupport_None;
+	}
+
+	// feature queries need vkGetPhysicalDeviceFeatures2, and the extension's dependencies are core in 1.2
+	if (context.apiVersion < VK_API_VERSION_1_2)
+	{
+		return DynamicRenderingSupport_None;
+	}
+
+	uint32_t deviceApiVersion = context.physicalDeviceProperties.apiVersion;
+	if (deviceApiVersion < VK_API_VERSION_1_2)
+	{
+		return DynamicRenderingSupport_None;
+	}
+
+	bool core = deviceApiVersion >= VK_API_VERSION_1_3 && context.apiVersion >= VK_API_VERSION_1_3;
+	if (!core && !hasDeviceExtension(context, makeStringId(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME)))
+	{
+		return DynamicRenderingSupport_None;
+	}
+
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+	dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &dynamicRenderingFeatures;
+	vkGetPhysicalDeviceFeatures2(context.physicalDevice, &features);
+
+	if (!dynamicRenderingFeatures.dynamicRendering)
+	{
+		return DynamicRenderingSupport_None;
+	}
+
+	return core ? DynamicRenderingSupport_Core : DynamicRenderingSupport_Extension;
+}
+
+void loadDynamicRenderingFunctions(EngineContext& context)
+{
+	if (context.dynamicRendering == DynamicRenderingSupport_None)
+	{
+		return;
+	}
+
+	bool core = context.dynamicRendering == DynamicRenderingSupport_Core;
+	context.cmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(context.device, core ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR"));
+	context.cmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(context.device, core ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR"));
+
+	if (!context.cmdBeginRendering || !context.cmdEndRendering)
+	{
+		Log::fatal("Dynamic rendering is enabled but its functions couldn't be loaded");
+	}
+
+	Log::log("Using dynamic rendering (%s)\n", core ? "core" : VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+}
+
+static void transitionSwapchainImage(EngineContext& context, VkCommandBuffer commandBuffer, uint32_t imageIndex, VkImageLayout oldLayout, VkImageLayout newLayout,
+	VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	recordImageBarrier(commandBuffer, context.swapchainImages[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, oldLayout, newLayout, srcStage, srcAccess, dstStage, dstAccess);
+}
+
+static void transitionSceneColor(EngineContext& context, VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout,
+	VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	recordImageBarrier(commandBuffer, context.sceneColor.image, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, oldLayout, newLayout, srcStage, srcAccess, dstStage, dstAccess);
+}
+
+static void beginSceneRenderingWithLoadOp(EngineContext& context, VkCommandBuffer commandBuffer, VkAttachmentLoadOp loadOp, const VkClearValue* clearValues)
+{
+	VkRect2D renderArea = {};
+	renderArea.extent = context.renderExtent;
+
+	if (context.dynamicRendering == DynamicRenderingSupport_None)
+	{
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR ? context.renderPass : context.resumeRenderPass;
+		renderPassInfo.framebuffer = context.sceneFramebuffer;
+		renderPassInfo.renderArea = renderArea;
+		renderPassInfo.clearValueCount = loadOp == VK_ATTACHMENT_LOAD_OP_CLEAR ? 2 : 0;
+		renderPassInfo.pClearValues = clearValues;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
+
+	VkRenderingAttachmentInfoKHR colorAttachment = {};
+	colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+	colorAttachment.imageView = context.sceneColor.view;
+	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.loadOp = loadOp;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+	VkRenderingAttachmentInfoKHR depthAttachment = {};
+	depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+	depthAttachment.imageView = context.depthImage.view;
+	depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.loadOp = loadOp;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+	if (clearValues)
+	{
+		colorAttachment.clearValue = clearValues[0];
+		depthAttachment.clearValue = clearValues[1];
+	}
+
+	VkRenderingInfoKHR renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+	renderingInfo.renderArea = renderArea;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachments = &colorAttachment;
+	renderingInfo.pDepthAttachment = &depthAttachment;
+
+	context.cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+static void endRendering(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	if (context.dynamicRendering == DynamicRenderingSupport_None)
+	{
+		vkCmdEndRenderPass(commandBuffer);
+	}
+	else
+	{
+		context.cmdEndRendering(commandBuffer);
+	}
+}
+
+void beginSceneRendering(EngineContext& context, VkCommandBuffer commandBuffer, const VkClearValue& clearColor)
+{
+	VkClearValue clearValues[2] = { clearColor, {} };
+	clearValues[1].depthStencil.depth = 1.0f;
+
+	// the render pass does the same transitions through its initial layouts and external dependency
+	if (context.dynamicRendering != DynamicRenderingSupport_None)
+	{
+		// the previous contents are cleared anyway, only the previous frame's upscale has to be done reading them
+		transitionSceneColor(context, commandBuffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+		// the previous frame may still be testing against or building a pyramid from the depth buffer
+		transitionDepthBuffer(context, commandBuffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+	}
+
+	beginSceneRenderingWithLoadOp(context, commandBuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, clearValues);
+}
+
+void endSceneRendering(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	endRendering(context, commandBuffer);
+
+	// both render passes leave the target as an attachment since either may be the last one. Post
+	// processing reads it in a compute dispatch before the upscale pass.
+	transitionSceneColor(context, commandBuffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+void suspendSceneRendering(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	endRendering(context, commandBuffer);
+}
+
+void resumeSceneRendering(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	if (context.dynamicRendering != DynamicRenderingSupport_None)
+	{
+		transitionSceneColor(context, commandBuffer, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+		transitionDepthBuffer(context, commandBuffer, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+	}
+
+	beginSceneRenderingWithLoadOp(context, commandBuffer, VK_ATTACHMENT_LOAD_OP_LOAD, nullptr);
+}
+
+void beginSwapchainRendering(EngineContext& context, VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	VkRect2D renderArea = {};
+	renderArea.extent = context.swapchainExtent;
+
+	if (context.dynamicRendering == DynamicRenderingSupport_None)
+	{
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = context.swapchainRenderPass;
+		renderPassInfo.framebuffer = context.swapchainFramebuffers[imageIndex];
+		renderPassInfo.renderArea = renderArea;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
+
+	// the previous contents are overwritten anyway. The stage matches the acquire semaphore's wait stage.
+	transitionSwapchainImage(context, commandBuffer, imageIndex, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+
+	VkRenderingAttachmentInfoKHR colorAttachment = {};
+	colorAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+	colorAttachment.imageView = context.swapchainImageViews[imageIndex];
+	colorAttachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+	VkRenderingInfoKHR renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+	renderingInfo.renderArea = renderArea;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = 1;
+	renderingInfo.pColorAttachments = &colorAttachment;
+
+	context.cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void endSwapchainRendering(EngineContext& context, VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	if (context.dynamicRendering == DynamicRenderingSupport_None)
+	{
+		vkCmdEndRenderPass(commandBuffer);
+		return;
+	}
+
+	context.cmdEndRendering(commandBuffer);
+
+	transitionSwapchainImage(context, commandBuffer, imageIndex, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, context.presentLayout,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+}
@@ -0,0 +1,341 @@
+#include "DynamicResolution.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <EASTL/vector.h>
+
+#include "Clock.h"
+#include "ComputePass.h"
+#include "EngineContext.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "PipelineCache.h"
+#include "PostProcess.h"
+#include "ResolutionController.h"
+#include "ResourceRegistry.h"
+
+// render extents are rounded to this many pixels so the scale doesn't jitter by single pixels
+static const uint32_t ExtentGranularity = 8;
+static const uint32_t NumQueriesPerFrame = 2;
+
+static const double StatsInterval = 5.0;
+
+struct UpscalePushConstants
+{
+	// maps the swapchain's uv to the rendered part of the scene target
+	float uvScale[2];
+	// last texel centers that are inside the rendered part, so filtering doesn't pick up stale pixels
+	float uvMax[2];
+};
+
+struct DynamicResolution
+{
+	// frames are timed whenever the graphics queue has timestamps, even at a fixed resolution
+	bool timing;
+	// false when ENGINE_DYNAMIC_RESOLUTION=0 or frames aren't timed
+	bool enabled;
+	ResolutionController controller;
+
+	VkQueryPool queryPool;
+	// nanoseconds per timestamp tick
+	float timestampPeriod;
+	uint64_t timestampMask;
+	bool queriesWritten[MAX_FRAMES_IN_FLIGHT];
+	float lastGpuMilliseconds;
+	// of the frame the current slot held before, negative when there's none
+	float slotGpuMilliseconds;
+
+	VkSampler sampler;
+	VkDescriptorSetLayout setLayout;
+	VkPipelineLayout pipelineLayout;
+	PipelineDesc upscalePipelineDesc;
+	VkDescriptorSet descriptorSet;
+
+	bool logStats;
+	double lastStatsTime;
+};
+
+static float readEnvFloat(const char* name, float defaultValue)
+{
+	const char* value = getenv(name);
+	return value ? static_cast<float>(atof(value)) : defaultValue;
+}
+
+static uint32_t roundExtent(float size, uint32_t fullSize)
+{
+	uint32_t rounded = static_cast<uint32_t>(size / ExtentGranularity + 0.5f) * ExtentGranularity;
+	rounded = rounded < ExtentGranularity ? ExtentGranularity : rounded;
+	return rounded < fullSize ? rounded : fullSize;
+}
+
+void createSceneColorTarget(EngineContext& context)
+{
+	// without post processing the upscale pass copies it to the swapchain, so the same format avoids any conversion
+	context.postProcessing = queryPostProcessSupport(context);
+	context.sceneColorFormat = context.postProcessing ? chooseHdrSceneColorFormat(context) : context.swapchainFormat;
+	context.renderExtent = context.swapchainExtent;
+
+	createGpuImage(context, context.swapchainExtent.width, context.swapchainExtent.height, 1, context.sceneColorFormat,
+		VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT, context.sceneColor);
+	context.sceneColorHandle = registerImage(context, "sceneColor", context.sceneColor, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+void destroySceneColorTarget(EngineContext& context)
+{
+	unregisterImage(context, context.sceneColorHandle);
+	destroyGpuImage(context, context.sceneColor);
+}
+
+static void createUpscalePipeline(EngineContext& context, DynamicResolution& resolution)
+{
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+	VkResult result = vkCreateSampler(context.device, &samplerInfo, nullptr, &resolution.sampler);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create upscale sampler");
+	}
+
+	VkDescriptorSetLayoutBinding binding = {};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = 1;
+	setLayoutInfo.pBindings = &binding;
+
+	result = vkCreateDescriptorSetLayout(context.device, &setLayoutInfo, nullptr, &resolution.setLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create upscale descriptor set layout");
+	}
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstantRange.size = sizeof(UpscalePushConstants);
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &resolution.setLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	result = vkCreatePipelineLayout(context.device, &layoutInfo, nullptr, &resolution.pipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create upscale pipeline layout");
+	}
+
+	resolution.upscalePipelineDesc = makeDefaultPipelineDesc();
+	resolution.upscalePipelineDesc.vertexShader = "upscale.vert";
+	resolution.upscalePipelineDesc.fragmentShader = "upscale.frag";
+	resolution.upscalePipelineDesc.layout = resolution.pipelineLayout;
+	resolution.upscalePipelineDesc.cullMode = VK_CULL_MODE_NONE;
+	resolution.upscalePipelineDesc.renderPass = context.swapchainRenderPass;
+	resolution.upscalePipelineDesc.colorFormat = context.swapchainFormat;
+
+	getPipeline(context, resolution.upscalePipelineDesc);
+
+	resolution.descriptorSet = allocateDescriptorSet(context, resolution.setLayout);
+
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.sampler = resolution.sampler;
+	imageInfo.imageView = context.sceneColor.view;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = resolution.descriptorSet;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(context.device, 1, &write, 0, nullptr);
+}
+
+void createDynamicResolution(EngineContext& context)
+{
+	DynamicResolution* resolution = new DynamicResolution;
+	*resolution = {};
+
+	const char* setting = getenv("ENGINE_DYNAMIC_RESOLUTION");
+	bool requested = !setting || strcmp(setting, "0") != 0;
+	uint64_t timestampMask = getTimestampMask(context, context.graphicsQueueFamily);
+	resolution->timing = timestampMask != 0;
+	resolution->enabled = requested && resolution->timing;
+	if (requested && !resolution->enabled)
+	{
+		Log::error("The graphics queue has no timestamps, rendering at full resolution\n");
+	}
+
+	ResolutionSettings settings = makeDefaultResolutionSettings();
+	settings.budgetMilliseconds = readEnvFloat("ENGINE_GPU_BUDGET_MS", settings.budgetMilliseconds);
+	settings.minScale = readEnvFloat("ENGINE_MIN_RESOLUTION_SCALE", settings.minScale);
+	settings.minScale = settings.minScale < 0.1f ? 0.1f : (settings.minScale > 1.0f ? 1.0f : settings.minScale);
+	initResolutionController(resolution->controller, settings);
+
+	if (resolution->timing)
+	{
+		resolution->timestampMask = timestampMask;
+		resolution->timestampPeriod = context.physicalDeviceProperties.limits.timestampPeriod;
+
+		VkQueryPoolCreateInfo queryPoolInfo = {};
+		queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryPoolInfo.queryCount = NumQueriesPerFrame * MAX_FRAMES_IN_FLIGHT;
+
+		VkResult result = vkCreateQueryPool(context.device, &queryPoolInfo, nullptr, &resolution->queryPool);
+		if (result != VK_SUCCESS)
+		{
+			Log::fatal("Couldn't create timestamp query pool");
+		}
+	}
+
+	if (resolution->enabled)
+	{
+		Log::log("Dynamic resolution targets %.1f ms of GPU time, scale %.2f to %.2f\n", settings.budgetMilliseconds, settings.minScale, settings.maxScale);
+	}
+
+	createUpscalePipeline(context, *resolution);
+
+	const char* logStats = getenv("ENGINE_RESOLUTION_STATS");
+	resolution->logStats = logStats && strcmp(logStats, "0") != 0;
+	resolution->lastStatsTime = getEngineTime();
+
+	context.dynamicResolution = resolution;
+}
+
+void destroyDynamicResolution(EngineContext& context)
+{
+	DynamicResolution* resolution = context.dynamicResolution;
+	if (!resolution)
+	{
+		return;
+	}
+
+	vkDestroyPipelineLayout(context.device, resolution->pipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(context.device, resolution->setLayout, nullptr);
+	vkDestroySampler(context.device, resolution->sampler, nullptr);
+	if (resolution->queryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(context.device, resolution->queryPool, nullptr);
+	}
+
+	delete resolution;
+	context.dynamicResolution = nullptr;
+}
+
+void updateDynamicResolution(EngineContext& context)
+{
+	DynamicResolution& resolution = *context.dynamicResolution;
+	resolution.slotGpuMilliseconds = -1.0f;
+	if (!resolution.timing)
+	{
+		return;
+	}
+
+	uint32_t slot = context.currentFrame;
+	if (resolution.queriesWritten[slot])
+	{
+		// each result is followed by its availability
+		uint64_t results[NumQueriesPerFrame * 2] = {};
+		VkResult result = vkGetQueryPoolResults(context.device, resolution.queryPool, slot * NumQueriesPerFrame, NumQueriesPerFrame,
+			sizeof(results), results, 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+		if (result == VK_SUCCESS && results[1] && results[3])
+		{
+			uint64_t ticks = (results[2] - results[0]) & resolution.timestampMask;
+			resolution.lastGpuMilliseconds = static_cast<float>(static_cast<double>(ticks) * resolution.timestampPeriod * 1e-6);
+			resolution.slotGpuMilliseconds = resolution.lastGpuMilliseconds;
+			if (resolution.enabled)
+			{
+				updateResolutionController(resolution.controller, resolution.lastGpuMilliseconds);
+			}
+		}
+	}
+
+	if (!resolution.enabled)
+	{
+		return;
+	}
+
+	float scale = getResolutionScale(resolution.controller);
+	context.renderExtent.width = roundExtent(scale * context.swapchainExtent.width, context.swapchainExtent.width);
+	context.renderExtent.height = roundExtent(scale * context.swapchainExtent.height, context.swapchainExtent.height);
+
+	double time = getEngineTime();
+	if (resolution.logStats && time - resolution.lastStatsTime >= StatsInterval)
+	{
+		Log::log("Dynamic resolution: %ux%u (%.0f%%), %.2f ms of GPU time, %.1f ms budget\n", context.renderExtent.width, context.renderExtent.height,
+			scale * 100.0f, resolution.lastGpuMilliseconds, resolution.controller.settings.budgetMilliseconds);
+		resolution.lastStatsTime = time;
+	}
+}
+
+void beginGpuFrameTiming(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	DynamicResolution& resolution = *context.dynamicResolution;
+	if (!resolution.timing)
+	{
+		return;
+	}
+
+	uint32_t firstQuery = context.currentFrame * NumQueriesPerFrame;
+	vkCmdResetQueryPool(commandBuffer, resolution.queryPool, firstQuery, NumQueriesPerFrame);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, resolution.queryPool, firstQuery);
+}
+
+void endGpuFrameTiming(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	DynamicResolution& resolution = *context.dynamicResolution;
+	if (!resolution.timing)
+	{
+		return;
+	}
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, resolution.queryPool, context.currentFrame * NumQueriesPerFrame + 1);
+	resolution.queriesWritten[context.currentFrame] = true;
+}
+
+float getGpuFrameMilliseconds(EngineContext& context)
+{
+	return context.dynamicResolution->slotGpuMilliseconds;
+}
+
+void getUpscaleUvTransform(EngineContext& context, float uvScale[2], float uvMax[2])
+{
+	float fullWidth = static_cast<float>(context.swapchainExtent.width);
+	float fullHeight = static_cast<float>(context.swapchainExtent.height);
+
+	uvScale[0] = context.renderExtent.width / fullWidth;
+	uvScale[1] = context.renderExtent.height / fullHeight;
+	uvMax[0] = (context.renderExtent.width - 0.5f) / fullWidth;
+	uvMax[1] = (context.renderExtent.height - 0.5f) / fullHeight;
+}
+
+void recordUpscale(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	DynamicResolution& resolution = *context.dynamicResolution;
+
+	UpscalePushConstants pushConstants = {};
+	getUpscaleUvTransform(context, pushConstants.uvScale, pushConstants.uvMax);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(context, resolution.upscalePipelineDesc));
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, resolution.pipelineLayout, 0, 1, &resolution.descriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, resolution.pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pushConstants), &pushConstants);
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
@@ -0,0 +1,16 @@
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// EASTL's default allocator calls these, every program linking EngineCore gets them from here
+
+void* operator new[](size_t size, const char* name, int flags, unsigned debugFlags, const char* file, int line)
+{
+	return new uint8_t[size];
+}
+
+void* operator new[](size_t size, size_t alignment, size_t offset, const char* name, int flags, unsigned debugFlags, const char* file, int line)
+{
+	assert(false);
+	return new uint8_t[size];
+}
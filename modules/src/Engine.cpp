@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -11,30 +12,45 @@
 #include "EASTL/algorithm.h"
 #include "EASTL/numeric_limits.h"
 #include "EASTL/optional.h"
-#include "EASTL/set.h"
-#include "EASTL/string.h"
 #include "EASTL/vector.h"
 
 #include "ArraySize.h"
+#include "Camera.h"
+#include "Clock.h"
+#include "ClusteredLighting.h"
+#include "ComputePass.h"
+#include "DebugDraw.h"
+#include "DeferredDestroy.h"
+#include "DepthBuffer.h"
+#include "DepthPyramid.h"
+#include "DeviceSelection.h"
+#include "DynamicRendering.h"
+#include "DynamicResolution.h"
 #include "EngineContext.h"
+#include "FrameCapture.h"
+#include "FrameTrace.h"
+#include "JobSystem.h"
+#include "LodSample.h"
 #include "Log.h"
-
-void* __cdecl operator new[](size_t size, const char* name, int flags, unsigned debugFlags, const char* file, int line)
-{
-	return new uint8_t[size];
-}
-
-void* __cdecl operator new[](size_t size, size_t alignment, size_t offset, const char* name, int flags, unsigned debugFlags, const char* file, int line)
-{
-	assert(false);
-	return new uint8_t[size];
-}
+#include "MeshShading.h"
+#include "MeshletSample.h"
+#include "ParticleSample.h"
+#include "PipelineCache.h"
+#include "PostProcess.h"
+#include "RenderCommands.h"
+#include "ResourceRegistry.h"
+#include "ShaderHotReload.h"
+#include "ShadowMaps.h"
+#include "Simulation.h"
+#include "SkinningSample.h"
+#include "StartupTimings.h"
+#include "Telemetry.h"
+#include "ShaderVariants.h"
+#include "Shaders.h"
 
 const uint32_t WIDTH = 800;
 const uint32_t HEIGHT = 600;
 
-static const char ShadersFolder[] = "D:\\Projects\\Engine\\shaders\\";
-
 static const char* const ValidationLayers[] = {
 	"VK_LAYER_KHRONOS_validation"
 };
@@ -43,21 +59,38 @@ static const char* const DeviceExtensions[] = {
 	VK_KHR_SWAPCHAIN_EXTENSION_NAME
 };
 
+static constexpr StringId DeviceExtensionIds[] = {
+	makeStringId(VK_KHR_SWAPCHAIN_EXTENSION_NAME)
+};
+static_assert(ARRAY_SIZE(DeviceExtensionIds) == ARRAY_SIZE(DeviceExtensions), "DeviceExtensionIds has to match DeviceExtensions");
+
 #ifdef NDEBUG
 static const bool EnableValidationLayers = false;
+static const bool EnableShaderHotReload = false;
 #else
 static const bool EnableValidationLayers = true;
+static const bool EnableShaderHotReload = true;
 #endif
 
+struct TrianglePushConstants
+{
+	float offset[2];
+	float rotation;
+};
+
+
+static void initGlfw(EngineContext& context);
 static void initWindow(EngineContext& context);
-static void initVulkan(EngineContext& context);
+static void createInstanceJob(void* data);
+static void preloadShaderFilesJob(void* data);
+static void initVulkan(EngineContext& context, JobCounter& shaderFileCounter);
 static void cleanupVulkan(EngineContext& context);
 static void cleanupWindow(EngineContext& context);
 
 static void createInstance(EngineContext& context);
 
 static bool checkValidationLayerSupport();
-static eastl::vector<const char*> getRequiredExtensions();
+static eastl::vector<const char*> getRequiredExtensions(EngineContext& context);
 
 static VKAPI_ATTR VkBool32 VKAPI_CALL vulkanDebugCallback(
 	VkDebugUtilsMessageSeverityFlagBitsEXT           messageSeverity,
@@ -69,7 +102,6 @@ static void setupDebugCallback(EngineContext& context);
 static void destroyDebugCallback(EngineContext& context);
 
 static void pickPhysicalDevice(EngineContext& context);
-static bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR onSurface);
 
 static void createLogicalDevice(EngineContext& context);
 static void getQueueHandles(EngineContext& context);
@@ -77,12 +109,16 @@ static void getQueueHandles(EngineContext& context);
 static void createSurface(EngineContext& context);
 static void destroySurface(EngineContext& context);
 
-static bool checkDeviceExtensionSupport(VkPhysicalDevice physicalDevice);
+static eastl::vector<VkExtensionProperties> queryDeviceExtensions(VkPhysicalDevice physicalDevice);
+static bool checkDeviceExtensionSupport(const eastl::vector<VkExtensionProperties>& availableExtensions);
 
 struct QueueFamilyIndices
 {
+	eastl::vector<VkQueueFamilyProperties> properties;
 	eastl::optional<uint32_t> graphicsFamily;
 	eastl::optional<uint32_t> presentFamily;
+	// a compute-only family if there is one, otherwise the graphics family
+	eastl::optional<uint32_t> computeFamily;
 
 	bool isComplete() const
 	{
@@ -92,92 +128,255 @@ struct QueueFamilyIndices
 };
 static QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
 
-struct SwapChainSupportDetails
+// Everything queried while picking a device, kept so the chosen one's results can be cached in the context
+struct DeviceCandidate
 {
-	VkSurfaceCapabilitiesKHR capabilities;
-	eastl::vector<VkSurfaceFormatKHR> formats;
-	eastl::vector<VkPresentModeKHR> presentModes;
+	VkPhysicalDevice device;
+	QueueFamilyIndices queueFamilies;
+	eastl::vector<VkExtensionProperties> extensions;
+	SwapChainSupportDetails swapChainSupport;
 };
+static bool isDeviceSuitable(DeviceCandidate& candidate, VkSurfaceKHR onSurface);
+
 static SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
 static VkSurfaceFormatKHR chooseSwapSurfaceFormat(const eastl::vector<VkSurfaceFormatKHR>& availableFormats);
 static VkPresentModeKHR chooseSwapPresentMode(const eastl::vector<VkPresentModeKHR>& availablePresentModes);
 static VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, GLFWwindow* window);
 static void createSwapchain(EngineContext& context);
+static void createOffscreenImages(EngineContext& context);
 static void createSwapchainImageViews(EngineContext& context);
 
+static VkRenderPass createSceneRenderPass(EngineContext& context, bool resume);
+static VkRenderPass createSwapchainRenderPass(EngineContext& context);
 static void createRenderPass(EngineContext& context);
 static void createGraphicsPipeline(EngineContext& context);
-static eastl::vector<uint8_t> readShaderFile(const char* filename);
-static VkShaderModule createShaderModule(VkDevice device, const eastl::vector<uint8_t>& code);
+static void prewarmGraphicsPipelines(EngineContext& context);
+static void prewarmGraphicsPipelinesJob(void* data);
+static PipelineDesc makeTrianglePipelineDesc(EngineContext& context);
 
 static void createFramebuffers(EngineContext& context);
 
 static void createCommandPool(EngineContext& context);
+static void createDescriptorPool(EngineContext& context);
 static void createCommandBuffer(EngineContext& context);
+static void setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent);
 static void recordCommandBuffer(EngineContext& context, VkCommandBuffer commandBuffer, uint32_t imageIndex);
 
+static void emitFrameDrawPackets(EngineContext& context);
+
 static void createSyncObjects(EngineContext& context);
 
 static void drawFrame(EngineContext& context);
 
+static const ShaderProgram TriangleProgram = {
+	"triangle",
+	"shader.vert",
+	"shader.frag",
+	ShaderFeature_Grayscale | ShaderFeature_Invert
+};
+
 void init(EngineContext& context)
 {
-	initWindow(context);
-	initVulkan(context);
-	
+	beginStartupTimings(context);
+
+	// nobody watches a replay, it runs without a window so it also runs without a display, see FrameTrace.h
+	context.headless = isTraceReplay(context);
+	context.jobSystem = createJobSystem(0);
+
+	// reading the compiled shaders needs nothing from Vulkan, it runs through instance, window and device creation
+	JobCounter shaderFileCounter = {};
+	submitJob(context.jobSystem, preloadShaderFilesJob, &context, &shaderFileCounter);
+
+	// GLFW wants its window created on the main thread, the instance doesn't depend on it and is created meanwhile
+	if (!context.headless)
+	{
+		runStartupStage(context, "initGlfw", initGlfw);
+	}
+	JobCounter instanceCounter = {};
+	submitJob(context.jobSystem, createInstanceJob, &context, &instanceCounter);
+	if (!context.headless)
+	{
+		runStartupStage(context, "initWindow", initWindow);
+	}
+	waitForCounter(context.jobSystem, &instanceCounter);
+
+	initVulkan(context, shaderFileCounter);
 }
 
 void run(EngineContext& context)
 {
-	while (!glfwWindowShouldClose(context.window)) 
+	startSimulation(context);
+
+	while (!glfwWindowShouldClose(context.window) && !context.quitRequested)
 	{
 		glfwPollEvents();
 		drawFrame(context);
 	}
 
+	stopSimulation(context);
+
+	vkDeviceWaitIdle(context.device);
+}
+
+bool replay(EngineContext& context)
+{
+	while (!context.quitRequested && !isTraceReplayFinished(context))
+	{
+		drawFrame(context);
+	}
+
 	vkDeviceWaitIdle(context.device);
+
+	return finishTraceReplay(context);
 }
 
 void cleanup(EngineContext& context)
 {
 	cleanupVulkan(context);
 	cleanupWindow(context);
+
+	destroyJobSystem(context.jobSystem);
 }
 
-static void initWindow(EngineContext& context)
+static void initGlfw(EngineContext& context)
 {
 	glfwInit();
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+}
+
+static void initWindow(EngineContext& context)
+{
 	context.window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
 }
 
-static void initVulkan(EngineContext& context)
+static void createInstanceJob(void* data)
 {
-	createInstance(context);
-	setupDebugCallback(context);
-	createSurface(context);
-	pickPhysicalDevice(context);
-	createLogicalDevice(context);
-	getQueueHandles(context);
-	createSwapchain(context);
-	createSwapchainImageViews(context);
-	createRenderPass(context);
-	createGraphicsPipeline(context);
-	createFramebuffers(context);
-	createCommandPool(context);
-	createCommandBuffer(context);
-	createSyncObjects(context);
+	EngineContext& context = *static_cast<EngineContext*>(data);
+
+	runStartupStage(context, "createInstance", createInstance);
+	runStartupStage(context, "setupDebugCallback", setupDebugCallback);
+}
+
+static void preloadShaderFilesJob(void* data)
+{
+	EngineContext& context = *static_cast<EngineContext*>(data);
+
+	runStartupStage(context, "preloadShaderFiles", preloadShaderFiles);
+}
+
+static void initVulkan(EngineContext& context, JobCounter& shaderFileCounter)
+{
+	if (!context.headless)
+	{
+		runStartupStage(context, "createSurface", createSurface);
+	}
+	runStartupStage(context, "pickPhysicalDevice", pickPhysicalDevice);
+	runStartupStage(context, "createLogicalDevice", createLogicalDevice);
+	runStartupStage(context, "getQueueHandles", getQueueHandles);
+	runStartupStage(context, "createTelemetry", createTelemetry);
+	if (context.headless)
+	{
+		runStartupStage(context, "createOffscreenImages", createOffscreenImages);
+	}
+	else
+	{
+		runStartupStage(context, "createSwapchain", createSwapchain);
+	}
+	runStartupStage(context, "createFrameTrace", createFrameTrace);
+	runStartupStage(context, "createSwapchainImageViews", createSwapchainImageViews);
+	runStartupStage(context, "createResourceRegistry", createResourceRegistry);
+	runStartupStage(context, "createDepthBuffer", createDepthBuffer);
+	runStartupStage(context, "createSceneColorTarget", createSceneColorTarget);
+	if (context.dynamicRendering == DynamicRenderingSupport_None)
+	{
+		runStartupStage(context, "createRenderPass", createRenderPass);
+	}
+	// the pipelines below are the first to need the shaders
+	waitForCounter(context.jobSystem, &shaderFileCounter);
+	if (EnableShaderHotReload)
+	{
+		runStartupStage(context, "startShaderHotReload", startShaderHotReload);
+	}
+	runStartupStage(context, "createPipelineCache", createPipelineCache);
+	runStartupStage(context, "createGraphicsPipeline", createGraphicsPipeline);
+
+	// shader loading and pipeline compilation are the slowest part of init, they overlap with everything below
+	JobCounter pipelineCounter = {};
+	submitJob(context.jobSystem, prewarmGraphicsPipelinesJob, &context, &pipelineCounter);
+
+	if (context.dynamicRendering == DynamicRenderingSupport_None)
+	{
+		runStartupStage(context, "createFramebuffers", createFramebuffers);
+	}
+	runStartupStage(context, "createCommandPool", createCommandPool);
+	runStartupStage(context, "createCommandBuffer", createCommandBuffer);
+	runStartupStage(context, "createSyncObjects", createSyncObjects);
+	runStartupStage(context, "createRenderCommands", createRenderCommands);
+	runStartupStage(context, "createDescriptorPool", createDescriptorPool);
+	runStartupStage(context, "createDynamicResolution", createDynamicResolution);
+	runStartupStage(context, "createFrameCapture", createFrameCapture);
+	runStartupStage(context, "createDebugDraw", createDebugDraw);
+	runStartupStage(context, "createHeadlessDevices", createHeadlessDevices);
+	runStartupStage(context, "createComputeResources", createComputeResources);
+	if (context.postProcessing)
+	{
+		runStartupStage(context, "createPostProcess", createPostProcess);
+	}
+	runStartupStage(context, "createShadowMaps", createShadowMaps);
+	runStartupStage(context, "createParticleSample", createParticleSample);
+	runStartupStage(context, "createClusteredLighting", createClusteredLighting);
+	if (isMeshletSampleRequested())
+	{
+		runStartupStage(context, "createDepthPyramid", createDepthPyramid);
+		runStartupStage(context, "createMeshletSample", createMeshletSample);
+	}
+	else if (isSkinningSampleRequested())
+	{
+		runStartupStage(context, "createSkinningSample", createSkinningSample);
+	}
+	else
+	{
+		runStartupStage(context, "createLodSample", createLodSample);
+	}
+
+	waitForCounter(context.jobSystem, &pipelineCounter);
 }
 
 static void cleanupWindow(EngineContext& context)
 {
+	if (context.headless)
+	{
+		return;
+	}
+
 	glfwDestroyWindow(context.window);
 	glfwTerminate();
 }
 
 static void cleanupVulkan(EngineContext& context)
 {
+	stopShaderHotReload(context);
+	flushDeferredDestroys(context);
+	reportShaderVariantUsage(context);
+	reportPipelineCacheStats(context);
+
+	destroyHeadlessDevices(context);
+	destroyDebugDraw(context);
+	destroyFrameCapture(context);
+	destroyMeshletSample(context);
+	destroyDepthPyramid(context);
+	destroySkinningSample(context);
+	destroyLodSample(context);
+	destroyClusteredLighting(context);
+	destroyParticleSample(context);
+	destroyShadowMaps(context);
+	destroyPostProcess(context);
+	destroyComputeResources(context);
+	destroyDynamicResolution(context);
+	vkDestroyDescriptorPool(context.device, context.descriptorPool, nullptr);
+	destroyRenderCommands(context);
+
 	for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
 	{
 		vkDestroySemaphore(context.device, context.imageAvailableSemaphores[i], nullptr);
@@ -190,14 +389,34 @@ static void cleanupVulkan(EngineContext& context)
 	{
 		vkDestroyFramebuffer(context.device, framebuffer, nullptr);
 	}
-	vkDestroyPipeline(context.device, context.pipeline, nullptr);
+	vkDestroyFramebuffer(context.device, context.sceneFramebuffer, nullptr);
+	destroyShaderVariants(context);
+	destroyPipelineCache(context);
+	destroyShaderFileCache(context);
 	vkDestroyPipelineLayout(context.device, context.pipelineLayout, nullptr);
 	vkDestroyRenderPass(context.device, context.renderPass, nullptr);
+	vkDestroyRenderPass(context.device, context.resumeRenderPass, nullptr);
+	vkDestroyRenderPass(context.device, context.swapchainRenderPass, nullptr);
+	destroySceneColorTarget(context);
+	destroyDepthBuffer(context);
 	for (VkImageView& swapchainImageView : context.swapchainImageViews)
 	{
 		vkDestroyImageView(context.device, swapchainImageView, nullptr);
 	}
-	vkDestroySwapchainKHR(context.device, context.swapchain, nullptr);
+	if (context.headless)
+	{
+		for (GpuImage& image : context.offscreenImages)
+		{
+			destroyGpuImage(context, image);
+		}
+	}
+	else
+	{
+		vkDestroySwapchainKHR(context.device, context.swapchain, nullptr);
+	}
+	destroyResourceRegistry(context);
+	destroyTelemetry(context);
+	destroyFrameTrace(context);
 	vkDestroyDevice(context.device, nullptr);
 	destroySurface(context);
 	destroyDebugCallback(context);
@@ -218,13 +437,14 @@ static void createInstance(EngineContext& context)
 	appInfo.applicationVersion = VK_MAKE_VERSION(0, 1, 0);
 	appInfo.pEngineName = "EngineUnknown";
 	appInfo.engineVersion = VK_MAKE_VERSION(0, 1, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	context.apiVersion = queryInstanceApiVersion();
+	appInfo.apiVersion = context.apiVersion;
 
 	VkInstanceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	createInfo.pApplicationInfo = &appInfo;
 
-	eastl::vector<const char*> extensions = getRequiredExtensions();
+	eastl::vector<const char*> extensions = getRequiredExtensions(context);
 	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
 	createInfo.ppEnabledExtensionNames = extensions.data();
 
@@ -274,12 +494,16 @@ static bool checkValidationLayerSupport()
 	return true;
 }
 
-static eastl::vector<const char*> getRequiredExtensions()
+static eastl::vector<const char*> getRequiredExtensions(EngineContext& context)
 {
-	uint32_t numGlfwExtensions = 0;
-	const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&numGlfwExtensions);
-
-	eastl::vector<const char*> extensions(glfwExtensions, glfwExtensions + numGlfwExtensions);
+	// the surface extensions GLFW asks for, none when headless
+	eastl::vector<const char*> extensions;
+	if (!context.headless)
+	{
+		uint32_t numGlfwExtensions = 0;
+		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&numGlfwExtensions);
+		extensions.assign(glfwExtensions, glfwExtensions + numGlfwExtensions);
+	}
 
 	if (EnableValidationLayers)
 	{
@@ -368,52 +592,89 @@ static void pickPhysicalDevice(EngineContext& context)
 {
 	context.physicalDevice = VK_NULL_HANDLE;
 
-	uint32_t numDevices = 0;
-	vkEnumeratePhysicalDevices(context.instance, &numDevices, nullptr);
-
-	if (numDevices == 0)
+	eastl::vector<DeviceInfo> infos = queryDeviceInfos(context.instance, context.apiVersion);
+	if (infos.empty())
 	{
 		Log::fatal("No Vulkan-capable devices");
 	}
 
-	eastl::vector<VkPhysicalDevice> devices(numDevices);
-	vkEnumeratePhysicalDevices(context.instance, &numDevices, devices.data());
+	logDeviceInfos(infos);
 
-	for (const VkPhysicalDevice& device : devices)
+	DeviceOverride deviceOverride;
+	bool overridden = readDeviceOverride(deviceOverride);
+
+	for (uint32_t index : rankDevices(infos))
 	{
-		if (isDeviceSuitable(device, context.surface))
+		const DeviceInfo& info = infos[index];
+		if (overridden && !matchesDeviceOverride(deviceOverride, info))
 		{
-			context.physicalDevice = device;
+			continue;
+		}
+
+		DeviceCandidate candidate;
+		candidate.device = info.device;
+		if (isDeviceSuitable(candidate, context.surface))
+		{
+			context.physicalDevice = info.device;
+			context.graphicsQueueFamily = candidate.queueFamilies.graphicsFamily.value();
+			context.presentQueueFamily = candidate.queueFamilies.presentFamily.value();
+			context.computeQueueFamily = candidate.queueFamilies.computeFamily.value();
+			context.queueFamilyProperties = eastl::move(candidate.queueFamilies.properties);
+			context.deviceExtensions = eastl::move(candidate.extensions);
+			for (const VkExtensionProperties& extension : context.deviceExtensions)
+			{
+				context.deviceExtensionIds.push_back(makeStringId(extension.extensionName));
+			}
+			eastl::sort(context.deviceExtensionIds.begin(), context.deviceExtensionIds.end());
+			context.swapChainSupport = eastl::move(candidate.swapChainSupport);
 			break;
 		}
+
+		if (overridden)
+		{
+			Log::fatal("The device picked with ENGINE_DEVICE, %s, %s\n", info.properties.deviceName,
+				context.headless ? "has no graphics queue" : "can't present to the window");
+		}
 	}
 
 	if (context.physicalDevice == VK_NULL_HANDLE)
 	{
-		Log::fatal("No suitable GPUs found");
+		Log::fatal(overridden ? "No device matches ENGINE_DEVICE" : "No suitable GPUs found");
+	}
+
+	vkGetPhysicalDeviceProperties(context.physicalDevice, &context.physicalDeviceProperties);
+	vkGetPhysicalDeviceMemoryProperties(context.physicalDevice, &context.memoryProperties);
+
+	Log::log("Using %s\n", context.physicalDeviceProperties.deviceName);
+	if (context.physicalDeviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU)
+	{
+		Log::warning("Rendering on a CPU implementation, expect it to be slow\n");
 	}
 }
 
-static bool isDeviceSuitable(VkPhysicalDevice device, VkSurfaceKHR onSurface)
+// Without a surface the device only needs a graphics queue, it presents nothing and gets no
+// VK_KHR_swapchain, like the headless devices in DeviceSelection.h
+static bool isDeviceSuitable(DeviceCandidate& candidate, VkSurfaceKHR onSurface)
 {
-	QueueFamilyIndices indices = findQueueFamilies(device, onSurface);
-	if (!indices.isComplete())
+	candidate.queueFamilies = findQueueFamilies(candidate.device, onSurface);
+	if (!candidate.queueFamilies.isComplete())
 	{
 		return false;
 	}
 
-	bool extensionsSupported = checkDeviceExtensionSupport(device);
-	if (!extensionsSupported)
+	candidate.extensions = queryDeviceExtensions(candidate.device);
+	if (onSurface == VK_NULL_HANDLE)
 	{
-		return false;
+		return true;
 	}
 
-	bool swapChainSuitable = false;
-	if (extensionsSupported)
+	if (!checkDeviceExtensionSupport(candidate.extensions))
 	{
-		SwapChainSupportDetails swapChainDetails = querySwapChainSupport(device, onSurface);
-		swapChainSuitable = !swapChainDetails.formats.empty() && !swapChainDetails.presentModes.empty();
+		return false;
 	}
+
+	candidate.swapChainSupport = querySwapChainSupport(candidate.device, onSurface);
+	bool swapChainSuitable = !candidate.swapChainSupport.formats.empty() && !candidate.swapChainSupport.presentModes.empty();
 	if (!swapChainSuitable)
 	{
 		return false;
@@ -429,8 +690,9 @@ static QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKH
 	uint32_t numQueueFamilies = 0;
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &numQueueFamilies, nullptr);
 
-	eastl::vector<VkQueueFamilyProperties> queueFamilies(numQueueFamilies);
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &numQueueFamilies, queueFamilies.data());
+	indices.properties.resize(numQueueFamilies);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &numQueueFamilies, indices.properties.data());
+	const eastl::vector<VkQueueFamilyProperties>& queueFamilies = indices.properties;
 
 	for (int i = 0; i < queueFamilies.size(); ++i)
 	{
@@ -439,8 +701,12 @@ static QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKH
 			indices.graphicsFamily = i;
 		}
 
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		// without a surface the present queue is only submitted to, the first graphics family will do
+		VkBool32 presentSupport = surface == VK_NULL_HANDLE && (queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT);
+		if (surface != VK_NULL_HANDLE)
+		{
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+		}
 		if (presentSupport)
 		{
 			indices.presentFamily = i;
@@ -452,20 +718,35 @@ static QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKH
 		}
 	}
 
+	for (int i = 0; i < queueFamilies.size(); ++i)
+	{
+		if ((queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+		{
+			indices.computeFamily = i;
+			break;
+		}
+	}
+
+	if (!indices.computeFamily.has_value())
+	{
+		indices.computeFamily = indices.graphicsFamily;
+	}
+
 	return indices;
 }
 
 static void createLogicalDevice(EngineContext& context)
 {
-	QueueFamilyIndices indices = findQueueFamilies(context.physicalDevice, context.surface);
-	assert(indices.isComplete());
-
 	// deduplicated queue indices
 	eastl::vector<uint32_t> uniqueQueueFamilies;
-	uniqueQueueFamilies.push_back(indices.graphicsFamily.value());
-	if (eastl::find(uniqueQueueFamilies.begin(), uniqueQueueFamilies.end(), indices.presentFamily.value()) == uniqueQueueFamilies.end())
+	uniqueQueueFamilies.push_back(context.graphicsQueueFamily);
+	if (eastl::find(uniqueQueueFamilies.begin(), uniqueQueueFamilies.end(), context.presentQueueFamily) == uniqueQueueFamilies.end())
+	{
+		uniqueQueueFamilies.push_back(context.presentQueueFamily);
+	}
+	if (eastl::find(uniqueQueueFamilies.begin(), uniqueQueueFamilies.end(), context.computeQueueFamily) == uniqueQueueFamilies.end())
 	{
-		uniqueQueueFamilies.push_back(indices.presentFamily.value());
+		uniqueQueueFamilies.push_back(context.computeQueueFamily);
 	}
 
 	eastl::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
@@ -474,7 +755,7 @@ static void createLogicalDevice(EngineContext& context)
 	{
 		VkDeviceQueueCreateInfo queueCreateInfo = {};
 		queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-		queueCreateInfo.queueFamilyIndex = indices.graphicsFamily.value();
+		queueCreateInfo.queueFamilyIndex = queueIndex;
 		queueCreateInfo.queueCount = 1;
 		queueCreateInfo.pQueuePriorities = &queuePriority;
 
@@ -486,31 +767,66 @@ static void createLogicalDevice(EngineContext& context)
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 	
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(context.physicalDevice, &supportedFeatures);
+
+	// the depth pyramid is an rg32f storage image
 	VkPhysicalDeviceFeatures deviceFeatures = {};
+	deviceFeatures.shaderStorageImageExtendedFormats = supportedFeatures.shaderStorageImageExtendedFormats;
 	createInfo.pEnabledFeatures = &deviceFeatures;
 
+	eastl::vector<const char*> extensions;
+	if (!context.headless)
+	{
+		extensions.assign(eastl::begin(DeviceExtensions), eastl::end(DeviceExtensions));
+	}
+
+	VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRenderingFeatures = {};
+	dynamicRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+	dynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+
+	context.dynamicRendering = queryDynamicRenderingSupport(context);
+	if (context.dynamicRendering != DynamicRenderingSupport_None)
+	{
+		createInfo.pNext = &dynamicRenderingFeatures;
+	}
+	if (context.dynamicRendering == DynamicRenderingSupport_Extension)
+	{
+		extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+	}
+
+	VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {};
+	context.meshShaders = queryMeshShaderSupport(context);
+	chainMeshShaderFeatures(context, meshShaderFeatures, createInfo.pNext);
+	if (context.meshShaders)
+	{
+		extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+	}
+
 	if (EnableValidationLayers)
 	{
 		createInfo.enabledLayerCount = ARRAY_SIZE(ValidationLayers);
 		createInfo.ppEnabledLayerNames = ValidationLayers;
 	}
 
-	createInfo.enabledExtensionCount = ARRAY_SIZE(DeviceExtensions);
-	createInfo.ppEnabledExtensionNames = DeviceExtensions;
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	createInfo.ppEnabledExtensionNames = extensions.data();
 
 	VkResult result = vkCreateDevice(context.physicalDevice, &createInfo, nullptr, &context.device);
 	if (result != VK_SUCCESS)
 	{
 		Log::fatal("Can't create device, result is %d", result);
 	}
+
+	loadDynamicRenderingFunctions(context);
+	loadMeshShaderFunctions(context);
 }
 
 static void getQueueHandles(EngineContext& context)
 {
-	QueueFamilyIndices indices = findQueueFamilies(context.physicalDevice, context.surface);
-
-	vkGetDeviceQueue(context.device, indices.graphicsFamily.value(), 0, &context.graphicsQueue);
-	vkGetDeviceQueue(context.device, indices.presentFamily.value(), 0, &context.presentQueue);
+	vkGetDeviceQueue(context.device, context.graphicsQueueFamily, 0, &context.graphicsQueue);
+	vkGetDeviceQueue(context.device, context.presentQueueFamily, 0, &context.presentQueue);
+	vkGetDeviceQueue(context.device, context.computeQueueFamily, 0, &context.computeQueue);
 }
 
 static void createSurface(EngineContext& context)
@@ -524,26 +840,40 @@ static void createSurface(EngineContext& context)
 
 static void destroySurface(EngineContext& context)
 {
+	if (context.headless)
+	{
+		return;
+	}
+
 	vkDestroySurfaceKHR(context.instance, context.surface, nullptr);
 }
 
-static bool checkDeviceExtensionSupport(VkPhysicalDevice physicalDevice)
+static eastl::vector<VkExtensionProperties> queryDeviceExtensions(VkPhysicalDevice physicalDevice)
 {
 	uint32_t numExtensions = 0;
 	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &numExtensions, nullptr);
 
-	eastl::vector<VkExtensionProperties> availableExtensions(numExtensions);
-	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &numExtensions, availableExtensions.data());
+	eastl::vector<VkExtensionProperties> extensions(numExtensions);
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &numExtensions, extensions.data());
 
-	// true if an extension from DeviceExtensions is supported, false if no
-	eastl::set<eastl::string> requiredExtensions(eastl::begin(DeviceExtensions), eastl::end(DeviceExtensions));
+	return extensions;
+}
 
+static bool checkDeviceExtensionSupport(const eastl::vector<VkExtensionProperties>& availableExtensions)
+{
+	// true if every extension from DeviceExtensions is supported. Devices list each extension once,
+	// so counting the matches is enough.
+	size_t numFound = 0;
 	for (const VkExtensionProperties& extension : availableExtensions)
 	{
-		requiredExtensions.erase(extension.extensionName);
+		StringId id = makeStringId(extension.extensionName);
+		for (StringId required : DeviceExtensionIds)
+		{
+			numFound += id == required;
+		}
 	}
 
-	return requiredExtensions.empty();
+	return numFound == ARRAY_SIZE(DeviceExtensionIds);
 }
 
 static SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device, VkSurfaceKHR surface)
@@ -626,7 +956,7 @@ static VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities,
 
 static void createSwapchain(EngineContext& context)
 {
-	SwapChainSupportDetails swapChainSupport = querySwapChainSupport(context.physicalDevice, context.surface);
+	const SwapChainSupportDetails& swapChainSupport = context.swapChainSupport;
 
 	VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
 	VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities, context.window);
@@ -646,11 +976,18 @@ static void createSwapchain(EngineContext& context)
 	createInfo.imageExtent = extent;
 	createInfo.imageArrayLayers = 1;
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+	if (isFrameCaptureRequested())
+	{
+		if (!(swapChainSupport.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+		{
+			Log::fatal("Frame capture needs swapchain images that can be copied from");
+		}
+		createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
 
-	QueueFamilyIndices indices = findQueueFamilies(context.physicalDevice, context.surface);
-	uint32_t queueFamilyIndices[] = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+	uint32_t queueFamilyIndices[] = { context.graphicsQueueFamily, context.presentQueueFamily };
 
-	if (indices.graphicsFamily != indices.presentFamily)
+	if (context.graphicsQueueFamily != context.presentQueueFamily)
 	{
 		createInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
 		createInfo.queueFamilyIndexCount = ARRAY_SIZE(queueFamilyIndices);
@@ -680,6 +1017,28 @@ static void createSwapchain(EngineContext& context)
 
 	context.swapchainFormat = surfaceFormat.format;
 	context.swapchainExtent = extent;
+	context.presentLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+}
+
+// What a headless replay has instead of a swapchain, at the recorded swapchain's size and format so its
+// images hash the same as the recording's
+static void createOffscreenImages(EngineContext& context)
+{
+	getTraceSwapchain(context, context.swapchainFormat, context.swapchainExtent);
+	// ready to be copied by frame capture
+	context.presentLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	// one per frame in flight, the frame index is the image index
+	context.offscreenImages.resize(MAX_FRAMES_IN_FLIGHT);
+	context.swapchainImages.resize(MAX_FRAMES_IN_FLIGHT);
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		createGpuImage(context, context.swapchainExtent.width, context.swapchainExtent.height, 1, context.swapchainFormat,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT, context.offscreenImages[i]);
+		context.swapchainImages[i] = context.offscreenImages[i].image;
+	}
+
+	Log::log("Headless, rendering into %ux%u offscreen images\n", context.swapchainExtent.width, context.swapchainExtent.height);
 }
 
 static void createSwapchainImageViews(EngineContext& context)
@@ -711,172 +1070,132 @@ static void createSwapchainImageViews(EngineContext& context)
 
 static void createGraphicsPipeline(EngineContext& context)
 {
-	eastl::vector<uint8_t> vertShaderCode = readShaderFile("shader.vert.spv");
-	eastl::vector<uint8_t> fragShaderCode = readShaderFile("shader.frag.spv");
-
-	VkShaderModule vertShadereModule = createShaderModule(context.device, vertShaderCode);
-	VkShaderModule fragShaderModule = createShaderModule(context.device, fragShaderCode);
-
-	VkPipelineShaderStageCreateInfo vertStageCreateInfo = {};
-	vertStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertStageCreateInfo.module = vertShadereModule;
-	vertStageCreateInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo fragStageCreateInfo = {};
-	fragStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragStageCreateInfo.module = fragShaderModule;
-	fragStageCreateInfo.pName = "main";
-
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertStageCreateInfo, fragStageCreateInfo };
-
-	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexBindingDescriptionCount = 0;
-	vertexInputInfo.pVertexBindingDescriptions = nullptr;
-	vertexInputInfo.vertexAttributeDescriptionCount = 0;
-	vertexInputInfo.pVertexAttributeDescriptions = nullptr;
-
-	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-	VkViewport viewport = {};
-	viewport.width = static_cast<float>(context.swapchainExtent.width);
-	viewport.height = static_cast<float>(context.swapchainExtent.height);
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor = {};
-	scissor.extent = context.swapchainExtent;
-
-	VkDynamicState dynamicStates[] =
-	{
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR
-	};
-	VkPipelineDynamicStateCreateInfo dynamicState = {};
-	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-	dynamicState.dynamicStateCount = ARRAY_SIZE(dynamicStates);
-	dynamicState.pDynamicStates = dynamicStates;
-
-	VkPipelineViewportStateCreateInfo viewportState = {};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
-	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
-
-	VkPipelineRasterizationStateCreateInfo rasterizer = {};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
-
-	VkPipelineMultisampleStateCreateInfo multisampling = {};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_FALSE;
-	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-	multisampling.minSampleShading = 1.0f;
-	multisampling.pSampleMask = nullptr;
-	multisampling.alphaToCoverageEnable = VK_FALSE;
-	multisampling.alphaToOneEnable = VK_FALSE;
-
-	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
-
-	VkPipelineColorBlendStateCreateInfo	colorBlending = {};
-	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	colorBlending.logicOpEnable = VK_FALSE;
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.size = sizeof(TrianglePushConstants);
 
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 	VkResult pipelineLayoutResult = vkCreatePipelineLayout(context.device, &pipelineLayoutInfo, nullptr, &context.pipelineLayout);
 	if (pipelineLayoutResult != VK_SUCCESS)
 	{
 		Log::fatal("Couldn't create pipeline layout");
 	}
 
-	VkGraphicsPipelineCreateInfo pipelineInfo = {};
-	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = ARRAY_SIZE(shaderStages);
-	pipelineInfo.pStages = shaderStages;
-	pipelineInfo.pVertexInputState = &vertexInputInfo;
-	pipelineInfo.pInputAssemblyState = &inputAssembly;
-	pipelineInfo.pViewportState = &viewportState;
-	pipelineInfo.pRasterizationState = &rasterizer;
-	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = nullptr;
-	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.pDynamicState = &dynamicState;
-	pipelineInfo.layout = context.pipelineLayout;
-	pipelineInfo.renderPass = context.renderPass;
-	pipelineInfo.subpass = 0;
-	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
-	pipelineInfo.basePipelineIndex = -1;
-
-	VkResult pipelineResult = vkCreateGraphicsPipelines(context.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &context.pipeline);
-	if (pipelineResult != VK_SUCCESS)
-	{
-		Log::fatal("Couldn't create pipeline");
-	}
-
-	vkDestroyShaderModule(context.device, fragShaderModule, nullptr);
-	vkDestroyShaderModule(context.device, vertShadereModule, nullptr);
+	const char* features = getenv("ENGINE_SHADER_FEATURES");
+	if (features)
+	{
+		context.shaderFeatures = static_cast<uint32_t>(strtoul(features, nullptr, 0));
+	}
+
 }
 
-static eastl::vector<uint8_t> readShaderFile(const char* filename)
+static void prewarmGraphicsPipelines(EngineContext& context)
 {
-	eastl::string fullName = ShadersFolder;
-	fullName += filename;
-
-	FILE* f = fopen(fullName.c_str(), "rb");
-	fseek(f, 0, SEEK_END);
+	prewarmShaderVariants(context, TriangleProgram, &context.shaderFeatures, 1, makeTrianglePipelineDesc(context));
+}
 
-	uint64_t fileLength = ftell(f);
+static void prewarmGraphicsPipelinesJob(void* data)
+{
+	EngineContext& context = *static_cast<EngineContext*>(data);
+	runStartupStage(context, "prewarmGraphicsPipelines", prewarmGraphicsPipelines);
+}
 
-	eastl::vector<uint8_t> loadedData(fileLength);
-	fseek(f, 0, SEEK_SET);
-	fread(loadedData.data(), 1, fileLength, f);
-	fclose(f);
+static PipelineDesc makeTrianglePipelineDesc(EngineContext& context)
+{
+	PipelineDesc desc = makeDefaultPipelineDesc();
+	desc.layout = context.pipelineLayout;
+	desc.renderPass = context.renderPass;
+	desc.colorFormat = context.sceneColorFormat;
+	desc.depthFormat = context.depthFormat;
 
-	return loadedData;
+	return desc;
 }
 
-static VkShaderModule createShaderModule(VkDevice device, const eastl::vector<uint8_t>& code)
+static VkRenderPass createSceneRenderPass(EngineContext& context, bool resume)
 {
-	VkShaderModuleCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = code.size();
-	assert(reinterpret_cast<intptr_t>(code.data()) % sizeof(uint32_t) == 0);
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-	VkShaderModule shaderModule;
-	VkResult result = vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule);
-	if (result != VK_SUCCESS)
+	// both passes leave the color attachment as it is, endSceneRendering transitions it for the upscale pass
+	VkAttachmentDescription attachments[2] = {};
+	VkAttachmentDescription& colorAttachment = attachments[0];
+	colorAttachment.format = context.sceneColorFormat;
+	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	colorAttachment.loadOp = resume ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	colorAttachment.initialLayout = resume ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	// resumed after the depth pyramid was built from it, see resumeSceneRendering
+	VkAttachmentDescription& depthAttachment = attachments[1];
+	depthAttachment.format = context.depthFormat;
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = resume ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = resume ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference colorAttachmentRef = {};
+	colorAttachmentRef.attachment = 0;
+	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depthAttachmentRef = {};
+	depthAttachmentRef.attachment = 1;
+	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 1;
+	subpass.pColorAttachments = &colorAttachmentRef;
+	subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+	// covers the previous pass' attachment writes, the depth pyramid reading the depth buffer and
+	// the previous frame's upscale pass sampling the color target
+	VkSubpassDependency dependency = {};
+	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependency.dstSubpass = 0;
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+		VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = ARRAY_SIZE(attachments);
+	renderPassInfo.pAttachments = attachments;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+	renderPassInfo.dependencyCount = 1;
+	renderPassInfo.pDependencies = &dependency;
+
+	VkRenderPass renderPass;
+	VkResult passCreateResult = vkCreateRenderPass(context.device, &renderPassInfo, nullptr, &renderPass);
+	if (passCreateResult != VK_SUCCESS)
 	{
-		Log::fatal("Cannot create shader module");
+		Log::fatal("Couldn't create render pass");
 	}
 
-	return shaderModule;
+	return renderPass;
 }
 
-static void createRenderPass(EngineContext& context)
+static VkRenderPass createSwapchainRenderPass(EngineContext& context)
 {
+	// the upscale pass covers every pixel, so the previous contents don't matter
 	VkAttachmentDescription colorAttachment = {};
 	colorAttachment.format = context.swapchainFormat;
 	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachment.finalLayout = context.presentLayout;
 
 	VkAttachmentReference colorAttachmentRef = {};
 	colorAttachmentRef.attachment = 0;
@@ -887,13 +1206,14 @@ static void createRenderPass(EngineContext& context)
 	subpass.colorAttachmentCount = 1;
 	subpass.pColorAttachments = &colorAttachmentRef;
 
+	// waits for the acquire semaphore, which is waited on at the color output stage
 	VkSubpassDependency dependency = {};
 	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependency.dstSubpass = 0;
 	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 	dependency.srcAccessMask = 0;
 	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
 	VkRenderPassCreateInfo renderPassInfo = {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -904,22 +1224,50 @@ static void createRenderPass(EngineContext& context)
 	renderPassInfo.dependencyCount = 1;
 	renderPassInfo.pDependencies = &dependency;
 
-	VkResult passCreateResult = vkCreateRenderPass(context.device, &renderPassInfo, nullptr, &context.renderPass);
+	VkRenderPass renderPass;
+	VkResult passCreateResult = vkCreateRenderPass(context.device, &renderPassInfo, nullptr, &renderPass);
 	if (passCreateResult != VK_SUCCESS)
 	{
-		Log::fatal("Couldn't create render pass");
+		Log::fatal("Couldn't create swapchain render pass");
 	}
+
+	return renderPass;
+}
+
+static void createRenderPass(EngineContext& context)
+{
+	// only load ops and layouts differ, so the passes are compatible and share pipelines and framebuffers
+	context.renderPass = createSceneRenderPass(context, false);
+	context.resumeRenderPass = createSceneRenderPass(context, true);
+	context.swapchainRenderPass = createSwapchainRenderPass(context);
 }
 
 static void createFramebuffers(EngineContext& context)
 {
+	VkImageView sceneAttachments[] = { context.sceneColor.view, context.depthImage.view };
+
+	VkFramebufferCreateInfo sceneFramebufferInfo = {};
+	sceneFramebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	sceneFramebufferInfo.renderPass = context.renderPass;
+	sceneFramebufferInfo.attachmentCount = ARRAY_SIZE(sceneAttachments);
+	sceneFramebufferInfo.pAttachments = sceneAttachments;
+	sceneFramebufferInfo.width = context.swapchainExtent.width;
+	sceneFramebufferInfo.height = context.swapchainExtent.height;
+	sceneFramebufferInfo.layers = 1;
+
+	VkResult sceneCreateResult = vkCreateFramebuffer(context.device, &sceneFramebufferInfo, nullptr, &context.sceneFramebuffer);
+	if (sceneCreateResult != VK_SUCCESS)
+	{
+		Log::fatal("Cannot create scene framebuffer");
+	}
+
 	context.swapchainFramebuffers.resize(context.swapchainImageViews.size());
 
 	for (int i = 0; i < context.swapchainImageViews.size(); ++i)
 	{
 		VkFramebufferCreateInfo framebufferInfo = {};
 		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferInfo.renderPass = context.renderPass;
+		framebufferInfo.renderPass = context.swapchainRenderPass;
 		framebufferInfo.attachmentCount = 1;
 		framebufferInfo.pAttachments = &context.swapchainImageViews[i];
 		framebufferInfo.width = context.swapchainExtent.width;
@@ -936,12 +1284,10 @@ static void createFramebuffers(EngineContext& context)
 
 static void createCommandPool(EngineContext& context)
 {
-	QueueFamilyIndices indices = findQueueFamilies(context.physicalDevice, context.surface);
-
 	VkCommandPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-	poolInfo.queueFamilyIndex = indices.graphicsFamily.value();
+	poolInfo.queueFamilyIndex = context.graphicsQueueFamily;
 
 	VkResult poolCreateResult = vkCreateCommandPool(context.device, &poolInfo, nullptr, &context.commandPool);
 	if (poolCreateResult != VK_SUCCESS)
@@ -950,6 +1296,29 @@ static void createCommandPool(EngineContext& context)
 	}
 }
 
+static void createDescriptorPool(EngineContext& context)
+{
+	VkDescriptorPoolSize poolSizes[] =
+	{
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 64 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 256 },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 64 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 64 },
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 128;
+	poolInfo.poolSizeCount = ARRAY_SIZE(poolSizes);
+	poolInfo.pPoolSizes = poolSizes;
+
+	VkResult poolCreateResult = vkCreateDescriptorPool(context.device, &poolInfo, nullptr, &context.descriptorPool);
+	if (poolCreateResult != VK_SUCCESS)
+	{
+		Log::fatal("Cannot create descriptor pool");
+	}
+}
+
 static void createCommandBuffer(EngineContext& context)
 {
 	VkCommandBufferAllocateInfo bufferAllocationInfo = {};
@@ -965,6 +1334,20 @@ static void createCommandBuffer(EngineContext& context)
 	}
 }
 
+static void setViewportAndScissor(VkCommandBuffer commandBuffer, VkExtent2D extent)
+{
+	VkViewport viewport = {};
+	viewport.width = static_cast<float>(extent.width);
+	viewport.height = static_cast<float>(extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+	VkRect2D scissor = {};
+	scissor.extent = extent;
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+}
+
 static void recordCommandBuffer(EngineContext& context, VkCommandBuffer commandBuffer, uint32_t imageIndex)
 {
 	VkCommandBufferBeginInfo beginInfo = {};
@@ -976,37 +1359,71 @@ static void recordCommandBuffer(EngineContext& context, VkCommandBuffer commandB
 		Log::fatal("Cannot begin command buffer");
 	}
 
-	VkRenderPassBeginInfo renderPassInfo = {};
-	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-	renderPassInfo.renderPass = context.renderPass;
-	renderPassInfo.framebuffer = context.swapchainFramebuffers[imageIndex];
-	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = context.swapchainExtent;
+	beginGpuFrameTiming(context, commandBuffer);
+	beginDebugGpuPasses(context, commandBuffer);
+	resetClusteredShadingTimer(context, commandBuffer);
+
+	sortRenderCommands(context);
+	cullMeshletSampleEarly(context, commandBuffer);
+	markDebugGpuPass(context, commandBuffer, "early cull");
+	recordShadowMaps(context, commandBuffer);
+	markDebugGpuPass(context, commandBuffer, "shadows");
 
 	VkClearValue clearColor = {};
 	clearColor.color.float32[3] = 1.0f; // alpha 1
 
-	renderPassInfo.clearValueCount = 1;
-	renderPassInfo.pClearValues = &clearColor;
+	beginSceneRendering(context, commandBuffer, clearColor);
+	setViewportAndScissor(commandBuffer, context.renderExtent);
 
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	markClusteredShading(context, commandBuffer, false);
+	executeRenderCommands(context, commandBuffer, DrawPass_Background, DrawPass_Background);
+	markClusteredShading(context, commandBuffer, true);
+	executeRenderCommands(context, commandBuffer, DrawPass_Opaque, DrawPass_Opaque);
 
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, context.pipeline);
+	// occlusion culling re-tests what the previous frame's depth rejected against the depth drawn so far,
+	// and the pyramid built at the end of the frame is what the next frame's early culling tests against
+	if (context.depthPyramid)
+	{
+		suspendSceneRendering(context, commandBuffer);
+		buildDepthPyramid(context, commandBuffer);
+		cullMeshletSampleLate(context, commandBuffer);
+		resumeSceneRendering(context, commandBuffer);
+	}
 
-	VkViewport viewport = {};
-	viewport.width = static_cast<float>(context.swapchainExtent.width);
-	viewport.height = static_cast<float>(context.swapchainExtent.height);
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	executeRenderCommands(context, commandBuffer, DrawPass_OpaqueLate, DrawPass_Additive);
 
-	VkRect2D scissor = {};
-	scissor.extent = context.swapchainExtent;
-	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+	endSceneRendering(context, commandBuffer);
+	markDebugGpuPass(context, commandBuffer, "scene");
+
+	if (context.depthPyramid)
+	{
+		buildDepthPyramid(context, commandBuffer);
+		markDebugGpuPass(context, commandBuffer, "depth pyramid");
+	}
+
+	if (context.postProcess)
+	{
+		recordPostProcess(context, commandBuffer);
+		markDebugGpuPass(context, commandBuffer, "post process");
+	}
+
+	beginSwapchainRendering(context, commandBuffer, imageIndex);
+	setViewportAndScissor(commandBuffer, context.swapchainExtent);
+	if (context.postProcess)
+	{
+		recordTonemap(context, commandBuffer);
+	}
+	else
+	{
+		recordUpscale(context, commandBuffer);
+	}
+	recordDebugDraw(context, commandBuffer);
+	endSwapchainRendering(context, commandBuffer, imageIndex);
+	markDebugGpuPass(context, commandBuffer, "swapchain");
 
-	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	endGpuFrameTiming(context, commandBuffer);
 
-	vkCmdEndRenderPass(commandBuffer);
+	recordFrameCapture(context, commandBuffer, imageIndex);
 
 	result = vkEndCommandBuffer(commandBuffer);
 	if (result != VK_SUCCESS)
@@ -1015,6 +1432,36 @@ static void recordCommandBuffer(EngineContext& context, VkCommandBuffer commandB
 	}
 }
 
+static void emitFrameDrawPackets(EngineContext& context)
+{
+	// a replay has no simulation, it draws the recorded snapshots
+	SimulationSnapshot snapshot = isTraceReplay(context) ? getReplaySnapshot(context) : getInterpolatedSnapshot(context);
+	traceSnapshot(context, snapshot);
+
+	TrianglePushConstants pushConstants = {};
+	pushConstants.offset[0] = snapshot.position[0];
+	pushConstants.offset[1] = snapshot.position[1];
+	pushConstants.rotation = snapshot.rotation;
+
+	DrawPacket packet = {};
+	packet.pipeline = getShaderVariant(context, TriangleProgram, context.shaderFeatures, makeTrianglePipelineDesc(context));
+	packet.pipelineLayout = context.pipelineLayout;
+	packet.sortKey = makeDrawSortKey(DrawPass_Opaque, packet.pipeline, 0, 0.0f);
+	packet.vertexCount = 3;
+	packet.instanceCount = 1;
+	packet.pushConstantStages = VK_SHADER_STAGE_VERTEX_BIT;
+	packet.pushConstantSize = sizeof(pushConstants);
+	memcpy(packet.pushConstants, &pushConstants, sizeof(pushConstants));
+
+	emitDrawPacket(context, packet);
+
+	emitParticleSample(context);
+	emitClusteredLighting(context);
+	emitLodSample(context);
+	emitMeshletSample(context);
+	emitSkinningSample(context);
+}
+
 static void createSyncObjects(EngineContext& context)
 {
 	VkSemaphoreCreateInfo semaphoreInfo = {};
@@ -1049,25 +1496,63 @@ static void createSyncObjects(EngineContext& context)
 
 static void drawFrame(EngineContext& context) 
 {
+	double fenceWaitStart = getEngineTime();
 	vkWaitForFences(context.device, 1, &context.inFlightFences[context.currentFrame], VK_TRUE, UINT64_MAX);
+	context.frameTime = getEngineTime();
+	double fenceWaitSeconds = context.frameTime - fenceWaitStart;
 	vkResetFences(context.device, 1, &context.inFlightFences[context.currentFrame]);
-
-	uint32_t imageIndex = 0;
-	vkAcquireNextImageKHR(context.device, context.swapchain, UINT64_MAX, context.imageAvailableSemaphores[context.currentFrame], VK_NULL_HANDLE, &imageIndex);
+	recordTelemetryFrame(context, fenceWaitSeconds);
+
+	processDeferredDestroys(context);
+	collectFrameCapture(context);
+	applyShaderHotReload(context);
+	updateDynamicResolution(context);
+	beginTraceFrame(context);
+	updateSceneCamera(context);
+	updateDebugOverlay(context);
+
+	VkCommandBuffer computeCommandBuffer = beginComputePass(context);
+	simulateParticleSample(context, computeCommandBuffer);
+	cullClusteredLights(context, computeCommandBuffer);
+	skinSkinningSample(context, computeCommandBuffer);
+	submitComputePass(context, computeCommandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	// headless frames have no image to acquire, each frame in flight has its own
+	uint32_t imageIndex = context.currentFrame;
+	if (!context.headless)
+	{
+		vkAcquireNextImageKHR(context.device, context.swapchain, UINT64_MAX, context.imageAvailableSemaphores[context.currentFrame], VK_NULL_HANDLE, &imageIndex);
+	}
 
 	vkResetCommandBuffer(context.commandBuffers[context.currentFrame], 0);
 
+	emitFrameDrawPackets(context);
+	updateShadowMaps(context);
 	recordCommandBuffer(context, context.commandBuffers[context.currentFrame], imageIndex);
 
-	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	VkSemaphore waitSemaphores[2];
+	VkPipelineStageFlags waitStages[2];
+	uint32_t numWaitSemaphores = 0;
+	if (!context.headless)
+	{
+		waitSemaphores[numWaitSemaphores] = context.imageAvailableSemaphores[context.currentFrame];
+		waitStages[numWaitSemaphores++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	}
+	if (context.computeWaitStage)
+	{
+		waitSemaphores[numWaitSemaphores] = context.computeFinishedSemaphores[context.currentFrame];
+		waitStages[numWaitSemaphores++] = context.computeWaitStage;
+	}
+
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = &context.imageAvailableSemaphores[context.currentFrame];
-	submitInfo.pWaitDstStageMask = &waitStage;
+	submitInfo.waitSemaphoreCount = numWaitSemaphores;
+	submitInfo.pWaitSemaphores = waitSemaphores;
+	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &context.commandBuffers[context.currentFrame];
-	submitInfo.signalSemaphoreCount = 1;
+	// nothing is presented headless, so nothing waits for the frame but its fence
+	submitInfo.signalSemaphoreCount = context.headless ? 0 : 1;
 	submitInfo.pSignalSemaphores = &context.renderFinishedSemaphores[context.currentFrame];
 
 	VkResult submitResult = vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, context.inFlightFences[context.currentFrame]);
@@ -1075,15 +1560,28 @@ static void drawFrame(EngineContext& context)
 	{
 		Log::fatal("Couldn't submit commandlist");
 	}
+	countTelemetryEvent(context, TelemetryCounter_GraphicsSubmits);
+	endTraceFrame(context);
+	context.computeWaitStage = 0;
+
+	if (!context.headless)
+	{
+		VkPresentInfoKHR presentInfo = {};
+		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.swapchainCount = 1;
+		presentInfo.pSwapchains = &context.swapchain;
+		presentInfo.pImageIndices = &imageIndex;
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores = &context.renderFinishedSemaphores[context.currentFrame];
+		VkResult presentResult = vkQueuePresentKHR(context.presentQueue, &presentInfo);
+		countTelemetryEvent(context, TelemetryCounter_Presents);
+	}
 
-	VkPresentInfoKHR presentInfo = {};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = &context.swapchain;
-	presentInfo.pImageIndices = &imageIndex;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = &context.renderFinishedSemaphores[context.currentFrame];
-	VkResult presentResult = vkQueuePresentKHR(context.presentQueue, &presentInfo);
+	if (context.frameNumber == 0)
+	{
+		finishStartupTimings(context);
+	}
 
 	context.currentFrame = (context.currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	++context.frameNumber;
 }
@@ -1 +1,8 @@
-#include "EngineContext.h"
\ No newline at end of file
+#include "EngineContext.h"
+
+#include <EASTL/algorithm.h>
+
+bool hasDeviceExtension(const EngineContext& context, StringId name)
+{
+	return eastl::binary_search(context.deviceExtensionIds.begin(), context.deviceExtensionIds.end(), name);
+}
@@ -0,0 +1,397 @@
+#include "FrameCapture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <condition_variable>
+#include <mutex>
+
+#include <EASTL/string.h>
+#include <EASTL/vector.h>
+
+#include "EngineContext.h"
+#include "GpuMemory.h"
+#include "ImageWriter.h"
+#include "JobSystem.h"
+#include "Log.h"
+
+// encoding more frames than this behind the renderer means the encoders can't keep up
+static const uint32_t MaxPendingEncodes = 16;
+
+static const uint64_t FnvOffsetBasis = 14695981039346656037ull;
+static const uint64_t FnvPrime = 1099511628211ull;
+
+enum CaptureMode
+{
+	CaptureMode_Png,
+	CaptureMode_Raw,
+	CaptureMode_Stdout,
+	CaptureMode_Hash,
+};
+
+struct CaptureSlot
+{
+	GpuBuffer readback;
+	bool pending;
+	uint64_t frameIndex;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct CapturedFrame
+{
+	FrameCapture* capture;
+	eastl::vector<uint8_t> pixels;
+	uint64_t frameIndex;
+	uint32_t width;
+	uint32_t height;
+};
+
+struct FrameCapture
+{
+	CaptureMode mode;
+	eastl::string directory;
+	bool swizzleBgra;
+
+	CaptureSlot slots[MAX_FRAMES_IN_FLIGHT];
+	uint64_t numCaptured;
+
+	JobCounter encodes;
+
+	// recycled frame allocations
+	std::mutex freeFramesMutex;
+	eastl::vector<CapturedFrame*> freeFrames;
+
+	// frames go to stdout in order even though they are encoded out of order
+	std::mutex stdoutMutex;
+	std::condition_variable stdoutTurn;
+	uint64_t nextStdoutFrame;
+
+	// by frame index, 0 until the frame was hashed
+	std::mutex hashesMutex;
+	eastl::vector<uint64_t> hashes;
+};
+
+bool isFrameCaptureRequested()
+{
+	return getenv("ENGINE_CAPTURE") != nullptr;
+}
+
+static void encodeFrame(void* data)
+{
+	CapturedFrame* frame = static_cast<CapturedFrame*>(data);
+	FrameCapture& capture = *frame->capture;
+
+	if (capture.swizzleBgra)
+	{
+		uint8_t* pixel = frame->pixels.data();
+		uint8_t* end = pixel + frame->pixels.size();
+		for (; pixel < end; pixel += 4)
+		{
+			uint8_t b = pixel[0];
+			pixel[0] = pixel[2];
+			pixel[2] = b;
+		}
+	}
+
+	eastl::string path;
+	switch (capture.mode)
+	{
+	case CaptureMode_Png:
+		path.sprintf("%sframe_%06llu.png", capture.directory.c_str(), static_cast<unsigned long long>(frame->frameIndex));
+		if (!writePng(path.c_str(), frame->pixels.data(), frame->width, frame->height))
+		{
+			Log::error("Couldn't write %s\n", path.c_str());
+		}
+		break;
+	case CaptureMode_Raw:
+	{
+		path.sprintf("%sframe_%06llu.rgba", capture.directory.c_str(), static_cast<unsigned long long>(frame->frameIndex));
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file || !writeRawRgba(file, frame->pixels.data(), frame->width, frame->height))
+		{
+			Log::error("Couldn't write %s\n", path.c_str());
+		}
+		if (file)
+		{
+			fclose(file);
+		}
+		break;
+	}
+	case CaptureMode_Stdout:
+	{
+		std::unique_lock<std::mutex> lock(capture.stdoutMutex);
+		capture.stdoutTurn.wait(lock, [&] { return capture.nextStdoutFrame == frame->frameIndex; });
+
+		writeRawRgba(stdout, frame->pixels.data(), frame->width, frame->height);
+		fflush(stdout);
+
+		++capture.nextStdoutFrame;
+		capture.stdoutTurn.notify_all();
+		break;
+	}
+	case CaptureMode_Hash:
+	{
+		uint64_t hash = FnvOffsetBasis;
+		for (uint8_t byte : frame->pixels)
+		{
+			hash = (hash ^ byte) * FnvPrime;
+		}
+
+		std::lock_guard<std::mutex> lock(capture.hashesMutex);
+		if (capture.hashes.size() <= frame->frameIndex)
+		{
+			capture.hashes.resize(frame->frameIndex + 1, 0);
+		}
+		capture.hashes[frame->frameIndex] = hash;
+		break;
+	}
+	}
+
+	std::lock_guard<std::mutex> lock(capture.freeFramesMutex);
+	capture.freeFrames.push_back(frame);
+}
+
+void createFrameCapture(EngineContext& context)
+{
+	const char* modeName = getenv("ENGINE_CAPTURE");
+	if (!modeName)
+	{
+		return;
+	}
+
+	FrameCapture* capture = new FrameCapture;
+	capture->numCaptured = 0;
+	capture->nextStdoutFrame = 0;
+	capture->encodes.pending = 0;
+
+	if (strcmp(modeName, "png") == 0)
+	{
+		capture->mode = CaptureMode_Png;
+	}
+	else if (strcmp(modeName, "raw") == 0)
+	{
+		capture->mode = CaptureMode_Raw;
+	}
+	else if (strcmp(modeName, "stdout") == 0)
+	{
+		capture->mode = CaptureMode_Stdout;
+		Log::setOutput(stderr);
+	}
+	else if (strcmp(modeName, "hash") == 0)
+	{
+		capture->mode = CaptureMode_Hash;
+	}
+	else
+	{
+		Log::fatal("Unknown ENGINE_CAPTURE mode %s, expected png, raw, stdout or hash\n", modeName);
+	}
+
+	const char* directory = getenv("ENGINE_CAPTURE_DIR");
+	if (directory)
+	{
+		capture->directory = directory;
+		if (!capture->directory.empty() && capture->directory.back() != '/' && capture->directory.back() != '\\')
+		{
+			capture->directory += '/';
+		}
+	}
+
+	switch (context.swapchainFormat)
+	{
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+		capture->swizzleBgra = true;
+		break;
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		capture->swizzleBgra = false;
+		break;
+	default:
+		Log::fatal("Frame capture doesn't support swapchain format %d\n", context.swapchainFormat);
+	}
+
+	// cached memory makes the CPU reads much faster where it's available
+	VkMemoryPropertyFlags readbackProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	const VkPhysicalDeviceMemoryProperties& memoryProperties = context.memoryProperties;
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+	{
+		VkMemoryPropertyFlags cached = readbackProperties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+		if ((memoryProperties.memoryTypes[i].propertyFlags & cached) == cached)
+		{
+			readbackProperties = cached;
+			break;
+		}
+	}
+
+	VkDeviceSize imageSize = static_cast<VkDeviceSize>(context.swapchainExtent.width) * context.swapchainExtent.height * 4;
+	for (CaptureSlot& slot : capture->slots)
+	{
+		createGpuBuffer(context, imageSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, readbackProperties, slot.readback);
+		slot.pending = false;
+	}
+
+	context.frameCapture = capture;
+}
+
+static void encodeSlot(EngineContext& context, FrameCapture& capture, CaptureSlot& slot)
+{
+	if (!slot.pending)
+	{
+		return;
+	}
+
+	// only until a worker finished one, encodes are background jobs so the render thread never runs them
+	waitForCounterBelow(context.jobSystem, &capture.encodes, MaxPendingEncodes);
+
+	CapturedFrame* frame = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(capture.freeFramesMutex);
+		if (!capture.freeFrames.empty())
+		{
+			frame = capture.freeFrames.back();
+			capture.freeFrames.pop_back();
+		}
+	}
+	if (!frame)
+	{
+		frame = new CapturedFrame;
+	}
+
+	size_t size = static_cast<size_t>(slot.width) * slot.height * 4;
+	frame->capture = &capture;
+	frame->frameIndex = slot.frameIndex;
+	frame->width = slot.width;
+	frame->height = slot.height;
+	frame->pixels.resize(size);
+	memcpy(frame->pixels.data(), slot.readback.mapped, size);
+
+	slot.pending = false;
+
+	submitBackgroundJob(context.jobSystem, encodeFrame, frame, &capture.encodes);
+}
+
+void flushFrameCapture(EngineContext& context)
+{
+	FrameCapture* capture = context.frameCapture;
+	if (!capture)
+	{
+		return;
+	}
+
+	// oldest first so stdout gets them in order
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		CaptureSlot& slot = capture->slots[(context.currentFrame + i) % MAX_FRAMES_IN_FLIGHT];
+		encodeSlot(context, *capture, slot);
+	}
+
+	waitForCounter(context.jobSystem, &capture->encodes);
+}
+
+void destroyFrameCapture(EngineContext& context)
+{
+	FrameCapture* capture = context.frameCapture;
+	if (!capture)
+	{
+		return;
+	}
+
+	flushFrameCapture(context);
+
+	for (CaptureSlot& slot : capture->slots)
+	{
+		destroyGpuBuffer(context, slot.readback);
+	}
+
+	for (CapturedFrame* frame : capture->freeFrames)
+	{
+		delete frame;
+	}
+
+	Log::log("Captured %llu frames\n", static_cast<unsigned long long>(capture->numCaptured));
+
+	delete capture;
+	context.frameCapture = nullptr;
+}
+
+void collectFrameCapture(EngineContext& context)
+{
+	FrameCapture* capture = context.frameCapture;
+	if (!capture)
+	{
+		return;
+	}
+
+	encodeSlot(context, *capture, capture->slots[context.currentFrame]);
+}
+
+void recordFrameCapture(EngineContext& context, VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	FrameCapture* capture = context.frameCapture;
+	if (!capture)
+	{
+		return;
+	}
+
+	CaptureSlot& slot = capture->slots[context.currentFrame];
+	VkImage image = context.swapchainImages[imageIndex];
+
+	VkImageMemoryBarrier toTransfer = {};
+	toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	toTransfer.oldLayout = context.presentLayout;
+	toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toTransfer.image = image;
+	toTransfer.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	toTransfer.subresourceRange.levelCount = 1;
+	toTransfer.subresourceRange.layerCount = 1;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+	VkBufferImageCopy region = {};
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.layerCount = 1;
+	region.imageExtent.width = context.swapchainExtent.width;
+	region.imageExtent.height = context.swapchainExtent.height;
+	region.imageExtent.depth = 1;
+	vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.readback.buffer, 1, &region);
+
+	VkImageMemoryBarrier toPresent = toTransfer;
+	toPresent.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	toPresent.dstAccessMask = 0;
+	toPresent.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	toPresent.newLayout = context.presentLayout;
+
+	VkBufferMemoryBarrier toHost = {};
+	toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	toHost.buffer = slot.readback.buffer;
+	toHost.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost, 1, &toPresent);
+
+	slot.pending = true;
+	slot.frameIndex = capture->numCaptured++;
+	slot.width = context.swapchainExtent.width;
+	slot.height = context.swapchainExtent.height;
+}
+
+bool getCapturedFrameHash(EngineContext& context, uint64_t frameIndex, uint64_t& hash)
+{
+	FrameCapture* capture = context.frameCapture;
+	if (!capture || capture->mode != CaptureMode_Hash)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(capture->hashesMutex);
+	hash = frameIndex < capture->hashes.size() ? capture->hashes[frameIndex] : 0;
+	return hash != 0;
+}
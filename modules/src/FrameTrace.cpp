@@ -0,0 +1,804 @@
+#include "FrameTrace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <mutex>
+
+#include <EASTL/algorithm.h>
+#include <EASTL/hash_map.h>
+#include <EASTL/string.h>
+#include <EASTL/vector.h>
+
+#include "Clock.h"
+#include "DynamicResolution.h"
+#include "EngineContext.h"
+#include "FrameCapture.h"
+#include "Log.h"
+#include "RenderCommands.h"
+
+// "ETRC"
+static const uint32_t TraceMagic = 0x43525445;
+static const uint32_t TraceVersion = 1;
+// uploads and pipeline builds before the first frame
+static const uint64_t StartupFrame = ~0ull;
+// see makeDrawSortKey, these bits come from the pipeline handle
+static const uint64_t SortKeyPipelineBits = 0xffffull << 44;
+
+static const uint64_t FnvOffsetBasis = 14695981039346656037ull;
+static const uint64_t FnvPrime = 1099511628211ull;
+
+// The file is a TraceHeader followed by records, each a TraceRecordHeader and size bytes of payload.
+// Everything is written as it happens, so a trace ends at the last complete record.
+enum TraceRecordType : uint32_t
+{
+	// a TraceFrame followed by its TracePackets, written when the frame is submitted
+	TraceRecord_Frame,
+	TraceRecord_Upload,
+	TraceRecord_PipelineBuild,
+};
+
+struct TraceHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t swapchainWidth;
+	uint32_t swapchainHeight;
+	uint32_t swapchainFormat;
+	uint32_t maxFramesInFlight;
+};
+
+struct TraceRecordHeader
+{
+	uint32_t type;
+	uint32_t size;
+};
+
+struct TraceFrame
+{
+	uint64_t frameNumber;
+	double time;
+	SimulationSnapshot snapshot;
+	uint32_t renderWidth;
+	uint32_t renderHeight;
+	uint32_t shaderFeatures;
+	uint32_t numPackets;
+};
+
+enum TracePacketFlags : uint32_t
+{
+	TracePacket_DescriptorSet = 1 << 0,
+	TracePacket_IndirectBuffer = 1 << 1,
+};
+
+// A DrawPacket without handles. Zeroed before it's filled, so packets compare and hash as bytes.
+struct TracePacket
+{
+	uint64_t sortKey;
+	// hashPipelineDescContents of the pipeline's description, 0 for pipelines the trace didn't see built
+	uint64_t pipelineId;
+	uint64_t indirectOffset;
+	uint32_t flags;
+	uint32_t drawType;
+	uint32_t vertexCount;
+	uint32_t instanceCount;
+	uint32_t firstVertex;
+	uint32_t firstInstance;
+	uint32_t pushConstantStages;
+	uint32_t pushConstantSize;
+	uint8_t pushConstants[MaxDrawPushConstantSize];
+};
+
+struct TraceUpload
+{
+	uint64_t frameNumber;
+	uint64_t size;
+	uint64_t hash;
+};
+
+struct TracePipelineBuild
+{
+	uint64_t frameNumber;
+	uint64_t pipelineId;
+};
+
+struct ReplayFrame
+{
+	TraceFrame frame;
+	uint32_t firstPacket;
+	uint32_t numUploads;
+	uint32_t numPipelineBuilds;
+};
+
+struct ReplayResult
+{
+	float cpuMilliseconds;
+	// negative when the frame wasn't timed
+	float gpuMilliseconds;
+	uint32_t numPackets;
+	bool matches;
+	uint32_t numUploads;
+	uint32_t numPipelineBuilds;
+};
+
+struct FrameTrace
+{
+	bool replaying;
+
+	// guards the file and everything below it that other threads touch
+	std::mutex mutex;
+	// pipeline handle to hashPipelineDescContents, in both modes
+	eastl::hash_map<uint64_t, uint64_t> pipelineIds;
+	uint64_t currentFrame;
+
+	// recording
+	FILE* file;
+	eastl::string path;
+	TraceFrame pendingFrame;
+	uint64_t numRecordedFrames;
+
+	// replaying
+	TraceHeader header;
+	eastl::vector<ReplayFrame> frames;
+	eastl::vector<TracePacket> packets;
+	uint32_t numStartupUploads;
+	uint32_t numStartupPipelineBuilds;
+	eastl::string reportPath;
+	eastl::string referencePath;
+	uint32_t nextFrame;
+	double cpuStartTime;
+	eastl::vector<ReplayResult> results;
+	uint32_t numReplayStartupUploads;
+	uint32_t numReplayStartupPipelineBuilds;
+
+	// render thread scratch
+	eastl::vector<TracePacket> framePackets;
+	eastl::vector<uint64_t> recordedHashes;
+	eastl::vector<uint64_t> replayedHashes;
+};
+
+static uint64_t hashBytes(const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = FnvOffsetBasis;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * FnvPrime;
+	}
+	return hash;
+}
+
+static FrameTrace* newFrameTrace()
+{
+	FrameTrace* trace = new FrameTrace;
+	trace->replaying = false;
+	trace->currentFrame = StartupFrame;
+	trace->file = nullptr;
+	trace->pendingFrame = {};
+	trace->numRecordedFrames = 0;
+	trace->header = {};
+	trace->numStartupUploads = 0;
+	trace->numStartupPipelineBuilds = 0;
+	trace->nextFrame = 0;
+	trace->cpuStartTime = 0.0;
+	trace->numReplayStartupUploads = 0;
+	trace->numReplayStartupPipelineBuilds = 0;
+	return trace;
+}
+
+static void writeRecord(FrameTrace& trace, TraceRecordType type, const void* payload, uint32_t size)
+{
+	TraceRecordHeader header = {};
+	header.type = type;
+	header.size = size;
+	fwrite(&header, sizeof(header), 1, trace.file);
+	fwrite(payload, size, 1, trace.file);
+}
+
+static bool readFile(const char* path, eastl::vector<uint8_t>& data)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file)
+	{
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	long length = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	data.resize(length > 0 ? length : 0);
+	bool succeeded = length >= 0 && fread(data.data(), 1, data.size(), file) == data.size();
+	fclose(file);
+	return succeeded;
+}
+
+// Counts towards the frame that's being built, or startup before the first one
+static ReplayResult* getCurrentResult(FrameTrace& trace)
+{
+	if (trace.currentFrame == StartupFrame || trace.currentFrame >= trace.results.size())
+	{
+		return nullptr;
+	}
+	return &trace.results[trace.currentFrame];
+}
+
+void openTraceReplay(EngineContext& context, const char* tracePath, const char* reportPath, const char* referencePath)
+{
+	eastl::vector<uint8_t> data;
+	if (!readFile(tracePath, data))
+	{
+		Log::fatal("Couldn't read trace %s\n", tracePath);
+	}
+
+	FrameTrace* trace = newFrameTrace();
+	trace->replaying = true;
+	trace->reportPath = reportPath ? reportPath : "";
+	trace->referencePath = referencePath ? referencePath : "";
+
+	if (data.size() < sizeof(TraceHeader))
+	{
+		Log::fatal("%s is not a trace\n", tracePath);
+	}
+	memcpy(&trace->header, data.data(), sizeof(TraceHeader));
+	if (trace->header.magic != TraceMagic || trace->header.version != TraceVersion)
+	{
+		Log::fatal("%s is not a version %u trace\n", tracePath, TraceVersion);
+	}
+
+	// uploads and pipeline builds come before the record of their frame
+	eastl::vector<uint64_t> uploadFrames;
+	eastl::vector<uint64_t> pipelineBuildFrames;
+
+	size_t offset = sizeof(TraceHeader);
+	while (offset + sizeof(TraceRecordHeader) <= data.size())
+	{
+		TraceRecordHeader record;
+		memcpy(&record, data.data() + offset, sizeof(record));
+		offset += sizeof(record);
+		if (offset + record.size > data.size())
+		{
+			// the recording didn't shut down, the last record is cut off
+			break;
+		}
+		const uint8_t* payload = data.data() + offset;
+		offset += record.size;
+
+		uint32_t minSize = record.type == TraceRecord_Frame ? sizeof(TraceFrame) : (record.type == TraceRecord_Upload ? sizeof(TraceUpload) : sizeof(TracePipelineBuild));
+		if (record.size < minSize)
+		{
+			Log::fatal("Record %u bytes into %s is too small\n", static_cast<uint32_t>(offset - record.size), tracePath);
+		}
+
+		switch (record.type)
+		{
+		case TraceRecord_Frame:
+		{
+			ReplayFrame frame = {};
+			memcpy(&frame.frame, payload, sizeof(TraceFrame));
+			if (frame.frame.frameNumber != trace->frames.size() || record.size != sizeof(TraceFrame) + frame.frame.numPackets * sizeof(TracePacket))
+			{
+				Log::fatal("Frame record %u of %s is broken\n", static_cast<uint32_t>(trace->frames.size()), tracePath);
+			}
+
+			frame.firstPacket = static_cast<uint32_t>(trace->packets.size());
+			const TracePacket* packets = reinterpret_cast<const TracePacket*>(payload + sizeof(TraceFrame));
+			trace->packets.insert(trace->packets.end(), packets, packets + frame.frame.numPackets);
+			trace->frames.push_back(frame);
+			break;
+		}
+		case TraceRecord_Upload:
+		{
+			TraceUpload upload;
+			memcpy(&upload, payload, sizeof(upload));
+			uploadFrames.push_back(upload.frameNumber);
+			break;
+		}
+		case TraceRecord_PipelineBuild:
+		{
+			TracePipelineBuild build;
+			memcpy(&build, payload, sizeof(build));
+			pipelineBuildFrames.push_back(build.frameNumber);
+			break;
+		}
+		default:
+			Log::fatal("Unknown record type %u in %s\n", record.type, tracePath);
+		}
+	}
+
+	// those of a frame that was cut off are dropped with it
+	for (uint64_t frameNumber : uploadFrames)
+	{
+		if (frameNumber == StartupFrame)
+		{
+			++trace->numStartupUploads;
+		}
+		else if (frameNumber < trace->frames.size())
+		{
+			++trace->frames[frameNumber].numUploads;
+		}
+	}
+	for (uint64_t frameNumber : pipelineBuildFrames)
+	{
+		if (frameNumber == StartupFrame)
+		{
+			++trace->numStartupPipelineBuilds;
+		}
+		else if (frameNumber < trace->frames.size())
+		{
+			++trace->frames[frameNumber].numPipelineBuilds;
+		}
+	}
+
+	ReplayResult notReplayed = {};
+	notReplayed.gpuMilliseconds = -1.0f;
+	trace->results.resize(trace->frames.size(), notReplayed);
+
+	Log::log("Replaying %u frames from %s\n", static_cast<uint32_t>(trace->frames.size()), tracePath);
+	context.frameTrace = trace;
+}
+
+bool isTraceReplay(const EngineContext& context)
+{
+	return context.frameTrace && context.frameTrace->replaying;
+}
+
+bool isTraceReplayFinished(const EngineContext& context)
+{
+	return isTraceReplay(context) && context.frameTrace->nextFrame >= context.frameTrace->frames.size();
+}
+
+void getTraceSwapchain(const EngineContext& context, VkFormat& format, VkExtent2D& extent)
+{
+	const TraceHeader& header = context.frameTrace->header;
+	format = static_cast<VkFormat>(header.swapchainFormat);
+	extent.width = header.swapchainWidth;
+	extent.height = header.swapchainHeight;
+}
+
+void createFrameTrace(EngineContext& context)
+{
+	FrameTrace* replay = context.frameTrace;
+	if (replay)
+	{
+		const TraceHeader& header = replay->header;
+		if (header.swapchainWidth != context.swapchainExtent.width || header.swapchainHeight != context.swapchainExtent.height ||
+			header.swapchainFormat != static_cast<uint32_t>(context.swapchainFormat))
+		{
+			Log::warning("The trace was recorded at %ux%u in format %u and is replayed at %ux%u in format %u, its images won't match\n",
+				header.swapchainWidth, header.swapchainHeight, header.swapchainFormat,
+				context.swapchainExtent.width, context.swapchainExtent.height, static_cast<uint32_t>(context.swapchainFormat));
+		}
+		if (header.maxFramesInFlight != MAX_FRAMES_IN_FLIGHT)
+		{
+			Log::warning("The trace was recorded with %u frames in flight, replaying with %u\n", header.maxFramesInFlight, MAX_FRAMES_IN_FLIGHT);
+		}
+		return;
+	}
+
+	const char* path = getenv("ENGINE_TRACE");
+	if (!path || !*path)
+	{
+		return;
+	}
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		Log::error("Couldn't open %s, not recording a trace\n", path);
+		return;
+	}
+
+	FrameTrace* trace = newFrameTrace();
+	trace->file = file;
+	trace->path = path;
+
+	TraceHeader header = {};
+	header.magic = TraceMagic;
+	header.version = TraceVersion;
+	header.swapchainWidth = context.swapchainExtent.width;
+	header.swapchainHeight = context.swapchainExtent.height;
+	header.swapchainFormat = context.swapchainFormat;
+	header.maxFramesInFlight = MAX_FRAMES_IN_FLIGHT;
+	fwrite(&header, sizeof(header), 1, file);
+
+	Log::log("Recording a trace to %s\n", path);
+	context.frameTrace = trace;
+}
+
+void destroyFrameTrace(EngineContext& context)
+{
+	FrameTrace* trace = context.frameTrace;
+	if (!trace)
+	{
+		return;
+	}
+
+	if (trace->file)
+	{
+		fclose(trace->file);
+		Log::log("Recorded %llu frames to %s\n", static_cast<unsigned long long>(trace->numRecordedFrames), trace->path.c_str());
+	}
+
+	delete trace;
+	context.frameTrace = nullptr;
+}
+
+void traceUpload(EngineContext& context, const void* data, VkDeviceSize size)
+{
+	FrameTrace* trace = context.frameTrace;
+	if (!trace)
+	{
+		return;
+	}
+
+	if (trace->replaying)
+	{
+		std::lock_guard<std::mutex> lock(trace->mutex);
+		ReplayResult* result = getCurrentResult(*trace);
+		if (result)
+		{
+			++result->numUploads;
+		}
+		else
+		{
+			++trace->numReplayStartupUploads;
+		}
+		return;
+	}
+
+	// hashed outside the lock, uploads can be large
+	TraceUpload upload = {};
+	upload.size = size;
+	upload.hash = hashBytes(data, static_cast<size_t>(size));
+
+	std::lock_guard<std::mutex> lock(trace->mutex);
+	upload.frameNumber = trace->currentFrame;
+	writeRecord(*trace, TraceRecord_Upload, &upload, sizeof(upload));
+}
+
+void tracePipelineBuild(EngineContext& context, const PipelineDesc& desc, VkPipeline pipeline)
+{
+	FrameTrace* trace = context.frameTrace;
+	if (!trace)
+	{
+		return;
+	}
+
+	uint64_t pipelineId = hashPipelineDescContents(desc);
+
+	std::lock_guard<std::mutex> lock(trace->mutex);
+	trace->pipelineIds[(uint64_t)(pipeline)] = pipelineId;
+
+	if (trace->replaying)
+	{
+		ReplayResult* result = getCurrentResult(*trace);
+		if (result)
+		{
+			++result->numPipelineBuilds;
+		}
+		else
+		{
+			++trace->numReplayStartupPipelineBuilds;
+		}
+		return;
+	}
+
+	TracePipelineBuild build = {};
+	build.frameNumber = trace->currentFrame;
+	build.pipelineId = pipelineId;
+	writeRecord(*trace, TraceRecord_PipelineBuild, &build, sizeof(build));
+}
+
+void beginTraceFrame(EngineContext& context)
+{
+	FrameTrace* trace = context.frameTrace;
+	if (!trace)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(trace->mutex);
+		trace->currentFrame = context.frameNumber;
+	}
+
+	if (!trace->replaying)
+	{
+		TraceFrame& frame = trace->pendingFrame;
+		memset(&frame, 0, sizeof(frame));
+		frame.frameNumber = context.frameNumber;
+		frame.time = context.frameTime;
+		frame.renderWidth = context.renderExtent.width;
+		frame.renderHeight = context.renderExtent.height;
+		frame.shaderFeatures = context.shaderFeatures;
+		return;
+	}
+
+	// the slot's timestamps were written by the frame that used it last
+	float gpuMilliseconds = getGpuFrameMilliseconds(context);
+	if (gpuMilliseconds >= 0.0f && trace->nextFrame >= MAX_FRAMES_IN_FLIGHT)
+	{
+		trace->results[trace->nextFrame - MAX_FRAMES_IN_FLIGHT].gpuMilliseconds = gpuMilliseconds;
+	}
+
+	// context.frameTime still comes from the clock here
+	trace->cpuStartTime = context.frameTime;
+
+	const TraceFrame& frame = trace->frames[trace->nextFrame].frame;
+	context.frameTime = frame.time;
+	context.renderExtent.width = eastl::min(frame.renderWidth, context.swapchainExtent.width);
+	context.renderExtent.height = eastl::min(frame.renderHeight, context.swapchainExtent.height);
+	context.shaderFeatures = frame.shaderFeatures;
+}
+
+SimulationSnapshot getReplaySnapshot(EngineContext& context)
+{
+	FrameTrace& trace = *context.frameTrace;
+	return trace.frames[trace.nextFrame].frame.snapshot;
+}
+
+void traceSnapshot(EngineContext& context, const SimulationSnapshot& snapshot)
+{
+	FrameTrace* trace = context.frameTrace;
+	if (trace && !trace->replaying)
+	{
+		trace->pendingFrame.snapshot = snapshot;
+	}
+}
+
+static void makeTracePacket(FrameTrace& trace, const DrawPacket& packet, TracePacket& tracePacket)
+{
+	memset(&tracePacket, 0, sizeof(tracePacket));
+
+	auto found = trace.pipelineIds.find((uint64_t)(packet.pipeline));
+	tracePacket.sortKey = packet.sortKey & ~SortKeyPipelineBits;
+	tracePacket.pipelineId = found != trace.pipelineIds.end() ? found->second : 0;
+	tracePacket.indirectOffset = packet.indirectOffset;
+	tracePacket.flags = (packet.descriptorSet != VK_NULL_HANDLE ? TracePacket_DescriptorSet : 0) |
+		(packet.indirectBuffer != VK_NULL_HANDLE ? TracePacket_IndirectBuffer : 0);
+	tracePacket.drawType = packet.drawType;
+	tracePacket.vertexCount = packet.vertexCount;
+	tracePacket.instanceCount = packet.instanceCount;
+	tracePacket.firstVertex = packet.firstVertex;
+	tracePacket.firstInstance = packet.firstInstance;
+	tracePacket.pushConstantStages = packet.pushConstantStages;
+	tracePacket.pushConstantSize = eastl::min(packet.pushConstantSize, MaxDrawPushConstantSize);
+	memcpy(tracePacket.pushConstants, packet.pushConstants, tracePacket.pushConstantSize);
+}
+
+// Packets are gathered from per-thread buffers in no fixed order, so they're compared as sorted hashes
+static bool matchesRecording(FrameTrace& trace, const ReplayFrame& recorded)
+{
+	trace.recordedHashes.clear();
+	for (uint32_t i = 0; i < recorded.frame.numPackets; ++i)
+	{
+		trace.recordedHashes.push_back(hashBytes(&trace.packets[recorded.firstPacket + i], sizeof(TracePacket)));
+	}
+
+	trace.replayedHashes.clear();
+	for (const TracePacket& packet : trace.framePackets)
+	{
+		trace.replayedHashes.push_back(hashBytes(&packet, sizeof(TracePacket)));
+	}
+
+	eastl::sort(trace.recordedHashes.begin(), trace.recordedHashes.end());
+	eastl::sort(trace.replayedHashes.begin(), trace.replayedHashes.end());
+	return trace.recordedHashes == trace.replayedHashes;
+}
+
+void endTraceFrame(EngineContext& context)
+{
+	FrameTrace* trace = context.frameTrace;
+	if (!trace)
+	{
+		return;
+	}
+
+	uint32_t numPackets = 0;
+	const DrawPacket* packets = getGatheredDrawPackets(context, numPackets);
+	trace->framePackets.resize(numPackets);
+
+	std::lock_guard<std::mutex> lock(trace->mutex);
+	for (uint32_t i = 0; i < numPackets; ++i)
+	{
+		makeTracePacket(*trace, packets[i], trace->framePackets[i]);
+	}
+
+	if (!trace->replaying)
+	{
+		trace->pendingFrame.numPackets = numPackets;
+
+		TraceRecordHeader header = {};
+		header.type = TraceRecord_Frame;
+		header.size = static_cast<uint32_t>(sizeof(TraceFrame) + numPackets * sizeof(TracePacket));
+		fwrite(&header, sizeof(header), 1, trace->file);
+		fwrite(&trace->pendingFrame, sizeof(TraceFrame), 1, trace->file);
+		fwrite(trace->framePackets.data(), sizeof(TracePacket), numPackets, trace->file);
+
+		++trace->numRecordedFrames;
+		return;
+	}
+
+	ReplayResult& result = trace->results[trace->nextFrame];
+	result.cpuMilliseconds = static_cast<float>((getEngineTime() - trace->cpuStartTime) * 1000.0);
+	result.numPackets = numPackets;
+	result.matches = matchesRecording(*trace, trace->frames[trace->nextFrame]);
+
+	++trace->nextFrame;
+}
+
+static void writeReport(FrameTrace& trace, const eastl::vector<uint64_t>& imageHashes)
+{
+	FILE* file = fopen(trace.reportPath.c_str(), "w");
+	if (!file)
+	{
+		Log::error("Couldn't write the replay report %s\n", trace.reportPath.c_str());
+		return;
+	}
+
+	// empty columns weren't measured
+	fprintf(file, "frame,cpu_ms,gpu_ms,draws,matches_recording,uploads,pipeline_builds,image_hash\n");
+	for (uint32_t i = 0; i < trace.nextFrame; ++i)
+	{
+		const ReplayResult& result = trace.results[i];
+		fprintf(file, "%u,%.4f,", i, result.cpuMilliseconds);
+		if (result.gpuMilliseconds >= 0.0f)
+		{
+			fprintf(file, "%.4f", result.gpuMilliseconds);
+		}
+		fprintf(file, ",%u,%d,%u,%u,", result.numPackets, result.matches ? 1 : 0, result.numUploads, result.numPipelineBuilds);
+		if (imageHashes[i])
+		{
+			fprintf(file, "%016llx", static_cast<unsigned long long>(imageHashes[i]));
+		}
+		fprintf(file, "\n");
+	}
+
+	fclose(file);
+	Log::log("Wrote the replay report to %s\n", trace.reportPath.c_str());
+}
+
+// The image hash is the last column of each line of the other report
+static bool compareWithReference(FrameTrace& trace, const eastl::vector<uint64_t>& imageHashes)
+{
+	eastl::vector<uint8_t> data;
+	if (!readFile(trace.referencePath.c_str(), data))
+	{
+		Log::error("Couldn't read the reference report %s\n", trace.referencePath.c_str());
+		return false;
+	}
+	data.push_back(0);
+
+	uint32_t numCompared = 0;
+	uint32_t numDifferent = 0;
+	uint64_t firstDifferent = 0;
+
+	// the first line is the header
+	const char* line = reinterpret_cast<const char*>(data.data());
+	const char* next = strchr(line, '\n');
+	while (next && next[1])
+	{
+		line = next + 1;
+		next = strchr(line, '\n');
+		const char* end = next ? next : line + strlen(line);
+
+		const char* lastComma = nullptr;
+		for (const char* c = line; c < end; ++c)
+		{
+			if (*c == ',')
+			{
+				lastComma = c;
+			}
+		}
+		if (!lastComma)
+		{
+			continue;
+		}
+
+		uint64_t frame = strtoull(line, nullptr, 10);
+		uint64_t referenceHash = strtoull(lastComma + 1, nullptr, 16);
+		if (referenceHash == 0 || frame >= imageHashes.size() || imageHashes[frame] == 0)
+		{
+			continue;
+		}
+
+		++numCompared;
+		if (imageHashes[frame] != referenceHash)
+		{
+			firstDifferent = numDifferent == 0 ? frame : firstDifferent;
+			++numDifferent;
+		}
+	}
+
+	if (numCompared == 0)
+	{
+		Log::error("No frames to compare against %s, both runs need ENGINE_CAPTURE=hash\n", trace.referencePath.c_str());
+		return false;
+	}
+	if (numDifferent)
+	{
+		Log::error("%u of %u frames differ from %s, the first is frame %llu\n", numDifferent, numCompared, trace.referencePath.c_str(),
+			static_cast<unsigned long long>(firstDifferent));
+		return false;
+	}
+
+	Log::log("All %u compared frames match %s\n", numCompared, trace.referencePath.c_str());
+	return true;
+}
+
+static void logTimes(const char* name, eastl::vector<float>& milliseconds)
+{
+	if (milliseconds.empty())
+	{
+		Log::log("%s time wasn't measured\n", name);
+		return;
+	}
+
+	eastl::sort(milliseconds.begin(), milliseconds.end());
+	double sum = 0.0;
+	for (float value : milliseconds)
+	{
+		sum += value;
+	}
+
+	uint32_t count = static_cast<uint32_t>(milliseconds.size());
+	Log::log("%s time over %u frames: %.3f ms mean, %.3f median, %.3f p99, %.3f max\n", name, count, sum / count,
+		milliseconds[count / 2], milliseconds[static_cast<uint32_t>((count - 1) * 0.99)], milliseconds.back());
+}
+
+bool finishTraceReplay(EngineContext& context)
+{
+	FrameTrace& trace = *context.frameTrace;
+
+	flushFrameCapture(context);
+	eastl::vector<uint64_t> imageHashes(trace.nextFrame, 0);
+	for (uint32_t i = 0; i < trace.nextFrame; ++i)
+	{
+		if (!getCapturedFrameHash(context, i, imageHashes[i]))
+		{
+			imageHashes[i] = 0;
+		}
+	}
+
+	if (!trace.reportPath.empty())
+	{
+		writeReport(trace, imageHashes);
+	}
+
+	eastl::vector<float> cpuMilliseconds;
+	eastl::vector<float> gpuMilliseconds;
+	uint32_t numDiverged = 0;
+	uint32_t firstDiverged = 0;
+	uint32_t numBuildFrames = 0;
+	for (uint32_t i = 0; i < trace.nextFrame; ++i)
+	{
+		const ReplayResult& result = trace.results[i];
+		cpuMilliseconds.push_back(result.cpuMilliseconds);
+		if (result.gpuMilliseconds >= 0.0f)
+		{
+			gpuMilliseconds.push_back(result.gpuMilliseconds);
+		}
+		if (!result.matches)
+		{
+			firstDiverged = numDiverged == 0 ? i : firstDiverged;
+			++numDiverged;
+		}
+		numBuildFrames += result.numPipelineBuilds ? 1 : 0;
+	}
+
+	Log::log("Replayed %u of %u frames\n", trace.nextFrame, static_cast<uint32_t>(trace.frames.size()));
+	logTimes("CPU", cpuMilliseconds);
+	logTimes("GPU", gpuMilliseconds);
+	Log::log("Startup made %u uploads and %u pipeline builds, the recording %u and %u. %u frames built pipelines.\n",
+		trace.numReplayStartupUploads, trace.numReplayStartupPipelineBuilds, trace.numStartupUploads, trace.numStartupPipelineBuilds, numBuildFrames);
+
+	if (numDiverged)
+	{
+		Log::error("%u frames drew something else than the recording, the first is frame %u\n", numDiverged, firstDiverged);
+	}
+
+	bool imagesMatch = trace.referencePath.empty() || compareWithReference(trace, imageHashes);
+	return numDiverged == 0 && imagesMatch;
+}
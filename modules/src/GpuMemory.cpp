@@ -0,0 +1,272 @@
+#include "GpuMemory.h"
+
+#include <string.h>
+
+#include "ArraySize.h"
+#include "EngineContext.h"
+#include "FrameTrace.h"
+#include "Log.h"
+#include "Telemetry.h"
+
+uint32_t findMemoryType(EngineContext& context, uint32_t typeBits, VkMemoryPropertyFlags properties)
+{
+	const VkPhysicalDeviceMemoryProperties& memoryProperties = context.memoryProperties;
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
+	{
+		if ((typeBits & (1u << i)) && (memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	Log::fatal("No memory type with properties 0x%x for type bits 0x%x\n", properties, typeBits);
+}
+
+uint64_t getTimestampMask(EngineContext& context, uint32_t queueFamily)
+{
+	uint32_t timestampBits = context.queueFamilyProperties[queueFamily].timestampValidBits;
+	return timestampBits >= 64 ? ~0ull : (1ull << timestampBits) - 1;
+}
+
+void createGpuBuffer(EngineContext& context, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, GpuBuffer& buffer)
+{
+	buffer = {};
+	buffer.size = size;
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+
+	uint32_t queueFamilyIndices[] = { context.graphicsQueueFamily, context.computeQueueFamily };
+	if (context.graphicsQueueFamily != context.computeQueueFamily)
+	{
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = ARRAY_SIZE(queueFamilyIndices);
+		bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+	}
+	else
+	{
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	}
+
+	VkResult result = vkCreateBuffer(context.device, &bufferInfo, nullptr, &buffer.buffer);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create buffer of size %llu\n", static_cast<unsigned long long>(size));
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(context.device, buffer.buffer, &requirements);
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(context, requirements.memoryTypeBits, properties);
+
+	result = vkAllocateMemory(context.device, &allocInfo, nullptr, &buffer.memory);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't allocate %llu bytes of buffer memory\n", static_cast<unsigned long long>(requirements.size));
+	}
+
+	vkBindBufferMemory(context.device, buffer.buffer, buffer.memory, 0);
+
+	buffer.heapIndex = context.memoryProperties.memoryTypes[allocInfo.memoryTypeIndex].heapIndex;
+
+	if (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		vkMapMemory(context.device, buffer.memory, 0, VK_WHOLE_SIZE, 0, &buffer.mapped);
+	}
+
+	buffer.allocationSize = requirements.size;
+	context.gpuMemoryStats.bytesPerHeap[buffer.heapIndex] += buffer.allocationSize;
+	++context.gpuMemoryStats.numLiveAllocations;
+	++context.gpuMemoryStats.numAllocationsTotal;
+}
+
+void destroyGpuBuffer(EngineContext& context, GpuBuffer& buffer)
+{
+	if (buffer.buffer == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	context.gpuMemoryStats.bytesPerHeap[buffer.heapIndex] -= buffer.allocationSize;
+	--context.gpuMemoryStats.numLiveAllocations;
+
+	vkDestroyBuffer(context.device, buffer.buffer, nullptr);
+	vkFreeMemory(context.device, buffer.memory, nullptr);
+
+	buffer = {};
+}
+
+void createGpuImage(EngineContext& context, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags viewAspect, GpuImage& image)
+{
+	image = {};
+	image.format = format;
+	image.extent.width = width;
+	image.extent.height = height;
+	image.mipLevels = mipLevels;
+
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = format;
+	imageInfo.extent.width = width;
+	imageInfo.extent.height = height;
+	imageInfo.extent.depth = 1;
+	imageInfo.mipLevels = mipLevels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = usage;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VkResult result = vkCreateImage(context.device, &imageInfo, nullptr, &image.image);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create %ux%u image\n", width, height);
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(context.device, image.image, &requirements);
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = findMemoryType(context, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	result = vkAllocateMemory(context.device, &allocInfo, nullptr, &image.memory);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't allocate %llu bytes of image memory\n", static_cast<unsigned long long>(requirements.size));
+	}
+
+	vkBindImageMemory(context.device, image.image, image.memory, 0);
+
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image.image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange.aspectMask = viewAspect;
+	viewInfo.subresourceRange.levelCount = mipLevels;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	result = vkCreateImageView(context.device, &viewInfo, nullptr, &image.view);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create image view\n");
+	}
+
+	image.heapIndex = context.memoryProperties.memoryTypes[allocInfo.memoryTypeIndex].heapIndex;
+	image.allocationSize = requirements.size;
+	context.gpuMemoryStats.bytesPerHeap[image.heapIndex] += image.allocationSize;
+	++context.gpuMemoryStats.numLiveAllocations;
+	++context.gpuMemoryStats.numAllocationsTotal;
+}
+
+void destroyGpuImage(EngineContext& context, GpuImage& image)
+{
+	if (image.image == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	context.gpuMemoryStats.bytesPerHeap[image.heapIndex] -= image.allocationSize;
+	--context.gpuMemoryStats.numLiveAllocations;
+
+	vkDestroyImageView(context.device, image.view, nullptr);
+	vkDestroyImage(context.device, image.image, nullptr);
+	vkFreeMemory(context.device, image.memory, nullptr);
+
+	image = {};
+}
+
+void recordImageBarrier(VkCommandBuffer commandBuffer, VkImage image, VkImageAspectFlags aspect, uint32_t baseMipLevel, uint32_t levelCount,
+	VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = aspect;
+	barrier.subresourceRange.baseMipLevel = baseMipLevel;
+	barrier.subresourceRange.levelCount = levelCount;
+	barrier.subresourceRange.layerCount = 1;
+
+	vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+static VkCommandBuffer beginOneTimeCommands(EngineContext& context)
+{
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = context.commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	VkResult result = vkAllocateCommandBuffers(context.device, &allocInfo, &commandBuffer);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Cannot allocate upload command buffer");
+	}
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	return commandBuffer;
+}
+
+static void submitOneTimeCommands(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	vkEndCommandBuffer(commandBuffer);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+	countTelemetryEvent(context, TelemetryCounter_GraphicsSubmits);
+	vkQueueWaitIdle(context.graphicsQueue);
+
+	vkFreeCommandBuffers(context.device, context.commandPool, 1, &commandBuffer);
+}
+
+void uploadToGpuBuffer(EngineContext& context, GpuBuffer& dst, const void* data, VkDeviceSize size)
+{
+	GpuBuffer staging;
+	createGpuBuffer(context, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging);
+	memcpy(staging.mapped, data, size);
+	traceUpload(context, data, size);
+
+	VkCommandBuffer commandBuffer = beginOneTimeCommands(context);
+
+	VkBufferCopy region = {};
+	region.size = size;
+	vkCmdCopyBuffer(commandBuffer, staging.buffer, dst.buffer, 1, &region);
+
+	submitOneTimeCommands(context, commandBuffer);
+	destroyGpuBuffer(context, staging);
+}
+
+void initializeGpuImageLayout(EngineContext& context, GpuImage& image, VkImageAspectFlags aspect, VkImageLayout layout)
+{
+	VkCommandBuffer commandBuffer = beginOneTimeCommands(context);
+
+	recordImageBarrier(commandBuffer, image.image, aspect, 0, image.mipLevels, VK_IMAGE_LAYOUT_UNDEFINED, layout,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0);
+
+	submitOneTimeCommands(context, commandBuffer);
+}
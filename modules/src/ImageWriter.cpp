@@ -0,0 +1,148 @@
+#include "ImageWriter.h"
+
+#include <string.h>
+
+#include <EASTL/vector.h>
+
+static const uint32_t MaxStoredBlockSize = 65535;
+
+struct Crc32Table
+{
+	uint32_t values[256];
+};
+
+static Crc32Table makeCrc32Table()
+{
+	Crc32Table table;
+	for (uint32_t i = 0; i < 256; ++i)
+	{
+		uint32_t c = i;
+		for (int k = 0; k < 8; ++k)
+		{
+			c = (c & 1) ? (0xedb88320u ^ (c >> 1)) : (c >> 1);
+		}
+		table.values[i] = c;
+	}
+	return table;
+}
+
+static uint32_t updateCrc32(uint32_t crc, const uint8_t* data, size_t size)
+{
+	// encoder threads call this concurrently, function-local statics are initialized exactly once
+	static const Crc32Table table = makeCrc32Table();
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc = table.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+static void putU32BigEndian(eastl::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back(static_cast<uint8_t>(value >> 24));
+	out.push_back(static_cast<uint8_t>(value >> 16));
+	out.push_back(static_cast<uint8_t>(value >> 8));
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+static void writeChunk(FILE* file, const char* type, const uint8_t* data, uint32_t size)
+{
+	uint8_t header[8] = {
+		static_cast<uint8_t>(size >> 24), static_cast<uint8_t>(size >> 16), static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size),
+		static_cast<uint8_t>(type[0]), static_cast<uint8_t>(type[1]), static_cast<uint8_t>(type[2]), static_cast<uint8_t>(type[3])
+	};
+	fwrite(header, 1, sizeof(header), file);
+	fwrite(data, 1, size, file);
+
+	uint32_t crc = updateCrc32(0xffffffffu, header + 4, 4);
+	crc = updateCrc32(crc, data, size) ^ 0xffffffffu;
+
+	uint8_t crcBytes[4] = { static_cast<uint8_t>(crc >> 24), static_cast<uint8_t>(crc >> 16), static_cast<uint8_t>(crc >> 8), static_cast<uint8_t>(crc) };
+	fwrite(crcBytes, 1, sizeof(crcBytes), file);
+}
+
+bool writePng(const char* path, const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	static const uint8_t Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	fwrite(Signature, 1, sizeof(Signature), file);
+
+	eastl::vector<uint8_t> ihdr;
+	putU32BigEndian(ihdr, width);
+	putU32BigEndian(ihdr, height);
+	ihdr.push_back(8); // bit depth
+	ihdr.push_back(6); // RGBA
+	ihdr.push_back(0);
+	ihdr.push_back(0);
+	ihdr.push_back(0);
+	writeChunk(file, "IHDR", ihdr.data(), static_cast<uint32_t>(ihdr.size()));
+
+	// each row is prefixed with filter type 0
+	size_t rowSize = static_cast<size_t>(width) * 4;
+	size_t rawSize = (rowSize + 1) * height;
+	size_t numBlocks = (rawSize + MaxStoredBlockSize - 1) / MaxStoredBlockSize;
+
+	eastl::vector<uint8_t> idat;
+	idat.reserve(2 + rawSize + numBlocks * 5 + 4);
+	idat.push_back(0x78);
+	idat.push_back(0x01);
+
+	uint32_t adlerA = 1;
+	uint32_t adlerB = 0;
+	size_t blockRemaining = 0;
+	size_t rawWritten = 0;
+
+	auto putRawByte = [&](uint8_t value)
+	{
+		if (blockRemaining == 0)
+		{
+			size_t blockSize = rawSize - rawWritten < MaxStoredBlockSize ? rawSize - rawWritten : MaxStoredBlockSize;
+			bool isFinal = rawWritten + blockSize == rawSize;
+			idat.push_back(isFinal ? 1 : 0);
+			idat.push_back(static_cast<uint8_t>(blockSize));
+			idat.push_back(static_cast<uint8_t>(blockSize >> 8));
+			idat.push_back(static_cast<uint8_t>(~blockSize));
+			idat.push_back(static_cast<uint8_t>(~blockSize >> 8));
+			blockRemaining = blockSize;
+		}
+
+		idat.push_back(value);
+		--blockRemaining;
+		++rawWritten;
+
+		adlerA = (adlerA + value) % 65521;
+		adlerB = (adlerB + adlerA) % 65521;
+	};
+
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		putRawByte(0);
+
+		const uint8_t* row = rgba + y * rowSize;
+		for (size_t x = 0; x < rowSize; ++x)
+		{
+			putRawByte(row[x]);
+		}
+	}
+
+	putU32BigEndian(idat, (adlerB << 16) | adlerA);
+	writeChunk(file, "IDAT", idat.data(), static_cast<uint32_t>(idat.size()));
+	writeChunk(file, "IEND", nullptr, 0);
+
+	bool ok = ferror(file) == 0;
+	fclose(file);
+
+	return ok;
+}
+
+bool writeRawRgba(FILE* file, const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+	size_t size = static_cast<size_t>(width) * height * 4;
+	return fwrite(rgba, 1, size, file) == size;
+}
@@ -0,0 +1,189 @@
+#include "JobSystem.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <EASTL/deque.h>
+#include <EASTL/vector.h>
+
+struct Job
+{
+	JobFunc func;
+	void* data;
+	JobCounter* counter;
+};
+
+struct JobSystem
+{
+	eastl::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	eastl::deque<Job> queue;
+	// only popped by the workers
+	eastl::deque<Job> backgroundQueue;
+	bool stopping;
+};
+
+static void runJob(const Job& job)
+{
+	job.func(job.data);
+
+	if (job.counter)
+	{
+		job.counter->pending.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+static bool tryPopJob(JobSystem& jobSystem, Job& job)
+{
+	std::lock_guard<std::mutex> lock(jobSystem.mutex);
+	if (jobSystem.queue.empty())
+	{
+		return false;
+	}
+
+	job = jobSystem.queue.front();
+	jobSystem.queue.pop_front();
+	return true;
+}
+
+static void workerThread(JobSystem& jobSystem)
+{
+	for (;;)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(jobSystem.mutex);
+			jobSystem.jobAvailable.wait(lock, [&jobSystem]
+				{ return jobSystem.stopping || !jobSystem.queue.empty() || !jobSystem.backgroundQueue.empty(); });
+
+			if (!jobSystem.queue.empty())
+			{
+				job = jobSystem.queue.front();
+				jobSystem.queue.pop_front();
+			}
+			else if (!jobSystem.backgroundQueue.empty())
+			{
+				job = jobSystem.backgroundQueue.front();
+				jobSystem.backgroundQueue.pop_front();
+			}
+			else
+			{
+				return;
+			}
+		}
+
+		runJob(job);
+	}
+}
+
+JobSystem* createJobSystem(uint32_t numWorkers)
+{
+	if (numWorkers == 0)
+	{
+		uint32_t numHardwareThreads = std::thread::hardware_concurrency();
+		numWorkers = numHardwareThreads > 1 ? numHardwareThreads - 1 : 1;
+	}
+
+	JobSystem* jobSystem = new JobSystem;
+	jobSystem->stopping = false;
+
+	for (uint32_t i = 0; i < numWorkers; ++i)
+	{
+		jobSystem->workers.push_back(std::thread(workerThread, std::ref(*jobSystem)));
+	}
+
+	return jobSystem;
+}
+
+void destroyJobSystem(JobSystem* jobSystem)
+{
+	if (!jobSystem)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(jobSystem->mutex);
+		jobSystem->stopping = true;
+	}
+	jobSystem->jobAvailable.notify_all();
+
+	for (std::thread& worker : jobSystem->workers)
+	{
+		worker.join();
+	}
+
+	delete jobSystem;
+}
+
+void submitJob(JobSystem* jobSystem, JobFunc func, void* data, JobCounter* counter)
+{
+	if (counter)
+	{
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Job job = { func, data, counter };
+	{
+		std::lock_guard<std::mutex> lock(jobSystem->mutex);
+		jobSystem->queue.push_back(job);
+	}
+	jobSystem->jobAvailable.notify_one();
+}
+
+void submitBackgroundJob(JobSystem* jobSystem, JobFunc func, void* data, JobCounter* counter)
+{
+	if (counter)
+	{
+		counter->pending.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	Job job = { func, data, counter };
+	{
+		std::lock_guard<std::mutex> lock(jobSystem->mutex);
+		jobSystem->backgroundQueue.push_back(job);
+	}
+	jobSystem->jobAvailable.notify_one();
+}
+
+void waitForCounter(JobSystem* jobSystem, JobCounter* counter)
+{
+	waitForCounterBelow(jobSystem, counter, 1);
+}
+
+void waitForCounterBelow(JobSystem* jobSystem, JobCounter* counter, uint32_t limit)
+{
+	while (counter->pending.load(std::memory_order_acquire) >= limit)
+	{
+		Job job;
+		if (tryPopJob(*jobSystem, job))
+		{
+			runJob(job);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+bool runPendingJob(JobSystem* jobSystem)
+{
+	Job job;
+	if (!tryPopJob(*jobSystem, job))
+	{
+		return false;
+	}
+
+	runJob(job);
+	return true;
+}
+
+uint32_t getNumJobWorkers(JobSystem* jobSystem)
+{
+	return static_cast<uint32_t>(jobSystem->workers.size());
+}
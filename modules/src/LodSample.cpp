@@ -0,0 +1,367 @@
+#include "LodSample.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <EASTL/vector.h>
+
+#include "ArraySize.h"
+#include "ComputePass.h"
+#include "EngineContext.h"
+#include "GpuMemory.h"
+#include "LodSelection.h"
+#include "Log.h"
+#include "Mesh.h"
+#include "MeshSimplifier.h"
+#include "PipelineCache.h"
+#include "RenderCommands.h"
+#include "ShadowMaps.h"
+
+static const uint32_t GridSize = 16;
+static const uint32_t NumInstances = GridSize * GridSize;
+static const float GridSpacing = 2.5f;
+
+static const uint32_t MeshSubdivisions = 5;
+static const float MeshBumpiness = 0.1f;
+static const float LodReduction = 0.5f;
+static const uint32_t MinLodTriangles = 64;
+
+static const double StatsInterval = 5.0;
+
+// std140 layout of Camera in lod.vert
+struct LodCameraUniforms
+{
+	float viewProjection[16];
+	float eye[4];
+};
+
+// std430 layout of Instance in lod.vert
+struct GpuLodInstance
+{
+	float positionScale[4];
+	// x is the dither coverage, y is 1 for the outgoing level of a cross-fade
+	float fade[4];
+};
+
+struct LodSample
+{
+	Mesh mesh;
+	eastl::vector<LodInstance> instances;
+
+	LodSettings settings;
+	LodSelection selection;
+
+	GpuBuffer vertexBuffer;
+	GpuBuffer indexBuffer;
+	// positions only, for the shadow maps
+	GpuBuffer shadowPositionBuffer;
+	// every instance can be drawn twice while it fades
+	GpuBuffer instanceBuffers[MAX_FRAMES_IN_FLIGHT];
+	GpuBuffer cameraBuffers[MAX_FRAMES_IN_FLIGHT];
+
+	VkDescriptorSetLayout drawSetLayout;
+	VkPipelineLayout drawPipelineLayout;
+	PipelineDesc drawPipelineDesc;
+	VkDescriptorSet drawSets[MAX_FRAMES_IN_FLIGHT];
+
+	double lastTime;
+	bool logStats;
+	double lastStatsTime;
+};
+
+static float getEnvFloat(const char* name, float defaultValue)
+{
+	const char* value = getenv(name);
+	return value ? static_cast<float>(atof(value)) : defaultValue;
+}
+
+static void writeBufferDescriptor(EngineContext& context, VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const GpuBuffer& buffer)
+{
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer.buffer;
+	bufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+	write.pBufferInfo = &bufferInfo;
+
+	vkUpdateDescriptorSets(context.device, 1, &write, 0, nullptr);
+}
+
+static void createInstances(LodSample& sample)
+{
+	sample.instances.resize(NumInstances);
+
+	float offset = (GridSize - 1) * GridSpacing * 0.5f;
+	for (uint32_t z = 0; z < GridSize; ++z)
+	{
+		for (uint32_t x = 0; x < GridSize; ++x)
+		{
+			LodInstance& instance = sample.instances[z * GridSize + x];
+			instance.scale = 0.6f + (static_cast<float>(rand()) / RAND_MAX) * 0.4f;
+			instance.position[0] = x * GridSpacing - offset;
+			instance.position[1] = instance.scale;
+			instance.position[2] = z * GridSpacing - offset;
+		}
+	}
+}
+
+// The field never moves, so it is a static caster and the distant cascades can be cached. Cascades
+// are drawn with coarser levels of detail the further away they reach.
+static void addFieldShadowCaster(EngineContext& context, LodSample& sample)
+{
+	createShadowPositionBuffer(context, sample.mesh.vertices.data(), static_cast<uint32_t>(sample.mesh.vertices.size()), sample.shadowPositionBuffer);
+
+	ShadowCasterDesc desc = {};
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		desc.positionBuffers[i] = sample.shadowPositionBuffer.buffer;
+	}
+	desc.indexBuffer = sample.indexBuffer.buffer;
+	for (uint32_t i = 0; i < MaxShadowCascades; ++i)
+	{
+		const MeshLod& lod = sample.mesh.lods[i < sample.mesh.numLods ? i : sample.mesh.numLods - 1];
+		desc.firstIndex[i] = lod.firstIndex;
+		desc.numIndices[i] = lod.numIndices;
+	}
+	desc.isStatic = true;
+
+	const Mesh& mesh = sample.mesh;
+	eastl::vector<ShadowInstance> instances(sample.instances.size());
+	for (uint32_t i = 0; i < instances.size(); ++i)
+	{
+		const LodInstance& instance = sample.instances[i];
+		ShadowInstance& shadowInstance = instances[i];
+		shadowInstance.position = makeVec3(instance.position[0], instance.position[1], instance.position[2]);
+		shadowInstance.scale = instance.scale;
+		shadowInstance.boundsCenter = shadowInstance.position + makeVec3(mesh.boundsCenter[0], mesh.boundsCenter[1], mesh.boundsCenter[2]) * instance.scale;
+		shadowInstance.boundsRadius = mesh.boundsRadius * instance.scale;
+	}
+
+	uint32_t caster = addShadowCaster(context, desc);
+	setShadowCasterInstances(context, caster, instances.data(), static_cast<uint32_t>(instances.size()));
+}
+
+static void createDrawPipeline(EngineContext& context, LodSample& sample)
+{
+	VkDescriptorSetLayoutBinding bindings[4 + NumShadowReceiverBindings] = {};
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	}
+	makeShadowReceiverBindings(4, VK_SHADER_STAGE_FRAGMENT_BIT, bindings + 4);
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = ARRAY_SIZE(bindings);
+	setLayoutInfo.pBindings = bindings;
+
+	VkResult result = vkCreateDescriptorSetLayout(context.device, &setLayoutInfo, nullptr, &sample.drawSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create level of detail descriptor set layout");
+	}
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &sample.drawSetLayout;
+
+	result = vkCreatePipelineLayout(context.device, &layoutInfo, nullptr, &sample.drawPipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create level of detail pipeline layout");
+	}
+
+	// vertices are pulled from the storage buffers, there is no vertex input
+	sample.drawPipelineDesc = makeDefaultPipelineDesc();
+	sample.drawPipelineDesc.vertexShader = "lod.vert";
+	sample.drawPipelineDesc.fragmentShader = "lod.frag";
+	sample.drawPipelineDesc.layout = sample.drawPipelineLayout;
+	sample.drawPipelineDesc.depthTestEnable = VK_TRUE;
+	sample.drawPipelineDesc.depthWriteEnable = VK_TRUE;
+	sample.drawPipelineDesc.renderPass = context.renderPass;
+	sample.drawPipelineDesc.colorFormat = context.sceneColorFormat;
+	sample.drawPipelineDesc.depthFormat = context.depthFormat;
+
+	getPipeline(context, sample.drawPipelineDesc);
+}
+
+void createLodSample(EngineContext& context)
+{
+	LodSample* sample = new LodSample;
+	*sample = {};
+
+	makeBumpySphereMesh(MeshSubdivisions, MeshBumpiness, sample->mesh);
+	generateMeshLods(sample->mesh, LodReduction, MinLodTriangles);
+
+	for (uint32_t i = 0; i < sample->mesh.numLods; ++i)
+	{
+		const MeshLod& lod = sample->mesh.lods[i];
+		Log::log("Mesh LOD %u: %u triangles, error %.4f\n", i, lod.numIndices / 3, lod.error);
+	}
+
+	createInstances(*sample);
+
+	sample->settings.pixelErrorThreshold = getEnvFloat("ENGINE_LOD_PIXEL_ERROR", 1.0f);
+	sample->settings.hysteresis = 0.25f;
+	sample->settings.triangleBudget = static_cast<uint32_t>(getEnvFloat("ENGINE_LOD_TRIANGLE_BUDGET", 0.0f));
+	sample->settings.crossFadeSeconds = getEnvFloat("ENGINE_LOD_CROSSFADE", 0.25f);
+
+	const char* logStats = getenv("ENGINE_LOD_STATS");
+	sample->logStats = logStats && strcmp(logStats, "0") != 0;
+
+	initLodSelection(sample->selection, NumInstances);
+
+	VkDeviceSize vertexSize = sample->mesh.vertices.size() * sizeof(MeshVertex);
+	createGpuBuffer(context, vertexSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->vertexBuffer);
+	uploadToGpuBuffer(context, sample->vertexBuffer, sample->mesh.vertices.data(), vertexSize);
+
+	VkDeviceSize indexSize = sample->mesh.indices.size() * sizeof(uint32_t);
+	createGpuBuffer(context, indexSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->indexBuffer);
+	uploadToGpuBuffer(context, sample->indexBuffer, sample->mesh.indices.data(), indexSize);
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		createGpuBuffer(context, 2 * NumInstances * sizeof(GpuLodInstance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, sample->instanceBuffers[i]);
+		createGpuBuffer(context, sizeof(LodCameraUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, sample->cameraBuffers[i]);
+	}
+
+	createDrawPipeline(context, *sample);
+	addFieldShadowCaster(context, *sample);
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		sample->drawSets[i] = allocateDescriptorSet(context, sample->drawSetLayout);
+		writeBufferDescriptor(context, sample->drawSets[i], 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, sample->cameraBuffers[i]);
+		writeBufferDescriptor(context, sample->drawSets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->vertexBuffer);
+		writeBufferDescriptor(context, sample->drawSets[i], 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->indexBuffer);
+		writeBufferDescriptor(context, sample->drawSets[i], 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->instanceBuffers[i]);
+		writeShadowReceiverDescriptors(context, sample->drawSets[i], 4, i);
+	}
+
+	sample->lastTime = context.frameTime;
+	sample->lastStatsTime = sample->lastTime;
+
+	context.lodSample = sample;
+}
+
+void destroyLodSample(EngineContext& context)
+{
+	LodSample* sample = context.lodSample;
+	if (!sample)
+	{
+		return;
+	}
+
+	vkDestroyPipelineLayout(context.device, sample->drawPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(context.device, sample->drawSetLayout, nullptr);
+
+	destroyGpuBuffer(context, sample->vertexBuffer);
+	destroyGpuBuffer(context, sample->indexBuffer);
+	destroyGpuBuffer(context, sample->shadowPositionBuffer);
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		destroyGpuBuffer(context, sample->instanceBuffers[i]);
+		destroyGpuBuffer(context, sample->cameraBuffers[i]);
+	}
+
+	delete sample;
+	context.lodSample = nullptr;
+}
+
+static void logSelectionStats(const LodSample& sample)
+{
+	const LodSelectionStats& stats = sample.selection.stats;
+
+	char drawsPerLod[MaxMeshLods * 12] = {};
+	int length = 0;
+	for (uint32_t i = 0; i < sample.mesh.numLods; ++i)
+	{
+		length += snprintf(drawsPerLod + length, sizeof(drawsPerLod) - length, " %u", stats.numDrawsPerLod[i]);
+	}
+
+	Log::log("LOD: %u visible, %u culled, %u fading, %u triangles, threshold %.2f px, draws per level:%s\n", stats.numVisible, stats.numCulled, stats.numFading, stats.numTriangles, stats.pixelErrorThreshold, drawsPerLod);
+}
+
+void emitLodSample(EngineContext& context)
+{
+	LodSample* sample = context.lodSample;
+	if (!sample)
+	{
+		return;
+	}
+
+	uint32_t slot = context.currentFrame;
+	const Camera& camera = context.camera;
+
+	double time = context.frameTime;
+	float deltaTime = static_cast<float>(time - sample->lastTime);
+	sample->lastTime = time;
+
+	LodSelection& selection = sample->selection;
+	selectLods(selection, sample->settings, sample->mesh, sample->instances.data(), NumInstances, camera, static_cast<float>(context.renderExtent.height), deltaTime);
+
+	if (sample->logStats && time - sample->lastStatsTime >= StatsInterval)
+	{
+		logSelectionStats(*sample);
+		sample->lastStatsTime = time;
+	}
+
+	LodCameraUniforms uniforms = {};
+	memcpy(uniforms.viewProjection, camera.viewProjection.m, sizeof(uniforms.viewProjection));
+	uniforms.eye[0] = camera.position.x;
+	uniforms.eye[1] = camera.position.y;
+	uniforms.eye[2] = camera.position.z;
+	uniforms.eye[3] = 1.0f;
+	memcpy(sample->cameraBuffers[slot].mapped, &uniforms, sizeof(uniforms));
+
+	GpuLodInstance* mapped = static_cast<GpuLodInstance*>(sample->instanceBuffers[slot].mapped);
+	for (uint32_t i = 0; i < selection.draws.size(); ++i)
+	{
+		const LodDraw& draw = selection.draws[i];
+		const LodInstance& instance = sample->instances[draw.instance];
+
+		GpuLodInstance gpuInstance = {};
+		memcpy(gpuInstance.positionScale, instance.position, sizeof(instance.position));
+		gpuInstance.positionScale[3] = instance.scale;
+		gpuInstance.fade[0] = draw.fade;
+		gpuInstance.fade[1] = draw.fadingOut ? 1.0f : 0.0f;
+		mapped[i] = gpuInstance;
+	}
+
+	VkPipeline pipeline = getPipeline(context, sample->drawPipelineDesc);
+
+	for (uint32_t lod = 0; lod < sample->mesh.numLods; ++lod)
+	{
+		uint32_t firstDraw = selection.lodOffsets[lod];
+		uint32_t numDraws = selection.lodOffsets[lod + 1] - firstDraw;
+		if (numDraws == 0)
+		{
+			continue;
+		}
+
+		// there is no depth buffer yet. Instances are sorted far to near within a level and coarse
+		// levels, which are mostly further away, are drawn first.
+		DrawPacket packet = {};
+		packet.pipeline = pipeline;
+		packet.pipelineLayout = sample->drawPipelineLayout;
+		packet.descriptorSet = sample->drawSets[slot];
+		packet.sortKey = makeDrawSortKey(DrawPass_Opaque, pipeline, MaxMeshLods - 1 - lod, 0.0f);
+		packet.vertexCount = sample->mesh.lods[lod].numIndices;
+		packet.firstVertex = sample->mesh.lods[lod].firstIndex;
+		packet.instanceCount = numDraws;
+		packet.firstInstance = firstDraw;
+
+		emitDrawPacket(context, packet);
+	}
+}
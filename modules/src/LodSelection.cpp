@@ -0,0 +1,239 @@
+#include "LodSelection.h"
+
+#include <float.h>
+
+#include <EASTL/sort.h>
+
+#include "Camera.h"
+#include "Culling.h"
+#include "VectorMath.h"
+
+static const float BudgetThresholdScale = 1.5f;
+// instances that were never visible snap to their first level instead of fading in
+static const uint32_t NoLod = ~0u;
+
+void initLodSelection(LodSelection& selection, uint32_t numInstances)
+{
+	LodInstanceState initialState = {};
+	initialState.lod = NoLod;
+	initialState.fade = 1.0f;
+
+	selection.states.assign(numInstances, initialState);
+	selection.draws.clear();
+	selection.stats = {};
+}
+
+static uint32_t pickLod(const Mesh& mesh, uint32_t currentLod, float pixelsPerUnit, float threshold, float hysteresis)
+{
+	uint32_t lod = currentLod < mesh.numLods ? currentLod : mesh.numLods - 1;
+
+	while (lod > 0 && mesh.lods[lod].error * pixelsPerUnit > threshold)
+	{
+		--lod;
+	}
+
+	while (lod + 1 < mesh.numLods && mesh.lods[lod + 1].error * pixelsPerUnit <= threshold * (1.0f - hysteresis))
+	{
+		++lod;
+	}
+
+	return lod;
+}
+
+// Triangles an instance draws this frame when it targets lod, including the level a cross-fade
+// fades out. Must match how selectLods advances the fades.
+static uint32_t countTriangles(const Mesh& mesh, const LodInstanceState& state, uint32_t lod, float fadeStep)
+{
+	uint32_t numTriangles = mesh.lods[lod].numIndices / 3;
+	if (state.lod == NoLod || fadeStep >= 1.0f)
+	{
+		return numTriangles;
+	}
+
+	// a switch starts fading out the current level
+	if (lod != state.lod)
+	{
+		return numTriangles + mesh.lods[state.lod].numIndices / 3;
+	}
+
+	if (state.fade + fadeStep < 1.0f)
+	{
+		numTriangles += mesh.lods[state.previousLod].numIndices / 3;
+	}
+	return numTriangles;
+}
+
+// Returns the triangles drawn with threshold. allCoarsest is set when every visible instance picked
+// the last level, raising the threshold further can't lower the count then.
+static uint32_t pickLods(LodSelection& selection, const LodSettings& settings, const Mesh& mesh, uint32_t numInstances, float threshold, float fadeStep, bool& allCoarsest)
+{
+	uint32_t numTriangles = 0;
+	allCoarsest = true;
+	for (uint32_t i = 0; i < numInstances; ++i)
+	{
+		if (selection.distances[i] < 0.0f)
+		{
+			continue;
+		}
+
+		const LodInstanceState& state = selection.states[i];
+		uint32_t lod = pickLod(mesh, state.lod, selection.pixelsPerUnit[i], threshold, settings.hysteresis);
+		selection.targetLods[i] = lod;
+		numTriangles += countTriangles(mesh, state, lod, fadeStep);
+		allCoarsest = allCoarsest && lod == mesh.numLods - 1;
+	}
+
+	return numTriangles;
+}
+
+static void addDraw(LodSelection& selection, uint32_t lod, uint32_t instance, float fade, bool fadingOut)
+{
+	LodDraw draw;
+	draw.instance = instance;
+	draw.fade = fade;
+	draw.fadingOut = fadingOut;
+	draw.distance = selection.distances[instance];
+	selection.draws.push_back(draw);
+
+	++selection.lodOffsets[lod + 1];
+}
+
+void selectLods(LodSelection& selection, const LodSettings& settings, const Mesh& mesh, const LodInstance* instances, uint32_t numInstances, const Camera& camera, float screenHeight, float deltaTime)
+{
+	LodSelectionStats& stats = selection.stats;
+	stats = {};
+
+	selection.distances.resize(numInstances);
+	selection.pixelsPerUnit.resize(numInstances);
+	selection.targetLods.resize(numInstances);
+
+	// screen pixels covered by one world unit at distance 1
+	float pixelsAtUnitDistance = screenHeight / (2.0f * camera.tanHalfFovY);
+	Vec3 boundsCenter = makeVec3(mesh.boundsCenter[0], mesh.boundsCenter[1], mesh.boundsCenter[2]);
+
+	selection.centerX.resize(numInstances);
+	selection.centerY.resize(numInstances);
+	selection.centerZ.resize(numInstances);
+	selection.radii.resize(numInstances);
+	selection.visible.resize(numInstances);
+	for (uint32_t i = 0; i < numInstances; ++i)
+	{
+		const LodInstance& instance = instances[i];
+		selection.centerX[i] = instance.position[0] + boundsCenter.x * instance.scale;
+		selection.centerY[i] = instance.position[1] + boundsCenter.y * instance.scale;
+		selection.centerZ[i] = instance.position[2] + boundsCenter.z * instance.scale;
+		selection.radii[i] = mesh.boundsRadius * instance.scale;
+	}
+	cullSpheres(camera.frustumPlanes, selection.centerX.data(), selection.centerY.data(), selection.centerZ.data(), selection.radii.data(), numInstances, selection.visible.data());
+
+	for (uint32_t i = 0; i < numInstances; ++i)
+	{
+		const LodInstance& instance = instances[i];
+		Vec3 center = makeVec3(selection.centerX[i], selection.centerY[i], selection.centerZ[i]);
+		float radius = selection.radii[i];
+
+		if (!selection.visible[i])
+		{
+			// negative distance marks the instance as culled
+			selection.distances[i] = -1.0f;
+			++stats.numCulled;
+			continue;
+		}
+
+		// distance to the closest point of the bounds, so the error is never underestimated
+		float distance = length(center - camera.position) - radius;
+		distance = distance > camera.nearPlane ? distance : camera.nearPlane;
+
+		selection.distances[i] = distance;
+		selection.pixelsPerUnit[i] = instance.scale * pixelsAtUnitDistance / distance;
+		++stats.numVisible;
+	}
+
+	float fadeStep = settings.crossFadeSeconds > 0.0f ? deltaTime / settings.crossFadeSeconds : 1.0f;
+
+	// Raised until the selection fits or every instance is at its coarsest level. A threshold that
+	// overflows also stops it, a hysteresis of 1 or more never coarsens.
+	float threshold = settings.pixelErrorThreshold;
+	bool allCoarsest = false;
+	uint32_t numTriangles = pickLods(selection, settings, mesh, numInstances, threshold, fadeStep, allCoarsest);
+	while (settings.triangleBudget > 0 && numTriangles > settings.triangleBudget && !allCoarsest && threshold < FLT_MAX)
+	{
+		// a threshold of 0 has to start somewhere, one pixel
+		threshold = threshold > 0.0f ? threshold * BudgetThresholdScale : 1.0f;
+		numTriangles = pickLods(selection, settings, mesh, numInstances, threshold, fadeStep, allCoarsest);
+	}
+	stats.pixelErrorThreshold = threshold;
+
+	selection.draws.clear();
+	for (uint32_t lod = 0; lod <= MaxMeshLods; ++lod)
+	{
+		selection.lodOffsets[lod] = 0;
+	}
+
+	for (uint32_t i = 0; i < numInstances; ++i)
+	{
+		LodInstanceState& state = selection.states[i];
+
+		if (selection.distances[i] < 0.0f)
+		{
+			// nobody sees the switch, finish any fade right away
+			state.fade = 1.0f;
+			continue;
+		}
+
+		uint32_t lod = selection.targetLods[i];
+		if (state.lod == NoLod)
+		{
+			state.lod = lod;
+		}
+		else if (lod != state.lod)
+		{
+			// a switch during a fade starts over from the level currently fading in
+			state.previousLod = state.lod;
+			state.lod = lod;
+			state.fade = 0.0f;
+		}
+
+		state.fade = state.fade + fadeStep < 1.0f ? state.fade + fadeStep : 1.0f;
+
+		addDraw(selection, state.lod, i, state.fade, false);
+		stats.numTriangles += mesh.lods[state.lod].numIndices / 3;
+
+		if (state.fade < 1.0f)
+		{
+			addDraw(selection, state.previousLod, i, state.fade, true);
+			stats.numTriangles += mesh.lods[state.previousLod].numIndices / 3;
+			++stats.numFading;
+		}
+	}
+
+	for (uint32_t lod = 0; lod < MaxMeshLods; ++lod)
+	{
+		stats.numDrawsPerLod[lod] = selection.lodOffsets[lod + 1];
+		selection.lodOffsets[lod + 1] += selection.lodOffsets[lod];
+	}
+
+	// scatter into level of detail groups, then order each group far to near
+	selection.ungroupedDraws.swap(selection.draws);
+	selection.draws.resize(selection.ungroupedDraws.size());
+
+	uint32_t offsets[MaxMeshLods];
+	for (uint32_t lod = 0; lod < MaxMeshLods; ++lod)
+	{
+		offsets[lod] = selection.lodOffsets[lod];
+	}
+
+	for (const LodDraw& draw : selection.ungroupedDraws)
+	{
+		uint32_t lod = draw.fadingOut ? selection.states[draw.instance].previousLod : selection.states[draw.instance].lod;
+		selection.draws[offsets[lod]++] = draw;
+	}
+
+	for (uint32_t lod = 0; lod < MaxMeshLods; ++lod)
+	{
+		eastl::sort(selection.draws.begin() + selection.lodOffsets[lod], selection.draws.begin() + selection.lodOffsets[lod + 1], [](const LodDraw& a, const LodDraw& b)
+		{
+			return a.distance > b.distance;
+		});
+	}
+}
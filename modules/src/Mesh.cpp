@@ -0,0 +1,160 @@
+#include "Mesh.h"
+
+#include <math.h>
+
+#include <EASTL/hash_map.h>
+
+#include "VectorMath.h"
+
+static Vec3 getPosition(const MeshVertex& vertex)
+{
+	return makeVec3(vertex.position[0], vertex.position[1], vertex.position[2]);
+}
+
+static void setPosition(MeshVertex& vertex, const Vec3& position)
+{
+	vertex.position[0] = position.x;
+	vertex.position[1] = position.y;
+	vertex.position[2] = position.z;
+}
+
+static uint32_t addVertex(Mesh& mesh, const Vec3& position)
+{
+	MeshVertex vertex = {};
+	setPosition(vertex, normalize(position));
+	mesh.vertices.push_back(vertex);
+	return static_cast<uint32_t>(mesh.vertices.size() - 1);
+}
+
+static uint32_t getMidpoint(Mesh& mesh, eastl::hash_map<uint64_t, uint32_t>& midpoints, uint32_t a, uint32_t b)
+{
+	uint64_t key = a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+
+	auto it = midpoints.find(key);
+	if (it != midpoints.end())
+	{
+		return it->second;
+	}
+
+	Vec3 midpoint = (getPosition(mesh.vertices[a]) + getPosition(mesh.vertices[b])) * 0.5f;
+	uint32_t index = addVertex(mesh, midpoint);
+	midpoints[key] = index;
+	return index;
+}
+
+void makeBumpySphereMesh(uint32_t numSubdivisions, float bumpiness, Mesh& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	const float t = (1.0f + sqrtf(5.0f)) * 0.5f;
+	const float icosahedron[12][3] =
+	{
+		{ -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+		{ 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+		{ t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 },
+	};
+	const uint32_t faces[20][3] =
+	{
+		{ 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+		{ 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+		{ 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+		{ 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 },
+	};
+
+	for (const float* corner : icosahedron)
+	{
+		addVertex(mesh, makeVec3(corner[0], corner[1], corner[2]));
+	}
+	for (const uint32_t* face : faces)
+	{
+		mesh.indices.insert(mesh.indices.end(), face, face + 3);
+	}
+
+	for (uint32_t subdivision = 0; subdivision < numSubdivisions; ++subdivision)
+	{
+		eastl::hash_map<uint64_t, uint32_t> midpoints;
+		eastl::vector<uint32_t> subdivided;
+		subdivided.reserve(mesh.indices.size() * 4);
+
+		for (size_t i = 0; i < mesh.indices.size(); i += 3)
+		{
+			uint32_t a = mesh.indices[i];
+			uint32_t b = mesh.indices[i + 1];
+			uint32_t c = mesh.indices[i + 2];
+			uint32_t ab = getMidpoint(mesh, midpoints, a, b);
+			uint32_t bc = getMidpoint(mesh, midpoints, b, c);
+			uint32_t ca = getMidpoint(mesh, midpoints, c, a);
+
+			uint32_t triangles[12] = { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca };
+			subdivided.insert(subdivided.end(), triangles, triangles + 12);
+		}
+
+		mesh.indices.swap(subdivided);
+	}
+
+	for (MeshVertex& vertex : mesh.vertices)
+	{
+		Vec3 direction = getPosition(vertex);
+		float bump = sinf(direction.x * 7.0f) * sinf(direction.y * 5.0f) * sinf(direction.z * 6.0f);
+		setPosition(vertex, direction * (1.0f + bump * bumpiness));
+	}
+
+	mesh.numLods = 1;
+	mesh.lods[0].firstIndex = 0;
+	mesh.lods[0].numIndices = static_cast<uint32_t>(mesh.indices.size());
+	mesh.lods[0].error = 0.0f;
+
+	computeMeshNormals(mesh);
+	computeMeshBounds(mesh);
+}
+
+void computeMeshNormals(Mesh& mesh)
+{
+	eastl::vector<Vec3> normals(mesh.vertices.size(), makeVec3(0.0f, 0.0f, 0.0f));
+
+	const MeshLod& lod = mesh.lods[0];
+	for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.numIndices; i += 3)
+	{
+		uint32_t a = mesh.indices[i];
+		uint32_t b = mesh.indices[i + 1];
+		uint32_t c = mesh.indices[i + 2];
+
+		// area weighted, the cross product's length is twice the triangle's area
+		Vec3 normal = cross(getPosition(mesh.vertices[b]) - getPosition(mesh.vertices[a]), getPosition(mesh.vertices[c]) - getPosition(mesh.vertices[a]));
+		normals[a] = normals[a] + normal;
+		normals[b] = normals[b] + normal;
+		normals[c] = normals[c] + normal;
+	}
+
+	for (size_t i = 0; i < mesh.vertices.size(); ++i)
+	{
+		Vec3 normal = normalize(normals[i]);
+		mesh.vertices[i].normal[0] = normal.x;
+		mesh.vertices[i].normal[1] = normal.y;
+		mesh.vertices[i].normal[2] = normal.z;
+	}
+}
+
+void computeMeshBounds(Mesh& mesh)
+{
+	Vec3 min = makeVec3(INFINITY, INFINITY, INFINITY);
+	Vec3 max = makeVec3(-INFINITY, -INFINITY, -INFINITY);
+	for (const MeshVertex& vertex : mesh.vertices)
+	{
+		min = makeVec3(fminf(min.x, vertex.position[0]), fminf(min.y, vertex.position[1]), fminf(min.z, vertex.position[2]));
+		max = makeVec3(fmaxf(max.x, vertex.position[0]), fmaxf(max.y, vertex.position[1]), fmaxf(max.z, vertex.position[2]));
+	}
+
+	Vec3 center = (min + max) * 0.5f;
+	float radius = 0.0f;
+	for (const MeshVertex& vertex : mesh.vertices)
+	{
+		radius = fmaxf(radius, length(getPosition(vertex) - center));
+	}
+
+	mesh.boundsCenter[0] = center.x;
+	mesh.boundsCenter[1] = center.y;
+	mesh.boundsCenter[2] = center.z;
+	mesh.boundsRadius = radius;
+}
@@ -0,0 +1,70 @@
+#include "MeshShading.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "EngineContext.h"
+#include "Log.h"
+
+bool queryMeshShaderSupport(EngineContext& context)
+{
+	const char* setting = getenv("ENGINE_MESH_SHADERS");
+	if (setting && strcmp(setting, "0") == 0)
+	{
+		return false;
+	}
+
+	// mesh shaders are SPIR-V 1.4, which is core in 1.2
+	if (context.apiVersion < VK_API_VERSION_1_2 || context.physicalDeviceProperties.apiVersion < VK_API_VERSION_1_2)
+	{
+		return false;
+	}
+
+	if (!hasDeviceExtension(context, makeStringId(VK_EXT_MESH_SHADER_EXTENSION_NAME)))
+	{
+		return false;
+	}
+
+	VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures = {};
+	meshShaderFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &meshShaderFeatures;
+	vkGetPhysicalDeviceFeatures2(context.physicalDevice, &features);
+
+	return meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+}
+
+void chainMeshShaderFeatures(EngineContext& context, VkPhysicalDeviceMeshShaderFeaturesEXT& features, const void*& pNext)
+{
+	if (!context.meshShaders)
+	{
+		return;
+	}
+
+	features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+	features.pNext = const_cast<void*>(pNext);
+	features.taskShader = VK_TRUE;
+	features.meshShader = VK_TRUE;
+
+	pNext = &features;
+}
+
+void loadMeshShaderFunctions(EngineContext& context)
+{
+	if (!context.meshShaders)
+	{
+		Log::log("Mesh shaders not available, meshlets are drawn with the vertex shader path\n");
+		return;
+	}
+
+	context.cmdDrawMeshTasksIndirect = reinterpret_cast<PFN_vkCmdDrawMeshTasksIndirectEXT>(vkGetDeviceProcAddr(context.device, "vkCmdDrawMeshTasksIndirectEXT"));
+	if (!context.cmdDrawMeshTasksIndirect)
+	{
+		Log::fatal("Mesh shaders are enabled but vkCmdDrawMeshTasksIndirectEXT couldn't be loaded");
+	}
+
+	Log::log("Using mesh shaders (%s)\n", VK_EXT_MESH_SHADER_EXTENSION_NAME);
+}
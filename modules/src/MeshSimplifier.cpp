@@ -0,0 +1,358 @@
+#include "MeshSimplifier.h"
+
+#include <math.h>
+
+#include <EASTL/hash_map.h>
+#include <EASTL/sort.h>
+
+#include "Mesh.h"
+#include "VectorMath.h"
+
+// Plane quadrics are scaled up along borders so they don't get eaten away
+static const float BorderWeight = 10.0f;
+// Each pass only collapses the cheapest share of the edges, so costs stay close to sorted order
+static const float EdgesPerPass = 0.25f;
+static const float MaxNormalChange = 0.2f;
+
+// Symmetric 4x4 matrix, a11 a12 a13 a14 a22 a23 a24 a33 a34 a44
+struct Quadric
+{
+	double a[10];
+};
+
+struct EdgeFaces
+{
+	uint32_t count;
+	// first triangle with the edge, the only one of a border edge
+	uint32_t triangle;
+};
+
+struct Collapse
+{
+	uint32_t from;
+	uint32_t to;
+	double cost;
+};
+
+static Vec3 getPosition(const Mesh& mesh, uint32_t vertex)
+{
+	const float* position = mesh.vertices[vertex].position;
+	return makeVec3(position[0], position[1], position[2]);
+}
+
+static void addPlane(Quadric& quadric, const Vec3& normal, float d, float weight)
+{
+	double p[4] = { normal.x, normal.y, normal.z, d };
+	int k = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		for (int j = i; j < 4; ++j)
+		{
+			quadric.a[k++] += weight * p[i] * p[j];
+		}
+	}
+}
+
+static void addQuadric(Quadric& quadric, const Quadric& other)
+{
+	for (int i = 0; i < 10; ++i)
+	{
+		quadric.a[i] += other.a[i];
+	}
+}
+
+static double evaluateQuadric(const Quadric& q, const Vec3& v)
+{
+	const double* a = q.a;
+	double x = v.x;
+	double y = v.y;
+	double z = v.z;
+
+	double error = a[0] * x * x + 2 * a[1] * x * y + 2 * a[2] * x * z + 2 * a[3] * x
+		+ a[4] * y * y + 2 * a[5] * y * z + 2 * a[6] * y
+		+ a[7] * z * z + 2 * a[8] * z
+		+ a[9];
+
+	return error > 0.0 ? error : 0.0;
+}
+
+static uint64_t makeEdgeKey(uint32_t a, uint32_t b)
+{
+	return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+}
+
+static void computeQuadrics(const Mesh& mesh, const eastl::vector<uint32_t>& indices, eastl::vector<Quadric>& quadrics, eastl::vector<uint64_t>& edges)
+{
+	quadrics.assign(mesh.vertices.size(), Quadric());
+	for (Quadric& quadric : quadrics)
+	{
+		quadric = {};
+	}
+
+	// interior edges show up twice, once per adjacent triangle
+	eastl::hash_map<uint64_t, EdgeFaces> edgeFaces;
+	edgeFaces.reserve(indices.size());
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		Vec3 p[3] = { getPosition(mesh, indices[i]), getPosition(mesh, indices[i + 1]), getPosition(mesh, indices[i + 2]) };
+		Vec3 normal = cross(p[1] - p[0], p[2] - p[0]);
+		float area = length(normal);
+		if (area == 0.0f)
+		{
+			continue;
+		}
+		normal = normal * (1.0f / area);
+
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			addPlane(quadrics[indices[i + corner]], normal, -dot(normal, p[0]), 1.0f);
+
+			EdgeFaces newFaces = { 0, static_cast<uint32_t>(i / 3) };
+			uint64_t edge = makeEdgeKey(indices[i + corner], indices[i + (corner + 1) % 3]);
+			++edgeFaces.insert(eastl::make_pair(edge, newFaces)).first->second.count;
+		}
+	}
+
+	edges.clear();
+	edges.reserve(edgeFaces.size());
+	for (const auto& entry : edgeFaces)
+	{
+		edges.push_back(entry.first);
+	}
+	// the hash map's order depends on its buckets, collapses are made in edge order
+	eastl::sort(edges.begin(), edges.end());
+
+	for (uint64_t edge : edges)
+	{
+		const EdgeFaces& faces = edgeFaces.find(edge)->second;
+		if (faces.count != 1)
+		{
+			continue;
+		}
+
+		// constrain border vertices to a plane through the edge, perpendicular to its triangle
+		uint32_t a = static_cast<uint32_t>(edge >> 32);
+		uint32_t b = static_cast<uint32_t>(edge & 0xffffffff);
+		const uint32_t* corners = &indices[faces.triangle * 3];
+		Vec3 p0 = getPosition(mesh, corners[0]);
+		Vec3 faceNormal = normalize(cross(getPosition(mesh, corners[1]) - p0, getPosition(mesh, corners[2]) - p0));
+		Vec3 borderNormal = normalize(cross(getPosition(mesh, b) - getPosition(mesh, a), faceNormal));
+		float d = -dot(borderNormal, getPosition(mesh, a));
+		addPlane(quadrics[a], borderNormal, d, BorderWeight);
+		addPlane(quadrics[b], borderNormal, d, BorderWeight);
+	}
+}
+
+// A collapse must not turn any of the triangles around the moved vertex over or make it degenerate
+static bool isCollapseValid(const Mesh& mesh, const eastl::vector<uint32_t>& indices, const eastl::vector<uint32_t>& triangleOffsets, const eastl::vector<uint32_t>& vertexTriangles, uint32_t from, uint32_t to)
+{
+	Vec3 target = getPosition(mesh, to);
+
+	for (uint32_t i = triangleOffsets[from]; i < triangleOffsets[from + 1]; ++i)
+	{
+		uint32_t triangle = vertexTriangles[i];
+		const uint32_t* corners = &indices[triangle * 3];
+		if (corners[0] == to || corners[1] == to || corners[2] == to)
+		{
+			// this one collapses away
+			continue;
+		}
+
+		Vec3 before[3];
+		Vec3 after[3];
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			before[corner] = getPosition(mesh, corners[corner]);
+			after[corner] = corners[corner] == from ? target : before[corner];
+		}
+
+		Vec3 normalBefore = normalize(cross(before[1] - before[0], before[2] - before[0]));
+		Vec3 normalAfter = cross(after[1] - after[0], after[2] - after[0]);
+		if (length(normalAfter) == 0.0f || dot(normalBefore, normalize(normalAfter)) < MaxNormalChange)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+float simplifyMesh(const Mesh& mesh, const uint32_t* inputIndices, uint32_t numIndices, uint32_t targetNumIndices, eastl::vector<uint32_t>& result)
+{
+	result.assign(inputIndices, inputIndices + numIndices);
+
+	uint32_t numVertices = static_cast<uint32_t>(mesh.vertices.size());
+	eastl::vector<Quadric> quadrics;
+	eastl::vector<uint64_t> edges;
+	computeQuadrics(mesh, result, quadrics, edges);
+
+	eastl::vector<uint32_t> remap(numVertices);
+	eastl::vector<bool> locked(numVertices);
+	eastl::vector<uint32_t> triangleOffsets(numVertices + 1);
+	eastl::vector<uint32_t> vertexTriangles;
+	eastl::vector<Collapse> collapses;
+
+	double maxError = 0.0;
+
+	while (result.size() > targetNumIndices)
+	{
+		// vertex to triangle adjacency, rebuilt every pass
+		eastl::fill(triangleOffsets.begin(), triangleOffsets.end(), 0u);
+		for (uint32_t index : result)
+		{
+			++triangleOffsets[index + 1];
+		}
+		for (uint32_t i = 0; i < numVertices; ++i)
+		{
+			triangleOffsets[i + 1] += triangleOffsets[i];
+		}
+		vertexTriangles.resize(result.size());
+		eastl::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (uint32_t i = 0; i < result.size(); ++i)
+		{
+			vertexTriangles[fill[result[i]]++] = i / 3;
+		}
+
+		collapses.clear();
+		for (uint64_t edge : edges)
+		{
+			uint32_t a = static_cast<uint32_t>(edge >> 32);
+			uint32_t b = static_cast<uint32_t>(edge & 0xffffffff);
+
+			Quadric combined = quadrics[a];
+			addQuadric(combined, quadrics[b]);
+
+			Collapse collapse;
+			double costToB = evaluateQuadric(combined, getPosition(mesh, b));
+			double costToA = evaluateQuadric(combined, getPosition(mesh, a));
+			collapse.from = costToB <= costToA ? a : b;
+			collapse.to = costToB <= costToA ? b : a;
+			collapse.cost = costToB <= costToA ? costToB : costToA;
+			collapses.push_back(collapse);
+		}
+
+		eastl::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y)
+		{
+			return x.cost < y.cost;
+		});
+
+		for (uint32_t i = 0; i < numVertices; ++i)
+		{
+			remap[i] = i;
+		}
+		eastl::fill(locked.begin(), locked.end(), false);
+
+		// every collapse removes about two triangles
+		size_t numTrianglesToRemove = (result.size() - targetNumIndices) / 3;
+		size_t maxCollapses = static_cast<size_t>(collapses.size() * EdgesPerPass) + 1;
+		size_t numTrianglesRemoved = 0;
+		size_t numCollapsed = 0;
+
+		for (size_t i = 0; i < collapses.size() && numCollapsed < maxCollapses && numTrianglesRemoved < numTrianglesToRemove; ++i)
+		{
+			const Collapse& collapse = collapses[i];
+			if (locked[collapse.from] || locked[collapse.to])
+			{
+				continue;
+			}
+
+			if (!isCollapseValid(mesh, result, triangleOffsets, vertexTriangles, collapse.from, collapse.to))
+			{
+				continue;
+			}
+
+			remap[collapse.from] = collapse.to;
+			addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+			maxError = collapse.cost > maxError ? collapse.cost : maxError;
+
+			// the triangles around the removed vertex change, so none of their vertices can move again this pass
+			for (uint32_t t = triangleOffsets[collapse.from]; t < triangleOffsets[collapse.from + 1]; ++t)
+			{
+				const uint32_t* corners = &result[vertexTriangles[t] * 3];
+				locked[corners[0]] = true;
+				locked[corners[1]] = true;
+				locked[corners[2]] = true;
+
+				if (corners[0] == collapse.to || corners[1] == collapse.to || corners[2] == collapse.to)
+				{
+					++numTrianglesRemoved;
+				}
+			}
+
+			++numCollapsed;
+		}
+
+		if (numCollapsed == 0)
+		{
+			break;
+		}
+
+		size_t numKept = 0;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			uint32_t a = remap[result[i]];
+			uint32_t b = remap[result[i + 1]];
+			uint32_t c = remap[result[i + 2]];
+			if (a == b || b == c || c == a)
+			{
+				continue;
+			}
+
+			result[numKept++] = a;
+			result[numKept++] = b;
+			result[numKept++] = c;
+		}
+		result.resize(numKept);
+
+		eastl::vector<uint64_t> remainingEdges;
+		for (uint64_t edge : edges)
+		{
+			uint32_t a = remap[static_cast<uint32_t>(edge >> 32)];
+			uint32_t b = remap[static_cast<uint32_t>(edge & 0xffffffff)];
+			if (a != b)
+			{
+				remainingEdges.push_back(makeEdgeKey(a, b));
+			}
+		}
+		eastl::sort(remainingEdges.begin(), remainingEdges.end());
+		remainingEdges.erase(eastl::unique(remainingEdges.begin(), remainingEdges.end()), remainingEdges.end());
+		edges.swap(remainingEdges);
+	}
+
+	return static_cast<float>(sqrt(maxError));
+}
+
+void generateMeshLods(Mesh& mesh, float reduction, uint32_t minTriangles)
+{
+	eastl::vector<uint32_t> indices(mesh.indices.begin() + mesh.lods[0].firstIndex, mesh.indices.begin() + mesh.lods[0].firstIndex + mesh.lods[0].numIndices);
+	mesh.indices = indices;
+	mesh.lods[0].firstIndex = 0;
+	mesh.lods[0].error = 0.0f;
+	mesh.numLods = 1;
+
+	eastl::vector<uint32_t> simplified;
+	while (mesh.numLods < MaxMeshLods)
+	{
+		const MeshLod& previous = mesh.lods[mesh.numLods - 1];
+		uint32_t target = static_cast<uint32_t>(previous.numIndices / 3 * reduction) * 3;
+		if (target / 3 < minTriangles)
+		{
+			break;
+		}
+
+		float error = simplifyMesh(mesh, &mesh.indices[previous.firstIndex], previous.numIndices, target, simplified);
+		if (simplified.size() > previous.numIndices * (1.0f + reduction) * 0.5f)
+		{
+			// stuck well short of the target, the remaining collapses would all be invalid
+			break;
+		}
+
+		MeshLod& lod = mesh.lods[mesh.numLods++];
+		lod.firstIndex = static_cast<uint32_t>(mesh.indices.size());
+		lod.numIndices = static_cast<uint32_t>(simplified.size());
+		// simplifying from the previous level builds on its error
+		lod.error = previous.error + error;
+
+		mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+	}
+}
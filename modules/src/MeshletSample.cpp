@@ -0,0 +1,533 @@
+#include "MeshletSample.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <EASTL/vector.h>
+
+#include "Clock.h"
+#include "ComputePass.h"
+#include "DepthPyramid.h"
+#include "EngineContext.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "Mesh.h"
+#include "Meshlets.h"
+#include "PipelineCache.h"
+#include "RenderCommands.h"
+#include "ShadowMaps.h"
+
+static const uint32_t GridSize = 16;
+static const uint32_t NumInstances = GridSize * GridSize;
+static const float GridSpacing = 2.5f;
+
+static const uint32_t MeshSubdivisions = 5;
+static const float MeshBumpiness = 0.1f;
+
+// must match the local size in meshletcull.comp
+static const uint32_t CullGroupSize = 64;
+// the draw shaders use the first NumDrawBindings, the culling pass adds the occlusion state
+static const uint32_t NumDrawBindings = 8;
+static const uint32_t NumCullBindings = 11;
+static const uint32_t DepthPyramidBinding = 10;
+
+enum CullPhase
+{
+	// meshlets tested against the previous frame's depth pyramid
+	CullPhase_Early,
+	// meshlets the early phase found occluded, tested again against this frame's pyramid
+	CullPhase_Late,
+	NumCullPhases
+};
+
+static const double StatsInterval = 5.0;
+
+// std140 layout of Scene in meshlet.glsl
+struct MeshletSceneUniforms
+{
+	float viewProjection[16];
+	float eye[4];
+	float frustumPlanes[6][4];
+	uint32_t counts[4];
+	uint32_t pyramid[4];
+};
+
+// std430 layout of DrawArgs in meshlet.glsl
+struct MeshletDrawArgs
+{
+	VkDrawIndirectCommand draw;
+	VkDrawMeshTasksIndirectCommandEXT meshTasks;
+	uint32_t padding;
+};
+
+// std430 layout of OcclusionArgs in meshletcull.comp
+struct MeshletOcclusionArgs
+{
+	VkDispatchIndirectCommand lateDispatch;
+	uint32_t numOccluded;
+};
+
+struct MeshletSample
+{
+	Mesh mesh;
+	MeshletMesh meshlets;
+	uint32_t numMeshlets;
+
+	GpuBuffer meshletBuffer;
+	GpuBuffer meshletVertexBuffer;
+	GpuBuffer meshletTriangleBuffer;
+	GpuBuffer vertexBuffer;
+	GpuBuffer instanceBuffer;
+	// plain positions and triangles, the shadow maps don't draw meshlets
+	GpuBuffer shadowPositionBuffer;
+	GpuBuffer shadowIndexBuffer;
+
+	// per frame in flight. The arguments are host visible so the counts can be logged.
+	GpuBuffer sceneBuffers[MAX_FRAMES_IN_FLIGHT];
+	GpuBuffer visibleBuffers[MAX_FRAMES_IN_FLIGHT][NumCullPhases];
+	GpuBuffer argsBuffers[MAX_FRAMES_IN_FLIGHT][NumCullPhases];
+	GpuBuffer occludedBuffers[MAX_FRAMES_IN_FLIGHT];
+	GpuBuffer occlusionArgsBuffers[MAX_FRAMES_IN_FLIGHT];
+
+	ComputePipeline cullPipeline;
+	VkDescriptorSet cullSets[MAX_FRAMES_IN_FLIGHT][NumCullPhases];
+
+	VkDescriptorSetLayout drawSetLayout;
+	VkPipelineLayout drawPipelineLayout;
+	PipelineDesc drawPipelineDesc;
+	VkDescriptorSet drawSets[MAX_FRAMES_IN_FLIGHT][NumCullPhases];
+
+	bool logStats;
+	double lastStatsTime;
+};
+
+bool isMeshletSampleRequested()
+{
+	const char* setting = getenv("ENGINE_MESHLETS");
+	return setting && strcmp(setting, "0") != 0;
+}
+
+static void writeBufferDescriptor(EngineContext& context, VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const GpuBuffer& buffer)
+{
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer.buffer;
+	bufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+	write.pBufferInfo = &bufferInfo;
+
+	vkUpdateDescriptorSets(context.device, 1, &write, 0, nullptr);
+}
+
+static VkDescriptorType getBindingType(uint32_t binding)
+{
+	if (binding == 0)
+	{
+		return VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	}
+	return binding == DepthPyramidBinding ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+}
+
+static void makeBindings(VkDescriptorSetLayoutBinding* bindings, uint32_t numBindings, VkShaderStageFlags stages)
+{
+	for (uint32_t i = 0; i < numBindings; ++i)
+	{
+		bindings[i] = {};
+		bindings[i].binding = i;
+		bindings[i].descriptorType = getBindingType(i);
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = stages;
+	}
+}
+
+static void writeDescriptors(EngineContext& context, MeshletSample& sample, VkDescriptorSet set, uint32_t numBindings, uint32_t slot, CullPhase phase)
+{
+	const GpuBuffer* buffers[NumCullBindings - 1] =
+	{
+		&sample.sceneBuffers[slot],
+		&sample.meshletBuffer,
+		&sample.meshletVertexBuffer,
+		&sample.meshletTriangleBuffer,
+		&sample.vertexBuffer,
+		&sample.instanceBuffer,
+		&sample.visibleBuffers[slot][phase],
+		&sample.argsBuffers[slot][phase],
+		&sample.occludedBuffers[slot],
+		&sample.occlusionArgsBuffers[slot],
+	};
+
+	for (uint32_t i = 0; i < numBindings && i < DepthPyramidBinding; ++i)
+	{
+		writeBufferDescriptor(context, set, i, getBindingType(i), *buffers[i]);
+	}
+
+	if (numBindings > DepthPyramidBinding)
+	{
+		VkDescriptorImageInfo imageInfo = getDepthPyramidDescriptor(context);
+
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = set;
+		write.dstBinding = DepthPyramidBinding;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets(context.device, 1, &write, 0, nullptr);
+	}
+}
+
+static void createStaticBuffer(EngineContext& context, const void* data, VkDeviceSize size, GpuBuffer& buffer)
+{
+	createGpuBuffer(context, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer);
+	uploadToGpuBuffer(context, buffer, data, size);
+}
+
+// The field is static, so it only has to be drawn again into the cached cascades when the light moves
+static void addFieldShadowCaster(EngineContext& context, MeshletSample& sample, const float* instances)
+{
+	const Mesh& mesh = sample.mesh;
+	createShadowPositionBuffer(context, mesh.vertices.data(), static_cast<uint32_t>(mesh.vertices.size()), sample.shadowPositionBuffer);
+	createStaticBuffer(context, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t), sample.shadowIndexBuffer);
+
+	ShadowCasterDesc desc = {};
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		desc.positionBuffers[i] = sample.shadowPositionBuffer.buffer;
+	}
+	desc.indexBuffer = sample.shadowIndexBuffer.buffer;
+	for (uint32_t i = 0; i < MaxShadowCascades; ++i)
+	{
+		desc.firstIndex[i] = mesh.lods[0].firstIndex;
+		desc.numIndices[i] = mesh.lods[0].numIndices;
+	}
+	desc.isStatic = true;
+
+	eastl::vector<ShadowInstance> shadowInstances(NumInstances);
+	for (uint32_t i = 0; i < NumInstances; ++i)
+	{
+		const float* instance = &instances[i * 4];
+		ShadowInstance& shadowInstance = shadowInstances[i];
+		shadowInstance.position = makeVec3(instance[0], instance[1], instance[2]);
+		shadowInstance.scale = instance[3];
+		shadowInstance.boundsCenter = shadowInstance.position + makeVec3(mesh.boundsCenter[0], mesh.boundsCenter[1], mesh.boundsCenter[2]) * instance[3];
+		shadowInstance.boundsRadius = mesh.boundsRadius * instance[3];
+	}
+
+	uint32_t caster = addShadowCaster(context, desc);
+	setShadowCasterInstances(context, caster, shadowInstances.data(), NumInstances);
+}
+
+static void createDrawPipeline(EngineContext& context, MeshletSample& sample)
+{
+	VkShaderStageFlags stages = context.meshShaders ? VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT : VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutBinding bindings[NumDrawBindings];
+	makeBindings(bindings, NumDrawBindings, stages);
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = NumDrawBindings;
+	setLayoutInfo.pBindings = bindings;
+
+	VkResult result = vkCreateDescriptorSetLayout(context.device, &setLayoutInfo, nullptr, &sample.drawSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create meshlet descriptor set layout");
+	}
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &sample.drawSetLayout;
+
+	result = vkCreatePipelineLayout(context.device, &layoutInfo, nullptr, &sample.drawPipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create meshlet pipeline layout");
+	}
+
+	sample.drawPipelineDesc = makeDefaultPipelineDesc();
+	if (context.meshShaders)
+	{
+		sample.drawPipelineDesc.taskShader = "meshlet.task";
+		sample.drawPipelineDesc.meshShader = "meshlet.mesh";
+	}
+	else
+	{
+		sample.drawPipelineDesc.vertexShader = "meshlet.vert";
+	}
+	sample.drawPipelineDesc.fragmentShader = "meshlet.frag";
+	sample.drawPipelineDesc.layout = sample.drawPipelineLayout;
+	sample.drawPipelineDesc.depthTestEnable = VK_TRUE;
+	sample.drawPipelineDesc.depthWriteEnable = VK_TRUE;
+	sample.drawPipelineDesc.renderPass = context.renderPass;
+	sample.drawPipelineDesc.colorFormat = context.sceneColorFormat;
+	sample.drawPipelineDesc.depthFormat = context.depthFormat;
+
+	getPipeline(context, sample.drawPipelineDesc);
+}
+
+void createMeshletSample(EngineContext& context)
+{
+	MeshletSample* sample = new MeshletSample;
+	*sample = {};
+
+	makeBumpySphereMesh(MeshSubdivisions, MeshBumpiness, sample->mesh);
+	buildMeshlets(sample->mesh, 0, sample->meshlets);
+	sample->numMeshlets = static_cast<uint32_t>(sample->meshlets.meshlets.size());
+
+	Log::log("Mesh split into %u meshlets, %.1f triangles and %.1f vertices on average\n", sample->numMeshlets,
+		static_cast<float>(sample->meshlets.triangles.size()) / sample->numMeshlets,
+		static_cast<float>(sample->meshlets.vertices.size()) / sample->numMeshlets);
+
+	// same layout as the level of detail sample
+	eastl::vector<float> instances(NumInstances * 4);
+	float offset = (GridSize - 1) * GridSpacing * 0.5f;
+	for (uint32_t z = 0; z < GridSize; ++z)
+	{
+		for (uint32_t x = 0; x < GridSize; ++x)
+		{
+			float* instance = &instances[(z * GridSize + x) * 4];
+			float scale = 0.6f + (static_cast<float>(rand()) / RAND_MAX) * 0.4f;
+			instance[0] = x * GridSpacing - offset;
+			instance[1] = scale;
+			instance[2] = z * GridSpacing - offset;
+			instance[3] = scale;
+		}
+	}
+
+	const MeshletMesh& meshlets = sample->meshlets;
+	createStaticBuffer(context, meshlets.meshlets.data(), meshlets.meshlets.size() * sizeof(Meshlet), sample->meshletBuffer);
+	createStaticBuffer(context, meshlets.vertices.data(), meshlets.vertices.size() * sizeof(uint32_t), sample->meshletVertexBuffer);
+	createStaticBuffer(context, meshlets.triangles.data(), meshlets.triangles.size() * sizeof(uint32_t), sample->meshletTriangleBuffer);
+	createStaticBuffer(context, sample->mesh.vertices.data(), sample->mesh.vertices.size() * sizeof(MeshVertex), sample->vertexBuffer);
+	createStaticBuffer(context, instances.data(), instances.size() * sizeof(float), sample->instanceBuffer);
+	addFieldShadowCaster(context, *sample, instances.data());
+
+	VkDeviceSize listSize = NumInstances * sample->numMeshlets * 2 * sizeof(uint32_t);
+	VkBufferUsageFlags argsUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		createGpuBuffer(context, sizeof(MeshletSceneUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, sample->sceneBuffers[i]);
+		for (uint32_t phase = 0; phase < NumCullPhases; ++phase)
+		{
+			createGpuBuffer(context, listSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->visibleBuffers[i][phase]);
+			createGpuBuffer(context, sizeof(MeshletDrawArgs), argsUsage, hostVisible, sample->argsBuffers[i][phase]);
+		}
+		createGpuBuffer(context, listSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->occludedBuffers[i]);
+		createGpuBuffer(context, sizeof(MeshletOcclusionArgs), argsUsage, hostVisible, sample->occlusionArgsBuffers[i]);
+	}
+
+	VkDescriptorSetLayoutBinding bindings[NumCullBindings];
+	makeBindings(bindings, NumCullBindings, VK_SHADER_STAGE_COMPUTE_BIT);
+	createComputePipeline(context, "meshletcull.comp.spv", bindings, NumCullBindings, sizeof(uint32_t), sample->cullPipeline);
+
+	createDrawPipeline(context, *sample);
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		for (uint32_t phase = 0; phase < NumCullPhases; ++phase)
+		{
+			sample->cullSets[i][phase] = allocateDescriptorSet(context, sample->cullPipeline.descriptorSetLayout);
+			sample->drawSets[i][phase] = allocateDescriptorSet(context, sample->drawSetLayout);
+			writeDescriptors(context, *sample, sample->cullSets[i][phase], NumCullBindings, i, static_cast<CullPhase>(phase));
+			writeDescriptors(context, *sample, sample->drawSets[i][phase], NumDrawBindings, i, static_cast<CullPhase>(phase));
+		}
+	}
+
+	const char* logStats = getenv("ENGINE_MESHLET_STATS");
+	sample->logStats = logStats && strcmp(logStats, "0") != 0;
+	sample->lastStatsTime = getEngineTime();
+
+	context.meshletSample = sample;
+}
+
+void destroyMeshletSample(EngineContext& context)
+{
+	MeshletSample* sample = context.meshletSample;
+	if (!sample)
+	{
+		return;
+	}
+
+	vkDestroyPipelineLayout(context.device, sample->drawPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(context.device, sample->drawSetLayout, nullptr);
+	destroyComputePipeline(context, sample->cullPipeline);
+
+	destroyGpuBuffer(context, sample->meshletBuffer);
+	destroyGpuBuffer(context, sample->meshletVertexBuffer);
+	destroyGpuBuffer(context, sample->meshletTriangleBuffer);
+	destroyGpuBuffer(context, sample->vertexBuffer);
+	destroyGpuBuffer(context, sample->instanceBuffer);
+	destroyGpuBuffer(context, sample->shadowPositionBuffer);
+	destroyGpuBuffer(context, sample->shadowIndexBuffer);
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		destroyGpuBuffer(context, sample->sceneBuffers[i]);
+		for (uint32_t phase = 0; phase < NumCullPhases; ++phase)
+		{
+			destroyGpuBuffer(context, sample->visibleBuffers[i][phase]);
+			destroyGpuBuffer(context, sample->argsBuffers[i][phase]);
+		}
+		destroyGpuBuffer(context, sample->occludedBuffers[i]);
+		destroyGpuBuffer(context, sample->occlusionArgsBuffers[i]);
+	}
+
+	delete sample;
+	context.meshletSample = nullptr;
+}
+
+static void updateScene(EngineContext& context, MeshletSample& sample, GpuBuffer& buffer)
+{
+	const Camera& camera = context.camera;
+
+	MeshletSceneUniforms uniforms = {};
+	memcpy(uniforms.viewProjection, camera.viewProjection.m, sizeof(uniforms.viewProjection));
+	uniforms.eye[0] = camera.position.x;
+	uniforms.eye[1] = camera.position.y;
+	uniforms.eye[2] = camera.position.z;
+	uniforms.eye[3] = 1.0f;
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		uniforms.frustumPlanes[i][0] = camera.frustumPlanes[i].normal.x;
+		uniforms.frustumPlanes[i][1] = camera.frustumPlanes[i].normal.y;
+		uniforms.frustumPlanes[i][2] = camera.frustumPlanes[i].normal.z;
+		uniforms.frustumPlanes[i][3] = camera.frustumPlanes[i].d;
+	}
+	uniforms.counts[0] = sample.numMeshlets;
+	uniforms.counts[1] = NumInstances;
+	getDepthPyramidSize(context, uniforms.pyramid[0], uniforms.pyramid[1], uniforms.pyramid[2]);
+	// the late phase always tests, the early phase only once a previous frame left a pyramid behind
+	uniforms.pyramid[3] = isDepthPyramidBuilt(context) ? 1 : 0;
+
+	memcpy(buffer.mapped, &uniforms, sizeof(uniforms));
+}
+
+static void recordCullBarrier(EngineContext& context, VkCommandBuffer commandBuffer, VkPipelineStageFlags srcStage, VkAccessFlags srcAccess)
+{
+	VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+	if (context.meshShaders)
+	{
+		dstStage |= VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT;
+	}
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void cullMeshletSampleEarly(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	MeshletSample* sample = context.meshletSample;
+	if (!sample)
+	{
+		return;
+	}
+
+	uint32_t slot = context.currentFrame;
+
+	// the frame's fence was waited on, so its arguments hold the counts culled two frames ago
+	double time = getEngineTime();
+	if (sample->logStats && time - sample->lastStatsTime >= StatsInterval)
+	{
+		const MeshletDrawArgs* earlyArgs = static_cast<const MeshletDrawArgs*>(sample->argsBuffers[slot][CullPhase_Early].mapped);
+		const MeshletDrawArgs* lateArgs = static_cast<const MeshletDrawArgs*>(sample->argsBuffers[slot][CullPhase_Late].mapped);
+		const MeshletOcclusionArgs* occlusionArgs = static_cast<const MeshletOcclusionArgs*>(sample->occlusionArgsBuffers[slot].mapped);
+		Log::log("Meshlets: %u of %u drawn, %u drawn early, %u of %u occluded meshlets disoccluded\n",
+			earlyArgs->draw.instanceCount + lateArgs->draw.instanceCount, NumInstances * sample->numMeshlets,
+			earlyArgs->draw.instanceCount, lateArgs->draw.instanceCount, occlusionArgs->numOccluded);
+		sample->lastStatsTime = time;
+	}
+
+	updateScene(context, *sample, sample->sceneBuffers[slot]);
+
+	MeshletDrawArgs args = {};
+	args.draw.vertexCount = MaxMeshletTriangles * 3;
+	args.meshTasks.groupCountY = 1;
+	args.meshTasks.groupCountZ = 1;
+	MeshletOcclusionArgs occlusionArgs = {};
+	occlusionArgs.lateDispatch.y = 1;
+	occlusionArgs.lateDispatch.z = 1;
+	for (uint32_t phase = 0; phase < NumCullPhases; ++phase)
+	{
+		vkCmdUpdateBuffer(commandBuffer, sample->argsBuffers[slot][phase].buffer, 0, sizeof(args), &args);
+	}
+	vkCmdUpdateBuffer(commandBuffer, sample->occlusionArgsBuffers[slot].buffer, 0, sizeof(occlusionArgs), &occlusionArgs);
+
+	// the culling pass counts into the reset arguments
+	recordCullBarrier(context, commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+	uint32_t phase = CullPhase_Early;
+	uint32_t numGroups = (NumInstances * sample->numMeshlets + CullGroupSize - 1) / CullGroupSize;
+	dispatchCompute(commandBuffer, sample->cullPipeline, sample->cullSets[slot][CullPhase_Early], &phase, numGroups, 1, 1);
+
+	recordCullBarrier(context, commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+}
+
+void cullMeshletSampleLate(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	MeshletSample* sample = context.meshletSample;
+	if (!sample)
+	{
+		return;
+	}
+
+	uint32_t slot = context.currentFrame;
+
+	uint32_t phase = CullPhase_Late;
+	dispatchComputeIndirect(commandBuffer, sample->cullPipeline, sample->cullSets[slot][CullPhase_Late], &phase,
+		sample->occlusionArgsBuffers[slot].buffer, offsetof(MeshletOcclusionArgs, lateDispatch));
+
+	recordCullBarrier(context, commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+
+	// the counts are read back for the stats once the frame's fence signals
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void emitMeshletSample(EngineContext& context)
+{
+	MeshletSample* sample = context.meshletSample;
+	if (!sample)
+	{
+		return;
+	}
+
+	VkPipeline pipeline = getPipeline(context, sample->drawPipelineDesc);
+	const DrawPass passes[NumCullPhases] = { DrawPass_Opaque, DrawPass_OpaqueLate };
+
+	for (uint32_t phase = 0; phase < NumCullPhases; ++phase)
+	{
+		DrawPacket packet = {};
+		packet.pipeline = pipeline;
+		packet.pipelineLayout = sample->drawPipelineLayout;
+		packet.descriptorSet = sample->drawSets[context.currentFrame][phase];
+		packet.sortKey = makeDrawSortKey(passes[phase], packet.pipeline, 0, 0.0f);
+		packet.indirectBuffer = sample->argsBuffers[context.currentFrame][phase].buffer;
+		if (context.meshShaders)
+		{
+			packet.drawType = DrawType_MeshTasksIndirect;
+			packet.indirectOffset = offsetof(MeshletDrawArgs, meshTasks);
+		}
+		else
+		{
+			packet.drawType = DrawType_Indirect;
+			packet.indirectOffset = offsetof(MeshletDrawArgs, draw);
+		}
+
+		emitDrawPacket(context, packet);
+	}
+}
@@ -0,0 +1,233 @@
+#include "Meshlets.h"
+
+#include <math.h>
+
+#include "Mesh.h"
+#include "VectorMath.h"
+
+static const uint32_t NoSlot = ~0u;
+
+static Vec3 getPosition(const Mesh& mesh, uint32_t vertex)
+{
+	const float* position = mesh.vertices[vertex].position;
+	return makeVec3(position[0], position[1], position[2]);
+}
+
+static void computeMeshletBounds(const Mesh& mesh, MeshletMesh& result, Meshlet& meshlet)
+{
+	Vec3 center = makeVec3(0.0f, 0.0f, 0.0f);
+	for (uint32_t i = 0; i < meshlet.numVertices; ++i)
+	{
+		center = center + getPosition(mesh, result.vertices[meshlet.vertexOffset + i]);
+	}
+	center = center * (1.0f / meshlet.numVertices);
+
+	float radius = 0.0f;
+	for (uint32_t i = 0; i < meshlet.numVertices; ++i)
+	{
+		radius = fmaxf(radius, length(getPosition(mesh, result.vertices[meshlet.vertexOffset + i]) - center));
+	}
+
+	Vec3 normals[MaxMeshletTriangles];
+	Vec3 axis = makeVec3(0.0f, 0.0f, 0.0f);
+	for (uint32_t i = 0; i < meshlet.numTriangles; ++i)
+	{
+		uint32_t packed = result.triangles[meshlet.triangleOffset + i];
+		Vec3 a = getPosition(mesh, result.vertices[meshlet.vertexOffset + (packed & 0xff)]);
+		Vec3 b = getPosition(mesh, result.vertices[meshlet.vertexOffset + ((packed >> 8) & 0xff)]);
+		Vec3 c = getPosition(mesh, result.vertices[meshlet.vertexOffset + ((packed >> 16) & 0xff)]);
+
+		Vec3 normal = cross(b - a, c - a);
+		float area = length(normal);
+		normals[i] = area > 0.0f ? normal * (1.0f / area) : makeVec3(0.0f, 0.0f, 0.0f);
+		axis = axis + normals[i];
+	}
+
+	float axisLength = length(axis);
+	axis = axisLength > 0.0f ? axis * (1.0f / axisLength) : makeVec3(1.0f, 0.0f, 0.0f);
+
+	float minDot = axisLength > 0.0f ? 1.0f : -1.0f;
+	for (uint32_t i = 0; i < meshlet.numTriangles; ++i)
+	{
+		minDot = fminf(minDot, dot(normals[i], axis));
+	}
+
+	meshlet.center[0] = center.x;
+	meshlet.center[1] = center.y;
+	meshlet.center[2] = center.z;
+	meshlet.radius = radius;
+
+	meshlet.coneAxis[0] = axis.x;
+	meshlet.coneAxis[1] = axis.y;
+	meshlet.coneAxis[2] = axis.z;
+	// sine of the cone's half angle, a cone wider than a hemisphere can't be culled
+	meshlet.coneCutoff = minDot > 0.0f ? sqrtf(1.0f - minDot * minDot) : 1.0f;
+}
+
+static uint32_t findBorderTriangle(const MeshletMesh& result, const Meshlet& meshlet, const eastl::vector<uint32_t>& triangleOffsets, const eastl::vector<uint32_t>& vertexTriangles, const eastl::vector<bool>& emitted)
+{
+	for (uint32_t v = 0; v < meshlet.numVertices; ++v)
+	{
+		uint32_t vertex = result.vertices[meshlet.vertexOffset + v];
+		for (uint32_t t = triangleOffsets[vertex]; t < triangleOffsets[vertex + 1]; ++t)
+		{
+			if (!emitted[vertexTriangles[t]])
+			{
+				return vertexTriangles[t];
+			}
+		}
+	}
+
+	return NoSlot;
+}
+
+void buildMeshlets(const Mesh& mesh, uint32_t lod, MeshletMesh& result)
+{
+	result.meshlets.clear();
+	result.vertices.clear();
+	result.triangles.clear();
+
+	const uint32_t* indices = &mesh.indices[mesh.lods[lod].firstIndex];
+	uint32_t numTriangles = mesh.lods[lod].numIndices / 3;
+	uint32_t numVertices = static_cast<uint32_t>(mesh.vertices.size());
+
+	// vertex to triangle adjacency
+	eastl::vector<uint32_t> triangleOffsets(numVertices + 1, 0);
+	for (uint32_t i = 0; i < numTriangles * 3; ++i)
+	{
+		++triangleOffsets[indices[i] + 1];
+	}
+	for (uint32_t i = 0; i < numVertices; ++i)
+	{
+		triangleOffsets[i + 1] += triangleOffsets[i];
+	}
+	eastl::vector<uint32_t> vertexTriangles(numTriangles * 3);
+	eastl::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+	for (uint32_t i = 0; i < numTriangles * 3; ++i)
+	{
+		vertexTriangles[fill[indices[i]]++] = i / 3;
+	}
+
+	// triangles of each vertex that aren't in a meshlet yet
+	eastl::vector<uint32_t> liveTriangles(numVertices);
+	for (uint32_t i = 0; i < numVertices; ++i)
+	{
+		liveTriangles[i] = triangleOffsets[i + 1] - triangleOffsets[i];
+	}
+
+	eastl::vector<bool> emitted(numTriangles, false);
+	// position of each mesh vertex in the meshlet being built
+	eastl::vector<uint32_t> slots(numVertices, NoSlot);
+	uint32_t nextSeed = 0;
+
+	Meshlet meshlet = {};
+	Vec3 vertexSum = makeVec3(0.0f, 0.0f, 0.0f);
+
+	for (;;)
+	{
+		// among the triangles touching the meshlet, pick the one that needs the fewest new vertices,
+		// then the one in the most used up corner, then the one closest to the meshlet's center
+		Vec3 meshletCenter = meshlet.numVertices > 0 ? vertexSum * (1.0f / meshlet.numVertices) : vertexSum;
+		uint32_t best = NoSlot;
+		uint32_t bestNewVertices = 4;
+		uint32_t bestNumLive = ~0u;
+		float bestDistance = INFINITY;
+		for (uint32_t v = 0; v < meshlet.numVertices; ++v)
+		{
+			uint32_t vertex = result.vertices[meshlet.vertexOffset + v];
+			for (uint32_t t = triangleOffsets[vertex]; t < triangleOffsets[vertex + 1]; ++t)
+			{
+				uint32_t triangle = vertexTriangles[t];
+				if (emitted[triangle])
+				{
+					continue;
+				}
+
+				uint32_t newVertices = 0;
+				for (uint32_t corner = 0; corner < 3; ++corner)
+				{
+					newVertices += slots[indices[triangle * 3 + corner]] == NoSlot ? 1 : 0;
+				}
+
+				if (newVertices > bestNewVertices)
+				{
+					continue;
+				}
+
+				// triangles whose vertices have few triangles left would otherwise end up stranded
+				uint32_t numLive = 0;
+				for (uint32_t corner = 0; corner < 3; ++corner)
+				{
+					numLive += liveTriangles[indices[triangle * 3 + corner]];
+				}
+
+				Vec3 triangleCenter = (getPosition(mesh, indices[triangle * 3]) + getPosition(mesh, indices[triangle * 3 + 1]) + getPosition(mesh, indices[triangle * 3 + 2])) * (1.0f / 3.0f);
+				Vec3 offset = triangleCenter - meshletCenter;
+				float distance = dot(offset, offset);
+
+				bool better = newVertices < bestNewVertices ||
+					(newVertices == bestNewVertices && (numLive < bestNumLive || (numLive == bestNumLive && distance < bestDistance)));
+				if (better)
+				{
+					best = triangle;
+					bestNewVertices = newVertices;
+					bestNumLive = numLive;
+					bestDistance = distance;
+				}
+			}
+		}
+
+		bool full = meshlet.numTriangles == MaxMeshletTriangles || (best != NoSlot && meshlet.numVertices + bestNewVertices > MaxMeshletVertices);
+		if (best == NoSlot || full)
+		{
+			if (meshlet.numTriangles > 0)
+			{
+				computeMeshletBounds(mesh, result, meshlet);
+				result.meshlets.push_back(meshlet);
+
+				for (uint32_t v = 0; v < meshlet.numVertices; ++v)
+				{
+					slots[result.vertices[meshlet.vertexOffset + v]] = NoSlot;
+				}
+			}
+
+			// continue next to the finished meshlet so the leftovers don't end up as small islands
+			best = findBorderTriangle(result, meshlet, triangleOffsets, vertexTriangles, emitted);
+			if (best == NoSlot)
+			{
+				while (nextSeed < numTriangles && emitted[nextSeed])
+				{
+					++nextSeed;
+				}
+				if (nextSeed == numTriangles)
+				{
+					break;
+				}
+				best = nextSeed;
+			}
+
+			meshlet = {};
+			vertexSum = makeVec3(0.0f, 0.0f, 0.0f);
+			meshlet.vertexOffset = static_cast<uint32_t>(result.vertices.size());
+			meshlet.triangleOffset = static_cast<uint32_t>(result.triangles.size());
+		}
+
+		uint32_t packed = 0;
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t vertex = indices[best * 3 + corner];
+			--liveTriangles[vertex];
+			if (slots[vertex] == NoSlot)
+			{
+				slots[vertex] = meshlet.numVertices++;
+				result.vertices.push_back(vertex);
+				vertexSum = vertexSum + getPosition(mesh, vertex);
+			}
+			packed |= slots[vertex] << (corner * 8);
+		}
+
+		result.triangles.push_back(packed);
+		++meshlet.numTriangles;
+		emitted[best] = true;
+	}
+}
@@ -0,0 +1,431 @@
+#include "ParticleSample.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <EASTL/vector.h>
+
+#include "ArraySize.h"
+#include "ComputePass.h"
+#include "EngineContext.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "PipelineCache.h"
+#include "RenderCommands.h"
+
+static const uint32_t DefaultCapacity = 1024 * 1024;
+// a CPU implementation simulates and sorts every slot on the host, keep the default pool small there
+static const uint32_t SoftwareCapacity = 64 * 1024;
+static const uint32_t ParticleGroupSize = 256;
+// matches SORT_BLOCK_SIZE in particles.glsl
+static const uint32_t SortBlockSize = 1024;
+
+// average lifetime in particleemit.comp, emitting capacity per lifetime keeps the pool nearly full
+static const float AverageLifetime = 3.0f;
+static const float MaxDeltaTime = 0.1f;
+
+enum ParticleBinding : uint32_t
+{
+	ParticleBinding_Particles,
+	ParticleBinding_DeadList,
+	ParticleBinding_AliveLists,
+	ParticleBinding_State,
+	ParticleBinding_FrameArgs,
+	ParticleBinding_SortEntries,
+	ParticleBinding_RenderParticles,
+	NumParticleBindings,
+};
+
+// State in particles.glsl
+struct ParticleState
+{
+	uint32_t aliveCounts[2];
+	uint32_t deadCount;
+	uint32_t emitCount;
+	uint32_t emitBase;
+	VkDispatchIndirectCommand updateDispatch;
+};
+
+// FrameArgs in particles.glsl
+struct ParticleFrameArgs
+{
+	uint32_t numAlive;
+	uint32_t sortSize;
+	VkDispatchIndirectCommand sortDispatch;
+	VkDrawIndirectCommand draw;
+};
+
+// PushConstants in particles.glsl, shared by every particle pass
+struct ParticlePushConstants
+{
+	float eye[4];
+	float forward[4];
+	float deltaTime;
+	uint32_t requestedEmitCount;
+	uint32_t seed;
+	uint32_t parity;
+	uint32_t capacity;
+	uint32_t sortK;
+	uint32_t sortJ;
+	uint32_t mode;
+};
+
+// std140 layout of Camera in particles.vert
+struct ParticleCameraUniforms
+{
+	float viewProjection[16];
+	float right[4];
+	float up[4];
+};
+
+struct ParticleSample
+{
+	uint32_t capacity;
+	// capacity rounded up to a power of two, the largest sort
+	uint32_t sortCapacity;
+
+	GpuBuffer particleBuffer;
+	GpuBuffer deadListBuffer;
+	GpuBuffer aliveListsBuffer;
+	GpuBuffer stateBuffer;
+	// what a frame draws is kept apart from the simulation, which moves on while the frame is in flight
+	GpuBuffer frameArgsBuffers[MAX_FRAMES_IN_FLIGHT];
+	GpuBuffer sortBuffers[MAX_FRAMES_IN_FLIGHT];
+	GpuBuffer renderBuffers[MAX_FRAMES_IN_FLIGHT];
+	GpuBuffer cameraBuffers[MAX_FRAMES_IN_FLIGHT];
+
+	ComputePipeline preparePipeline;
+	ComputePipeline emitPipeline;
+	ComputePipeline updatePipeline;
+	ComputePipeline sortPipeline;
+	VkDescriptorSet computeSets[MAX_FRAMES_IN_FLIGHT];
+
+	VkDescriptorSetLayout drawSetLayout;
+	VkPipelineLayout drawPipelineLayout;
+	PipelineDesc drawPipelineDesc;
+	VkDescriptorSet drawSets[MAX_FRAMES_IN_FLIGHT];
+
+	float emitRate;
+	float emitAccumulator;
+	uint32_t parity;
+	double lastTime;
+};
+
+static void writeBufferDescriptor(EngineContext& context, VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const GpuBuffer& buffer)
+{
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer.buffer;
+	bufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+	write.pBufferInfo = &bufferInfo;
+
+	vkUpdateDescriptorSets(context.device, 1, &write, 0, nullptr);
+}
+
+static void createDrawPipeline(EngineContext& context, ParticleSample& sample)
+{
+	VkDescriptorSetLayoutBinding bindings[3] = {};
+	for (uint32_t i = 0; i < ARRAY_SIZE(bindings); ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = ARRAY_SIZE(bindings);
+	setLayoutInfo.pBindings = bindings;
+
+	VkResult result = vkCreateDescriptorSetLayout(context.device, &setLayoutInfo, nullptr, &sample.drawSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create particle descriptor set layout");
+	}
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &sample.drawSetLayout;
+
+	result = vkCreatePipelineLayout(context.device, &layoutInfo, nullptr, &sample.drawPipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create particle pipeline layout");
+	}
+
+	// sorted back to front, so they're tested against the scene's depth without writing it
+	sample.drawPipelineDesc = makeDefaultPipelineDesc();
+	sample.drawPipelineDesc.vertexShader = "particles.vert";
+	sample.drawPipelineDesc.fragmentShader = "particles.frag";
+	sample.drawPipelineDesc.layout = sample.drawPipelineLayout;
+	sample.drawPipelineDesc.cullMode = VK_CULL_MODE_NONE;
+	sample.drawPipelineDesc.blendMode = BlendMode_Alpha;
+	sample.drawPipelineDesc.depthTestEnable = VK_TRUE;
+	sample.drawPipelineDesc.depthWriteEnable = VK_FALSE;
+	sample.drawPipelineDesc.renderPass = context.renderPass;
+	sample.drawPipelineDesc.colorFormat = context.sceneColorFormat;
+	sample.drawPipelineDesc.depthFormat = context.depthFormat;
+
+	getPipeline(context, sample.drawPipelineDesc);
+}
+
+static void createComputePipelines(EngineContext& context, ParticleSample& sample)
+{
+	// every pass has the same bindings, so the descriptor sets allocated against one of the
+	// identically defined set layouts work with all of them
+	VkDescriptorSetLayoutBinding bindings[NumParticleBindings] = {};
+	for (uint32_t i = 0; i < NumParticleBindings; ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	uint32_t pushConstantSize = sizeof(ParticlePushConstants);
+	createComputePipeline(context, "particleprepare.comp.spv", bindings, NumParticleBindings, pushConstantSize, sample.preparePipeline);
+	createComputePipeline(context, "particleemit.comp.spv", bindings, NumParticleBindings, pushConstantSize, sample.emitPipeline);
+	createComputePipeline(context, "particleupdate.comp.spv", bindings, NumParticleBindings, pushConstantSize, sample.updatePipeline);
+	createComputePipeline(context, "particlesort.comp.spv", bindings, NumParticleBindings, pushConstantSize, sample.sortPipeline);
+}
+
+void createParticleSample(EngineContext& context)
+{
+	ParticleSample* sample = new ParticleSample;
+	*sample = {};
+
+	bool isSoftware = context.physicalDeviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+	const char* capacity = getenv("ENGINE_PARTICLES");
+	sample->capacity = capacity ? static_cast<uint32_t>(atoi(capacity)) : (isSoftware ? SoftwareCapacity : DefaultCapacity);
+	sample->capacity = sample->capacity > 0 ? sample->capacity : 1;
+	sample->sortCapacity = SortBlockSize;
+	while (sample->sortCapacity < sample->capacity)
+	{
+		sample->sortCapacity *= 2;
+	}
+	sample->emitRate = sample->capacity / AverageLifetime;
+
+	VkBufferUsageFlags storage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	VkBufferUsageFlags indirect = storage | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+	VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+	createGpuBuffer(context, static_cast<VkDeviceSize>(sample->capacity) * 8 * sizeof(float), storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->particleBuffer);
+	createGpuBuffer(context, static_cast<VkDeviceSize>(sample->capacity) * sizeof(uint32_t), storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->deadListBuffer);
+	createGpuBuffer(context, static_cast<VkDeviceSize>(sample->capacity) * 2 * sizeof(uint32_t), storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->aliveListsBuffer);
+	createGpuBuffer(context, sizeof(ParticleState), indirect, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->stateBuffer);
+
+	// every particle starts out dead
+	eastl::vector<uint32_t> deadList(sample->capacity);
+	for (uint32_t i = 0; i < sample->capacity; ++i)
+	{
+		deadList[i] = i;
+	}
+	uploadToGpuBuffer(context, sample->deadListBuffer, deadList.data(), deadList.size() * sizeof(uint32_t));
+
+	ParticleState state = {};
+	state.deadCount = sample->capacity;
+	uploadToGpuBuffer(context, sample->stateBuffer, &state, sizeof(state));
+
+	ParticleFrameArgs frameArgs = {};
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		createGpuBuffer(context, sizeof(ParticleFrameArgs), indirect, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->frameArgsBuffers[i]);
+		uploadToGpuBuffer(context, sample->frameArgsBuffers[i], &frameArgs, sizeof(frameArgs));
+
+		createGpuBuffer(context, static_cast<VkDeviceSize>(sample->sortCapacity) * 2 * sizeof(uint32_t), storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->sortBuffers[i]);
+		createGpuBuffer(context, static_cast<VkDeviceSize>(sample->capacity) * 4 * sizeof(float), storage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->renderBuffers[i]);
+		createGpuBuffer(context, sizeof(ParticleCameraUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, sample->cameraBuffers[i]);
+	}
+
+	createComputePipelines(context, *sample);
+	createDrawPipeline(context, *sample);
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		VkDescriptorSet set = allocateDescriptorSet(context, sample->updatePipeline.descriptorSetLayout);
+		writeBufferDescriptor(context, set, ParticleBinding_Particles, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->particleBuffer);
+		writeBufferDescriptor(context, set, ParticleBinding_DeadList, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->deadListBuffer);
+		writeBufferDescriptor(context, set, ParticleBinding_AliveLists, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->aliveListsBuffer);
+		writeBufferDescriptor(context, set, ParticleBinding_State, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->stateBuffer);
+		writeBufferDescriptor(context, set, ParticleBinding_FrameArgs, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->frameArgsBuffers[i]);
+		writeBufferDescriptor(context, set, ParticleBinding_SortEntries, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->sortBuffers[i]);
+		writeBufferDescriptor(context, set, ParticleBinding_RenderParticles, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->renderBuffers[i]);
+		sample->computeSets[i] = set;
+
+		sample->drawSets[i] = allocateDescriptorSet(context, sample->drawSetLayout);
+		writeBufferDescriptor(context, sample->drawSets[i], 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, sample->cameraBuffers[i]);
+		writeBufferDescriptor(context, sample->drawSets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->sortBuffers[i]);
+		writeBufferDescriptor(context, sample->drawSets[i], 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->renderBuffers[i]);
+	}
+
+	Log::log("GPU particles: %u capacity, sorting up to %u\n", sample->capacity, sample->sortCapacity);
+
+	sample->lastTime = context.frameTime;
+
+	context.particleSample = sample;
+}
+
+void destroyParticleSample(EngineContext& context)
+{
+	ParticleSample* sample = context.particleSample;
+	if (!sample)
+	{
+		return;
+	}
+
+	vkDestroyPipelineLayout(context.device, sample->drawPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(context.device, sample->drawSetLayout, nullptr);
+	destroyComputePipeline(context, sample->preparePipeline);
+	destroyComputePipeline(context, sample->emitPipeline);
+	destroyComputePipeline(context, sample->updatePipeline);
+	destroyComputePipeline(context, sample->sortPipeline);
+
+	destroyGpuBuffer(context, sample->particleBuffer);
+	destroyGpuBuffer(context, sample->deadListBuffer);
+	destroyGpuBuffer(context, sample->aliveListsBuffer);
+	destroyGpuBuffer(context, sample->stateBuffer);
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		destroyGpuBuffer(context, sample->frameArgsBuffers[i]);
+		destroyGpuBuffer(context, sample->sortBuffers[i]);
+		destroyGpuBuffer(context, sample->renderBuffers[i]);
+		destroyGpuBuffer(context, sample->cameraBuffers[i]);
+	}
+
+	delete sample;
+	context.particleSample = nullptr;
+}
+
+// Makes one pass's writes, including indirect arguments, visible to the next
+static void recordPassBarrier(VkCommandBuffer commandBuffer)
+{
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void simulateParticleSample(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	ParticleSample* sample = context.particleSample;
+	if (!sample)
+	{
+		return;
+	}
+
+	uint32_t slot = context.currentFrame;
+	VkDescriptorSet set = sample->computeSets[slot];
+	const Camera& camera = context.camera;
+
+	double time = context.frameTime;
+	float deltaTime = static_cast<float>(time - sample->lastTime);
+	deltaTime = deltaTime < MaxDeltaTime ? deltaTime : MaxDeltaTime;
+	sample->lastTime = time;
+
+	// the emission count is the only thing the CPU decides, the GPU clamps it to the free particles
+	sample->emitAccumulator += sample->emitRate * deltaTime;
+	uint32_t emitCount = static_cast<uint32_t>(sample->emitAccumulator);
+	emitCount = emitCount < sample->capacity ? emitCount : sample->capacity;
+	sample->emitAccumulator -= floorf(sample->emitAccumulator);
+
+	ParticlePushConstants pushConstants = {};
+	pushConstants.eye[0] = camera.position.x;
+	pushConstants.eye[1] = camera.position.y;
+	pushConstants.eye[2] = camera.position.z;
+	pushConstants.forward[0] = camera.forward.x;
+	pushConstants.forward[1] = camera.forward.y;
+	pushConstants.forward[2] = camera.forward.z;
+	pushConstants.deltaTime = deltaTime;
+	pushConstants.requestedEmitCount = emitCount;
+	pushConstants.seed = static_cast<uint32_t>(context.frameNumber * 0x9e3779b9ull);
+	pushConstants.parity = sample->parity;
+	pushConstants.capacity = sample->capacity;
+
+	pushConstants.mode = 0;
+	dispatchCompute(commandBuffer, sample->preparePipeline, set, &pushConstants, 1, 1, 1);
+	recordPassBarrier(commandBuffer);
+
+	if (emitCount > 0)
+	{
+		dispatchCompute(commandBuffer, sample->emitPipeline, set, &pushConstants, (emitCount + ParticleGroupSize - 1) / ParticleGroupSize, 1, 1);
+		recordPassBarrier(commandBuffer);
+	}
+
+	dispatchComputeIndirect(commandBuffer, sample->updatePipeline, set, &pushConstants, sample->stateBuffer.buffer, offsetof(ParticleState, updateDispatch));
+	recordPassBarrier(commandBuffer);
+
+	pushConstants.mode = 1;
+	dispatchCompute(commandBuffer, sample->preparePipeline, set, &pushConstants, 1, 1, 1);
+	recordPassBarrier(commandBuffer);
+
+	// Bitonic sort, recorded for the largest size. The dispatches are sized by the alive count on
+	// the GPU and steps for sizes above it find everything in order already.
+	VkDeviceSize sortDispatchOffset = offsetof(ParticleFrameArgs, sortDispatch);
+	VkBuffer frameArgs = sample->frameArgsBuffers[slot].buffer;
+
+	pushConstants.mode = 0;
+	dispatchComputeIndirect(commandBuffer, sample->sortPipeline, set, &pushConstants, frameArgs, sortDispatchOffset);
+	recordPassBarrier(commandBuffer);
+
+	for (uint32_t k = SortBlockSize * 2; k <= sample->sortCapacity; k *= 2)
+	{
+		pushConstants.sortK = k;
+		pushConstants.mode = 1;
+		for (uint32_t j = k / 2; j >= SortBlockSize; j /= 2)
+		{
+			pushConstants.sortJ = j;
+			dispatchComputeIndirect(commandBuffer, sample->sortPipeline, set, &pushConstants, frameArgs, sortDispatchOffset);
+			recordPassBarrier(commandBuffer);
+		}
+
+		pushConstants.mode = 2;
+		dispatchComputeIndirect(commandBuffer, sample->sortPipeline, set, &pushConstants, frameArgs, sortDispatchOffset);
+		recordPassBarrier(commandBuffer);
+	}
+
+	sample->parity = 1 - sample->parity;
+}
+
+void emitParticleSample(EngineContext& context)
+{
+	ParticleSample* sample = context.particleSample;
+	if (!sample)
+	{
+		return;
+	}
+
+	uint32_t slot = context.currentFrame;
+	const Camera& camera = context.camera;
+
+	ParticleCameraUniforms uniforms = {};
+	memcpy(uniforms.viewProjection, camera.viewProjection.m, sizeof(uniforms.viewProjection));
+	uniforms.right[0] = camera.right.x;
+	uniforms.right[1] = camera.right.y;
+	uniforms.right[2] = camera.right.z;
+	uniforms.up[0] = camera.up.x;
+	uniforms.up[1] = camera.up.y;
+	uniforms.up[2] = camera.up.z;
+	memcpy(sample->cameraBuffers[slot].mapped, &uniforms, sizeof(uniforms));
+
+	DrawPacket packet = {};
+	packet.pipeline = getPipeline(context, sample->drawPipelineDesc);
+	packet.pipelineLayout = sample->drawPipelineLayout;
+	packet.descriptorSet = sample->drawSets[slot];
+	packet.sortKey = makeDrawSortKey(DrawPass_Additive, packet.pipeline, 0, 0.0f);
+	packet.drawType = DrawType_Indirect;
+	packet.indirectBuffer = sample->frameArgsBuffers[slot].buffer;
+	packet.indirectOffset = offsetof(ParticleFrameArgs, draw);
+
+	emitDrawPacket(context, packet);
+}
@@ -0,0 +1,580 @@
+#include "PipelineCache.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+#include <EASTL/fixed_vector.h>
+#include <EASTL/hash_map.h>
+#include <EASTL/string.h>
+#include <EASTL/vector.h>
+
+#include "ArraySize.h"
+#include "EngineContext.h"
+#include "FrameTrace.h"
+#include "Log.h"
+#include "ShaderHotReload.h"
+#include "ShaderVariants.h"
+#include "Shaders.h"
+
+static const uint32_t NumShards = 16;
+
+static const uint64_t FnvOffsetBasis = 14695981039346656037ull;
+static const uint64_t FnvPrime = 1099511628211ull;
+
+// Descriptions are compared and hashed through a flat serialization, which also takes care of
+// struct padding and of shader names being compared by content rather than by pointer
+typedef eastl::fixed_vector<uint8_t, 512, true> DescBytes;
+
+struct PipelineCacheShard;
+
+struct PipelineCacheEntry
+{
+	PipelineDesc desc;
+	DescBytes bytes;
+	// hot reload replaces it, so it's only read and written under the shard lock
+	VkPipeline pipeline;
+	// set with release once pipeline is written, so findParentPipeline can skip parents still building
+	// without waiting on the shard lock
+	std::atomic<bool> ready;
+	PipelineCacheShard* shard;
+};
+
+struct PipelineCacheShard
+{
+	std::mutex mutex;
+	std::condition_variable buildFinished;
+	eastl::hash_map<uint64_t, PipelineCacheEntry*> entries;
+};
+
+struct PipelineCache
+{
+	VkPipelineCache vulkanCache;
+	PipelineCacheShard shards[NumShards];
+
+	// pipelines that differ only in fragment state derive from the first one created
+	std::mutex parentsMutex;
+	eastl::hash_map<uint64_t, PipelineCacheEntry*> parents;
+
+	std::mutex statsMutex;
+	PipelineCacheStats stats;
+};
+
+template<typename T>
+static void appendValue(DescBytes& bytes, const T& value)
+{
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(&value);
+	bytes.insert(bytes.end(), data, data + sizeof(T));
+}
+
+static void appendString(DescBytes& bytes, const char* string)
+{
+	if (string)
+	{
+		bytes.insert(bytes.end(), reinterpret_cast<const uint8_t*>(string), reinterpret_cast<const uint8_t*>(string) + strlen(string));
+	}
+	bytes.push_back(0);
+}
+
+static void serializeVertexAndRasterState(const PipelineDesc& desc, DescBytes& bytes)
+{
+	appendString(bytes, desc.vertexShader);
+	appendString(bytes, desc.taskShader);
+	appendString(bytes, desc.meshShader);
+	appendValue(bytes, desc.layout);
+
+	appendValue(bytes, desc.numVertexBindings);
+	for (uint32_t i = 0; i < desc.numVertexBindings; ++i)
+	{
+		appendValue(bytes, desc.vertexBindings[i].binding);
+		appendValue(bytes, desc.vertexBindings[i].stride);
+		appendValue(bytes, desc.vertexBindings[i].inputRate);
+	}
+
+	appendValue(bytes, desc.numVertexAttributes);
+	for (uint32_t i = 0; i < desc.numVertexAttributes; ++i)
+	{
+		appendValue(bytes, desc.vertexAttributes[i].location);
+		appendValue(bytes, desc.vertexAttributes[i].binding);
+		appendValue(bytes, desc.vertexAttributes[i].format);
+		appendValue(bytes, desc.vertexAttributes[i].offset);
+	}
+
+	appendValue(bytes, desc.topology);
+	appendValue(bytes, desc.polygonMode);
+	appendValue(bytes, desc.cullMode);
+	appendValue(bytes, desc.frontFace);
+	appendValue(bytes, desc.depthTestEnable);
+	appendValue(bytes, desc.depthWriteEnable);
+	appendValue(bytes, desc.depthCompareOp);
+	appendValue(bytes, desc.depthBiasConstant);
+	appendValue(bytes, desc.depthBiasSlope);
+	appendValue(bytes, desc.renderPass);
+	appendValue(bytes, desc.colorFormat);
+	appendValue(bytes, desc.depthFormat);
+	appendValue(bytes, desc.samples);
+}
+
+static void serializePipelineDesc(const PipelineDesc& desc, DescBytes& bytes)
+{
+	serializeVertexAndRasterState(desc, bytes);
+
+	appendString(bytes, desc.fragmentShader);
+	appendValue(bytes, desc.shaderFeatures);
+	appendValue(bytes, desc.blendMode);
+}
+
+static uint64_t hashBytes(const DescBytes& bytes)
+{
+	uint64_t hash = FnvOffsetBasis;
+	for (uint8_t byte : bytes)
+	{
+		hash = (hash ^ byte) * FnvPrime;
+	}
+	return hash;
+}
+
+PipelineDesc makeDefaultPipelineDesc()
+{
+	PipelineDesc desc;
+	memset(&desc, 0, sizeof(desc));
+
+	desc.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	desc.polygonMode = VK_POLYGON_MODE_FILL;
+	desc.cullMode = VK_CULL_MODE_BACK_BIT;
+	desc.frontFace = VK_FRONT_FACE_CLOCKWISE;
+	desc.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	desc.blendMode = BlendMode_Opaque;
+	desc.colorFormat = VK_FORMAT_UNDEFINED;
+	desc.depthFormat = VK_FORMAT_UNDEFINED;
+	desc.samples = VK_SAMPLE_COUNT_1_BIT;
+
+	return desc;
+}
+
+uint64_t hashPipelineDesc(const PipelineDesc& desc)
+{
+	DescBytes bytes;
+	serializePipelineDesc(desc, bytes);
+	return hashBytes(bytes);
+}
+
+uint64_t hashPipelineDescContents(const PipelineDesc& desc)
+{
+	PipelineDesc contents = desc;
+	contents.layout = VK_NULL_HANDLE;
+	contents.renderPass = VK_NULL_HANDLE;
+	return hashPipelineDesc(contents);
+}
+
+static const uint32_t MaxPipelineStages = 4;
+
+struct ShaderStageSource
+{
+	VkShaderStageFlagBits stage;
+	const char* source;
+};
+
+// The shader stages desc uses, in pipeline order. Returns how many were written to sources.
+static uint32_t getShaderStageSources(const PipelineDesc& desc, ShaderStageSource* sources)
+{
+	uint32_t numSources = 0;
+	if (desc.meshShader)
+	{
+		if (desc.taskShader)
+		{
+			sources[numSources++] = { VK_SHADER_STAGE_TASK_BIT_EXT, desc.taskShader };
+		}
+		sources[numSources++] = { VK_SHADER_STAGE_MESH_BIT_EXT, desc.meshShader };
+	}
+	else
+	{
+		sources[numSources++] = { VK_SHADER_STAGE_VERTEX_BIT, desc.vertexShader };
+	}
+
+	if (desc.fragmentShader)
+	{
+		sources[numSources++] = { VK_SHADER_STAGE_FRAGMENT_BIT, desc.fragmentShader };
+	}
+
+	return numSources;
+}
+
+static const char* getPipelineName(const PipelineDesc& desc)
+{
+	return desc.meshShader ? desc.meshShader : desc.vertexShader;
+}
+
+static VkPipeline createPipelineFromDesc(EngineContext& context, const PipelineDesc& desc, VkPipeline basePipeline)
+{
+	ShaderStageSource sources[MaxPipelineStages];
+	uint32_t numSources = getShaderStageSources(desc, sources);
+
+	ShaderSpecialization specialization;
+	const VkSpecializationInfo* specializationInfo = makeShaderSpecialization(desc.shaderFeatures, specialization);
+
+	VkPipelineShaderStageCreateInfo shaderStages[MaxPipelineStages] = {};
+	uint32_t numStages = 0;
+	bool loaded = true;
+
+	for (uint32_t i = 0; i < numSources; ++i)
+	{
+		const ShaderStageSource& source = sources[i];
+
+		eastl::string file = source.source;
+		file += ".spv";
+		eastl::vector<uint8_t> code = loadShaderFile(context, file.c_str());
+		if (code.empty())
+		{
+			loaded = false;
+			break;
+		}
+
+		shaderStages[numStages].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shaderStages[numStages].stage = source.stage;
+		shaderStages[numStages].module = createShaderModule(context.device, code);
+		shaderStages[numStages].pName = "main";
+		shaderStages[numStages].pSpecializationInfo = specializationInfo;
+		++numStages;
+	}
+
+	if (!loaded)
+	{
+		for (uint32_t i = 0; i < numStages; ++i)
+		{
+			vkDestroyShaderModule(context.device, shaderStages[i].module, nullptr);
+		}
+		return VK_NULL_HANDLE;
+	}
+
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputInfo.vertexBindingDescriptionCount = desc.numVertexBindings;
+	vertexInputInfo.pVertexBindingDescriptions = desc.vertexBindings;
+	vertexInputInfo.vertexAttributeDescriptionCount = desc.numVertexAttributes;
+	vertexInputInfo.pVertexAttributeDescriptions = desc.vertexAttributes;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = desc.topology;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	VkDynamicState dynamicStates[] =
+	{
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
+	};
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = ARRAY_SIZE(dynamicStates);
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer = {};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = desc.polygonMode;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = desc.cullMode;
+	rasterizer.frontFace = desc.frontFace;
+	rasterizer.depthBiasEnable = desc.depthBiasConstant != 0.0f || desc.depthBiasSlope != 0.0f;
+	rasterizer.depthBiasConstantFactor = desc.depthBiasConstant;
+	rasterizer.depthBiasSlopeFactor = desc.depthBiasSlope;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = desc.samples;
+	multisampling.minSampleShading = 1.0f;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencil.depthTestEnable = desc.depthTestEnable;
+	depthStencil.depthWriteEnable = desc.depthWriteEnable;
+	depthStencil.depthCompareOp = desc.depthCompareOp;
+	depthStencil.maxDepthBounds = 1.0f;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	switch (desc.blendMode)
+	{
+	case BlendMode_Opaque:
+		colorBlendAttachment.blendEnable = VK_FALSE;
+		break;
+	case BlendMode_Additive:
+		colorBlendAttachment.blendEnable = VK_TRUE;
+		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		break;
+	case BlendMode_Alpha:
+		colorBlendAttachment.blendEnable = VK_TRUE;
+		colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		break;
+	}
+
+	VkPipelineColorBlendStateCreateInfo colorBlending = {};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.attachmentCount = desc.colorFormat != VK_FORMAT_UNDEFINED ? 1 : 0;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	// without a render pass the pipeline is created for dynamic rendering against the attachment formats
+	VkPipelineRenderingCreateInfoKHR renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+	renderingInfo.colorAttachmentCount = desc.colorFormat != VK_FORMAT_UNDEFINED ? 1 : 0;
+	renderingInfo.pColorAttachmentFormats = &desc.colorFormat;
+	renderingInfo.depthAttachmentFormat = desc.depthFormat;
+
+	VkGraphicsPipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.pNext = desc.renderPass == VK_NULL_HANDLE ? &renderingInfo : nullptr;
+	pipelineInfo.flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
+	pipelineInfo.stageCount = numStages;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = desc.meshShader ? nullptr : &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = desc.meshShader ? nullptr : &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = desc.depthFormat != VK_FORMAT_UNDEFINED ? &depthStencil : nullptr;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = desc.layout;
+	pipelineInfo.renderPass = desc.renderPass;
+	pipelineInfo.subpass = 0;
+	pipelineInfo.basePipelineHandle = basePipeline;
+	pipelineInfo.basePipelineIndex = -1;
+	if (basePipeline != VK_NULL_HANDLE)
+	{
+		pipelineInfo.flags |= VK_PIPELINE_CREATE_DERIVATIVE_BIT;
+	}
+
+	VkPipelineCache vulkanCache = context.pipelineCache ? context.pipelineCache->vulkanCache : VK_NULL_HANDLE;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult pipelineResult = vkCreateGraphicsPipelines(context.device, vulkanCache, 1, &pipelineInfo, nullptr, &pipeline);
+	if (pipelineResult != VK_SUCCESS)
+	{
+		Log::error("vkCreateGraphicsPipelines failed for %s/%s, result is %d\n", getPipelineName(desc), desc.fragmentShader ? desc.fragmentShader : "-", pipelineResult);
+		pipeline = VK_NULL_HANDLE;
+	}
+
+	for (uint32_t i = 0; i < numStages; ++i)
+	{
+		vkDestroyShaderModule(context.device, shaderStages[i].module, nullptr);
+	}
+
+	return pipeline;
+}
+
+static VkPipeline rebuildForHotReload(EngineContext& context, const void* userData)
+{
+	const PipelineCacheEntry* entry = static_cast<const PipelineCacheEntry*>(userData);
+	VkPipeline pipeline = createPipelineFromDesc(context, entry->desc, VK_NULL_HANDLE);
+	if (pipeline != VK_NULL_HANDLE)
+	{
+		tracePipelineBuild(context, entry->desc, pipeline);
+	}
+	return pipeline;
+}
+
+// applyShaderHotReload runs on the render thread while other threads may be looking the entry up
+static VkPipeline swapForHotReload(VkPipeline* target, VkPipeline pipeline, const void* userData)
+{
+	const PipelineCacheEntry* entry = static_cast<const PipelineCacheEntry*>(userData);
+
+	std::lock_guard<std::mutex> lock(entry->shard->mutex);
+	VkPipeline previous = *target;
+	*target = pipeline;
+	return previous;
+}
+
+void createPipelineCache(EngineContext& context)
+{
+	PipelineCache* cache = new PipelineCache;
+	cache->stats = {};
+
+	VkPipelineCacheCreateInfo cacheInfo = {};
+	cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+	VkResult result = vkCreatePipelineCache(context.device, &cacheInfo, nullptr, &cache->vulkanCache);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create pipeline cache");
+	}
+
+	context.pipelineCache = cache;
+}
+
+void destroyPipelineCache(EngineContext& context)
+{
+	PipelineCache* cache = context.pipelineCache;
+	if (!cache)
+	{
+		return;
+	}
+
+	for (PipelineCacheShard& shard : cache->shards)
+	{
+		for (auto& entry : shard.entries)
+		{
+			vkDestroyPipeline(context.device, entry.second->pipeline, nullptr);
+			delete entry.second;
+		}
+	}
+
+	vkDestroyPipelineCache(context.device, cache->vulkanCache, nullptr);
+
+	delete cache;
+	context.pipelineCache = nullptr;
+}
+
+static VkPipeline findParentPipeline(PipelineCache& cache, uint64_t parentKey, PipelineCacheEntry* entry)
+{
+	std::lock_guard<std::mutex> lock(cache.parentsMutex);
+
+	auto it = cache.parents.find(parentKey);
+	if (it == cache.parents.end())
+	{
+		cache.parents[parentKey] = entry;
+		return VK_NULL_HANDLE;
+	}
+
+	// the parent may still be building on another thread, then this one is built standalone
+	PipelineCacheEntry* parent = it->second;
+	if (!parent->ready.load(std::memory_order_acquire))
+	{
+		return VK_NULL_HANDLE;
+	}
+
+	std::lock_guard<std::mutex> shardLock(parent->shard->mutex);
+	return parent->pipeline;
+}
+
+VkPipeline getPipeline(EngineContext& context, const PipelineDesc& desc)
+{
+	PipelineCache& cache = *context.pipelineCache;
+
+	DescBytes bytes;
+	serializePipelineDesc(desc, bytes);
+	uint64_t key = hashBytes(bytes);
+
+	PipelineCacheShard& shard = cache.shards[key % NumShards];
+	PipelineCacheEntry* entry = nullptr;
+	{
+		std::unique_lock<std::mutex> lock(shard.mutex);
+
+		// on a hash collision keep probing the following keys
+		for (;; ++key)
+		{
+			auto it = shard.entries.find(key);
+			if (it == shard.entries.end())
+			{
+				break;
+			}
+
+			PipelineCacheEntry* existing = it->second;
+			if (existing->bytes != bytes)
+			{
+				continue;
+			}
+
+			bool waited = false;
+			while (!existing->ready.load(std::memory_order_relaxed))
+			{
+				waited = true;
+				shard.buildFinished.wait(lock);
+			}
+
+			VkPipeline pipeline = existing->pipeline;
+			lock.unlock();
+
+			std::lock_guard<std::mutex> statsLock(cache.statsMutex);
+			++cache.stats.numHits;
+			if (waited)
+			{
+				++cache.stats.numWaitedForBuild;
+			}
+
+			return pipeline;
+		}
+
+		// claim the key so concurrent requests wait for this build instead of duplicating it
+		entry = new PipelineCacheEntry;
+		entry->desc = desc;
+		entry->bytes = bytes;
+		entry->pipeline = VK_NULL_HANDLE;
+		entry->ready.store(false, std::memory_order_relaxed);
+		entry->shard = &shard;
+		shard.entries[key] = entry;
+	}
+
+	DescBytes parentBytes;
+	serializeVertexAndRasterState(desc, parentBytes);
+	VkPipeline parent = findParentPipeline(cache, hashBytes(parentBytes), entry);
+
+	VkPipeline pipeline = createPipelineFromDesc(context, desc, parent);
+	if (pipeline == VK_NULL_HANDLE)
+	{
+		Log::fatal("Couldn't create pipeline for %s/%s\n", getPipelineName(desc), desc.fragmentShader ? desc.fragmentShader : "-");
+	}
+	tracePipelineBuild(context, desc, pipeline);
+
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		entry->pipeline = pipeline;
+		entry->ready.store(true, std::memory_order_release);
+	}
+	shard.buildFinished.notify_all();
+
+	{
+		std::lock_guard<std::mutex> statsLock(cache.statsMutex);
+		++cache.stats.numMisses;
+		if (parent != VK_NULL_HANDLE)
+		{
+			++cache.stats.numDerivatives;
+		}
+	}
+
+	ShaderStageSource sources[MaxPipelineStages];
+	uint32_t numSources = getShaderStageSources(desc, sources);
+	const char* shaderSources[MaxPipelineStages];
+	for (uint32_t i = 0; i < numSources; ++i)
+	{
+		shaderSources[i] = sources[i].source;
+	}
+	registerHotReloadPipeline(context, &entry->pipeline, shaderSources, numSources, rebuildForHotReload, swapForHotReload, entry);
+
+	return pipeline;
+}
+
+PipelineCacheStats getPipelineCacheStats(EngineContext& context)
+{
+	PipelineCache& cache = *context.pipelineCache;
+
+	std::lock_guard<std::mutex> lock(cache.statsMutex);
+	return cache.stats;
+}
+
+void reportPipelineCacheStats(EngineContext& context)
+{
+	PipelineCacheStats stats = getPipelineCacheStats(context);
+	Log::log("Pipeline cache: %llu pipelines created (%llu as derivatives), %llu hits, %llu waited on a concurrent build\n",
+		static_cast<unsigned long long>(stats.numMisses),
+		static_cast<unsigned long long>(stats.numDerivatives),
+		static_cast<unsigned long long>(stats.numHits),
+		static_cast<unsigned long long>(stats.numWaitedForBuild));
+}
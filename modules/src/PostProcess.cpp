@@ -0,0 +1,768 @@
+#include "PostProcess.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <EASTL/vector.h>
+
+#include "ComputePass.h"
+#include "DynamicResolution.h"
+#include "EngineContext.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "PipelineCache.h"
+#include "ResourceRegistry.h"
+
+// must match postprocess.glsl and tonemap.frag
+static const uint32_t NumBloomLevels = 5;
+static const uint32_t NumHistogramBins = 256;
+// scene pixels covered by one workgroup in each direction, 16x16 threads with 4x4 pixels each
+static const uint32_t TileSize = 64;
+// postprocess.comp sizes its per-subgroup partial sums for this
+static const uint32_t MinSubgroupSize = 4;
+
+// the histogram covers luminances from 2^-10 to 2^6
+static const float MinLogLuminance = -10.0f;
+static const float LogLuminanceRange = 16.0f;
+// auto exposure maps the average luminance to middle gray
+static const float KeyValue = 0.18f;
+// per second, how quickly the exposure follows the scene
+static const float AdaptationSpeed = 1.5f;
+static const float MaxDeltaTime = 0.1f;
+
+// exposed values above the threshold bloom, with a soft knee below it
+static const float BloomThreshold = 1.0f;
+static const float BloomKnee = 0.5f;
+static const float DefaultBloomStrength = 0.5f;
+
+// the sample's color grade
+static const float Saturation = 1.1f;
+static const float Contrast = 1.1f;
+static const float Tint[3] = { 1.0f, 0.98f, 0.94f };
+
+// start and end of the fused dispatch, then of the separate passes when comparing
+static const uint32_t NumQueriesPerPath = 2;
+static const uint32_t NumQueriesPerFrame = 2 * NumQueriesPerPath;
+static const double StatsInterval = 5.0;
+
+// std430, persists across frames. The histogram is accumulated by every workgroup and cleared by the last one.
+struct ExposureState
+{
+	uint32_t histogram[NumHistogramBins];
+	uint32_t numGroupsDone;
+	float averageLuminance;
+	float exposure;
+	float padding;
+};
+
+struct ReducePushConstants
+{
+	uint32_t renderSize[2];
+	float invTargetSize[2];
+	float bloomThreshold;
+	float bloomKnee;
+	float minLogLuminance;
+	float logLuminanceRange;
+	// fraction of the way from the previous average luminance to this frame's
+	float adaptation;
+	// key value and compensation, divided by the average luminance with auto exposure
+	float exposureScale;
+	uint32_t autoExposure;
+};
+
+// the steps of postprocessnaive.comp, one dispatch each
+enum NaiveStep : uint32_t
+{
+	NaiveStepPrefilter,
+	NaiveStepDownsample,
+	NaiveStepHistogram,
+	NaiveStepExposure,
+};
+
+struct NaivePushConstants
+{
+	ReducePushConstants reduce;
+	uint32_t step;
+	uint32_t level;
+};
+
+// A bloom chain and exposure state for one path, written by its compute work
+struct BloomTarget
+{
+	GpuImage image;
+	VkImageView levelViews[NumBloomLevels];
+	GpuBuffer exposureBuffer;
+};
+
+struct TonemapPushConstants
+{
+	float uvScale[2];
+	float uvMax[2];
+	// rendered part of the first bloom level in texels
+	float bloomSize[2];
+	float bloomStrength;
+	float saturation;
+	float tint[3];
+	float contrast;
+};
+
+struct PostProcess
+{
+	// half the size of the scene target, level 0 is the prefiltered scene
+	BloomTarget target;
+	ImageHandle bloomHandle;
+	BufferHandle exposureHandle;
+	VkSampler sampler;
+
+	ComputePipeline reducePipeline;
+	VkDescriptorSet reduceSet;
+
+	// the same work as separate passes into their own target, only created when comparing. Their
+	// result isn't used, they only run to be timed.
+	bool compare;
+	BloomTarget naiveTarget;
+	ComputePipeline naivePipeline;
+	VkDescriptorSet naiveSet;
+
+	VkDescriptorSetLayout tonemapSetLayout;
+	VkPipelineLayout tonemapPipelineLayout;
+	PipelineDesc tonemapPipelineDesc;
+	VkDescriptorSet tonemapSet;
+
+	bool autoExposure;
+	float exposureScale;
+	float bloomStrength;
+	double lastTime;
+
+	bool logStats;
+	double lastStatsTime;
+	// timestamps around the dispatch, only created when logging stats
+	VkQueryPool queryPool;
+	float timestampPeriod;
+	uint64_t timestampMask;
+	bool queriesWritten[MAX_FRAMES_IN_FLIGHT];
+	double gpuMilliseconds;
+	double naiveGpuMilliseconds;
+	uint32_t numTimedFrames;
+};
+
+static bool isEnvSet(const char* name, bool defaultValue)
+{
+	const char* value = getenv(name);
+	return value ? strcmp(value, "0") != 0 : defaultValue;
+}
+
+static float getEnvFloat(const char* name, float defaultValue)
+{
+	const char* value = getenv(name);
+	return value ? static_cast<float>(atof(value)) : defaultValue;
+}
+
+static uint32_t getLevelSize(uint32_t size, uint32_t level)
+{
+	size >>= level;
+	return size ? size : 1;
+}
+
+bool queryPostProcessSupport(EngineContext& context)
+{
+	if (!isEnvSet("ENGINE_POST_PROCESS", true))
+	{
+		return false;
+	}
+
+	// subgroup operations are core in 1.1
+	if (context.apiVersion < VK_API_VERSION_1_1 || context.physicalDeviceProperties.apiVersion < VK_API_VERSION_1_1)
+	{
+		Log::log("Post processing needs Vulkan 1.1, the scene is drawn straight to the swapchain format\n");
+		return false;
+	}
+
+	VkPhysicalDeviceSubgroupProperties subgroupProperties = {};
+	subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 properties = {};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &subgroupProperties;
+	vkGetPhysicalDeviceProperties2(context.physicalDevice, &properties);
+
+	VkSubgroupFeatureFlags required = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+	if (!(subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) || (subgroupProperties.supportedOperations & required) != required ||
+		subgroupProperties.subgroupSize < MinSubgroupSize)
+	{
+		Log::log("Post processing needs arithmetic and ballot subgroup operations in compute shaders, the scene is drawn straight to the swapchain format\n");
+		return false;
+	}
+
+	return true;
+}
+
+VkFormat chooseHdrSceneColorFormat(EngineContext& context)
+{
+	// half the bandwidth of RGBA16F, which every device can render to, blend and filter
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT |
+		VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(context.physicalDevice, VK_FORMAT_B10G11R11_UFLOAT_PACK32, &properties);
+	if ((properties.optimalTilingFeatures & required) == required)
+	{
+		return VK_FORMAT_B10G11R11_UFLOAT_PACK32;
+	}
+
+	return VK_FORMAT_R16G16B16A16_SFLOAT;
+}
+
+static void createBloomTarget(EngineContext& context, BloomTarget& target)
+{
+	uint32_t width = getLevelSize(context.swapchainExtent.width, 1);
+	uint32_t height = getLevelSize(context.swapchainExtent.height, 1);
+	createGpuImage(context, width, height, NumBloomLevels, VK_FORMAT_R16G16B16A16_SFLOAT,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT, target.image);
+	initializeGpuImageLayout(context, target.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL);
+
+	for (uint32_t i = 0; i < NumBloomLevels; ++i)
+	{
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = target.image.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R16G16B16A16_SFLOAT;
+		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		viewInfo.subresourceRange.baseMipLevel = i;
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		VkResult result = vkCreateImageView(context.device, &viewInfo, nullptr, &target.levelViews[i]);
+		if (result != VK_SUCCESS)
+		{
+			Log::fatal("Couldn't create view of bloom level %u\n", i);
+		}
+	}
+
+	createGpuBuffer(context, sizeof(ExposureState), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target.exposureBuffer);
+
+	// no average yet, the first frame takes its own without adapting
+	ExposureState state = {};
+	state.exposure = 1.0f;
+	uploadToGpuBuffer(context, target.exposureBuffer, &state, sizeof(state));
+}
+
+static void destroyBloomTarget(EngineContext& context, BloomTarget& target)
+{
+	destroyGpuBuffer(context, target.exposureBuffer);
+	for (uint32_t i = 0; i < NumBloomLevels; ++i)
+	{
+		vkDestroyImageView(context.device, target.levelViews[i], nullptr);
+	}
+	destroyGpuImage(context, target.image);
+}
+
+static void createSampler(EngineContext& context, PostProcess& post)
+{
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = static_cast<float>(NumBloomLevels);
+
+	VkResult result = vkCreateSampler(context.device, &samplerInfo, nullptr, &post.sampler);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create post processing sampler");
+	}
+}
+
+// Both pipelines read the scene and write a target's levels and exposure state
+static void createReducePipeline(EngineContext& context, const char* shaderFile, uint32_t pushConstantSize, ComputePipeline& pipeline)
+{
+	VkDescriptorSetLayoutBinding bindings[3] = {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].descriptorCount = NumBloomLevels;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[2].descriptorCount = 1;
+	bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	createComputePipeline(context, shaderFile, bindings, 3, pushConstantSize, pipeline);
+}
+
+static VkDescriptorSet createReduceSet(EngineContext& context, PostProcess& post, const ComputePipeline& pipeline, const BloomTarget& target)
+{
+	VkDescriptorSet set = allocateDescriptorSet(context, pipeline.descriptorSetLayout);
+
+	VkDescriptorImageInfo sceneInfo = {};
+	sceneInfo.sampler = post.sampler;
+	sceneInfo.imageView = getRegisteredImage(context, context.sceneColorHandle).view;
+	sceneInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkDescriptorImageInfo levelInfos[NumBloomLevels] = {};
+	for (uint32_t i = 0; i < NumBloomLevels; ++i)
+	{
+		levelInfos[i].imageView = target.levelViews[i];
+		levelInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+	}
+
+	VkDescriptorBufferInfo exposureInfo = {};
+	exposureInfo.buffer = target.exposureBuffer.buffer;
+	exposureInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet writes[3] = {};
+	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet = set;
+	writes[0].dstBinding = 0;
+	writes[0].descriptorCount = 1;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writes[0].pImageInfo = &sceneInfo;
+
+	writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[1].dstSet = set;
+	writes[1].dstBinding = 1;
+	writes[1].descriptorCount = NumBloomLevels;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	writes[1].pImageInfo = levelInfos;
+
+	writes[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[2].dstSet = set;
+	writes[2].dstBinding = 2;
+	writes[2].descriptorCount = 1;
+	writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writes[2].pBufferInfo = &exposureInfo;
+
+	vkUpdateDescriptorSets(context.device, 3, writes, 0, nullptr);
+	return set;
+}
+
+static void createTonemapPipeline(EngineContext& context, PostProcess& post)
+{
+	VkDescriptorSetLayoutBinding bindings[3] = {};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[2].descriptorCount = 1;
+	bindings[2].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = 3;
+	setLayoutInfo.pBindings = bindings;
+
+	VkResult result = vkCreateDescriptorSetLayout(context.device, &setLayoutInfo, nullptr, &post.tonemapSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create tonemap descriptor set layout");
+	}
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstantRange.size = sizeof(TonemapPushConstants);
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &post.tonemapSetLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	result = vkCreatePipelineLayout(context.device, &layoutInfo, nullptr, &post.tonemapPipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create tonemap pipeline layout");
+	}
+
+	// the upscale pass' full screen triangle with the tonemapping fragment shader
+	post.tonemapPipelineDesc = makeDefaultPipelineDesc();
+	post.tonemapPipelineDesc.vertexShader = "upscale.vert";
+	post.tonemapPipelineDesc.fragmentShader = "tonemap.frag";
+	post.tonemapPipelineDesc.layout = post.tonemapPipelineLayout;
+	post.tonemapPipelineDesc.cullMode = VK_CULL_MODE_NONE;
+	post.tonemapPipelineDesc.renderPass = context.swapchainRenderPass;
+	post.tonemapPipelineDesc.colorFormat = context.swapchainFormat;
+
+	getPipeline(context, post.tonemapPipelineDesc);
+
+	post.tonemapSet = allocateDescriptorSet(context, post.tonemapSetLayout);
+
+	VkDescriptorImageInfo sceneInfo = {};
+	sceneInfo.sampler = post.sampler;
+	sceneInfo.imageView = getRegisteredImage(context, context.sceneColorHandle).view;
+	sceneInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkDescriptorImageInfo bloomInfo = {};
+	bloomInfo.sampler = post.sampler;
+	bloomInfo.imageView = post.target.image.view;
+	bloomInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	VkDescriptorBufferInfo exposureInfo = {};
+	exposureInfo.buffer = post.target.exposureBuffer.buffer;
+	exposureInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet writes[3] = {};
+	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet = post.tonemapSet;
+	writes[0].dstBinding = 0;
+	writes[0].descriptorCount = 1;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writes[0].pImageInfo = &sceneInfo;
+
+	writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[1].dstSet = post.tonemapSet;
+	writes[1].dstBinding = 1;
+	writes[1].descriptorCount = 1;
+	writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writes[1].pImageInfo = &bloomInfo;
+
+	writes[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[2].dstSet = post.tonemapSet;
+	writes[2].dstBinding = 2;
+	writes[2].descriptorCount = 1;
+	writes[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	writes[2].pBufferInfo = &exposureInfo;
+
+	vkUpdateDescriptorSets(context.device, 3, writes, 0, nullptr);
+}
+
+static void createTimestampQueries(EngineContext& context, PostProcess& post)
+{
+	uint64_t timestampMask = getTimestampMask(context, context.graphicsQueueFamily);
+	if (timestampMask == 0)
+	{
+		Log::warning("The graphics queue has no timestamps, post processing stats only show memory traffic\n");
+		return;
+	}
+
+	post.timestampMask = timestampMask;
+	post.timestampPeriod = context.physicalDeviceProperties.limits.timestampPeriod;
+
+	VkQueryPoolCreateInfo queryPoolInfo = {};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = NumQueriesPerFrame * MAX_FRAMES_IN_FLIGHT;
+
+	VkResult result = vkCreateQueryPool(context.device, &queryPoolInfo, nullptr, &post.queryPool);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create post processing query pool");
+	}
+}
+
+void createPostProcess(EngineContext& context)
+{
+	PostProcess* post = new PostProcess;
+	*post = {};
+
+	post->autoExposure = isEnvSet("ENGINE_AUTO_EXPOSURE", true);
+	float compensation = getEnvFloat("ENGINE_EXPOSURE", 0.0f);
+	post->exposureScale = (post->autoExposure ? KeyValue : 1.0f) * exp2f(compensation);
+	post->bloomStrength = getEnvFloat("ENGINE_BLOOM", DefaultBloomStrength);
+	post->lastTime = context.frameTime;
+
+	createBloomTarget(context, post->target);
+	post->bloomHandle = registerImage(context, "bloom", post->target.image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_GENERAL);
+	post->exposureHandle = registerBuffer(context, "exposure", post->target.exposureBuffer);
+	createSampler(context, *post);
+	createReducePipeline(context, "postprocess.comp.spv", sizeof(ReducePushConstants), post->reducePipeline);
+	post->reduceSet = createReduceSet(context, *post, post->reducePipeline, post->target);
+	createTonemapPipeline(context, *post);
+
+	bool compare = isEnvSet("ENGINE_POST_COMPARE", false);
+	post->logStats = compare || isEnvSet("ENGINE_POST_STATS", false);
+	post->lastStatsTime = post->lastTime;
+	if (post->logStats)
+	{
+		createTimestampQueries(context, *post);
+	}
+
+	// only worth running when it can be timed
+	post->compare = compare && post->queryPool != VK_NULL_HANDLE;
+	if (post->compare)
+	{
+		createBloomTarget(context, post->naiveTarget);
+		createReducePipeline(context, "postprocessnaive.comp.spv", sizeof(NaivePushConstants), post->naivePipeline);
+		post->naiveSet = createReduceSet(context, *post, post->naivePipeline, post->naiveTarget);
+	}
+
+	Log::log("Post processing into %s scene target, %s exposure, %u bloom levels\n",
+		context.sceneColorFormat == VK_FORMAT_B10G11R11_UFLOAT_PACK32 ? "an R11G11B10" : "an RGBA16F",
+		post->autoExposure ? "automatic" : "fixed", NumBloomLevels);
+
+	context.postProcess = post;
+}
+
+void destroyPostProcess(EngineContext& context)
+{
+	PostProcess* post = context.postProcess;
+	if (!post)
+	{
+		return;
+	}
+
+	if (post->queryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(context.device, post->queryPool, nullptr);
+	}
+	if (post->compare)
+	{
+		destroyComputePipeline(context, post->naivePipeline);
+		destroyBloomTarget(context, post->naiveTarget);
+	}
+	vkDestroyPipelineLayout(context.device, post->tonemapPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(context.device, post->tonemapSetLayout, nullptr);
+	destroyComputePipeline(context, post->reducePipeline);
+	vkDestroySampler(context.device, post->sampler, nullptr);
+	unregisterBuffer(context, post->exposureHandle);
+	unregisterImage(context, post->bloomHandle);
+	destroyBloomTarget(context, post->target);
+
+	delete post;
+	context.postProcess = nullptr;
+}
+
+// Bytes the fused chain moves per frame against an equivalent chain of separate full screen passes:
+// histogram, prefilter, one pass per bloom level down and up, tonemap into an LDR target, upscale.
+// Every texel is assumed to be read and written once per pass, so this ignores caches.
+static void estimateMemoryTraffic(EngineContext& context, double& fusedBytes, double& separateBytes)
+{
+	double scenePixelSize = context.sceneColorFormat == VK_FORMAT_B10G11R11_UFLOAT_PACK32 ? 4.0 : 8.0;
+	double bloomPixelSize = 8.0;
+	double ldrPixelSize = 4.0;
+
+	double scene = static_cast<double>(context.renderExtent.width) * context.renderExtent.height * scenePixelSize;
+	double ldr = static_cast<double>(context.renderExtent.width) * context.renderExtent.height * ldrPixelSize;
+	double swapchain = static_cast<double>(context.swapchainExtent.width) * context.swapchainExtent.height * ldrPixelSize;
+
+	double levels[NumBloomLevels];
+	double allLevels = 0.0;
+	for (uint32_t i = 0; i < NumBloomLevels; ++i)
+	{
+		levels[i] = static_cast<double>(getLevelSize(context.renderExtent.width, i + 1)) * getLevelSize(context.renderExtent.height, i + 1) * bloomPixelSize;
+		allLevels += levels[i];
+	}
+
+	// the dispatch reads the scene and writes every level, tonemapping reads both and writes the swapchain
+	fusedBytes = scene + allLevels + scene + allLevels + swapchain;
+
+	separateBytes = scene;
+	separateBytes += scene + levels[0];
+	for (uint32_t i = 1; i < NumBloomLevels; ++i)
+	{
+		separateBytes += levels[i - 1] + levels[i];
+	}
+	for (uint32_t i = NumBloomLevels - 1; i > 0; --i)
+	{
+		separateBytes += levels[i] + 2.0 * levels[i - 1];
+	}
+	separateBytes += scene + levels[0] + ldr;
+	separateBytes += ldr + swapchain;
+}
+
+static double getMilliseconds(const PostProcess& post, const uint64_t* results)
+{
+	uint64_t ticks = (results[2] - results[0]) & post.timestampMask;
+	return static_cast<double>(ticks) * post.timestampPeriod * 1e-6;
+}
+
+static void readTimestamps(EngineContext& context, PostProcess& post)
+{
+	uint32_t slot = context.currentFrame;
+	if (post.queryPool == VK_NULL_HANDLE || !post.queriesWritten[slot])
+	{
+		return;
+	}
+
+	// each result is followed by its availability. The separate passes' queries are only written when comparing.
+	uint64_t results[NumQueriesPerFrame * 2] = {};
+	uint32_t numQueries = post.compare ? NumQueriesPerFrame : NumQueriesPerPath;
+	VkResult result = vkGetQueryPoolResults(context.device, post.queryPool, slot * NumQueriesPerFrame, numQueries,
+		numQueries * 2 * sizeof(uint64_t), results, 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+	if (result == VK_SUCCESS)
+	{
+		post.gpuMilliseconds += getMilliseconds(post, results);
+		if (post.compare)
+		{
+			post.naiveGpuMilliseconds += getMilliseconds(post, results + NumQueriesPerPath * 2);
+		}
+		++post.numTimedFrames;
+	}
+}
+
+static void logStats(EngineContext& context, PostProcess& post, double time)
+{
+	double fusedBytes = 0.0;
+	double separateBytes = 0.0;
+	estimateMemoryTraffic(context, fusedBytes, separateBytes);
+
+	if (post.numTimedFrames > 0 && post.compare)
+	{
+		Log::log("Post processing: %.3f ms of GPU time in the compute dispatch against %.3f ms for the same work as separate passes, estimated ~%.1f MB per frame against ~%.1f MB for a chain of separate passes (%.0f%%)\n",
+			post.gpuMilliseconds / post.numTimedFrames, post.naiveGpuMilliseconds / post.numTimedFrames,
+			fusedBytes / (1024.0 * 1024.0), separateBytes / (1024.0 * 1024.0), 100.0 * fusedBytes / separateBytes);
+	}
+	else if (post.numTimedFrames > 0)
+	{
+		Log::log("Post processing: %.3f ms of GPU time in the compute dispatch, estimated ~%.1f MB per frame against ~%.1f MB for a chain of separate passes (%.0f%%)\n",
+			post.gpuMilliseconds / post.numTimedFrames, fusedBytes / (1024.0 * 1024.0), separateBytes / (1024.0 * 1024.0), 100.0 * fusedBytes / separateBytes);
+	}
+	else
+	{
+		Log::log("Post processing: estimated ~%.1f MB per frame against ~%.1f MB for a chain of separate passes (%.0f%%)\n",
+			fusedBytes / (1024.0 * 1024.0), separateBytes / (1024.0 * 1024.0), 100.0 * fusedBytes / separateBytes);
+	}
+
+	post.gpuMilliseconds = 0.0;
+	post.naiveGpuMilliseconds = 0.0;
+	post.numTimedFrames = 0;
+	post.lastStatsTime = time;
+}
+
+static void addComputeBarrier(VkCommandBuffer commandBuffer)
+{
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+// The fused dispatch's work into the naive target, one dispatch per step with a barrier after each
+static void recordSeparatePasses(EngineContext& context, PostProcess& post, VkCommandBuffer commandBuffer, const ReducePushConstants& reduce)
+{
+	NaivePushConstants pushConstants = {};
+	pushConstants.reduce = reduce;
+
+	// 16x16 threads, one per texel of the level written
+	uint32_t width = getLevelSize(context.renderExtent.width, 1);
+	uint32_t height = getLevelSize(context.renderExtent.height, 1);
+
+	pushConstants.step = NaiveStepPrefilter;
+	pushConstants.level = 0;
+	dispatchCompute(commandBuffer, post.naivePipeline, post.naiveSet, &pushConstants, (width + 15) / 16, (height + 15) / 16, 1);
+	addComputeBarrier(commandBuffer);
+
+	pushConstants.step = NaiveStepDownsample;
+	for (uint32_t level = 1; level < NumBloomLevels; ++level)
+	{
+		uint32_t levelWidth = getLevelSize(width, level);
+		uint32_t levelHeight = getLevelSize(height, level);
+		pushConstants.level = level;
+		dispatchCompute(commandBuffer, post.naivePipeline, post.naiveSet, &pushConstants, (levelWidth + 15) / 16, (levelHeight + 15) / 16, 1);
+		addComputeBarrier(commandBuffer);
+	}
+
+	// reads the scene a second time, as a separate luminance pass would
+	pushConstants.step = NaiveStepHistogram;
+	pushConstants.level = 0;
+	dispatchCompute(commandBuffer, post.naivePipeline, post.naiveSet, &pushConstants, (width + 15) / 16, (height + 15) / 16, 1);
+	addComputeBarrier(commandBuffer);
+
+	pushConstants.step = NaiveStepExposure;
+	dispatchCompute(commandBuffer, post.naivePipeline, post.naiveSet, &pushConstants, 1, 1, 1);
+}
+
+void recordPostProcess(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	PostProcess& post = *context.postProcess;
+
+	double time = context.frameTime;
+	float deltaTime = static_cast<float>(time - post.lastTime);
+	deltaTime = deltaTime < MaxDeltaTime ? deltaTime : MaxDeltaTime;
+	post.lastTime = time;
+
+	readTimestamps(context, post);
+	if (post.logStats && time - post.lastStatsTime >= StatsInterval)
+	{
+		logStats(context, post, time);
+	}
+
+	// the previous frame's tonemapping may still be reading the bloom levels and the exposure, and its
+	// dispatch wrote the exposure this one adapts from. Images stay in GENERAL, so a global barrier covers both.
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	uint32_t firstQuery = context.currentFrame * NumQueriesPerFrame;
+	if (post.queryPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(commandBuffer, post.queryPool, firstQuery, NumQueriesPerFrame);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, post.queryPool, firstQuery);
+	}
+
+	ReducePushConstants pushConstants = {};
+	pushConstants.renderSize[0] = context.renderExtent.width;
+	pushConstants.renderSize[1] = context.renderExtent.height;
+	const VkExtent2D& targetSize = getRegisteredImage(context, context.sceneColorHandle).extent;
+	pushConstants.invTargetSize[0] = 1.0f / targetSize.width;
+	pushConstants.invTargetSize[1] = 1.0f / targetSize.height;
+	pushConstants.bloomThreshold = BloomThreshold;
+	pushConstants.bloomKnee = BloomKnee;
+	pushConstants.minLogLuminance = MinLogLuminance;
+	pushConstants.logLuminanceRange = LogLuminanceRange;
+	pushConstants.adaptation = 1.0f - expf(-deltaTime * AdaptationSpeed);
+	pushConstants.exposureScale = post.exposureScale;
+	pushConstants.autoExposure = post.autoExposure ? 1 : 0;
+
+	uint32_t groupsX = (context.renderExtent.width + TileSize - 1) / TileSize;
+	uint32_t groupsY = (context.renderExtent.height + TileSize - 1) / TileSize;
+	dispatchCompute(commandBuffer, post.reducePipeline, post.reduceSet, &pushConstants, groupsX, groupsY, 1);
+
+	if (post.queryPool != VK_NULL_HANDLE)
+	{
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, post.queryPool, firstQuery + 1);
+		post.queriesWritten[context.currentFrame] = true;
+	}
+
+	// timed the same way after the fused dispatch. The barriers between the steps are part of their cost.
+	if (post.compare)
+	{
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, post.queryPool, firstQuery + NumQueriesPerPath);
+		recordSeparatePasses(context, post, commandBuffer, pushConstants);
+		vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, post.queryPool, firstQuery + NumQueriesPerPath + 1);
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void recordTonemap(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	PostProcess& post = *context.postProcess;
+
+	TonemapPushConstants pushConstants = {};
+	getUpscaleUvTransform(context, pushConstants.uvScale, pushConstants.uvMax);
+	pushConstants.bloomSize[0] = static_cast<float>(getLevelSize(context.renderExtent.width, 1));
+	pushConstants.bloomSize[1] = static_cast<float>(getLevelSize(context.renderExtent.height, 1));
+	pushConstants.bloomStrength = post.bloomStrength;
+	pushConstants.saturation = Saturation;
+	memcpy(pushConstants.tint, Tint, sizeof(Tint));
+	pushConstants.contrast = Contrast;
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, getPipeline(context, post.tonemapPipelineDesc));
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, post.tonemapPipelineLayout, 0, 1, &post.tonemapSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, post.tonemapPipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(pushConstants), &pushConstants);
+	vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+}
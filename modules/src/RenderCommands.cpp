@@ -0,0 +1,249 @@
+#include "RenderCommands.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <EASTL/vector.h>
+
+#include "EngineContext.h"
+#include "RadixSort.h"
+
+// Packets go into packets[writeIndex] of the emitting thread. The sort flips writeIndex and then
+// reads the other half, after waiting out any emit that started before the flip, so the owning
+// thread and the render thread never touch the same half at once.
+struct ThreadCommandBuffer
+{
+	eastl::vector<DrawPacket> packets[2];
+	// set while the owning thread is inside emitDrawPacket
+	std::atomic<uint32_t> emitting;
+};
+
+struct RenderCommands
+{
+	// never reused, so a thread's cached buffer can't be mistaken for one of a later instance
+	// allocated at the same address
+	uint64_t generation;
+	std::atomic<uint32_t> writeIndex;
+
+	// guards threadBuffers, only taken the first time a thread emits
+	std::mutex registrationMutex;
+	eastl::vector<ThreadCommandBuffer*> threadBuffers;
+
+	// render thread scratch, kept between frames so steady state doesn't allocate
+	eastl::vector<DrawPacket> gathered;
+	eastl::vector<uint64_t> keys;
+	eastl::vector<uint32_t> indices;
+	eastl::vector<uint64_t> scratchKeys;
+	eastl::vector<uint32_t> scratchIndices;
+
+	RenderCommandStats stats;
+};
+
+static std::atomic<uint64_t> s_nextGeneration(1);
+
+static thread_local uint64_t t_generation = 0;
+static thread_local ThreadCommandBuffer* t_buffer = nullptr;
+
+uint64_t makeDrawSortKey(DrawPass pass, VkPipeline pipeline, uint32_t material, float depth)
+{
+	// only grouping matters for the pipeline bits, so the handle is folded down to 16 bits
+	uint64_t pipelineBits = (uint64_t)(pipeline);
+	pipelineBits ^= pipelineBits >> 32;
+	pipelineBits ^= pipelineBits >> 16;
+
+	depth = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+	uint64_t depthBits = static_cast<uint64_t>(depth * 0xffffff);
+
+	return (static_cast<uint64_t>(pass & 0xf) << 60) |
+		((pipelineBits & 0xffff) << 44) |
+		(static_cast<uint64_t>(material & 0xfffff) << 24) |
+		depthBits;
+}
+
+void createRenderCommands(EngineContext& context)
+{
+	RenderCommands* commands = new RenderCommands;
+	commands->generation = s_nextGeneration.fetch_add(1, std::memory_order_relaxed);
+	commands->writeIndex = 0;
+	context.renderCommands = commands;
+}
+
+void destroyRenderCommands(EngineContext& context)
+{
+	RenderCommands* commands = context.renderCommands;
+	if (!commands)
+	{
+		return;
+	}
+
+	for (ThreadCommandBuffer* buffer : commands->threadBuffers)
+	{
+		delete buffer;
+	}
+
+	delete commands;
+	context.renderCommands = nullptr;
+}
+
+void emitDrawPacket(EngineContext& context, const DrawPacket& packet)
+{
+	RenderCommands* commands = context.renderCommands;
+
+	if (t_generation != commands->generation)
+	{
+		t_buffer = new ThreadCommandBuffer;
+		t_buffer->emitting = 0;
+		t_generation = commands->generation;
+
+		std::lock_guard<std::mutex> lock(commands->registrationMutex);
+		commands->threadBuffers.push_back(t_buffer);
+	}
+
+	// pairs with the flip in sortRenderCommands: either the sort sees this flag and waits, or
+	// this load sees the flipped index
+	t_buffer->emitting.store(1, std::memory_order_seq_cst);
+	uint32_t writeIndex = commands->writeIndex.load(std::memory_order_seq_cst);
+	t_buffer->packets[writeIndex].push_back(packet);
+	t_buffer->emitting.store(0, std::memory_order_release);
+}
+
+void sortRenderCommands(EngineContext& context)
+{
+	RenderCommands& commands = *context.renderCommands;
+
+	// later emits go to the other half and are drawn next frame
+	uint32_t readIndex = commands.writeIndex.load(std::memory_order_relaxed);
+	commands.writeIndex.store(readIndex ^ 1, std::memory_order_seq_cst);
+
+	commands.gathered.clear();
+	{
+		std::lock_guard<std::mutex> lock(commands.registrationMutex);
+		for (ThreadCommandBuffer* buffer : commands.threadBuffers)
+		{
+			// an emit that read the old index may still be pushing, it's a single push_back
+			while (buffer->emitting.load(std::memory_order_acquire))
+			{
+				std::this_thread::yield();
+			}
+
+			eastl::vector<DrawPacket>& packets = buffer->packets[readIndex];
+			commands.gathered.insert(commands.gathered.end(), packets.begin(), packets.end());
+			packets.clear();
+		}
+	}
+
+	uint32_t numPackets = static_cast<uint32_t>(commands.gathered.size());
+	commands.keys.resize(numPackets);
+	commands.indices.resize(numPackets);
+	commands.scratchKeys.resize(numPackets);
+	commands.scratchIndices.resize(numPackets);
+
+	for (uint32_t i = 0; i < numPackets; ++i)
+	{
+		commands.keys[i] = commands.gathered[i].sortKey;
+		commands.indices[i] = i;
+	}
+
+	radixSort64(commands.keys.data(), commands.indices.data(), commands.scratchKeys.data(), commands.scratchIndices.data(), numPackets);
+
+	commands.stats = {};
+}
+
+const DrawPacket* getGatheredDrawPackets(EngineContext& context, uint32_t& numPackets)
+{
+	numPackets = static_cast<uint32_t>(context.renderCommands->gathered.size());
+	return context.renderCommands->gathered.data();
+}
+
+void executeRenderCommands(EngineContext& context, VkCommandBuffer commandBuffer, DrawPass firstPass, DrawPass lastPass)
+{
+	RenderCommands& commands = *context.renderCommands;
+
+	RenderCommandStats& stats = commands.stats;
+	// bindings don't carry over, other commands may have been recorded since the last call
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+	const DrawPacket* lastPushed = nullptr;
+
+	uint32_t numPackets = static_cast<uint32_t>(commands.keys.size());
+	for (uint32_t i = 0; i < numPackets; ++i)
+	{
+		// the pass is in the key's top bits, so each pass is a contiguous run
+		uint32_t pass = static_cast<uint32_t>(commands.keys[i] >> 60);
+		if (pass < firstPass)
+		{
+			continue;
+		}
+		if (pass > lastPass)
+		{
+			break;
+		}
+
+		const DrawPacket& packet = commands.gathered[commands.indices[i]];
+
+		if (packet.pipeline != boundPipeline)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipeline);
+			boundPipeline = packet.pipeline;
+			// a different pipeline layout may disturb the descriptor set and push constant bindings
+			boundDescriptorSet = VK_NULL_HANDLE;
+			lastPushed = nullptr;
+			++stats.numPipelineBinds;
+		}
+		else
+		{
+			++stats.numRedundantBindsSkipped;
+		}
+
+		if (packet.descriptorSet != VK_NULL_HANDLE)
+		{
+			if (packet.descriptorSet != boundDescriptorSet)
+			{
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pipelineLayout, 0, 1, &packet.descriptorSet, 0, nullptr);
+				boundDescriptorSet = packet.descriptorSet;
+				++stats.numDescriptorSetBinds;
+			}
+			else
+			{
+				++stats.numRedundantBindsSkipped;
+			}
+		}
+
+		if (packet.pushConstantSize)
+		{
+			bool samePushConstants = lastPushed &&
+				lastPushed->pipelineLayout == packet.pipelineLayout &&
+				lastPushed->pushConstantStages == packet.pushConstantStages &&
+				lastPushed->pushConstantSize == packet.pushConstantSize &&
+				memcmp(lastPushed->pushConstants, packet.pushConstants, packet.pushConstantSize) == 0;
+
+			if (!samePushConstants)
+			{
+				vkCmdPushConstants(commandBuffer, packet.pipelineLayout, packet.pushConstantStages, 0, packet.pushConstantSize, packet.pushConstants);
+				lastPushed = &packet;
+			}
+		}
+
+		switch (packet.drawType)
+		{
+		case DrawType_Direct:
+			vkCmdDraw(commandBuffer, packet.vertexCount, packet.instanceCount, packet.firstVertex, packet.firstInstance);
+			break;
+		case DrawType_Indirect:
+			vkCmdDrawIndirect(commandBuffer, packet.indirectBuffer, packet.indirectOffset, 1, sizeof(VkDrawIndirectCommand));
+			break;
+		case DrawType_MeshTasksIndirect:
+			context.cmdDrawMeshTasksIndirect(commandBuffer, packet.indirectBuffer, packet.indirectOffset, 1, sizeof(VkDrawMeshTasksIndirectCommandEXT));
+			break;
+		}
+		++stats.numDraws;
+	}
+}
+
+const RenderCommandStats& getRenderCommandStats(EngineContext& context)
+{
+	return context.renderCommands->stats;
+}
@@ -0,0 +1,64 @@
+#include "ResolutionController.h"
+
+#include <math.h>
+
+ResolutionSettings makeDefaultResolutionSettings()
+{
+	ResolutionSettings settings = {};
+	// leaves headroom below a 60 Hz frame for the CPU side of presenting
+	settings.budgetMilliseconds = 14.0f;
+	settings.minScale = 0.5f;
+	settings.maxScale = 1.0f;
+	settings.proportionalGain = 0.2f;
+	settings.integralGain = 0.25f;
+	settings.derivativeGain = 0.05f;
+	settings.smoothing = 0.3f;
+	return settings;
+}
+
+void initResolutionController(ResolutionController& controller, const ResolutionSettings& settings)
+{
+	controller = {};
+	controller.settings = settings;
+	controller.area = settings.maxScale * settings.maxScale;
+}
+
+float updateResolutionController(ResolutionController& controller, float gpuMilliseconds)
+{
+	const ResolutionSettings& settings = controller.settings;
+
+	if (controller.numMeasurements == 0)
+	{
+		controller.smoothedMilliseconds = gpuMilliseconds;
+	}
+	else
+	{
+		controller.smoothedMilliseconds += (gpuMilliseconds - controller.smoothedMilliseconds) * settings.smoothing;
+	}
+
+	float error = (settings.budgetMilliseconds - controller.smoothedMilliseconds) / settings.budgetMilliseconds;
+	// the first measurements have no history, their differences would look like a step
+	float previousError = controller.numMeasurements > 0 ? controller.errors[0] : error;
+	float previousPreviousError = controller.numMeasurements > 1 ? controller.errors[1] : previousError;
+
+	float delta = settings.proportionalGain * (error - previousError) +
+		settings.integralGain * error +
+		settings.derivativeGain * (error - 2.0f * previousError + previousPreviousError);
+
+	float minArea = settings.minScale * settings.minScale;
+	float maxArea = settings.maxScale * settings.maxScale;
+	// relative, so the loop gain doesn't depend on how expensive a full resolution frame is
+	float area = controller.area * (1.0f + delta);
+	controller.area = area < minArea ? minArea : (area > maxArea ? maxArea : area);
+
+	controller.errors[1] = previousError;
+	controller.errors[0] = error;
+	++controller.numMeasurements;
+
+	return getResolutionScale(controller);
+}
+
+float getResolutionScale(const ResolutionController& controller)
+{
+	return sqrtf(controller.area);
+}
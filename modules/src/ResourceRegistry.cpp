@@ -0,0 +1,173 @@
+#include "ResourceRegistry.h"
+
+#include <EASTL/hash_map.h>
+
+#include "EngineContext.h"
+#include "GpuMemory.h"
+#include "Log.h"
+
+struct ResourceRegistry
+{
+	HandlePool<RegisteredImage> images;
+	HandlePool<RegisteredBuffer> buffers;
+	// handle values by name id
+	eastl::hash_map<uint32_t, uint32_t> imageIds;
+	eastl::hash_map<uint32_t, uint32_t> bufferIds;
+};
+
+// Null handles when nothing is registered under the id
+static ImageHandle findImage(EngineContext& context, StringId id)
+{
+	ImageHandle handle = {};
+	auto found = context.resourceRegistry->imageIds.find(id.value);
+	if (found != context.resourceRegistry->imageIds.end())
+	{
+		handle.value = found->second;
+	}
+	return handle;
+}
+
+static BufferHandle findBuffer(EngineContext& context, StringId id)
+{
+	BufferHandle handle = {};
+	auto found = context.resourceRegistry->bufferIds.find(id.value);
+	if (found != context.resourceRegistry->bufferIds.end())
+	{
+		handle.value = found->second;
+	}
+	return handle;
+}
+
+void createResourceRegistry(EngineContext& context)
+{
+	ResourceRegistry* registry = new ResourceRegistry;
+	*registry = {};
+
+	context.resourceRegistry = registry;
+}
+
+void destroyResourceRegistry(EngineContext& context)
+{
+	ResourceRegistry* registry = context.resourceRegistry;
+	if (!registry)
+	{
+		return;
+	}
+
+	for (const RegisteredImage& image : registry->images.objects)
+	{
+		Log::warning("Image %s is still registered\n", image.name);
+	}
+	for (const RegisteredBuffer& buffer : registry->buffers.objects)
+	{
+		Log::warning("Buffer %s is still registered\n", buffer.name);
+	}
+
+	delete registry;
+	context.resourceRegistry = nullptr;
+}
+
+ImageHandle registerImage(EngineContext& context, const char* name, const GpuImage& image, VkImageAspectFlags aspect, VkImageLayout layout)
+{
+	ResourceRegistry& registry = *context.resourceRegistry;
+
+	StringId id = makeStringId(name);
+	ImageHandle existing = findImage(context, id);
+	if (!isNullHandle(existing))
+	{
+		// names are registered once, and two names hashing to the same id are caught here instead of aliasing in lookups
+		Log::fatal("Can't register image %s, its id is taken by %s\n", name, getFromPool(registry.images, existing).name);
+	}
+
+	RegisteredImage registered = {};
+	registered.name = name;
+	registered.id = id;
+	registered.image = image.image;
+	registered.view = image.view;
+	registered.format = image.format;
+	registered.extent = image.extent;
+	registered.mipLevels = image.mipLevels;
+	registered.aspect = aspect;
+	registered.layout = layout;
+	registered.allocationSize = image.allocationSize;
+
+	ImageHandle handle = addToPool(registry.images, registered);
+	registry.imageIds[id.value] = handle.value;
+	return handle;
+}
+
+BufferHandle registerBuffer(EngineContext& context, const char* name, const GpuBuffer& buffer)
+{
+	ResourceRegistry& registry = *context.resourceRegistry;
+
+	StringId id = makeStringId(name);
+	BufferHandle existing = findBuffer(context, id);
+	if (!isNullHandle(existing))
+	{
+		// names are registered once, and two names hashing to the same id are caught here instead of aliasing in lookups
+		Log::fatal("Can't register buffer %s, its id is taken by %s\n", name, getFromPool(registry.buffers, existing).name);
+	}
+
+	RegisteredBuffer registered = {};
+	registered.name = name;
+	registered.id = id;
+	registered.buffer = buffer.buffer;
+	registered.size = buffer.size;
+	registered.mapped = buffer.mapped;
+
+	BufferHandle handle = addToPool(registry.buffers, registered);
+	registry.bufferIds[id.value] = handle.value;
+	return handle;
+}
+
+void unregisterImage(EngineContext& context, ImageHandle handle)
+{
+	ResourceRegistry& registry = *context.resourceRegistry;
+
+	const RegisteredImage* image = lookupInPool(registry.images, handle);
+	if (!image)
+	{
+		Log::warning("Unregistering an image that isn't registered\n");
+		return;
+	}
+
+	registry.imageIds.erase(image->id.value);
+	removeFromPool(registry.images, handle);
+}
+
+void unregisterBuffer(EngineContext& context, BufferHandle handle)
+{
+	ResourceRegistry& registry = *context.resourceRegistry;
+
+	const RegisteredBuffer* buffer = lookupInPool(registry.buffers, handle);
+	if (!buffer)
+	{
+		Log::warning("Unregistering a buffer that isn't registered\n");
+		return;
+	}
+
+	registry.bufferIds.erase(buffer->id.value);
+	removeFromPool(registry.buffers, handle);
+}
+
+void setRegisteredImageLayout(EngineContext& context, ImageHandle handle, VkImageLayout layout)
+{
+	getFromPool(context.resourceRegistry->images, handle).layout = layout;
+}
+
+const RegisteredImage& getRegisteredImage(EngineContext& context, ImageHandle handle)
+{
+	return getFromPool(context.resourceRegistry->images, handle);
+}
+
+const RegisteredImage* getRegisteredImages(EngineContext& context, uint32_t& numImages)
+{
+	numImages = static_cast<uint32_t>(context.resourceRegistry->images.objects.size());
+	return context.resourceRegistry->images.objects.data();
+}
+
+const RegisteredBuffer* getRegisteredBuffers(EngineContext& context, uint32_t& numBuffers)
+{
+	numBuffers = static_cast<uint32_t>(context.resourceRegistry->buffers.objects.size());
+	return context.resourceRegistry->buffers.objects.data();
+}
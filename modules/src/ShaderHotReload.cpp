@@ -0,0 +1,395 @@
+#include "ShaderHotReload.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include <EASTL/algorithm.h>
+#include <EASTL/string.h>
+#include <EASTL/vector.h>
+
+#include "Constants.h"
+#include "DeferredDestroy.h"
+#include "EngineContext.h"
+#include "FileWatcher.h"
+#include "Log.h"
+#include "Shaders.h"
+
+#ifdef _WIN32
+static const char ShaderCompiler[] = "glslc.exe";
+#else
+static const char ShaderCompiler[] = "glslc";
+#endif
+
+static const int WatchTimeoutMs = 100;
+
+// edited by hand and read by compile.py too, so both compile with the same arguments
+static const char ShaderSourceList[] = "sources.list";
+static const char IncludeExtension[] = ".glsl";
+// includes nested deeper than this are assumed to be a cycle
+static const uint32_t MaxIncludeDepth = 8;
+
+struct ShaderSource
+{
+	eastl::string name;
+	// extra glslc arguments, e.g. the SPIR-V version
+	eastl::string arguments;
+};
+
+struct ReloadablePipeline
+{
+	VkPipeline* pipeline;
+	eastl::vector<eastl::string> shaderSources;
+	PipelineBuildFunc build;
+	PipelineSwapFunc swap;
+	const void* userData;
+};
+
+struct PendingSwap
+{
+	VkPipeline* target;
+	VkPipeline pipeline;
+	PipelineSwapFunc swap;
+	const void* userData;
+};
+
+struct ShaderHotReload
+{
+	FileWatcher* watcher;
+	std::thread thread;
+	std::atomic<bool> running;
+
+	// only used by the reload thread once it runs
+	eastl::vector<ShaderSource> sources;
+
+	// held while build functions run, so a pipeline isn't unregistered in the middle of its rebuild
+	std::mutex buildMutex;
+
+	// guards pipelines and pendingSwaps
+	std::mutex mutex;
+	eastl::vector<ReloadablePipeline> pipelines;
+	eastl::vector<PendingSwap> pendingSwaps;
+};
+
+static bool hasExtension(const eastl::string& name, const char* extension)
+{
+	size_t extensionLength = strlen(extension);
+	return name.size() >= extensionLength && name.compare(name.size() - extensionLength, extensionLength, extension) == 0;
+}
+
+// One source per line, followed by its arguments. Blank lines and lines starting with # are skipped.
+static bool readShaderSources(eastl::vector<ShaderSource>& sources)
+{
+	eastl::vector<uint8_t> text = readShaderFile(ShaderSourceList);
+	if (text.empty())
+	{
+		return false;
+	}
+
+	sources.clear();
+	const char* cursor = reinterpret_cast<const char*>(text.data());
+	const char* end = cursor + text.size();
+	while (cursor < end)
+	{
+		const char* lineEnd = eastl::find(cursor, end, '\n');
+		eastl::string line(cursor, lineEnd);
+		cursor = lineEnd < end ? lineEnd + 1 : end;
+
+		line.trim();
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		ShaderSource source;
+		size_t space = line.find_first_of(" \t");
+		source.name = line.substr(0, space);
+		if (space != eastl::string::npos)
+		{
+			source.arguments = line.substr(space + 1);
+			source.arguments.trim();
+		}
+		sources.push_back(source);
+	}
+
+	return true;
+}
+
+// Whether file includes include, directly or through other includes. Read from disk every time, so
+// edits to the #include lines themselves are picked up.
+static bool includesFile(const eastl::string& file, const eastl::string& include, uint32_t depth)
+{
+	if (depth > MaxIncludeDepth)
+	{
+		return false;
+	}
+
+	eastl::vector<uint8_t> text = readShaderFile(file.c_str());
+	const char* cursor = reinterpret_cast<const char*>(text.data());
+	const char* end = cursor + text.size();
+	while (cursor < end)
+	{
+		const char* lineEnd = eastl::find(cursor, end, '\n');
+		eastl::string line(cursor, lineEnd);
+		cursor = lineEnd < end ? lineEnd + 1 : end;
+
+		line.ltrim();
+		if (line.compare(0, 8, "#include") != 0)
+		{
+			continue;
+		}
+
+		size_t open = line.find('"');
+		size_t close = open != eastl::string::npos ? line.find('"', open + 1) : eastl::string::npos;
+		if (close == eastl::string::npos)
+		{
+			continue;
+		}
+
+		eastl::string included = line.substr(open + 1, close - open - 1);
+		if (included == include || includesFile(included, include, depth + 1))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool needsRecompile(const ShaderSource& source, const eastl::vector<eastl::string>& changedFiles)
+{
+	for (const eastl::string& changed : changedFiles)
+	{
+		if (changed == source.name || (hasExtension(changed, IncludeExtension) && includesFile(source.name, changed, 0)))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool compileShader(const ShaderSource& source)
+{
+	eastl::string path = ShadersFolder;
+	path += source.name;
+
+	eastl::string command = ShaderCompiler;
+	if (!source.arguments.empty())
+	{
+		command += " ";
+		command += source.arguments;
+	}
+	command += " \"" + path + "\" -o \"" + path + ".spv\"";
+
+	int result = system(command.c_str());
+	if (result != 0)
+	{
+		Log::error("Shader %s failed to compile, keeping the old version\n", source.name.c_str());
+		return false;
+	}
+
+	Log::log("Recompiled shader %s\n", source.name.c_str());
+	return true;
+}
+
+static void rebuildPipelines(EngineContext& context, ShaderHotReload& reload, const eastl::vector<eastl::string>& compiledShaders)
+{
+	std::lock_guard<std::mutex> buildLock(reload.buildMutex);
+
+	eastl::vector<ReloadablePipeline> affected;
+	{
+		std::lock_guard<std::mutex> lock(reload.mutex);
+		for (const ReloadablePipeline& reloadable : reload.pipelines)
+		{
+			for (const eastl::string& shader : compiledShaders)
+			{
+				if (eastl::find(reloadable.shaderSources.begin(), reloadable.shaderSources.end(), shader) != reloadable.shaderSources.end())
+				{
+					affected.push_back(reloadable);
+					break;
+				}
+			}
+		}
+	}
+
+	for (const ReloadablePipeline& reloadable : affected)
+	{
+		VkPipeline pipeline = reloadable.build(context, reloadable.userData);
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		PendingSwap swap = {};
+		swap.target = reloadable.pipeline;
+		swap.pipeline = pipeline;
+		swap.swap = reloadable.swap;
+		swap.userData = reloadable.userData;
+
+		std::lock_guard<std::mutex> lock(reload.mutex);
+		reload.pendingSwaps.push_back(swap);
+	}
+}
+
+static void hotReloadThread(EngineContext& context, ShaderHotReload& reload)
+{
+	eastl::vector<eastl::string> changedFiles;
+	eastl::vector<eastl::string> compiledShaders;
+
+	while (reload.running.load(std::memory_order_relaxed))
+	{
+		changedFiles.clear();
+		if (!waitForFileChanges(reload.watcher, WatchTimeoutMs, changedFiles))
+		{
+			continue;
+		}
+
+		if (eastl::find(changedFiles.begin(), changedFiles.end(), eastl::string(ShaderSourceList)) != changedFiles.end() &&
+			!readShaderSources(reload.sources))
+		{
+			Log::error("Couldn't read %s, keeping the previous list of shaders\n", ShaderSourceList);
+		}
+
+		// a changed include recompiles every shader using it
+		compiledShaders.clear();
+		for (const ShaderSource& source : reload.sources)
+		{
+			if (needsRecompile(source, changedFiles) && compileShader(source))
+			{
+				evictShaderFile(context, (source.name + ".spv").c_str());
+				compiledShaders.push_back(source.name);
+			}
+		}
+
+		if (!compiledShaders.empty())
+		{
+			rebuildPipelines(context, reload, compiledShaders);
+		}
+	}
+}
+
+void startShaderHotReload(EngineContext& context)
+{
+	FileWatcher* watcher = createFileWatcher(ShadersFolder);
+	if (!watcher)
+	{
+		Log::warning("Shader hot reload disabled, can't watch %s\n", ShadersFolder);
+		return;
+	}
+
+	ShaderHotReload* reload = new ShaderHotReload;
+	reload->watcher = watcher;
+	reload->running = true;
+	if (!readShaderSources(reload->sources))
+	{
+		Log::warning("Couldn't read %s%s, no shader is recompiled until it can be\n", ShadersFolder, ShaderSourceList);
+	}
+	reload->thread = std::thread(hotReloadThread, std::ref(context), std::ref(*reload));
+
+	context.shaderHotReload = reload;
+}
+
+void stopShaderHotReload(EngineContext& context)
+{
+	ShaderHotReload* reload = context.shaderHotReload;
+	if (!reload)
+	{
+		return;
+	}
+
+	reload->running = false;
+	reload->thread.join();
+
+	// pipelines built but never swapped in were not used by any frame
+	for (const PendingSwap& swap : reload->pendingSwaps)
+	{
+		vkDestroyPipeline(context.device, swap.pipeline, nullptr);
+	}
+
+	destroyFileWatcher(reload->watcher);
+	delete reload;
+
+	context.shaderHotReload = nullptr;
+}
+
+void registerHotReloadPipeline(EngineContext& context, VkPipeline* pipeline, const char* const* shaderSources, uint32_t numShaderSources, PipelineBuildFunc build, PipelineSwapFunc swap, const void* userData)
+{
+	ShaderHotReload* reload = context.shaderHotReload;
+	if (!reload)
+	{
+		return;
+	}
+
+	ReloadablePipeline reloadable;
+	reloadable.pipeline = pipeline;
+	reloadable.shaderSources.assign(shaderSources, shaderSources + numShaderSources);
+	reloadable.build = build;
+	reloadable.swap = swap;
+	reloadable.userData = userData;
+
+	std::lock_guard<std::mutex> lock(reload->mutex);
+	reload->pipelines.push_back(reloadable);
+}
+
+void unregisterHotReloadPipeline(EngineContext& context, VkPipeline* pipeline)
+{
+	ShaderHotReload* reload = context.shaderHotReload;
+	if (!reload)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> buildLock(reload->buildMutex);
+	std::lock_guard<std::mutex> lock(reload->mutex);
+
+	reload->pipelines.erase(eastl::remove_if(reload->pipelines.begin(), reload->pipelines.end(),
+		[pipeline](const ReloadablePipeline& reloadable) { return reloadable.pipeline == pipeline; }), reload->pipelines.end());
+
+	// never swapped in, so no frame used them
+	for (const PendingSwap& swap : reload->pendingSwaps)
+	{
+		if (swap.target == pipeline)
+		{
+			vkDestroyPipeline(context.device, swap.pipeline, nullptr);
+		}
+	}
+	reload->pendingSwaps.erase(eastl::remove_if(reload->pendingSwaps.begin(), reload->pendingSwaps.end(),
+		[pipeline](const PendingSwap& swap) { return swap.target == pipeline; }), reload->pendingSwaps.end());
+}
+
+void applyShaderHotReload(EngineContext& context)
+{
+	ShaderHotReload* reload = context.shaderHotReload;
+	if (!reload)
+	{
+		return;
+	}
+
+	// the reload thread may be holding the lock, in which case the swap waits for the next frame
+	std::unique_lock<std::mutex> lock(reload->mutex, std::try_to_lock);
+	if (!lock.owns_lock())
+	{
+		return;
+	}
+
+	for (const PendingSwap& swap : reload->pendingSwaps)
+	{
+		VkPipeline previous = *swap.target;
+		if (swap.swap)
+		{
+			previous = swap.swap(swap.target, swap.pipeline, swap.userData);
+		}
+		else
+		{
+			*swap.target = swap.pipeline;
+		}
+		deferDestroy(context, previous);
+	}
+
+	reload->pendingSwaps.clear();
+}
@@ -0,0 +1,135 @@
+#include "ShaderVariants.h"
+
+#include <EASTL/algorithm.h>
+
+#include "EngineContext.h"
+#include "Log.h"
+
+static const uint64_t FnvOffsetBasis = 14695981039346656037ull;
+static const uint64_t FnvPrime = 1099511628211ull;
+
+uint64_t makeShaderVariantKey(const ShaderProgram& program, uint32_t features)
+{
+	uint64_t hash = FnvOffsetBasis;
+	for (const char* c = program.name; *c; ++c)
+	{
+		hash = (hash ^ static_cast<uint8_t>(*c)) * FnvPrime;
+	}
+
+	for (int i = 0; i < 4; ++i)
+	{
+		hash = (hash ^ ((features >> (i * 8)) & 0xff)) * FnvPrime;
+	}
+
+	return hash;
+}
+
+const VkSpecializationInfo* makeShaderSpecialization(uint32_t features, ShaderSpecialization& specialization)
+{
+	for (uint32_t i = 0; i < NUM_SHADER_FEATURES; ++i)
+	{
+		specialization.entries[i].constantID = i;
+		specialization.entries[i].offset = i * sizeof(VkBool32);
+		specialization.entries[i].size = sizeof(VkBool32);
+		specialization.values[i] = (features & (1u << i)) ? VK_TRUE : VK_FALSE;
+	}
+
+	specialization.info.mapEntryCount = NUM_SHADER_FEATURES;
+	specialization.info.pMapEntries = specialization.entries;
+	specialization.info.dataSize = sizeof(specialization.values);
+	specialization.info.pData = specialization.values;
+
+	return &specialization.info;
+}
+
+static ShaderVariant& findOrBuildVariant(EngineContext& context, const ShaderProgram& program, uint32_t features, const PipelineDesc& stateDesc)
+{
+	features &= program.supportedFeatures;
+
+	PipelineDesc desc = stateDesc;
+	desc.vertexShader = program.vertexShader;
+	desc.fragmentShader = program.fragmentShader;
+	desc.shaderFeatures = features;
+
+	// the same program may be used with different state, so the state is part of the key too
+	uint64_t key = makeShaderVariantKey(program, features) ^ hashPipelineDesc(desc);
+
+	auto it = context.shaderVariants.find(key);
+	if (it == context.shaderVariants.end())
+	{
+		ShaderVariant variant = {};
+		variant.program = &program;
+		variant.features = features;
+		it = context.shaderVariants.insert(eastl::make_pair(key, variant)).first;
+	}
+
+	// always asked from the cache, hot reload may have replaced the pipeline since the last call
+	it->second.pipeline = getPipeline(context, desc);
+
+	return it->second;
+}
+
+VkPipeline getShaderVariant(EngineContext& context, const ShaderProgram& program, uint32_t features, const PipelineDesc& stateDesc)
+{
+	ShaderVariant& variant = findOrBuildVariant(context, program, features, stateDesc);
+	++variant.numUses;
+
+	return variant.pipeline;
+}
+
+void prewarmShaderVariants(EngineContext& context, const ShaderProgram& program, const uint32_t* features, uint32_t numFeatures, const PipelineDesc& stateDesc)
+{
+	for (uint32_t i = 0; i < numFeatures; ++i)
+	{
+		findOrBuildVariant(context, program, features[i], stateDesc);
+	}
+}
+
+void reportShaderVariantUsage(EngineContext& context)
+{
+	eastl::vector<const ShaderProgram*> programs;
+	for (const auto& entry : context.shaderVariants)
+	{
+		if (eastl::find(programs.begin(), programs.end(), entry.second.program) == programs.end())
+		{
+			programs.push_back(entry.second.program);
+		}
+	}
+
+	for (const ShaderProgram* program : programs)
+	{
+		uint32_t numBuilt = 0;
+		uint32_t numUsed = 0;
+		for (const auto& entry : context.shaderVariants)
+		{
+			const ShaderVariant& variant = entry.second;
+			if (variant.program != program)
+			{
+				continue;
+			}
+
+			++numBuilt;
+			if (variant.numUses > 0)
+			{
+				++numUsed;
+				Log::log("Shader program %s variant 0x%x used %llu times\n", program->name, variant.features, static_cast<unsigned long long>(variant.numUses));
+			}
+		}
+
+		uint32_t numPossible = 1;
+		for (uint32_t i = 0; i < NUM_SHADER_FEATURES; ++i)
+		{
+			if (program->supportedFeatures & (1u << i))
+			{
+				numPossible *= 2;
+			}
+		}
+
+		Log::log("Shader program %s: %u of %u possible variants used, %u built\n", program->name, numUsed, numPossible, numBuilt);
+	}
+}
+
+void destroyShaderVariants(EngineContext& context)
+{
+	context.shaderVariants.clear();
+}
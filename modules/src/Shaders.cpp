@@ -0,0 +1,150 @@
+#include "Shaders.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <mutex>
+
+#include <EASTL/hash_map.h>
+#include <EASTL/string.h>
+
+#include "AssetPipeline.h"
+#include "Constants.h"
+#include "EngineContext.h"
+#include "Log.h"
+#include "StringId.h"
+
+struct CachedShaderFile
+{
+	// ids are only 32 bits, lookups compare the name so a collision can't hand out the wrong code
+	eastl::string name;
+	eastl::vector<uint8_t> code;
+};
+
+struct ShaderFileCache
+{
+	std::mutex mutex;
+	// keyed by the id of the file name, so looking one up doesn't build a string
+	eastl::hash_map<uint32_t, CachedShaderFile> files;
+};
+
+eastl::vector<uint8_t> readShaderFile(const char* filename)
+{
+	eastl::string fullName = ShadersFolder;
+	fullName += filename;
+
+	FILE* f = fopen(fullName.c_str(), "rb");
+	if (!f)
+	{
+		Log::error("Cannot open shader file %s\n", fullName.c_str());
+		return {};
+	}
+
+	fseek(f, 0, SEEK_END);
+
+	uint64_t fileLength = ftell(f);
+
+	eastl::vector<uint8_t> loadedData(fileLength);
+	fseek(f, 0, SEEK_SET);
+	fread(loadedData.data(), 1, fileLength, f);
+	fclose(f);
+
+	return loadedData;
+}
+
+VkShaderModule createShaderModule(VkDevice device, const eastl::vector<uint8_t>& code)
+{
+	VkShaderModuleCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = code.size();
+	assert(reinterpret_cast<intptr_t>(code.data()) % sizeof(uint32_t) == 0);
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+	VkShaderModule shaderModule;
+	VkResult result = vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Cannot create shader module");
+	}
+
+	return shaderModule;
+}
+
+static void finishShaderFile(AssetId id, const char* path, eastl::vector<uint8_t>& data, void* userData)
+{
+	ShaderFileCache& cache = *static_cast<ShaderFileCache*>(userData);
+
+	std::lock_guard<std::mutex> lock(cache.mutex);
+	CachedShaderFile& file = cache.files[makeStringId(path).value];
+	if (!file.name.empty() && file.name != path)
+	{
+		Log::fatal("Shader files %s and %s have the same id, rename one of them\n", file.name.c_str(), path);
+	}
+	file.name = path;
+	file.code = eastl::move(data);
+}
+
+void preloadShaderFiles(EngineContext& context)
+{
+	ShaderFileCache* cache = new ShaderFileCache;
+	context.shaderFileCache = cache;
+
+	AssetPipeline* assets = createAssetPipeline(context.jobSystem, ShadersFolder);
+
+	AssetTypeHandler handler = {};
+	handler.finish = finishShaderFile;
+	handler.userData = cache;
+	setAssetTypeHandler(assets, AssetType_Shader, handler);
+
+	requestAsset(assets, AssetType_Manifest, ShaderManifest);
+	bool loaded = waitForAssets(assets);
+
+	AssetPipelineStats stats = getAssetPipelineStats(assets);
+	Log::log("Preloaded %u shader files, %llu KiB through %s\n", static_cast<uint32_t>(cache->files.size()),
+		static_cast<unsigned long long>(stats.bytesRead >> 10), getAssetPipelineIoBackend(assets));
+	if (!loaded)
+	{
+		Log::warning("Not every shader could be preloaded, the rest is read when first used\n");
+	}
+
+	destroyAssetPipeline(assets);
+}
+
+void destroyShaderFileCache(EngineContext& context)
+{
+	delete context.shaderFileCache;
+	context.shaderFileCache = nullptr;
+}
+
+eastl::vector<uint8_t> loadShaderFile(EngineContext& context, const char* filename)
+{
+	ShaderFileCache* cache = context.shaderFileCache;
+	if (cache)
+	{
+		std::lock_guard<std::mutex> lock(cache->mutex);
+		auto found = cache->files.find(makeStringId(filename).value);
+		if (found != cache->files.end() && found->second.name == filename)
+		{
+			return found->second.code;
+		}
+	}
+
+	return readShaderFile(filename);
+}
+
+void evictShaderFile(EngineContext& context, const char* filename)
+{
+	ShaderFileCache* cache = context.shaderFileCache;
+	if (!cache)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(cache->mutex);
+	auto found = cache->files.find(makeStringId(filename).value);
+	if (found != cache->files.end() && found->second.name == filename)
+	{
+		cache->files.erase(found);
+	}
+}
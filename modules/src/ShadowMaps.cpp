@@ -0,0 +1,921 @@
+#include "ShadowMaps.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <EASTL/vector.h>
+
+#include "Clock.h"
+#include "ComputePass.h"
+#include "DepthBuffer.h"
+#include "EngineContext.h"
+#include "GpuMemory.h"
+#include "Log.h"
+#include "Mesh.h"
+#include "PipelineCache.h"
+#include "ResourceRegistry.h"
+
+static const uint32_t DefaultMapSize = 2048;
+// cascades are laid out in a 2x2 grid of the atlas
+static const uint32_t AtlasColumns = 2;
+
+static const uint32_t MaxShadowCasters = 8;
+static const uint32_t MaxShadowInstances = 16 * 1024;
+
+// cascades from this one on may be cached, the closer ones change with every camera move anyway
+static const uint32_t FirstCachedCascade = 2;
+// cached cascades cover this much more than their slice, so they stay valid while the camera moves a bit
+static const float CachedCascadePadding = 0.25f;
+// split distances blend between uniform (0) and logarithmic (1)
+static const float CascadeSplitLambda = 0.75f;
+
+// the same light the samples were shaded with before there were shadows
+static const Vec3 BaseLightDirection = { 0.4f, 1.0f, -0.3f };
+
+static const double StatsInterval = 5.0;
+
+// std140 layout of Shadows in shadows.glsl
+struct ShadowUniforms
+{
+	float viewProjections[MaxShadowCascades][16];
+	// view depth at which each cascade ends
+	float splits[4];
+	// world size of a shadow map texel in each cascade
+	float texelSizes[4];
+	// w is the number of cascades, 0 when shadows are off
+	float eye[4];
+	float forward[4];
+	// towards the light
+	float lightDirection[4];
+	// x is one over the atlas size in texels, y the size of a cascade in atlas uv
+	float atlas[4];
+};
+
+// std430 layout of Instance in shadow.vert
+struct GpuShadowInstance
+{
+	float positionScale[4];
+	uint32_t vertexOffset;
+	uint32_t padding[3];
+};
+
+// Light space box, x and y across the shadow map and z away from the light
+struct LightSpaceBounds
+{
+	Vec3 min;
+	Vec3 max;
+};
+
+struct ShadowCaster
+{
+	ShadowCasterDesc desc;
+	eastl::vector<ShadowInstance> instances;
+	VkDescriptorSet drawSets[MAX_FRAMES_IN_FLIGHT];
+};
+
+struct ShadowCascade
+{
+	// what the cascade's square of the atlas was last drawn with, kept across frames for cached cascades
+	LightSpaceBounds bounds;
+	float nearPlane;
+	float texelSize;
+	Mat4 viewProjection;
+	bool valid;
+	bool hasDynamicCasters;
+	Vec3 lightDirection;
+	uint64_t staticVersion;
+
+	// this frame's draws, when it is redrawn
+	bool redraw;
+	uint32_t firstDraw;
+	uint32_t numDraws;
+
+	uint32_t numRedraws;
+};
+
+struct ShadowDraw
+{
+	uint32_t caster;
+	uint32_t firstInstance;
+	uint32_t numInstances;
+};
+
+struct ShadowMaps
+{
+	bool enabled;
+	bool caching;
+	uint32_t mapSize;
+	uint32_t numCascades;
+	float shadowDistance;
+	float lightSpeed;
+
+	GpuImage atlas;
+	ImageHandle atlasHandle;
+	VkSampler sampler;
+	// VK_NULL_HANDLE with dynamic rendering
+	VkRenderPass renderPass;
+	VkFramebuffer framebuffer;
+
+	VkDescriptorSetLayout drawSetLayout;
+	VkPipelineLayout drawPipelineLayout;
+	PipelineDesc drawPipelineDesc;
+
+	GpuBuffer uniformBuffers[MAX_FRAMES_IN_FLIGHT];
+	GpuBuffer instanceBuffers[MAX_FRAMES_IN_FLIGHT];
+
+	eastl::vector<ShadowCaster> casters;
+	// bumped whenever a static caster changes
+	uint64_t staticVersion;
+
+	Vec3 lightDirection;
+	Vec3 lightRight;
+	Vec3 lightUp;
+	Vec3 lightForward;
+	Mat4 lightView;
+
+	ShadowCascade cascades[MaxShadowCascades];
+	eastl::vector<ShadowDraw> draws;
+	uint32_t numInstances;
+	bool loggedOverflow;
+
+	double startTime;
+	bool logStats;
+	double lastStatsTime;
+	uint32_t numStatsFrames;
+	uint64_t numStatsInstances;
+};
+
+static bool isEnvSet(const char* name, bool defaultValue)
+{
+	const char* value = getenv(name);
+	return value ? strcmp(value, "0") != 0 : defaultValue;
+}
+
+static float getEnvFloat(const char* name, float defaultValue)
+{
+	const char* value = getenv(name);
+	return value ? static_cast<float>(atof(value)) : defaultValue;
+}
+
+static void writeBufferDescriptor(EngineContext& context, VkDescriptorSet set, uint32_t binding, VkDescriptorType type, VkBuffer buffer)
+{
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer;
+	bufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+	write.pBufferInfo = &bufferInfo;
+
+	vkUpdateDescriptorSets(context.device, 1, &write, 0, nullptr);
+}
+
+static VkRenderPass createShadowRenderPass(EngineContext& context, VkFormat format)
+{
+	// layouts are transitioned around all cascades at once by recordShadowMaps, and every cascade
+	// clears only its own square through the render area
+	VkAttachmentDescription depthAttachment = {};
+	depthAttachment.format = format;
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentReference depthAttachmentRef = {};
+	depthAttachmentRef.attachment = 0;
+	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments = &depthAttachment;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+
+	VkRenderPass renderPass;
+	VkResult result = vkCreateRenderPass(context.device, &renderPassInfo, nullptr, &renderPass);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create shadow render pass\n");
+	}
+
+	return renderPass;
+}
+
+static void createAtlas(EngineContext& context, ShadowMaps& shadows)
+{
+	uint32_t atlasSize = shadows.mapSize * AtlasColumns;
+	createGpuImage(context, atlasSize, atlasSize, 1, context.depthFormat,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, shadows.atlas);
+	initializeGpuImageLayout(context, shadows.atlas, getDepthBarrierAspect(context.depthFormat), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	shadows.atlasHandle = registerImage(context, "shadowAtlas", shadows.atlas, getDepthBarrierAspect(context.depthFormat),
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	// lit where the receiver is no further from the light than the stored depth
+	samplerInfo.compareEnable = VK_TRUE;
+	samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+	VkResult result = vkCreateSampler(context.device, &samplerInfo, nullptr, &shadows.sampler);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create shadow sampler\n");
+	}
+
+	if (context.dynamicRendering != DynamicRenderingSupport_None)
+	{
+		return;
+	}
+
+	shadows.renderPass = createShadowRenderPass(context, context.depthFormat);
+
+	VkFramebufferCreateInfo framebufferInfo = {};
+	framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	framebufferInfo.renderPass = shadows.renderPass;
+	framebufferInfo.attachmentCount = 1;
+	framebufferInfo.pAttachments = &shadows.atlas.view;
+	framebufferInfo.width = atlasSize;
+	framebufferInfo.height = atlasSize;
+	framebufferInfo.layers = 1;
+
+	result = vkCreateFramebuffer(context.device, &framebufferInfo, nullptr, &shadows.framebuffer);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create shadow framebuffer\n");
+	}
+}
+
+static void createDrawPipeline(EngineContext& context, ShadowMaps& shadows)
+{
+	VkDescriptorSetLayoutBinding bindings[3] = {};
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = 3;
+	setLayoutInfo.pBindings = bindings;
+
+	VkResult result = vkCreateDescriptorSetLayout(context.device, &setLayoutInfo, nullptr, &shadows.drawSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create shadow descriptor set layout\n");
+	}
+
+	// the cascade's view projection
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.size = sizeof(Mat4);
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &shadows.drawSetLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	result = vkCreatePipelineLayout(context.device, &layoutInfo, nullptr, &shadows.drawPipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create shadow pipeline layout\n");
+	}
+
+	// depth only, the slope scaled bias keeps surfaces facing away from the light from shadowing themselves
+	shadows.drawPipelineDesc = makeDefaultPipelineDesc();
+	shadows.drawPipelineDesc.vertexShader = "shadow.vert";
+	shadows.drawPipelineDesc.layout = shadows.drawPipelineLayout;
+	shadows.drawPipelineDesc.depthTestEnable = VK_TRUE;
+	shadows.drawPipelineDesc.depthWriteEnable = VK_TRUE;
+	shadows.drawPipelineDesc.depthBiasConstant = 1.0f;
+	shadows.drawPipelineDesc.depthBiasSlope = 1.5f;
+	shadows.drawPipelineDesc.renderPass = shadows.renderPass;
+	shadows.drawPipelineDesc.depthFormat = context.depthFormat;
+
+	getPipeline(context, shadows.drawPipelineDesc);
+}
+
+void createShadowMaps(EngineContext& context)
+{
+	ShadowMaps* shadows = new ShadowMaps;
+	*shadows = {};
+
+	shadows->enabled = isEnvSet("ENGINE_SHADOWS", true);
+	shadows->caching = isEnvSet("ENGINE_SHADOW_CACHE", true);
+	shadows->logStats = isEnvSet("ENGINE_SHADOW_STATS", false);
+	shadows->shadowDistance = getEnvFloat("ENGINE_SHADOW_DISTANCE", 0.0f);
+	shadows->lightSpeed = getEnvFloat("ENGINE_SHADOW_LIGHT_SPEED", 0.0f);
+	shadows->numCascades = MaxShadowCascades;
+
+	const char* mapSize = getenv("ENGINE_SHADOW_MAP_SIZE");
+	shadows->mapSize = mapSize ? static_cast<uint32_t>(strtoul(mapSize, nullptr, 0)) : DefaultMapSize;
+	shadows->mapSize = shadows->mapSize >= 64 ? shadows->mapSize : 64;
+	// receivers still sample something when shadows are off
+	if (!shadows->enabled)
+	{
+		shadows->mapSize = 1;
+	}
+
+	createAtlas(context, *shadows);
+	createDrawPipeline(context, *shadows);
+
+	VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		createGpuBuffer(context, sizeof(ShadowUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, shadows->uniformBuffers[i]);
+		createGpuBuffer(context, MaxShadowInstances * sizeof(GpuShadowInstance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, shadows->instanceBuffers[i]);
+
+		// nothing is drawn before the first update
+		memset(shadows->uniformBuffers[i].mapped, 0, sizeof(ShadowUniforms));
+	}
+
+	shadows->startTime = context.frameTime;
+	shadows->lastStatsTime = getEngineTime();
+
+	if (shadows->enabled)
+	{
+		Log::log("Shadows: %u cascades of %ux%u, cascades from %u on are %s\n", shadows->numCascades, shadows->mapSize, shadows->mapSize,
+			FirstCachedCascade, shadows->caching ? "cached" : "redrawn every frame");
+	}
+
+	context.shadowMaps = shadows;
+}
+
+void destroyShadowMaps(EngineContext& context)
+{
+	ShadowMaps* shadows = context.shadowMaps;
+	if (!shadows)
+	{
+		return;
+	}
+
+	vkDestroyPipelineLayout(context.device, shadows->drawPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(context.device, shadows->drawSetLayout, nullptr);
+	vkDestroyFramebuffer(context.device, shadows->framebuffer, nullptr);
+	vkDestroyRenderPass(context.device, shadows->renderPass, nullptr);
+	vkDestroySampler(context.device, shadows->sampler, nullptr);
+	unregisterImage(context, shadows->atlasHandle);
+	destroyGpuImage(context, shadows->atlas);
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		destroyGpuBuffer(context, shadows->uniformBuffers[i]);
+		destroyGpuBuffer(context, shadows->instanceBuffers[i]);
+	}
+
+	delete shadows;
+	context.shadowMaps = nullptr;
+}
+
+void createShadowPositionBuffer(EngineContext& context, const MeshVertex* vertices, uint32_t numVertices, GpuBuffer& buffer)
+{
+	eastl::vector<float> positions(numVertices * 3);
+	for (uint32_t i = 0; i < numVertices; ++i)
+	{
+		memcpy(&positions[i * 3], vertices[i].position, sizeof(vertices[i].position));
+	}
+
+	VkDeviceSize size = positions.size() * sizeof(float);
+	createGpuBuffer(context, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer);
+	uploadToGpuBuffer(context, buffer, positions.data(), size);
+}
+
+uint32_t addShadowCaster(EngineContext& context, const ShadowCasterDesc& desc)
+{
+	ShadowMaps& shadows = *context.shadowMaps;
+	if (shadows.casters.size() >= MaxShadowCasters)
+	{
+		Log::fatal("More than %u shadow casters\n", MaxShadowCasters);
+	}
+
+	ShadowCaster caster = {};
+	caster.desc = desc;
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		caster.drawSets[i] = allocateDescriptorSet(context, shadows.drawSetLayout);
+		writeBufferDescriptor(context, caster.drawSets[i], 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, desc.positionBuffers[i]);
+		writeBufferDescriptor(context, caster.drawSets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, desc.indexBuffer);
+		writeBufferDescriptor(context, caster.drawSets[i], 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, shadows.instanceBuffers[i].buffer);
+	}
+
+	shadows.casters.push_back(caster);
+	if (desc.isStatic)
+	{
+		++shadows.staticVersion;
+	}
+
+	return static_cast<uint32_t>(shadows.casters.size() - 1);
+}
+
+void setShadowCasterInstances(EngineContext& context, uint32_t caster, const ShadowInstance* instances, uint32_t numInstances)
+{
+	ShadowMaps& shadows = *context.shadowMaps;
+	ShadowCaster& shadowCaster = shadows.casters[caster];
+	shadowCaster.instances.assign(instances, instances + numInstances);
+
+	if (shadowCaster.desc.isStatic)
+	{
+		++shadows.staticVersion;
+	}
+}
+
+static Vec3 toLightSpace(const ShadowMaps& shadows, const Vec3& p)
+{
+	return makeVec3(dot(shadows.lightRight, p), dot(shadows.lightUp, p), dot(shadows.lightForward, p));
+}
+
+static void updateLight(ShadowMaps& shadows, double time)
+{
+	float angle = static_cast<float>(time - shadows.startTime) * shadows.lightSpeed;
+	float c = cosf(angle);
+	float s = sinf(angle);
+	Vec3 base = normalize(BaseLightDirection);
+	shadows.lightDirection = makeVec3(base.x * c + base.z * s, base.y, base.z * c - base.x * s);
+
+	// the light looks along its rays. Its up vector only matters for stability, it mustn't be parallel to them.
+	shadows.lightForward = shadows.lightDirection * -1.0f;
+	Vec3 worldUp = fabsf(shadows.lightForward.y) < 0.99f ? makeVec3(0.0f, 1.0f, 0.0f) : makeVec3(0.0f, 0.0f, 1.0f);
+	shadows.lightRight = normalize(cross(worldUp, shadows.lightForward));
+	shadows.lightUp = cross(shadows.lightForward, shadows.lightRight);
+	shadows.lightView = makeViewMatrix(makeVec3(0.0f, 0.0f, 0.0f), shadows.lightRight, shadows.lightUp, shadows.lightForward);
+}
+
+static void computeSplits(const ShadowMaps& shadows, const Camera& camera, float* splits)
+{
+	float nearPlane = camera.nearPlane;
+	float farPlane = shadows.shadowDistance > nearPlane && shadows.shadowDistance < camera.farPlane ? shadows.shadowDistance : camera.farPlane;
+
+	for (uint32_t i = 0; i < shadows.numCascades; ++i)
+	{
+		float t = static_cast<float>(i + 1) / shadows.numCascades;
+		float logarithmic = nearPlane * powf(farPlane / nearPlane, t);
+		float uniform = nearPlane + (farPlane - nearPlane) * t;
+		splits[i] = uniform + (logarithmic - uniform) * CascadeSplitLambda;
+	}
+}
+
+// Smallest sphere around the slice of the view frustum between two depths. It only depends on the
+// depths and the field of view, not on where the camera looks, so its size never changes.
+static void computeSliceSphere(const Camera& camera, float sliceNear, float sliceFar, Vec3& center, float& radius)
+{
+	float tanHalfFovX = camera.tanHalfFovY * camera.aspect;
+	float diagonal2 = tanHalfFovX * tanHalfFovX + camera.tanHalfFovY * camera.tanHalfFovY;
+
+	// equidistant from the near and far corners, unless the far ones alone need a larger sphere
+	float centerDepth = 0.5f * (sliceNear + sliceFar) * (1.0f + diagonal2);
+	centerDepth = centerDepth < sliceFar ? centerDepth : sliceFar;
+
+	float farOffset = sliceFar - centerDepth;
+	radius = sqrtf(farOffset * farOffset + sliceFar * sliceFar * diagonal2);
+	// rounded up so float noise doesn't change the texel size from frame to frame
+	radius = ceilf(radius * 16.0f) / 16.0f;
+	center = camera.position + camera.forward * centerDepth;
+}
+
+static LightSpaceBounds computeSliceBounds(const ShadowMaps& shadows, const Camera& camera, float sliceNear, float sliceFar)
+{
+	float tanHalfFovX = camera.tanHalfFovY * camera.aspect;
+
+	LightSpaceBounds bounds;
+	bounds.min = makeVec3(INFINITY, INFINITY, INFINITY);
+	bounds.max = makeVec3(-INFINITY, -INFINITY, -INFINITY);
+
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		float depth = i < 4 ? sliceNear : sliceFar;
+		float x = (i & 1) ? depth * tanHalfFovX : -depth * tanHalfFovX;
+		float y = (i & 2) ? depth * camera.tanHalfFovY : -depth * camera.tanHalfFovY;
+		Vec3 corner = toLightSpace(shadows, camera.position + camera.forward * depth + camera.right * x + camera.up * y);
+
+		bounds.min = makeVec3(fminf(bounds.min.x, corner.x), fminf(bounds.min.y, corner.y), fminf(bounds.min.z, corner.z));
+		bounds.max = makeVec3(fmaxf(bounds.max.x, corner.x), fmaxf(bounds.max.y, corner.y), fmaxf(bounds.max.z, corner.z));
+	}
+
+	return bounds;
+}
+
+// The square the cascade covers, with its center snapped to whole texels so that static casters are
+// rasterized the same way while it follows the camera
+static void fitCascade(const ShadowMaps& shadows, ShadowCascade& cascade, const Vec3& center, float radius)
+{
+	Vec3 lightCenter = toLightSpace(shadows, center);
+	float texelSize = 2.0f * radius / shadows.mapSize;
+	float x = floorf(lightCenter.x / texelSize) * texelSize;
+	float y = floorf(lightCenter.y / texelSize) * texelSize;
+
+	cascade.bounds.min = makeVec3(x - radius, y - radius, lightCenter.z - radius);
+	cascade.bounds.max = makeVec3(x + radius, y + radius, lightCenter.z + radius);
+	cascade.texelSize = texelSize;
+}
+
+static bool containsSphere(const LightSpaceBounds& bounds, const Vec3& center, float radius)
+{
+	return center.x - radius >= bounds.min.x && center.x + radius <= bounds.max.x &&
+		center.y - radius >= bounds.min.y && center.y + radius <= bounds.max.y &&
+		center.z - radius >= bounds.min.z && center.z + radius <= bounds.max.z;
+}
+
+// Whether a caster can throw a shadow onto receivers in the bounds. Casters are never behind the
+// light, so there is no test against the near side, the near plane is moved to them instead.
+static bool castsInto(const LightSpaceBounds& bounds, const Vec3& center, float radius)
+{
+	return center.x + radius >= bounds.min.x && center.x - radius <= bounds.max.x &&
+		center.y + radius >= bounds.min.y && center.y - radius <= bounds.max.y &&
+		center.z - radius <= bounds.max.z;
+}
+
+static bool hasDynamicCastersIn(const ShadowMaps& shadows, const LightSpaceBounds& bounds)
+{
+	for (const ShadowCaster& caster : shadows.casters)
+	{
+		if (caster.desc.isStatic)
+		{
+			continue;
+		}
+
+		for (const ShadowInstance& instance : caster.instances)
+		{
+			if (castsInto(bounds, toLightSpace(shadows, instance.boundsCenter), instance.boundsRadius))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// Appends the instances of every caster that can shadow the cull bounds to the frame's instance
+// buffer, one draw per caster. Moves the near plane back to the furthest caster.
+static void cullCasters(ShadowMaps& shadows, ShadowCascade& cascade, const LightSpaceBounds& cullBounds, uint32_t slot)
+{
+	GpuShadowInstance* mapped = static_cast<GpuShadowInstance*>(shadows.instanceBuffers[slot].mapped);
+
+	cascade.firstDraw = static_cast<uint32_t>(shadows.draws.size());
+	cascade.nearPlane = cascade.bounds.min.z;
+
+	for (uint32_t i = 0; i < shadows.casters.size(); ++i)
+	{
+		const ShadowCaster& caster = shadows.casters[i];
+
+		ShadowDraw draw = {};
+		draw.caster = i;
+		draw.firstInstance = shadows.numInstances;
+
+		for (const ShadowInstance& instance : caster.instances)
+		{
+			Vec3 center = toLightSpace(shadows, instance.boundsCenter);
+			if (!castsInto(cullBounds, center, instance.boundsRadius))
+			{
+				continue;
+			}
+
+			if (shadows.numInstances == MaxShadowInstances)
+			{
+				if (!shadows.loggedOverflow)
+				{
+					Log::warning("More than %u shadow caster instances in a frame, the rest are dropped\n", MaxShadowInstances);
+					shadows.loggedOverflow = true;
+				}
+				break;
+			}
+
+			GpuShadowInstance& gpuInstance = mapped[shadows.numInstances++];
+			gpuInstance.positionScale[0] = instance.position.x;
+			gpuInstance.positionScale[1] = instance.position.y;
+			gpuInstance.positionScale[2] = instance.position.z;
+			gpuInstance.positionScale[3] = instance.scale;
+			gpuInstance.vertexOffset = instance.vertexOffset;
+
+			float casterNear = center.z - instance.boundsRadius;
+			cascade.nearPlane = casterNear < cascade.nearPlane ? casterNear : cascade.nearPlane;
+		}
+
+		draw.numInstances = shadows.numInstances - draw.firstInstance;
+		if (draw.numInstances > 0)
+		{
+			shadows.draws.push_back(draw);
+		}
+	}
+
+	cascade.numDraws = static_cast<uint32_t>(shadows.draws.size()) - cascade.firstDraw;
+
+	const LightSpaceBounds& bounds = cascade.bounds;
+	Mat4 projection = makeOrthographic(bounds.min.x, bounds.max.x, bounds.min.y, bounds.max.y, cascade.nearPlane, bounds.max.z);
+	cascade.viewProjection = multiply(projection, shadows.lightView);
+}
+
+static bool isSameDirection(const Vec3& a, const Vec3& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+static void updateCascade(ShadowMaps& shadows, const Camera& camera, uint32_t index, float sliceNear, float sliceFar, uint32_t slot)
+{
+	ShadowCascade& cascade = shadows.cascades[index];
+	cascade.redraw = false;
+	cascade.numDraws = 0;
+
+	Vec3 center;
+	float radius;
+	computeSliceSphere(camera, sliceNear, sliceFar, center, radius);
+
+	if (index < FirstCachedCascade || !shadows.caching)
+	{
+		// only casters that can shadow the slice itself, not the whole square around it
+		fitCascade(shadows, cascade, center, radius);
+		LightSpaceBounds sliceBounds = computeSliceBounds(shadows, camera, sliceNear, sliceFar);
+
+		LightSpaceBounds cullBounds = cascade.bounds;
+		cullBounds.min = makeVec3(fmaxf(cullBounds.min.x, sliceBounds.min.x), fmaxf(cullBounds.min.y, sliceBounds.min.y), cullBounds.min.z);
+		cullBounds.max = makeVec3(fminf(cullBounds.max.x, sliceBounds.max.x), fminf(cullBounds.max.y, sliceBounds.max.y), fminf(cullBounds.max.z, sliceBounds.max.z));
+
+		cascade.redraw = true;
+		cascade.valid = false;
+		cullCasters(shadows, cascade, cullBounds, slot);
+		++cascade.numRedraws;
+		return;
+	}
+
+	bool refit = !cascade.valid || !isSameDirection(cascade.lightDirection, shadows.lightDirection) ||
+		!containsSphere(cascade.bounds, toLightSpace(shadows, center), radius);
+	if (refit)
+	{
+		fitCascade(shadows, cascade, center, radius * (1.0f + CachedCascadePadding));
+	}
+
+	// a dynamic caster that was drawn last time has to be erased again even if it left
+	bool hasDynamicCasters = hasDynamicCastersIn(shadows, cascade.bounds);
+	cascade.redraw = refit || cascade.staticVersion != shadows.staticVersion || hasDynamicCasters || cascade.hasDynamicCasters;
+	if (!cascade.redraw)
+	{
+		return;
+	}
+
+	// the cached contents serve every slice the square contains, so everything in it is drawn
+	cascade.valid = true;
+	cascade.hasDynamicCasters = hasDynamicCasters;
+	cascade.lightDirection = shadows.lightDirection;
+	cascade.staticVersion = shadows.staticVersion;
+	cullCasters(shadows, cascade, cascade.bounds, slot);
+	++cascade.numRedraws;
+}
+
+static void logStats(ShadowMaps& shadows, double time)
+{
+	char redraws[MaxShadowCascades * 12] = {};
+	int length = 0;
+	for (uint32_t i = 0; i < shadows.numCascades; ++i)
+	{
+		length += snprintf(redraws + length, sizeof(redraws) - length, " %u", shadows.cascades[i].numRedraws);
+		shadows.cascades[i].numRedraws = 0;
+	}
+
+	Log::log("Shadows: cascade redraws over %u frames:%s, %.0f caster instances per frame\n", shadows.numStatsFrames, redraws,
+		shadows.numStatsFrames > 0 ? static_cast<double>(shadows.numStatsInstances) / shadows.numStatsFrames : 0.0);
+
+	shadows.numStatsFrames = 0;
+	shadows.numStatsInstances = 0;
+	shadows.lastStatsTime = time;
+}
+
+void updateShadowMaps(EngineContext& context)
+{
+	ShadowMaps* shadows = context.shadowMaps;
+	if (!shadows)
+	{
+		return;
+	}
+
+	uint32_t slot = context.currentFrame;
+	const Camera& camera = context.camera;
+
+	shadows->draws.clear();
+	shadows->numInstances = 0;
+
+	updateLight(*shadows, context.frameTime);
+
+	ShadowUniforms uniforms = {};
+	uniforms.eye[0] = camera.position.x;
+	uniforms.eye[1] = camera.position.y;
+	uniforms.eye[2] = camera.position.z;
+	uniforms.forward[0] = camera.forward.x;
+	uniforms.forward[1] = camera.forward.y;
+	uniforms.forward[2] = camera.forward.z;
+	uniforms.lightDirection[0] = shadows->lightDirection.x;
+	uniforms.lightDirection[1] = shadows->lightDirection.y;
+	uniforms.lightDirection[2] = shadows->lightDirection.z;
+	uniforms.atlas[0] = 1.0f / (shadows->mapSize * AtlasColumns);
+	uniforms.atlas[1] = 1.0f / AtlasColumns;
+
+	if (shadows->enabled)
+	{
+		uniforms.eye[3] = static_cast<float>(shadows->numCascades);
+
+		computeSplits(*shadows, camera, uniforms.splits);
+
+		float sliceNear = camera.nearPlane;
+		for (uint32_t i = 0; i < shadows->numCascades; ++i)
+		{
+			updateCascade(*shadows, camera, i, sliceNear, uniforms.splits[i], slot);
+			sliceNear = uniforms.splits[i];
+
+			// cached cascades keep the projection their contents were drawn with
+			const ShadowCascade& cascade = shadows->cascades[i];
+			memcpy(uniforms.viewProjections[i], cascade.viewProjection.m, sizeof(uniforms.viewProjections[i]));
+			uniforms.texelSizes[i] = cascade.texelSize;
+		}
+	}
+
+	memcpy(shadows->uniformBuffers[slot].mapped, &uniforms, sizeof(uniforms));
+
+	++shadows->numStatsFrames;
+	shadows->numStatsInstances += shadows->numInstances;
+
+	double time = getEngineTime();
+	if (shadows->logStats && time - shadows->lastStatsTime >= StatsInterval)
+	{
+		logStats(*shadows, time);
+	}
+}
+
+static void beginCascadeRendering(EngineContext& context, ShadowMaps& shadows, VkCommandBuffer commandBuffer, const VkRect2D& area)
+{
+	VkClearValue clearValue = {};
+	clearValue.depthStencil.depth = 1.0f;
+
+	if (context.dynamicRendering == DynamicRenderingSupport_None)
+	{
+		VkRenderPassBeginInfo renderPassInfo = {};
+		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassInfo.renderPass = shadows.renderPass;
+		renderPassInfo.framebuffer = shadows.framebuffer;
+		renderPassInfo.renderArea = area;
+		renderPassInfo.clearValueCount = 1;
+		renderPassInfo.pClearValues = &clearValue;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
+
+	VkRenderingAttachmentInfoKHR depthAttachment = {};
+	depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+	depthAttachment.imageView = shadows.atlas.view;
+	depthAttachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depthAttachment.clearValue = clearValue;
+
+	VkRenderingInfoKHR renderingInfo = {};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+	renderingInfo.renderArea = area;
+	renderingInfo.layerCount = 1;
+	renderingInfo.pDepthAttachment = &depthAttachment;
+
+	context.cmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+static void endCascadeRendering(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	if (context.dynamicRendering == DynamicRenderingSupport_None)
+	{
+		vkCmdEndRenderPass(commandBuffer);
+	}
+	else
+	{
+		context.cmdEndRendering(commandBuffer);
+	}
+}
+
+void recordShadowMaps(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	ShadowMaps* shadows = context.shadowMaps;
+	if (!shadows || !shadows->enabled)
+	{
+		return;
+	}
+
+	bool anyRedraw = false;
+	for (uint32_t i = 0; i < shadows->numCascades; ++i)
+	{
+		anyRedraw = anyRedraw || shadows->cascades[i].redraw;
+	}
+
+	// every cascade is cached, the previous frames' contents are sampled as they are
+	if (!anyRedraw)
+	{
+		return;
+	}
+
+	uint32_t slot = context.currentFrame;
+	VkImageAspectFlags aspect = getDepthBarrierAspect(context.depthFormat);
+
+	// the previous frame's receivers have to be done sampling. Cascades that aren't redrawn keep their contents.
+	recordImageBarrier(commandBuffer, shadows->atlas.image, aspect, 0, 1, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+		VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT);
+
+	VkPipeline pipeline = getPipeline(context, shadows->drawPipelineDesc);
+
+	for (uint32_t i = 0; i < shadows->numCascades; ++i)
+	{
+		const ShadowCascade& cascade = shadows->cascades[i];
+		if (!cascade.redraw)
+		{
+			continue;
+		}
+
+		VkRect2D area = {};
+		area.offset.x = static_cast<int32_t>((i % AtlasColumns) * shadows->mapSize);
+		area.offset.y = static_cast<int32_t>((i / AtlasColumns) * shadows->mapSize);
+		area.extent.width = shadows->mapSize;
+		area.extent.height = shadows->mapSize;
+
+		// cleared even when nothing casts into it
+		beginCascadeRendering(context, *shadows, commandBuffer, area);
+
+		VkViewport viewport = {};
+		viewport.x = static_cast<float>(area.offset.x);
+		viewport.y = static_cast<float>(area.offset.y);
+		viewport.width = static_cast<float>(area.extent.width);
+		viewport.height = static_cast<float>(area.extent.height);
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &area);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdPushConstants(commandBuffer, shadows->drawPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(Mat4), cascade.viewProjection.m);
+
+		for (uint32_t j = 0; j < cascade.numDraws; ++j)
+		{
+			const ShadowDraw& draw = shadows->draws[cascade.firstDraw + j];
+			const ShadowCaster& caster = shadows->casters[draw.caster];
+
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shadows->drawPipelineLayout, 0, 1, &caster.drawSets[slot], 0, nullptr);
+			vkCmdDraw(commandBuffer, caster.desc.numIndices[i], draw.numInstances, caster.desc.firstIndex[i], draw.firstInstance);
+		}
+
+		endCascadeRendering(context, commandBuffer);
+	}
+
+	recordImageBarrier(commandBuffer, shadows->atlas.image, aspect, 0, 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+void makeShadowReceiverBindings(uint32_t firstBinding, VkShaderStageFlags stages, VkDescriptorSetLayoutBinding* bindings)
+{
+	for (uint32_t i = 0; i < NumShadowReceiverBindings; ++i)
+	{
+		bindings[i] = {};
+		bindings[i].binding = firstBinding + i;
+		bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = stages;
+	}
+}
+
+void writeShadowReceiverDescriptors(EngineContext& context, VkDescriptorSet set, uint32_t firstBinding, uint32_t slot)
+{
+	ShadowMaps& shadows = *context.shadowMaps;
+
+	writeBufferDescriptor(context, set, firstBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, shadows.uniformBuffers[slot].buffer);
+
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.sampler = shadows.sampler;
+	imageInfo.imageView = shadows.atlas.view;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = firstBinding + 1;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(context.device, 1, &write, 0, nullptr);
+}
@@ -0,0 +1,151 @@
+#include "Simulation.h"
+
+#include <math.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+#include "EngineContext.h"
+
+static const uint32_t SnapshotIndexMask = 0x3;
+static const uint32_t SnapshotNewBit = 0x4;
+
+struct Simulation
+{
+	std::thread thread;
+	std::atomic<bool> running;
+	std::chrono::steady_clock::time_point startTime;
+
+	// Triple buffer. The simulation writes buffers[writeIndex], the render thread reads
+	// buffers[readIndex] and the third one is parked in sharedIndex, with SnapshotNewBit set
+	// when it holds a snapshot the render thread hasn't seen yet.
+	SimulationSnapshot buffers[3];
+	std::atomic<uint32_t> sharedIndex;
+	uint32_t writeIndex;
+	uint32_t readIndex;
+
+	// simulation thread only
+	SimulationSnapshot state;
+
+	// render thread only
+	SimulationSnapshot previous;
+	SimulationSnapshot current;
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void tickSimulation(SimulationSnapshot& state, double deltaTime)
+{
+	++state.tick;
+	state.time += deltaTime;
+
+	state.rotation += static_cast<float>(deltaTime);
+	state.position[0] = 0.3f * static_cast<float>(cos(state.time * 0.5));
+	state.position[1] = 0.3f * static_cast<float>(sin(state.time * 0.5));
+}
+
+static void publishSnapshot(Simulation& simulation)
+{
+	simulation.buffers[simulation.writeIndex] = simulation.state;
+	simulation.writeIndex = simulation.sharedIndex.exchange(simulation.writeIndex | SnapshotNewBit, std::memory_order_acq_rel) & SnapshotIndexMask;
+}
+
+static void simulationThread(Simulation& simulation)
+{
+	const double tickDuration = 1.0 / SimulationTickRate;
+	double nextTickTime = simulation.state.time + tickDuration;
+
+	while (simulation.running.load(std::memory_order_relaxed))
+	{
+		// catch up if we fell behind, always with the fixed step
+		while (secondsSince(simulation.startTime) >= nextTickTime)
+		{
+			tickSimulation(simulation.state, tickDuration);
+			nextTickTime += tickDuration;
+		}
+
+		publishSnapshot(simulation);
+
+		std::this_thread::sleep_until(simulation.startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(nextTickTime)));
+	}
+}
+
+void startSimulation(EngineContext& context)
+{
+	Simulation* simulation = new Simulation;
+	simulation->startTime = std::chrono::steady_clock::now();
+	simulation->state = {};
+	simulation->buffers[0] = simulation->state;
+	simulation->buffers[1] = simulation->state;
+	simulation->buffers[2] = simulation->state;
+	simulation->writeIndex = 0;
+	simulation->sharedIndex = 1;
+	simulation->readIndex = 2;
+	simulation->previous = simulation->state;
+	simulation->current = simulation->state;
+	simulation->running = true;
+
+	simulation->thread = std::thread(simulationThread, std::ref(*simulation));
+
+	context.simulation = simulation;
+}
+
+void stopSimulation(EngineContext& context)
+{
+	Simulation* simulation = context.simulation;
+	if (!simulation)
+	{
+		return;
+	}
+
+	simulation->running = false;
+	simulation->thread.join();
+
+	delete simulation;
+	context.simulation = nullptr;
+}
+
+static float lerp(float a, float b, float t)
+{
+	return a + (b - a) * t;
+}
+
+SimulationSnapshot getInterpolatedSnapshot(EngineContext& context)
+{
+	Simulation& simulation = *context.simulation;
+
+	if (simulation.sharedIndex.load(std::memory_order_relaxed) & SnapshotNewBit)
+	{
+		simulation.readIndex = simulation.sharedIndex.exchange(simulation.readIndex, std::memory_order_acq_rel) & SnapshotIndexMask;
+	}
+
+	const SimulationSnapshot& latest = simulation.buffers[simulation.readIndex];
+	if (latest.tick != simulation.current.tick)
+	{
+		simulation.previous = simulation.current;
+		simulation.current = latest;
+	}
+
+	const SimulationSnapshot& a = simulation.previous;
+	const SimulationSnapshot& b = simulation.current;
+
+	double renderTime = secondsSince(simulation.startTime) - 1.0 / SimulationTickRate;
+	float t = 1.0f;
+	if (b.time > a.time)
+	{
+		t = static_cast<float>((renderTime - a.time) / (b.time - a.time));
+		t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+	}
+
+	SimulationSnapshot result = b;
+	result.position[0] = lerp(a.position[0], b.position[0], t);
+	result.position[1] = lerp(a.position[1], b.position[1], t);
+	result.rotation = lerp(a.rotation, b.rotation, t);
+
+	return result;
+}
@@ -0,0 +1,569 @@
+#include "SkinningSample.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <EASTL/vector.h>
+
+#include "Animation.h"
+#include "ArraySize.h"
+#include "Clock.h"
+#include "ComputePass.h"
+#include "EngineContext.h"
+#include "GpuMemory.h"
+#include "JobSystem.h"
+#include "Log.h"
+#include "Mesh.h"
+#include "PipelineCache.h"
+#include "RenderCommands.h"
+#include "ShadowMaps.h"
+
+static const uint32_t DefaultNumCharacters = 1024;
+static const float CharacterSpacing = 1.2f;
+
+// the character is a tapered tube bending along a chain of joints
+static const uint32_t NumJoints = 8;
+static const float CharacterHeight = 1.6f;
+static const float CharacterRadius = 0.14f;
+static const uint32_t NumRings = 33;
+static const uint32_t RingSegments = 12;
+
+static const float ClipFrameRate = 30.0f;
+static const uint32_t NumClips = 2;
+
+static const uint32_t SkinGroupSize = 64;
+static const double StatsInterval = 5.0;
+
+// std430 layout of SkinVertex in skinning.comp
+struct SkinVertex
+{
+	float position[3];
+	// four 8-bit joint indices
+	uint32_t joints;
+	float normal[3];
+	// four 8-bit unorm weights summing to one
+	uint32_t weights;
+};
+
+struct SkinPushConstants
+{
+	uint32_t numVertices;
+	uint32_t numJoints;
+};
+
+// std140 layout of Camera in skinned.vert
+struct SkinnedCameraUniforms
+{
+	float viewProjection[16];
+	float eye[4];
+	uint32_t numVertices;
+	uint32_t padding[3];
+};
+
+struct CrowdCharacter
+{
+	float speed;
+	float timeOffset;
+	float blendPhase;
+};
+
+struct SkinningSample
+{
+	Skeleton skeleton;
+	AnimationClip clips[NumClips];
+
+	uint32_t numCharacters;
+	uint32_t numVertices;
+	uint32_t numIndices;
+	eastl::vector<CrowdCharacter> crowd;
+	eastl::vector<AnimatedCharacter> characters;
+
+	GpuBuffer bindVertexBuffer;
+	GpuBuffer indexBuffer;
+	// skinning matrices are written by the jobs straight into mapped memory
+	GpuBuffer matrixBuffers[MAX_FRAMES_IN_FLIGHT];
+	// world space MeshVertex per character vertex
+	GpuBuffer skinnedBuffers[MAX_FRAMES_IN_FLIGHT];
+	// the same positions alone, what the shadow maps are drawn from
+	GpuBuffer skinnedPositionBuffers[MAX_FRAMES_IN_FLIGHT];
+	GpuBuffer cameraBuffers[MAX_FRAMES_IN_FLIGHT];
+
+	ComputePipeline skinPipeline;
+	VkDescriptorSet skinSets[MAX_FRAMES_IN_FLIGHT];
+
+	VkDescriptorSetLayout drawSetLayout;
+	VkPipelineLayout drawPipelineLayout;
+	PipelineDesc drawPipelineDesc;
+	VkDescriptorSet drawSets[MAX_FRAMES_IN_FLIGHT];
+
+	double startTime;
+	bool logStats;
+	double lastStatsTime;
+	double animateSeconds;
+	uint32_t numAnimatedFrames;
+};
+
+bool isSkinningSampleRequested()
+{
+	const char* setting = getenv("ENGINE_SKINNING");
+	return setting && strcmp(setting, "0") != 0;
+}
+
+static float randomFloat()
+{
+	return static_cast<float>(rand()) / RAND_MAX;
+}
+
+static float getSegmentLength()
+{
+	return CharacterHeight / NumJoints;
+}
+
+static Mat4 makeTranslation(float x, float y, float z)
+{
+	Mat4 m = {};
+	m.m[0] = 1.0f;
+	m.m[5] = 1.0f;
+	m.m[10] = 1.0f;
+	m.m[12] = x;
+	m.m[13] = y;
+	m.m[14] = z;
+	m.m[15] = 1.0f;
+	return m;
+}
+
+static void createSkeleton(Skeleton& skeleton)
+{
+	// a chain standing on the root, every joint one segment above its parent
+	skeleton.numJoints = NumJoints;
+	for (uint32_t joint = 0; joint < NumJoints; ++joint)
+	{
+		skeleton.parents[joint] = static_cast<int32_t>(joint) - 1;
+		skeleton.inverseBindMatrices[joint] = makeTranslation(0.0f, -getSegmentLength() * joint, 0.0f);
+	}
+}
+
+static void addSkinVertex(eastl::vector<SkinVertex>& vertices, const Vec3& position, const Vec3& normal)
+{
+	// blend between the two joints whose segment centers are either side of the vertex
+	float jointCoordinate = position.y / getSegmentLength() - 0.5f;
+	float lower = floorf(jointCoordinate);
+	uint32_t joint = lower < 0.0f ? 0 : (lower > NumJoints - 1 ? NumJoints - 1 : static_cast<uint32_t>(lower));
+	uint32_t nextJoint = joint + 1 < NumJoints ? joint + 1 : joint;
+	float fraction = jointCoordinate - joint;
+	fraction = nextJoint == joint || fraction < 0.0f ? 0.0f : (fraction > 1.0f ? 1.0f : fraction);
+
+	uint32_t weight = static_cast<uint32_t>(lroundf((1.0f - fraction) * 255.0f));
+
+	SkinVertex vertex = {};
+	vertex.position[0] = position.x;
+	vertex.position[1] = position.y;
+	vertex.position[2] = position.z;
+	vertex.normal[0] = normal.x;
+	vertex.normal[1] = normal.y;
+	vertex.normal[2] = normal.z;
+	vertex.joints = joint | (nextJoint << 8);
+	vertex.weights = weight | ((255 - weight) << 8);
+	vertices.push_back(vertex);
+}
+
+static void createCharacterMesh(eastl::vector<SkinVertex>& vertices, eastl::vector<uint32_t>& indices)
+{
+	for (uint32_t ring = 0; ring < NumRings; ++ring)
+	{
+		float y = CharacterHeight * ring / (NumRings - 1);
+		float radius = CharacterRadius * (1.0f - 0.5f * y / CharacterHeight);
+		for (uint32_t segment = 0; segment < RingSegments; ++segment)
+		{
+			float angle = 6.2831853f * segment / RingSegments;
+			Vec3 normal = makeVec3(cosf(angle), 0.0f, sinf(angle));
+			addSkinVertex(vertices, makeVec3(normal.x * radius, y, normal.z * radius), normal);
+		}
+	}
+
+	uint32_t top = static_cast<uint32_t>(vertices.size());
+	addSkinVertex(vertices, makeVec3(0.0f, CharacterHeight, 0.0f), makeVec3(0.0f, 1.0f, 0.0f));
+
+	// clockwise seen from outside, like the other meshes
+	for (uint32_t ring = 0; ring + 1 < NumRings; ++ring)
+	{
+		for (uint32_t segment = 0; segment < RingSegments; ++segment)
+		{
+			uint32_t a = ring * RingSegments + segment;
+			uint32_t b = ring * RingSegments + (segment + 1) % RingSegments;
+			uint32_t c = a + RingSegments;
+			uint32_t d = b + RingSegments;
+			uint32_t quad[6] = { a, c, b, b, c, d };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	uint32_t topRing = (NumRings - 1) * RingSegments;
+	for (uint32_t segment = 0; segment < RingSegments; ++segment)
+	{
+		uint32_t triangle[3] = { topRing + segment, top, topRing + (segment + 1) % RingSegments };
+		indices.insert(indices.end(), triangle, triangle + 3);
+	}
+}
+
+// Authored clips sampled at the frame rate: a sway to the side and a coil forward with a twist of
+// the root. Both loop, so their last frame is their first.
+static void createRawClip(uint32_t clip, RawAnimationClip& raw)
+{
+	float duration = clip == 0 ? 2.0f : 1.5f;
+
+	raw.frameRate = ClipFrameRate;
+	raw.numFrames = static_cast<uint32_t>(duration * ClipFrameRate) + 1;
+	raw.numJoints = NumJoints;
+	raw.transforms.resize(raw.numFrames * NumJoints);
+
+	for (uint32_t frame = 0; frame < raw.numFrames; ++frame)
+	{
+		float phase = 6.2831853f * frame / (raw.numFrames - 1);
+		for (uint32_t joint = 0; joint < NumJoints; ++joint)
+		{
+			JointTransform& transform = raw.transforms[frame * NumJoints + joint];
+			transform.translation = makeVec3(0.0f, joint == 0 ? 0.0f : getSegmentLength(), 0.0f);
+
+			if (clip == 0)
+			{
+				float angle = joint == 0 ? 0.0f : 0.25f * sinf(phase - joint * 0.7f);
+				transform.rotation = makeQuatFromAxisAngle(makeVec3(0.0f, 0.0f, 1.0f), angle);
+			}
+			else
+			{
+				float angle = joint == 0 ? 0.0f : 0.35f * sinf(2.0f * phase + joint * 0.9f);
+				Quat bend = makeQuatFromAxisAngle(makeVec3(1.0f, 0.0f, 0.0f), angle);
+				Quat twist = makeQuatFromAxisAngle(makeVec3(0.0f, 1.0f, 0.0f), joint == 0 ? 0.5f * sinf(phase) : 0.0f);
+				transform.rotation = multiply(twist, bend);
+			}
+		}
+	}
+}
+
+static void createClips(SkinningSample& sample)
+{
+	AnimationCompressionSettings settings = {};
+	settings.rotationTolerance = 0.002f;
+	settings.translationTolerance = 0.0005f;
+
+	for (uint32_t i = 0; i < NumClips; ++i)
+	{
+		RawAnimationClip raw;
+		createRawClip(i, raw);
+		compressAnimationClip(raw, settings, sample.clips[i]);
+
+		size_t rawSize = raw.transforms.size() * sizeof(JointTransform);
+		Log::log("Animation clip %u: %u frames, %u rotation keys, %u translation keys, %u of %u bytes\n", i, raw.numFrames,
+			static_cast<uint32_t>(sample.clips[i].rotationKeys.size()), static_cast<uint32_t>(sample.clips[i].translationKeyFrames.size()),
+			static_cast<uint32_t>(getAnimationClipSize(sample.clips[i])), static_cast<uint32_t>(rawSize));
+	}
+}
+
+static void createCrowd(SkinningSample& sample)
+{
+	sample.crowd.resize(sample.numCharacters);
+	sample.characters.resize(sample.numCharacters);
+
+	uint32_t gridSize = static_cast<uint32_t>(ceilf(sqrtf(static_cast<float>(sample.numCharacters))));
+	float offset = (gridSize - 1) * CharacterSpacing * 0.5f;
+
+	for (uint32_t i = 0; i < sample.numCharacters; ++i)
+	{
+		CrowdCharacter& member = sample.crowd[i];
+		member.speed = 0.8f + randomFloat() * 0.4f;
+		member.timeOffset = randomFloat() * 10.0f;
+		member.blendPhase = randomFloat() * 6.2831853f;
+
+		// facing a random direction, placed on a grid
+		float heading = randomFloat() * 6.2831853f;
+		Mat4 world = makeTranslation((i % gridSize) * CharacterSpacing - offset, 0.0f, (i / gridSize) * CharacterSpacing - offset);
+		world.m[0] = cosf(heading);
+		world.m[2] = -sinf(heading);
+		world.m[8] = sinf(heading);
+		world.m[10] = cosf(heading);
+
+		AnimatedCharacter& character = sample.characters[i];
+		character = {};
+		character.world = world;
+		character.clips[0] = 0;
+		character.clips[1] = 1;
+	}
+}
+
+static void writeBufferDescriptor(EngineContext& context, VkDescriptorSet set, uint32_t binding, VkDescriptorType type, const GpuBuffer& buffer)
+{
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer.buffer;
+	bufferInfo.range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.descriptorCount = 1;
+	write.descriptorType = type;
+	write.pBufferInfo = &bufferInfo;
+
+	vkUpdateDescriptorSets(context.device, 1, &write, 0, nullptr);
+}
+
+// The characters stand still but their geometry changes every frame, so they are a dynamic caster.
+// Each instance picks its character's range of the skinned positions.
+static void addCrowdShadowCaster(EngineContext& context, SkinningSample& sample)
+{
+	ShadowCasterDesc desc = {};
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		desc.positionBuffers[i] = sample.skinnedPositionBuffers[i].buffer;
+	}
+	desc.indexBuffer = sample.indexBuffer.buffer;
+	for (uint32_t i = 0; i < MaxShadowCascades; ++i)
+	{
+		desc.numIndices[i] = sample.numIndices;
+	}
+
+	eastl::vector<ShadowInstance> instances(sample.numCharacters);
+	for (uint32_t i = 0; i < sample.numCharacters; ++i)
+	{
+		const Mat4& world = sample.characters[i].world;
+		ShadowInstance& instance = instances[i];
+		instance.scale = 1.0f;
+		instance.vertexOffset = i * sample.numVertices;
+		// wherever the joints bend it, the tube stays within its height of its base
+		instance.boundsCenter = makeVec3(world.m[12], world.m[13], world.m[14]);
+		instance.boundsRadius = CharacterHeight + CharacterRadius;
+	}
+
+	uint32_t caster = addShadowCaster(context, desc);
+	setShadowCasterInstances(context, caster, instances.data(), sample.numCharacters);
+}
+
+static void createDrawPipeline(EngineContext& context, SkinningSample& sample)
+{
+	VkDescriptorSetLayoutBinding bindings[3 + NumShadowReceiverBindings] = {};
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = i == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	}
+	makeShadowReceiverBindings(3, VK_SHADER_STAGE_FRAGMENT_BIT, bindings + 3);
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = ARRAY_SIZE(bindings);
+	setLayoutInfo.pBindings = bindings;
+
+	VkResult result = vkCreateDescriptorSetLayout(context.device, &setLayoutInfo, nullptr, &sample.drawSetLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create skinning descriptor set layout");
+	}
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &sample.drawSetLayout;
+
+	result = vkCreatePipelineLayout(context.device, &layoutInfo, nullptr, &sample.drawPipelineLayout);
+	if (result != VK_SUCCESS)
+	{
+		Log::fatal("Couldn't create skinning pipeline layout");
+	}
+
+	// the skinned vertices are pulled from the storage buffer, there is no vertex input
+	sample.drawPipelineDesc = makeDefaultPipelineDesc();
+	sample.drawPipelineDesc.vertexShader = "skinned.vert";
+	sample.drawPipelineDesc.fragmentShader = "skinned.frag";
+	sample.drawPipelineDesc.layout = sample.drawPipelineLayout;
+	sample.drawPipelineDesc.depthTestEnable = VK_TRUE;
+	sample.drawPipelineDesc.depthWriteEnable = VK_TRUE;
+	sample.drawPipelineDesc.renderPass = context.renderPass;
+	sample.drawPipelineDesc.colorFormat = context.sceneColorFormat;
+	sample.drawPipelineDesc.depthFormat = context.depthFormat;
+
+	getPipeline(context, sample.drawPipelineDesc);
+}
+
+void createSkinningSample(EngineContext& context)
+{
+	SkinningSample* sample = new SkinningSample;
+	*sample = {};
+
+	const char* numCharacters = getenv("ENGINE_SKINNING_CHARACTERS");
+	sample->numCharacters = numCharacters ? static_cast<uint32_t>(atoi(numCharacters)) : DefaultNumCharacters;
+	sample->numCharacters = sample->numCharacters > 0 ? sample->numCharacters : 1;
+
+	createSkeleton(sample->skeleton);
+	createClips(*sample);
+	createCrowd(*sample);
+
+	eastl::vector<SkinVertex> vertices;
+	eastl::vector<uint32_t> indices;
+	createCharacterMesh(vertices, indices);
+	sample->numVertices = static_cast<uint32_t>(vertices.size());
+	sample->numIndices = static_cast<uint32_t>(indices.size());
+
+	VkDeviceSize vertexSize = vertices.size() * sizeof(SkinVertex);
+	createGpuBuffer(context, vertexSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->bindVertexBuffer);
+	uploadToGpuBuffer(context, sample->bindVertexBuffer, vertices.data(), vertexSize);
+
+	VkDeviceSize indexSize = indices.size() * sizeof(uint32_t);
+	createGpuBuffer(context, indexSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->indexBuffer);
+	uploadToGpuBuffer(context, sample->indexBuffer, indices.data(), indexSize);
+
+	VkDeviceSize matrixSize = static_cast<VkDeviceSize>(sample->numCharacters) * NumJoints * SkinningMatrixFloats * sizeof(float);
+	VkDeviceSize skinnedSize = static_cast<VkDeviceSize>(sample->numCharacters) * sample->numVertices * sizeof(MeshVertex);
+	VkDeviceSize skinnedPositionSize = static_cast<VkDeviceSize>(sample->numCharacters) * sample->numVertices * 3 * sizeof(float);
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		createGpuBuffer(context, matrixSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, sample->matrixBuffers[i]);
+		createGpuBuffer(context, skinnedSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->skinnedBuffers[i]);
+		createGpuBuffer(context, skinnedPositionSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sample->skinnedPositionBuffers[i]);
+		createGpuBuffer(context, sizeof(SkinnedCameraUniforms), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, sample->cameraBuffers[i]);
+	}
+
+	VkDescriptorSetLayoutBinding bindings[4] = {};
+	for (uint32_t i = 0; i < ARRAY_SIZE(bindings); ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	createComputePipeline(context, "skinning.comp.spv", bindings, ARRAY_SIZE(bindings), sizeof(SkinPushConstants), sample->skinPipeline);
+
+	createDrawPipeline(context, *sample);
+	addCrowdShadowCaster(context, *sample);
+
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		sample->skinSets[i] = allocateDescriptorSet(context, sample->skinPipeline.descriptorSetLayout);
+		writeBufferDescriptor(context, sample->skinSets[i], 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->bindVertexBuffer);
+		writeBufferDescriptor(context, sample->skinSets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->matrixBuffers[i]);
+		writeBufferDescriptor(context, sample->skinSets[i], 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->skinnedBuffers[i]);
+		writeBufferDescriptor(context, sample->skinSets[i], 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->skinnedPositionBuffers[i]);
+
+		sample->drawSets[i] = allocateDescriptorSet(context, sample->drawSetLayout);
+		writeBufferDescriptor(context, sample->drawSets[i], 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, sample->cameraBuffers[i]);
+		writeBufferDescriptor(context, sample->drawSets[i], 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->skinnedBuffers[i]);
+		writeBufferDescriptor(context, sample->drawSets[i], 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, sample->indexBuffer);
+		writeShadowReceiverDescriptors(context, sample->drawSets[i], 3, i);
+	}
+
+	Log::log("Skinning %u characters of %u vertices and %u joints\n", sample->numCharacters, sample->numVertices, NumJoints);
+
+	const char* logStats = getenv("ENGINE_SKINNING_STATS");
+	sample->logStats = logStats && strcmp(logStats, "0") != 0;
+	sample->startTime = context.frameTime;
+	sample->lastStatsTime = getEngineTime();
+
+	context.skinningSample = sample;
+}
+
+void destroySkinningSample(EngineContext& context)
+{
+	SkinningSample* sample = context.skinningSample;
+	if (!sample)
+	{
+		return;
+	}
+
+	vkDestroyPipelineLayout(context.device, sample->drawPipelineLayout, nullptr);
+	vkDestroyDescriptorSetLayout(context.device, sample->drawSetLayout, nullptr);
+	destroyComputePipeline(context, sample->skinPipeline);
+
+	destroyGpuBuffer(context, sample->bindVertexBuffer);
+	destroyGpuBuffer(context, sample->indexBuffer);
+	for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		destroyGpuBuffer(context, sample->matrixBuffers[i]);
+		destroyGpuBuffer(context, sample->skinnedBuffers[i]);
+		destroyGpuBuffer(context, sample->skinnedPositionBuffers[i]);
+		destroyGpuBuffer(context, sample->cameraBuffers[i]);
+	}
+
+	delete sample;
+	context.skinningSample = nullptr;
+}
+
+void skinSkinningSample(EngineContext& context, VkCommandBuffer commandBuffer)
+{
+	SkinningSample* sample = context.skinningSample;
+	if (!sample)
+	{
+		return;
+	}
+
+	uint32_t slot = context.currentFrame;
+	double time = getEngineTime();
+	float seconds = static_cast<float>(context.frameTime - sample->startTime);
+
+	for (uint32_t i = 0; i < sample->numCharacters; ++i)
+	{
+		const CrowdCharacter& member = sample->crowd[i];
+		AnimatedCharacter& character = sample->characters[i];
+		character.times[0] = seconds * member.speed + member.timeOffset;
+		character.times[1] = character.times[0];
+		character.blendWeight = 0.5f + 0.5f * sinf(seconds * 0.5f + member.blendPhase);
+	}
+
+	// the frame's fence was waited on, so the graphics and compute work that read this slot are done
+	float* matrices = static_cast<float*>(sample->matrixBuffers[slot].mapped);
+	animateCharacters(context.jobSystem, sample->skeleton, sample->clips, sample->characters.data(), sample->numCharacters, matrices);
+
+	double animated = getEngineTime();
+	sample->animateSeconds += animated - time;
+	++sample->numAnimatedFrames;
+	if (sample->logStats && animated - sample->lastStatsTime >= StatsInterval)
+	{
+		Log::log("Skinning: animated %u characters in %.3f ms per frame on %u job workers\n", sample->numCharacters,
+			sample->animateSeconds * 1000.0 / sample->numAnimatedFrames, getNumJobWorkers(context.jobSystem));
+		sample->animateSeconds = 0.0;
+		sample->numAnimatedFrames = 0;
+		sample->lastStatsTime = animated;
+	}
+
+	SkinPushConstants pushConstants = {};
+	pushConstants.numVertices = sample->numVertices;
+	pushConstants.numJoints = NumJoints;
+
+	uint32_t numGroups = (sample->numVertices + SkinGroupSize - 1) / SkinGroupSize;
+	dispatchCompute(commandBuffer, sample->skinPipeline, sample->skinSets[slot], &pushConstants, numGroups, sample->numCharacters, 1);
+}
+
+void emitSkinningSample(EngineContext& context)
+{
+	SkinningSample* sample = context.skinningSample;
+	if (!sample)
+	{
+		return;
+	}
+
+	uint32_t slot = context.currentFrame;
+	const Camera& camera = context.camera;
+
+	SkinnedCameraUniforms uniforms = {};
+	memcpy(uniforms.viewProjection, camera.viewProjection.m, sizeof(uniforms.viewProjection));
+	uniforms.eye[0] = camera.position.x;
+	uniforms.eye[1] = camera.position.y;
+	uniforms.eye[2] = camera.position.z;
+	uniforms.eye[3] = 1.0f;
+	uniforms.numVertices = sample->numVertices;
+	memcpy(sample->cameraBuffers[slot].mapped, &uniforms, sizeof(uniforms));
+
+	// one instance per character, each reading its own range of the skinned vertices
+	DrawPacket packet = {};
+	packet.pipeline = getPipeline(context, sample->drawPipelineDesc);
+	packet.pipelineLayout = sample->drawPipelineLayout;
+	packet.descriptorSet = sample->drawSets[slot];
+	packet.sortKey = makeDrawSortKey(DrawPass_Opaque, packet.pipeline, 0, 0.0f);
+	packet.vertexCount = sample->numIndices;
+	packet.instanceCount = sample->numCharacters;
+
+	emitDrawPacket(context, packet);
+}
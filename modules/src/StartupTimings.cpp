@@ -0,0 +1,91 @@
+#include "StartupTimings.h"
+
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include <EASTL/sort.h>
+#include <EASTL/vector.h>
+
+#include "EngineContext.h"
+#include "Log.h"
+
+struct StartupStage
+{
+	const char* name;
+	double startMs;
+	double durationMs;
+	bool mainThread;
+};
+
+struct StartupTimings
+{
+	std::chrono::steady_clock::time_point start;
+	std::thread::id mainThread;
+
+	std::mutex mutex;
+	eastl::vector<StartupStage> stages;
+};
+
+static double millisecondsSince(const StartupTimings& timings, std::chrono::steady_clock::time_point time)
+{
+	return std::chrono::duration<double, std::milli>(time - timings.start).count();
+}
+
+void beginStartupTimings(EngineContext& context)
+{
+	StartupTimings* timings = new StartupTimings;
+	timings->start = std::chrono::steady_clock::now();
+	timings->mainThread = std::this_thread::get_id();
+
+	context.startupTimings = timings;
+}
+
+void runStartupStage(EngineContext& context, const char* name, StartupStageFunc stage)
+{
+	StartupTimings* timings = context.startupTimings;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	stage(context);
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	if (!timings)
+	{
+		return;
+	}
+
+	StartupStage timed;
+	timed.name = name;
+	timed.startMs = millisecondsSince(*timings, start);
+	timed.durationMs = millisecondsSince(*timings, end) - timed.startMs;
+	timed.mainThread = std::this_thread::get_id() == timings->mainThread;
+
+	std::lock_guard<std::mutex> lock(timings->mutex);
+	timings->stages.push_back(timed);
+}
+
+void finishStartupTimings(EngineContext& context)
+{
+	StartupTimings* timings = context.startupTimings;
+	if (!timings)
+	{
+		return;
+	}
+
+	double firstFrameMs = millisecondsSince(*timings, std::chrono::steady_clock::now());
+
+	eastl::sort(timings->stages.begin(), timings->stages.end(), [](const StartupStage& a, const StartupStage& b)
+	{
+		return a.startMs < b.startMs;
+	});
+
+	Log::log("Startup breakdown:\n");
+	for (const StartupStage& stage : timings->stages)
+	{
+		Log::log("  %-28s at %8.2f ms took %8.2f ms%s\n", stage.name, stage.startMs, stage.durationMs, stage.mainThread ? "" : " (worker)");
+	}
+	Log::log("Time to first frame: %.2f ms\n", firstFrameMs);
+
+	delete timings;
+	context.startupTimings = nullptr;
+}
@@ -0,0 +1,355 @@
+#include "Telemetry.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <thread>
+
+#include <EASTL/algorithm.h>
+#include <EASTL/string.h>
+
+#include "ArraySize.h"
+#include "Clock.h"
+#include "EngineContext.h"
+#include "Log.h"
+#include "TelemetryServer.h"
+
+// frames, a power of two. A full ring drops samples instead of waiting for the telemetry thread.
+static const uint32_t SampleRingSize = 1024;
+// how often the telemetry thread drains the ring when nobody scrapes
+static const int AggregationIntervalMs = 100;
+// frames behind the quantiles of the recent frame time summary
+static const uint32_t NumRecentFrames = 600;
+
+static const uint32_t MaxHistogramBounds = 12;
+static const double FrameTimeBounds[] = { 0.004, 0.008, 0.0111, 0.0167, 0.025, 0.0333, 0.05, 0.1, 0.25 };
+static const double FenceWaitBounds[] = { 0.0001, 0.0005, 0.001, 0.002, 0.004, 0.008, 0.0167, 0.0333 };
+static const double RecentQuantiles[] = { 0.5, 0.9, 0.99, 1.0 };
+
+struct TelemetrySample
+{
+	float frameSeconds;
+	float fenceWaitSeconds;
+};
+
+// Bucket counts aren't cumulative here, they're summed up when written out
+struct TelemetryHistogram
+{
+	const double* bounds;
+	uint32_t numBounds;
+	uint64_t counts[MaxHistogramBounds + 1];
+	double sum;
+	uint64_t count;
+};
+
+// Only touched by the telemetry thread
+struct TelemetryAggregate
+{
+	TelemetryHistogram frameTimes;
+	TelemetryHistogram fenceWaits;
+	// ring buffer, recentIndex is where the next frame goes
+	float recentFrameTimes[NumRecentFrames];
+	uint32_t numRecentFrames;
+	uint32_t recentIndex;
+	uint64_t numScrapes;
+};
+
+struct Telemetry
+{
+	TelemetryServer* server;
+	std::thread thread;
+	std::atomic<bool> running;
+
+	// written by any thread
+	std::atomic<uint64_t> counters[TelemetryCounter_Count];
+	std::atomic<uint64_t> numDroppedSamples;
+	// stored by the render thread every frame, GpuMemoryStats itself isn't atomic
+	std::atomic<uint64_t> heapBytes[VK_MAX_MEMORY_HEAPS];
+	std::atomic<uint64_t> numLiveAllocations;
+	std::atomic<uint64_t> numAllocationsTotal;
+	std::atomic<uint64_t> numFrames;
+
+	// single producer, the render thread, and single consumer, the telemetry thread
+	TelemetrySample samples[SampleRingSize];
+	std::atomic<uint32_t> sampleHead;
+	std::atomic<uint32_t> sampleTail;
+
+	// render thread only, 0 until the first frame
+	double lastFrameTime;
+
+	// copied when created, the telemetry thread doesn't read the context
+	uint32_t numHeaps;
+	VkMemoryHeap heaps[VK_MAX_MEMORY_HEAPS];
+
+	TelemetryAggregate aggregate;
+	eastl::string response;
+};
+
+static void initHistogram(TelemetryHistogram& histogram, const double* bounds, uint32_t numBounds)
+{
+	histogram = {};
+	histogram.bounds = bounds;
+	histogram.numBounds = numBounds;
+}
+
+static void addToHistogram(TelemetryHistogram& histogram, double value)
+{
+	uint32_t bucket = 0;
+	while (bucket < histogram.numBounds && value > histogram.bounds[bucket])
+	{
+		++bucket;
+	}
+
+	++histogram.counts[bucket];
+	histogram.sum += value;
+	++histogram.count;
+}
+
+static void drainSamples(Telemetry& telemetry)
+{
+	TelemetryAggregate& aggregate = telemetry.aggregate;
+
+	uint32_t tail = telemetry.sampleTail.load(std::memory_order_relaxed);
+	uint32_t head = telemetry.sampleHead.load(std::memory_order_acquire);
+	for (; tail != head; ++tail)
+	{
+		const TelemetrySample& sample = telemetry.samples[tail % SampleRingSize];
+		addToHistogram(aggregate.frameTimes, sample.frameSeconds);
+		addToHistogram(aggregate.fenceWaits, sample.fenceWaitSeconds);
+
+		aggregate.recentFrameTimes[aggregate.recentIndex] = sample.frameSeconds;
+		aggregate.recentIndex = (aggregate.recentIndex + 1) % NumRecentFrames;
+		aggregate.numRecentFrames = eastl::min(aggregate.numRecentFrames + 1, NumRecentFrames);
+	}
+	telemetry.sampleTail.store(tail, std::memory_order_release);
+}
+
+// Every line fits, the longest are the HELP lines
+static void appendLine(eastl::string& out, const char* format, ...)
+{
+	char line[512];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	out.append(line);
+}
+
+static void writeHeader(eastl::string& out, const char* name, const char* type, const char* help)
+{
+	appendLine(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void writeHistogram(eastl::string& out, const char* name, const char* help, const TelemetryHistogram& histogram)
+{
+	writeHeader(out, name, "histogram", help);
+
+	uint64_t cumulative = 0;
+	for (uint32_t i = 0; i < histogram.numBounds; ++i)
+	{
+		cumulative += histogram.counts[i];
+		appendLine(out, "%s_bucket{le=\"%g\"} %llu\n", name, histogram.bounds[i], static_cast<unsigned long long>(cumulative));
+	}
+	appendLine(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, static_cast<unsigned long long>(histogram.count));
+	appendLine(out, "%s_sum %.9g\n", name, histogram.sum);
+	appendLine(out, "%s_count %llu\n", name, static_cast<unsigned long long>(histogram.count));
+}
+
+static void writeRecentFrameTimes(eastl::string& out, const TelemetryAggregate& aggregate)
+{
+	const char* name = "engine_frame_time_recent_seconds";
+	writeHeader(out, name, "summary", "Time between the starts of consecutive frames, over the last frames.");
+	if (aggregate.numRecentFrames == 0)
+	{
+		return;
+	}
+
+	float sorted[NumRecentFrames];
+	memcpy(sorted, aggregate.recentFrameTimes, aggregate.numRecentFrames * sizeof(float));
+	eastl::sort(sorted, sorted + aggregate.numRecentFrames);
+
+	double sum = 0.0;
+	for (uint32_t i = 0; i < aggregate.numRecentFrames; ++i)
+	{
+		sum += sorted[i];
+	}
+
+	for (double quantile : RecentQuantiles)
+	{
+		uint32_t index = static_cast<uint32_t>(quantile * (aggregate.numRecentFrames - 1) + 0.5);
+		appendLine(out, "%s{quantile=\"%g\"} %.9g\n", name, quantile, sorted[index]);
+	}
+	appendLine(out, "%s_sum %.9g\n", name, sum);
+	appendLine(out, "%s_count %u\n", name, aggregate.numRecentFrames);
+}
+
+static void writeCounter(eastl::string& out, const char* name, const char* labels, uint64_t value)
+{
+	appendLine(out, "%s%s %llu\n", name, labels, static_cast<unsigned long long>(value));
+}
+
+static const eastl::string& respondWithMetrics(void* userData)
+{
+	Telemetry& telemetry = *static_cast<Telemetry*>(userData);
+	TelemetryAggregate& aggregate = telemetry.aggregate;
+	drainSamples(telemetry);
+	++aggregate.numScrapes;
+
+	const std::memory_order relaxed = std::memory_order_relaxed;
+	eastl::string& out = telemetry.response;
+	out.clear();
+
+	writeHeader(out, "engine_frames_total", "counter", "Frames started.");
+	writeCounter(out, "engine_frames_total", "", telemetry.numFrames.load(relaxed));
+	writeHistogram(out, "engine_frame_time_seconds", "Time between the starts of consecutive frames.", aggregate.frameTimes);
+	writeRecentFrameTimes(out, aggregate);
+	writeHistogram(out, "engine_fence_wait_seconds", "Time spent waiting for the frame in flight's fence.", aggregate.fenceWaits);
+
+	writeHeader(out, "engine_queue_submits_total", "counter", "vkQueueSubmit calls.");
+	writeCounter(out, "engine_queue_submits_total", "{queue=\"graphics\"}", telemetry.counters[TelemetryCounter_GraphicsSubmits].load(relaxed));
+	writeCounter(out, "engine_queue_submits_total", "{queue=\"compute\"}", telemetry.counters[TelemetryCounter_ComputeSubmits].load(relaxed));
+	writeHeader(out, "engine_queue_presents_total", "counter", "vkQueuePresentKHR calls.");
+	writeCounter(out, "engine_queue_presents_total", "", telemetry.counters[TelemetryCounter_Presents].load(relaxed));
+
+	writeHeader(out, "engine_gpu_memory_used_bytes", "gauge", "Bytes allocated by the engine per memory heap.");
+	for (uint32_t i = 0; i < telemetry.numHeaps; ++i)
+	{
+		bool deviceLocal = (telemetry.heaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		appendLine(out, "engine_gpu_memory_used_bytes{heap=\"%u\",kind=\"%s\"} %llu\n", i, deviceLocal ? "device_local" : "host",
+			static_cast<unsigned long long>(telemetry.heapBytes[i].load(relaxed)));
+	}
+	writeHeader(out, "engine_gpu_memory_heap_size_bytes", "gauge", "Size of each memory heap.");
+	for (uint32_t i = 0; i < telemetry.numHeaps; ++i)
+	{
+		bool deviceLocal = (telemetry.heaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		appendLine(out, "engine_gpu_memory_heap_size_bytes{heap=\"%u\",kind=\"%s\"} %llu\n", i, deviceLocal ? "device_local" : "host",
+			static_cast<unsigned long long>(telemetry.heaps[i].size));
+	}
+
+	writeHeader(out, "engine_gpu_allocations_live", "gauge", "Device memory allocations currently alive.");
+	writeCounter(out, "engine_gpu_allocations_live", "", telemetry.numLiveAllocations.load(relaxed));
+	writeHeader(out, "engine_gpu_allocations_total", "counter", "Device memory allocations made.");
+	writeCounter(out, "engine_gpu_allocations_total", "", telemetry.numAllocationsTotal.load(relaxed));
+
+	writeHeader(out, "engine_telemetry_dropped_samples_total", "counter", "Frame samples dropped because the telemetry thread fell behind.");
+	writeCounter(out, "engine_telemetry_dropped_samples_total", "", telemetry.numDroppedSamples.load(relaxed));
+	writeHeader(out, "engine_telemetry_scrapes_total", "counter", "Times the metrics were served.");
+	writeCounter(out, "engine_telemetry_scrapes_total", "", aggregate.numScrapes);
+
+	return out;
+}
+
+static void telemetryThread(Telemetry& telemetry)
+{
+	while (telemetry.running.load(std::memory_order_relaxed))
+	{
+		// drained either way, so the ring doesn't fill up between scrapes
+		if (!pollTelemetryServer(telemetry.server, AggregationIntervalMs, respondWithMetrics, &telemetry))
+		{
+			drainSamples(telemetry);
+		}
+	}
+}
+
+void createTelemetry(EngineContext& context)
+{
+	const char* address = getenv("ENGINE_TELEMETRY");
+	if (!address || !*address || strcmp(address, "0") == 0)
+	{
+		return;
+	}
+
+	TelemetryServer* server = openTelemetryServer(address);
+	if (!server)
+	{
+		Log::error("Telemetry disabled, can't listen on %s\n", address);
+		return;
+	}
+
+	// atomics are zero initialized since C++20
+	Telemetry* telemetry = new Telemetry;
+	telemetry->server = server;
+	telemetry->lastFrameTime = 0.0;
+
+	telemetry->numHeaps = context.memoryProperties.memoryHeapCount;
+	memcpy(telemetry->heaps, context.memoryProperties.memoryHeaps, sizeof(telemetry->heaps));
+
+	telemetry->aggregate = {};
+	initHistogram(telemetry->aggregate.frameTimes, FrameTimeBounds, ARRAY_SIZE(FrameTimeBounds));
+	initHistogram(telemetry->aggregate.fenceWaits, FenceWaitBounds, ARRAY_SIZE(FenceWaitBounds));
+
+	telemetry->running = true;
+	telemetry->thread = std::thread(telemetryThread, std::ref(*telemetry));
+
+	Log::log("Serving telemetry on %s\n", address);
+	context.telemetry = telemetry;
+}
+
+void destroyTelemetry(EngineContext& context)
+{
+	Telemetry* telemetry = context.telemetry;
+	if (!telemetry)
+	{
+		return;
+	}
+
+	telemetry->running = false;
+	telemetry->thread.join();
+	closeTelemetryServer(telemetry->server);
+
+	delete telemetry;
+	context.telemetry = nullptr;
+}
+
+void countTelemetryEvent(EngineContext& context, TelemetryCounter counter)
+{
+	Telemetry* telemetry = context.telemetry;
+	if (telemetry)
+	{
+		telemetry->counters[counter].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void recordTelemetryFrame(EngineContext& context, double fenceWaitSeconds)
+{
+	Telemetry* telemetry = context.telemetry;
+	if (!telemetry)
+	{
+		return;
+	}
+
+	// the first frame has nothing to be timed against
+	double time = getEngineTime();
+	if (telemetry->lastFrameTime > 0.0)
+	{
+		TelemetrySample sample = {};
+		sample.frameSeconds = static_cast<float>(time - telemetry->lastFrameTime);
+		sample.fenceWaitSeconds = static_cast<float>(fenceWaitSeconds);
+
+		uint32_t head = telemetry->sampleHead.load(std::memory_order_relaxed);
+		uint32_t tail = telemetry->sampleTail.load(std::memory_order_acquire);
+		if (head - tail < SampleRingSize)
+		{
+			telemetry->samples[head % SampleRingSize] = sample;
+			telemetry->sampleHead.store(head + 1, std::memory_order_release);
+		}
+		else
+		{
+			telemetry->numDroppedSamples.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	telemetry->lastFrameTime = time;
+
+	const std::memory_order relaxed = std::memory_order_relaxed;
+	const GpuMemoryStats& memoryStats = context.gpuMemoryStats;
+	for (uint32_t i = 0; i < telemetry->numHeaps; ++i)
+	{
+		telemetry->heapBytes[i].store(memoryStats.bytesPerHeap[i], relaxed);
+	}
+	telemetry->numLiveAllocations.store(memoryStats.numLiveAllocations, relaxed);
+	telemetry->numAllocationsTotal.store(memoryStats.numAllocationsTotal, relaxed);
+	telemetry->numFrames.fetch_add(1, relaxed);
+}
@@ -0,0 +1,13 @@
+#ifdef __linux__
+
+#include "DebugBreak.h"
+
+#include <signal.h>
+
+void doDebugBreak()
+{
+	// stops in an attached debugger, which can continue past it
+	raise(SIGTRAP);
+}
+
+#endif // __linux__
@@ -0,0 +1,100 @@
+
+#ifdef __linux__
+
+#include "FileWatcher.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <EASTL/algorithm.h>
+
+#include "Log.h"
+
+struct FileWatcher
+{
+	int inotifyFd;
+	int watchDescriptor;
+};
+
+FileWatcher* createFileWatcher(const char* directory)
+{
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+	{
+		Log::error("Cannot initialize inotify, errno %d\n", errno);
+		return nullptr;
+	}
+
+	// editors either rewrite the file in place or write a temporary and rename it over the original
+	int wd = inotify_add_watch(fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (wd < 0)
+	{
+		Log::error("Cannot watch directory %s, errno %d\n", directory, errno);
+		close(fd);
+		return nullptr;
+	}
+
+	FileWatcher* watcher = new FileWatcher;
+	watcher->inotifyFd = fd;
+	watcher->watchDescriptor = wd;
+
+	return watcher;
+}
+
+void destroyFileWatcher(FileWatcher* watcher)
+{
+	if (!watcher)
+	{
+		return;
+	}
+
+	inotify_rm_watch(watcher->inotifyFd, watcher->watchDescriptor);
+	close(watcher->inotifyFd);
+	delete watcher;
+}
+
+bool waitForFileChanges(FileWatcher* watcher, int timeoutMs, eastl::vector<eastl::string>& changedFiles)
+{
+	pollfd pfd = {};
+	pfd.fd = watcher->inotifyFd;
+	pfd.events = POLLIN;
+
+	if (poll(&pfd, 1, timeoutMs) <= 0)
+	{
+		return false;
+	}
+
+	bool anyChanged = false;
+	alignas(inotify_event) char buffer[4096];
+
+	for (;;)
+	{
+		ssize_t length = read(watcher->inotifyFd, buffer, sizeof(buffer));
+		if (length <= 0)
+		{
+			break;
+		}
+
+		for (char* ptr = buffer; ptr < buffer + length; )
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+			if (event->len > 0)
+			{
+				eastl::string name = event->name;
+				if (eastl::find(changedFiles.begin(), changedFiles.end(), name) == changedFiles.end())
+				{
+					changedFiles.push_back(name);
+				}
+				anyChanged = true;
+			}
+
+			ptr += sizeof(inotify_event) + event->len;
+		}
+	}
+
+	return anyChanged;
+}
+
+#endif // __linux__
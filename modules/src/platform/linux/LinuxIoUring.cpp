@@ -0,0 +1,317 @@
+#ifdef __linux__
+
+#include "IoUring.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <linux/io_uring.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "Log.h"
+
+// the completion thread stops when it sees this, no read has a null operation
+static const uint64_t StopUserData = 0;
+
+// completions may queue follow-up reads, which must not wait for the thread itself to free a slot
+static thread_local bool onCompletionThread = false;
+
+struct IoUringOperation
+{
+	iovec buffer;
+	IoUringCompletion completion;
+	void* userData;
+};
+
+struct IoUring
+{
+	int fd;
+
+	void* sqRing;
+	size_t sqRingSize;
+	void* cqRing;
+	size_t cqRingSize;
+	io_uring_sqe* sqes;
+	size_t sqesSize;
+
+	unsigned* sqHead;
+	unsigned* sqTail;
+	unsigned sqMask;
+	unsigned* sqArray;
+	unsigned numSqEntries;
+
+	unsigned* cqHead;
+	unsigned* cqTail;
+	unsigned cqMask;
+	io_uring_cqe* cqes;
+	unsigned numCqEntries;
+
+	// submissions are serialized, completions only touched by the completion thread
+	std::mutex submitMutex;
+	std::condition_variable slotAvailable;
+	uint32_t numInFlight;
+
+	std::thread completionThread;
+};
+
+static int setupIoUring(uint32_t numEntries, io_uring_params& params)
+{
+	return static_cast<int>(syscall(__NR_io_uring_setup, numEntries, &params));
+}
+
+static int enterIoUring(int fd, uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+{
+	return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static unsigned loadAcquire(const unsigned* p)
+{
+	return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static void storeRelease(unsigned* p, unsigned value)
+{
+	__atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+static bool mapRings(IoUring& ring, const io_uring_params& params)
+{
+	ring.sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	ring.cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+	// newer kernels put both rings in one mapping
+	bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (singleMapping)
+	{
+		ring.sqRingSize = ring.sqRingSize > ring.cqRingSize ? ring.sqRingSize : ring.cqRingSize;
+		ring.cqRingSize = ring.sqRingSize;
+	}
+
+	ring.sqRing = mmap(nullptr, ring.sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQ_RING);
+	if (ring.sqRing == MAP_FAILED)
+	{
+		return false;
+	}
+
+	ring.cqRing = singleMapping ? ring.sqRing : mmap(nullptr, ring.cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_CQ_RING);
+	if (ring.cqRing == MAP_FAILED)
+	{
+		munmap(ring.sqRing, ring.sqRingSize);
+		return false;
+	}
+
+	ring.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+	void* sqes = mmap(nullptr, ring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd, IORING_OFF_SQES);
+	if (sqes == MAP_FAILED)
+	{
+		if (!singleMapping)
+		{
+			munmap(ring.cqRing, ring.cqRingSize);
+		}
+		munmap(ring.sqRing, ring.sqRingSize);
+		return false;
+	}
+	ring.sqes = static_cast<io_uring_sqe*>(sqes);
+
+	uint8_t* sq = static_cast<uint8_t*>(ring.sqRing);
+	ring.sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+	ring.sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+	ring.sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+	ring.sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+	ring.numSqEntries = params.sq_entries;
+
+	uint8_t* cq = static_cast<uint8_t*>(ring.cqRing);
+	ring.cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+	ring.cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+	ring.cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+	ring.cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+	ring.numCqEntries = params.cq_entries;
+
+	return true;
+}
+
+static void unmapRings(IoUring& ring)
+{
+	munmap(ring.sqes, ring.sqesSize);
+	if (ring.cqRing != ring.sqRing)
+	{
+		munmap(ring.cqRing, ring.cqRingSize);
+	}
+	munmap(ring.sqRing, ring.sqRingSize);
+}
+
+// Fills one submission queue entry, call with submitMutex held. False when the queue is full.
+static bool queueSqe(IoUring& ring, uint8_t opcode, int fd, const iovec* buffer, uint64_t offset, uint64_t userData)
+{
+	unsigned tail = *ring.sqTail;
+	if (tail - loadAcquire(ring.sqHead) == ring.numSqEntries)
+	{
+		return false;
+	}
+
+	unsigned index = tail & ring.sqMask;
+	io_uring_sqe& sqe = ring.sqes[index];
+	memset(&sqe, 0, sizeof(sqe));
+	sqe.opcode = opcode;
+	sqe.fd = fd;
+	sqe.addr = reinterpret_cast<uint64_t>(buffer);
+	sqe.len = buffer ? 1 : 0;
+	sqe.off = offset;
+	sqe.user_data = userData;
+
+	ring.sqArray[index] = index;
+	storeRelease(ring.sqTail, tail + 1);
+	return true;
+}
+
+static void submitQueued(IoUring& ring, uint32_t numQueued)
+{
+	while (numQueued > 0)
+	{
+		int submitted = enterIoUring(ring.fd, numQueued, 0, 0);
+		if (submitted < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+			{
+				continue;
+			}
+			Log::fatal("io_uring submission failed, errno %d\n", errno);
+		}
+		numQueued -= static_cast<uint32_t>(submitted);
+	}
+}
+
+static void completionThread(IoUring& ring)
+{
+	onCompletionThread = true;
+
+	bool stopping = false;
+	while (!stopping)
+	{
+		unsigned head = *ring.cqHead;
+		unsigned tail = loadAcquire(ring.cqTail);
+		if (head == tail)
+		{
+			int result = enterIoUring(ring.fd, 0, 1, IORING_ENTER_GETEVENTS);
+			if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+			{
+				Log::fatal("Waiting for io_uring completions failed, errno %d\n", errno);
+			}
+			continue;
+		}
+
+		for (; head != tail; ++head)
+		{
+			const io_uring_cqe& cqe = ring.cqes[head & ring.cqMask];
+			if (cqe.user_data == StopUserData)
+			{
+				stopping = true;
+				continue;
+			}
+
+			IoUringOperation* operation = reinterpret_cast<IoUringOperation*>(cqe.user_data);
+			int32_t result = cqe.res;
+
+			{
+				std::lock_guard<std::mutex> lock(ring.submitMutex);
+				--ring.numInFlight;
+			}
+			ring.slotAvailable.notify_all();
+
+			operation->completion(operation->userData, result);
+			delete operation;
+		}
+		storeRelease(ring.cqHead, head);
+	}
+}
+
+IoUring* createIoUring(uint32_t numEntries)
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	int fd = setupIoUring(numEntries, params);
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+
+	IoUring* ring = new IoUring;
+	ring->fd = fd;
+	ring->numInFlight = 0;
+	if (!mapRings(*ring, params))
+	{
+		close(fd);
+		delete ring;
+		return nullptr;
+	}
+
+	ring->completionThread = std::thread(completionThread, std::ref(*ring));
+	return ring;
+}
+
+void destroyIoUring(IoUring* ring)
+{
+	if (!ring)
+	{
+		return;
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(ring->submitMutex);
+		ring->slotAvailable.wait(lock, [ring] { return ring->numInFlight == 0; });
+
+		// submissions never stay queued, so there is always room for the no-op
+		queueSqe(*ring, IORING_OP_NOP, -1, nullptr, 0, StopUserData);
+		submitQueued(*ring, 1);
+	}
+
+	ring->completionThread.join();
+	unmapRings(*ring);
+	close(ring->fd);
+	delete ring;
+}
+
+void submitIoUringReads(IoUring* ring, const IoUringRead* reads, uint32_t numReads)
+{
+	std::unique_lock<std::mutex> lock(ring->submitMutex);
+
+	uint32_t numQueued = 0;
+	for (uint32_t i = 0; i < numReads; ++i)
+	{
+		// more reads in flight than the completion queue holds could drop completions on old kernels
+		if (ring->numInFlight >= ring->numCqEntries && !onCompletionThread)
+		{
+			submitQueued(*ring, numQueued);
+			numQueued = 0;
+			ring->slotAvailable.wait(lock, [ring] { return ring->numInFlight < ring->numCqEntries; });
+		}
+
+		const IoUringRead& read = reads[i];
+		IoUringOperation* operation = new IoUringOperation;
+		operation->buffer.iov_base = read.buffer;
+		operation->buffer.iov_len = read.size;
+		operation->completion = read.completion;
+		operation->userData = read.userData;
+
+		// READV rather than READ keeps kernels before 5.6 working
+		while (!queueSqe(*ring, IORING_OP_READV, read.fd, &operation->buffer, read.offset, reinterpret_cast<uint64_t>(operation)))
+		{
+			submitQueued(*ring, numQueued);
+			numQueued = 0;
+		}
+		++numQueued;
+		++ring->numInFlight;
+	}
+
+	submitQueued(*ring, numQueued);
+}
+
+#endif
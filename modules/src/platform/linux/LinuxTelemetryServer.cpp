@@ -0,0 +1,211 @@
+#ifdef __linux__
+
+#include "TelemetryServer.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Log.h"
+
+// a client gets this long to send its request, and to take the response
+static const int ClientTimeoutMs = 200;
+static const size_t MaxRequestSize = 4096;
+static const char UnixPrefix[] = "unix:";
+
+struct TelemetryServer
+{
+	int listenFd;
+	// empty for TCP, removed when closed
+	eastl::string unixPath;
+};
+
+static int openUnixSocket(const char* path)
+{
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path))
+	{
+		Log::error("Telemetry socket path %s is too long\n", path);
+		return -1;
+	}
+	strcpy(address.sun_path, path);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	// left behind by a previous run that didn't shut down
+	unlink(path);
+	if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		Log::error("Cannot bind telemetry socket %s, errno %d\n", path, errno);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+static int openLoopbackSocket(const char* portName)
+{
+	char* end = nullptr;
+	long port = strtol(portName, &end, 10);
+	if (*end != '\0' || port <= 0 || port > 65535)
+	{
+		Log::error("Telemetry address %s is neither unix:<path> nor a port\n", portName);
+		return -1;
+	}
+
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	int reuse = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	// loopback only, the metrics aren't meant to leave the machine
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(static_cast<uint16_t>(port));
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		Log::error("Cannot bind telemetry port %ld, errno %d\n", port, errno);
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+TelemetryServer* openTelemetryServer(const char* address)
+{
+	bool isUnix = strncmp(address, UnixPrefix, sizeof(UnixPrefix) - 1) == 0;
+	int fd = isUnix ? openUnixSocket(address + sizeof(UnixPrefix) - 1) : openLoopbackSocket(address);
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+
+	if (listen(fd, 4) != 0)
+	{
+		Log::error("Cannot listen for telemetry clients, errno %d\n", errno);
+		close(fd);
+		return nullptr;
+	}
+
+	TelemetryServer* server = new TelemetryServer;
+	server->listenFd = fd;
+	if (isUnix)
+	{
+		server->unixPath = address + sizeof(UnixPrefix) - 1;
+	}
+	return server;
+}
+
+void closeTelemetryServer(TelemetryServer* server)
+{
+	close(server->listenFd);
+	if (!server->unixPath.empty())
+	{
+		unlink(server->unixPath.c_str());
+	}
+
+	delete server;
+}
+
+// Reads until the end of an HTTP request's headers, the client closes its side or stops sending.
+// Plain readers send nothing and only cost the timeout.
+static size_t readRequest(int fd, char* request, size_t capacity)
+{
+	size_t size = 0;
+	while (size < capacity - 1)
+	{
+		pollfd client = { fd, POLLIN, 0 };
+		if (poll(&client, 1, ClientTimeoutMs) <= 0)
+		{
+			break;
+		}
+
+		ssize_t received = recv(fd, request + size, capacity - 1 - size, 0);
+		if (received <= 0)
+		{
+			break;
+		}
+		size += received;
+
+		request[size] = '\0';
+		if (strstr(request, "\r\n\r\n"))
+		{
+			break;
+		}
+	}
+
+	return size;
+}
+
+static void writeAll(int fd, const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		// a client that went away must not kill the process with SIGPIPE
+		ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+		if (sent <= 0)
+		{
+			return;
+		}
+
+		data += sent;
+		size -= sent;
+	}
+}
+
+bool pollTelemetryServer(TelemetryServer* server, int timeoutMs, TelemetryResponder respond, void* userData)
+{
+	pollfd listener = { server->listenFd, POLLIN, 0 };
+	if (poll(&listener, 1, timeoutMs) <= 0)
+	{
+		return false;
+	}
+
+	int fd = accept4(server->listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+	if (fd < 0)
+	{
+		return false;
+	}
+
+	timeval sendTimeout = {};
+	sendTimeout.tv_usec = ClientTimeoutMs * 1000;
+	setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+
+	char request[MaxRequestSize];
+	size_t requestSize = readRequest(fd, request, sizeof(request));
+	bool isHttp = requestSize >= 4 && memcmp(request, "GET ", 4) == 0;
+
+	const eastl::string& body = respond(userData);
+	if (isHttp)
+	{
+		char header[256];
+		int headerSize = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", body.size());
+		writeAll(fd, header, headerSize);
+	}
+	writeAll(fd, body.data(), body.size());
+
+	close(fd);
+	return true;
+}
+
+#endif // __linux__
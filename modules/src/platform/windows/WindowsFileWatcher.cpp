@@ -0,0 +1,79 @@
+
+#ifdef _WIN32
+
+#include "FileWatcher.h"
+
+#include <windows.h>
+
+#include <EASTL/algorithm.h>
+#include <EASTL/hash_map.h>
+
+#include "Log.h"
+
+// No inotify on Windows, so modification times are polled instead. Good enough for a handful of shader sources.
+struct FileWatcher
+{
+	eastl::string pattern;
+	eastl::hash_map<eastl::string, uint64_t> lastWriteTimes;
+};
+
+static void scanDirectory(FileWatcher* watcher, eastl::vector<eastl::string>* changedFiles)
+{
+	WIN32_FIND_DATAA findData;
+	HANDLE findHandle = FindFirstFileA(watcher->pattern.c_str(), &findData);
+	if (findHandle == INVALID_HANDLE_VALUE)
+	{
+		return;
+	}
+
+	do
+	{
+		if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+		{
+			continue;
+		}
+
+		uint64_t writeTime = (static_cast<uint64_t>(findData.ftLastWriteTime.dwHighDateTime) << 32) | findData.ftLastWriteTime.dwLowDateTime;
+		eastl::string name = findData.cFileName;
+
+		auto it = watcher->lastWriteTimes.find(name);
+		if (it == watcher->lastWriteTimes.end() || it->second != writeTime)
+		{
+			watcher->lastWriteTimes[name] = writeTime;
+			if (changedFiles && eastl::find(changedFiles->begin(), changedFiles->end(), name) == changedFiles->end())
+			{
+				changedFiles->push_back(name);
+			}
+		}
+	} while (FindNextFileA(findHandle, &findData));
+
+	FindClose(findHandle);
+}
+
+FileWatcher* createFileWatcher(const char* directory)
+{
+	FileWatcher* watcher = new FileWatcher;
+	watcher->pattern = directory;
+	watcher->pattern += "*";
+
+	scanDirectory(watcher, nullptr);
+
+	return watcher;
+}
+
+void destroyFileWatcher(FileWatcher* watcher)
+{
+	delete watcher;
+}
+
+bool waitForFileChanges(FileWatcher* watcher, int timeoutMs, eastl::vector<eastl::string>& changedFiles)
+{
+	Sleep(timeoutMs);
+
+	size_t numBefore = changedFiles.size();
+	scanDirectory(watcher, &changedFiles);
+
+	return changedFiles.size() != numBefore;
+}
+
+#endif // _WIN32
@@ -0,0 +1,170 @@
+#ifdef _WIN32
+
+#include "TelemetryServer.h"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Log.h"
+
+// a client gets this long to send its request, and to take the response
+static const int ClientTimeoutMs = 200;
+static const size_t MaxRequestSize = 4096;
+static const char UnixPrefix[] = "unix:";
+
+// TCP only, AF_UNIX support on Windows is too patchy to rely on
+struct TelemetryServer
+{
+	SOCKET listenSocket;
+};
+
+TelemetryServer* openTelemetryServer(const char* address)
+{
+	if (strncmp(address, UnixPrefix, sizeof(UnixPrefix) - 1) == 0)
+	{
+		Log::error("Telemetry on a Unix socket isn't supported on Windows, use a port\n");
+		return nullptr;
+	}
+
+	char* end = nullptr;
+	long port = strtol(address, &end, 10);
+	if (*end != '\0' || port <= 0 || port > 65535)
+	{
+		Log::error("Telemetry address %s is not a port\n", address);
+		return nullptr;
+	}
+
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+	{
+		Log::error("Cannot initialize Winsock for telemetry\n");
+		return nullptr;
+	}
+
+	SOCKET listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (listenSocket == INVALID_SOCKET)
+	{
+		WSACleanup();
+		return nullptr;
+	}
+
+	// loopback only, the metrics aren't meant to leave the machine
+	sockaddr_in socketAddress = {};
+	socketAddress.sin_family = AF_INET;
+	socketAddress.sin_port = htons(static_cast<u_short>(port));
+	socketAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (bind(listenSocket, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0 || listen(listenSocket, 4) != 0)
+	{
+		Log::error("Cannot listen on telemetry port %ld, error %d\n", port, WSAGetLastError());
+		closesocket(listenSocket);
+		WSACleanup();
+		return nullptr;
+	}
+
+	TelemetryServer* server = new TelemetryServer;
+	server->listenSocket = listenSocket;
+	return server;
+}
+
+void closeTelemetryServer(TelemetryServer* server)
+{
+	closesocket(server->listenSocket);
+	WSACleanup();
+
+	delete server;
+}
+
+static bool waitForReadable(SOCKET socket, int timeoutMs)
+{
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET(socket, &readable);
+
+	timeval timeout = {};
+	timeout.tv_sec = timeoutMs / 1000;
+	timeout.tv_usec = (timeoutMs % 1000) * 1000;
+	return select(0, &readable, nullptr, nullptr, &timeout) > 0;
+}
+
+// Reads until the end of an HTTP request's headers, the client closes its side or stops sending.
+// Plain readers send nothing and only cost the timeout.
+static size_t readRequest(SOCKET socket, char* request, size_t capacity)
+{
+	size_t size = 0;
+	while (size < capacity - 1)
+	{
+		if (!waitForReadable(socket, ClientTimeoutMs))
+		{
+			break;
+		}
+
+		int received = recv(socket, request + size, static_cast<int>(capacity - 1 - size), 0);
+		if (received <= 0)
+		{
+			break;
+		}
+		size += received;
+
+		request[size] = '\0';
+		if (strstr(request, "\r\n\r\n"))
+		{
+			break;
+		}
+	}
+
+	return size;
+}
+
+static void writeAll(SOCKET socket, const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		int sent = send(socket, data, static_cast<int>(size), 0);
+		if (sent <= 0)
+		{
+			return;
+		}
+
+		data += sent;
+		size -= sent;
+	}
+}
+
+bool pollTelemetryServer(TelemetryServer* server, int timeoutMs, TelemetryResponder respond, void* userData)
+{
+	if (!waitForReadable(server->listenSocket, timeoutMs))
+	{
+		return false;
+	}
+
+	SOCKET client = accept(server->listenSocket, nullptr, nullptr);
+	if (client == INVALID_SOCKET)
+	{
+		return false;
+	}
+
+	DWORD sendTimeout = ClientTimeoutMs;
+	setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&sendTimeout), sizeof(sendTimeout));
+
+	char request[MaxRequestSize];
+	size_t requestSize = readRequest(client, request, sizeof(request));
+	bool isHttp = requestSize >= 4 && memcmp(request, "GET ", 4) == 0;
+
+	const eastl::string& body = respond(userData);
+	if (isHttp)
+	{
+		char header[256];
+		int headerSize = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", body.size());
+		writeAll(client, header, headerSize);
+	}
+	writeAll(client, body.data(), body.size());
+
+	closesocket(client);
+	return true;
+}
+
+#endif // _WIN32
@@ -0,0 +1,71 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "clustered.glsl"
+
+#define SHADOW_BINDING 4
+#include "shadows.glsl"
+
+layout(std430, set = 0, binding = 2) readonly buffer ClusterLightCounts
+{
+    uint clusterLightCounts[];
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer ClusterLightIndices
+{
+    uint clusterLightIndices[];
+};
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / camera.screen.xy;
+    vec2 ndc = vec2(uv.x * 2.0 - 1.0, 1.0 - uv.y * 2.0);
+
+    // the forward component of the ray is 1, so the hit distance along it is the view depth
+    vec3 ray = camera.forward.xyz + ndc.x * camera.projection.x * camera.right.xyz + ndc.y * camera.projection.y * camera.up.xyz;
+    float viewDepth = ray.y < 0.0 ? -camera.eye.y / ray.y : camera.projection.w;
+    if (ray.y >= 0.0 || viewDepth >= camera.projection.w)
+    {
+        outColor = vec4(0.02, 0.02, 0.04, 1.0);
+        return;
+    }
+
+    vec3 position = camera.eye.xyz + ray * viewDepth;
+    vec3 normal = vec3(0.0, 1.0, 0.0);
+
+    vec2 checker = floor(position.xz);
+    float albedo = mod(checker.x + checker.y, 2.0) == 0.0 ? 0.8 : 0.5;
+
+    uvec3 cluster = uvec3(uv * vec2(camera.grid.xy), depthSlice(viewDepth));
+    cluster.xy = min(cluster.xy, camera.grid.xy - 1);
+    uint index = clusterIndex(cluster);
+
+    // a dim sun, so the shadows show between the lights
+    float sun = max(dot(normal, getShadowLightDirection()), 0.0) * sampleShadow(position, normal);
+    vec3 lighting = vec3(0.02) + vec3(0.3, 0.28, 0.25) * sun;
+    uint numLights = clusterLightCounts[index];
+    for (uint i = 0; i < numLights; ++i)
+    {
+        Light light = lights[clusterLightIndices[index * MAX_LIGHTS_PER_CLUSTER + i]];
+
+        vec3 toLight = light.positionRadius.xyz - position;
+        float distance = length(toLight);
+        vec3 direction = toLight / distance;
+
+        float falloff = clamp(1.0 - distance / light.positionRadius.w, 0.0, 1.0);
+        float attenuation = falloff * falloff;
+
+        float cosOuter = light.spotDirection.w;
+        if (cosOuter > -1.0)
+        {
+            float cosAngle = dot(-direction, light.spotDirection.xyz);
+            attenuation *= smoothstep(cosOuter, cosOuter + 0.05, cosAngle);
+        }
+
+        lighting += light.color.rgb * attenuation * max(dot(normal, direction), 0.0);
+    }
+
+    outColor = vec4(lighting * albedo, 1.0);
+}
@@ -0,0 +1,59 @@
+// Shared between the light culling pass and the clustered forward shaders
+
+struct Light
+{
+    // xyz world position, w radius
+    vec4 positionRadius;
+    // rgb color premultiplied by intensity
+    vec4 color;
+    // xyz spot direction, w cosine of the outer cone angle. Point lights have w <= -1.
+    vec4 spotDirection;
+};
+
+layout(std140, set = 0, binding = 0) uniform Camera
+{
+    vec4 eye;
+    vec4 right;
+    vec4 up;
+    vec4 forward;
+    // tan of half the horizontal and vertical fov, near, far
+    vec4 projection;
+    // cluster grid dimensions, w is the number of lights
+    uvec4 grid;
+    // xy framebuffer size
+    vec4 screen;
+} camera;
+
+layout(std430, set = 0, binding = 1) readonly buffer Lights
+{
+    Light lights[];
+};
+
+const uint MAX_LIGHTS_PER_CLUSTER = 256;
+
+uint clusterIndex(uvec3 cluster)
+{
+    return (cluster.z * camera.grid.y + cluster.y) * camera.grid.x + cluster.x;
+}
+
+// depth slices are exponential so clusters stay roughly cubic
+float sliceDepth(uint slice)
+{
+    float near = camera.projection.z;
+    float far = camera.projection.w;
+    return near * pow(far / near, float(slice) / float(camera.grid.z));
+}
+
+uint depthSlice(float viewDepth)
+{
+    float near = camera.projection.z;
+    float far = camera.projection.w;
+    float slice = log(viewDepth / near) / log(far / near) * float(camera.grid.z);
+    return uint(clamp(slice, 0.0, float(camera.grid.z - 1)));
+}
+
+vec3 toViewSpace(vec3 position)
+{
+    vec3 relative = position - camera.eye.xyz;
+    return vec3(dot(relative, camera.right.xyz), dot(relative, camera.up.xyz), dot(relative, camera.forward.xyz));
+}
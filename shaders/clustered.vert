@@ -0,0 +1,8 @@
+#version 450
+
+// Full screen triangle, the fragment shader ray casts the ground plane
+void main()
+{
+    vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -1,9 +1,38 @@
 
+import os
 import subprocess
+import sys
+
+# the engine's shader hot reload reads the same list
+SOURCE_LIST = "sources.list"
+
+
+def read_shader_sources():
+    # one source per line, followed by the extra glslc arguments it needs
+    sources = []
+    with open(SOURCE_LIST) as source_list:
+        for line in source_list:
+            line = line.strip()
+            if line and not line.startswith("#"):
+                parts = line.split()
+                sources.append((parts[0], parts[1:]))
+    return sources
+
 
 if __name__ == "__main__":
-    subprocess.call(["glslc.exe", "shader.vert", "-o", "shader.vert.spv"])
-    subprocess.call(["glslc.exe", "shader.frag", "-o", "shader.frag.spv"])
+    glslc = "glslc.exe" if sys.platform == "win32" else "glslc"
+    os.chdir(os.path.dirname(os.path.abspath(__file__)))
+    shader_sources = read_shader_sources()
+
+    for source, extra_args in shader_sources:
+        subprocess.call([glslc, source, "-o", source + ".spv"] + extra_args)
+
+    # the engine reads every shader listed here in one batch at startup
+    with open("shaders.manifest", "w") as manifest:
+        for source, _ in shader_sources:
+            manifest.write("shader " + source + ".spv\n")
 
-    print("Press Enter to continue")
-    input()
\ No newline at end of file
+    # the engine recompiles shaders itself when hot reload is on, so only wait when run interactively
+    if "--no-wait" not in sys.argv:
+        print("Press Enter to continue")
+        input()
@@ -0,0 +1,20 @@
+#version 450
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 1) in vec2 fragGlyphPixel;
+layout(location = 2) flat in uint fragGlyph;
+
+layout(location = 0) out vec4 outColor;
+
+// Glyphs are 3x5 bits, rows top to bottom with the leftmost column highest, see DebugDraw.cpp.
+// Lines and rectangles set all of them.
+void main()
+{
+    uvec2 pixel = uvec2(clamp(fragGlyphPixel, vec2(0.0), vec2(2.0, 4.0)));
+    if (((fragGlyph >> (14 - pixel.y * 3 - pixel.x)) & 1) == 0)
+    {
+        discard;
+    }
+
+    outColor = fragColor;
+}
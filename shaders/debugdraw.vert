@@ -0,0 +1,34 @@
+#version 450
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) in vec2 inGlyphPixel;
+layout(location = 3) in uint inGlyph;
+
+layout(push_constant) uniform DebugDraw
+{
+    mat4 viewProjection;
+    vec2 invScreenSize;
+    // positions are in pixels from the top left of the swapchain image instead of world space
+    uint screenSpace;
+} draw;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragGlyphPixel;
+layout(location = 2) flat out uint fragGlyph;
+
+void main()
+{
+    if (draw.screenSpace != 0)
+    {
+        gl_Position = vec4(inPosition.xy * draw.invScreenSize * 2.0 - 1.0, 0.0, 1.0);
+    }
+    else
+    {
+        gl_Position = draw.viewProjection * vec4(inPosition, 1.0);
+    }
+
+    fragColor = inColor;
+    fragGlyphPixel = inGlyphPixel;
+    fragGlyph = inGlyph;
+}
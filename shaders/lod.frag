@@ -0,0 +1,38 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define SHADOW_BINDING 4
+#include "shadows.glsl"
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec3 fragViewDirection;
+layout(location = 2) flat in vec2 fragFade;
+layout(location = 3) in vec3 fragWorldPosition;
+
+layout(location = 0) out vec4 outColor;
+
+const float bayer[16] = float[](
+    0.0, 8.0, 2.0, 10.0,
+    12.0, 4.0, 14.0, 6.0,
+    3.0, 11.0, 1.0, 9.0,
+    15.0, 7.0, 13.0, 5.0);
+
+void main()
+{
+    // the incoming level covers the pixels under the fade, the outgoing one the rest
+    ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+    float threshold = (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
+    bool covered = threshold < fragFade.x;
+    if (covered == (fragFade.y > 0.5))
+    {
+        discard;
+    }
+
+    vec3 normal = normalize(fragNormal);
+    vec3 lightDirection = getShadowLightDirection();
+    float diffuse = max(dot(normal, lightDirection), 0.0) * sampleShadow(fragWorldPosition, normal);
+    float rim = pow(1.0 - max(dot(normal, normalize(fragViewDirection)), 0.0), 3.0);
+
+    vec3 albedo = vec3(0.6, 0.55, 0.5);
+    outColor = vec4(albedo * (0.15 + diffuse) + rim * 0.1, 1.0);
+}
@@ -0,0 +1,53 @@
+#version 450
+
+layout(std140, set = 0, binding = 0) uniform Camera
+{
+    mat4 viewProjection;
+    vec4 eye;
+} camera;
+
+// MeshVertex, position then normal
+layout(std430, set = 0, binding = 1) readonly buffer Vertices
+{
+    float vertices[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Indices
+{
+    uint indices[];
+};
+
+struct Instance
+{
+    vec4 positionScale;
+    // x is the dither coverage, y is 1 for the outgoing level of a cross-fade
+    vec4 fade;
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer Instances
+{
+    Instance instances[];
+};
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec3 fragViewDirection;
+layout(location = 2) flat out vec2 fragFade;
+layout(location = 3) out vec3 fragWorldPosition;
+
+// Non-indexed draw, firstVertex is the level of detail's first index
+void main()
+{
+    uint vertex = indices[gl_VertexIndex] * 6;
+    vec3 position = vec3(vertices[vertex], vertices[vertex + 1], vertices[vertex + 2]);
+    vec3 normal = vec3(vertices[vertex + 3], vertices[vertex + 4], vertices[vertex + 5]);
+
+    Instance instance = instances[gl_InstanceIndex];
+    vec3 worldPosition = instance.positionScale.xyz + position * instance.positionScale.w;
+
+    gl_Position = camera.viewProjection * vec4(worldPosition, 1.0);
+
+    fragNormal = normal;
+    fragViewDirection = camera.eye.xyz - worldPosition;
+    fragFade = instance.fade.xy;
+    fragWorldPosition = worldPosition;
+}
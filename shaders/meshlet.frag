@@ -0,0 +1,16 @@
+#version 450
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) flat in vec3 fragColor;
+
+layout(location = 0) out vec4 outColor;
+
+// Meshlets are tinted so their boundaries are visible
+void main()
+{
+    vec3 normal = normalize(fragNormal);
+    vec3 lightDirection = normalize(vec3(0.4, 1.0, -0.3));
+    float diffuse = max(dot(normal, lightDirection), 0.0);
+
+    outColor = vec4(fragColor * (0.15 + diffuse), 1.0);
+}
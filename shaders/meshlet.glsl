@@ -0,0 +1,106 @@
+// Shared between the meshlet culling pass and the meshlet draw paths
+
+struct Meshlet
+{
+    uint vertexOffset;
+    uint triangleOffset;
+    uint numVertices;
+    uint numTriangles;
+    // xyz center, w radius
+    vec4 sphere;
+    // xyz axis, w cutoff, see Meshlets.h
+    vec4 cone;
+};
+
+const uint MAX_MESHLET_VERTICES = 64;
+const uint MAX_MESHLET_TRIANGLES = 124;
+// visible meshlets handled by one task shader workgroup
+const uint TASK_GROUP_SIZE = 32;
+
+layout(std140, set = 0, binding = 0) uniform Scene
+{
+    mat4 viewProjection;
+    vec4 eye;
+    // xyz normal, w distance, inside is positive
+    vec4 frustumPlanes[6];
+    // x meshlets per instance, y instances
+    uvec4 counts;
+    // depth pyramid level 0 width and height, number of levels, w is 0 until the first build
+    uvec4 pyramid;
+} scene;
+
+layout(std430, set = 0, binding = 1) readonly buffer Meshlets
+{
+    Meshlet meshlets[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer MeshletVertices
+{
+    uint meshletVertices[];
+};
+
+// three meshlet-local vertex indices packed in the low 24 bits
+layout(std430, set = 0, binding = 3) readonly buffer MeshletTriangles
+{
+    uint meshletTriangles[];
+};
+
+// MeshVertex, position then normal
+layout(std430, set = 0, binding = 4) readonly buffer Vertices
+{
+    float vertices[];
+};
+
+// xyz position, w uniform scale
+layout(std430, set = 0, binding = 5) readonly buffer Instances
+{
+    vec4 instances[];
+};
+
+// only the culling pass writes the last two buffers, vertex stages need them readonly
+#ifdef MESHLET_CULL_PASS
+#define CULL_OUTPUT
+#else
+#define CULL_OUTPUT readonly
+#endif
+
+// x instance, y meshlet
+layout(std430, set = 0, binding = 6) CULL_OUTPUT buffer VisibleMeshlets
+{
+    uvec2 visibleMeshlets[];
+};
+
+// written by the culling pass, read as indirect arguments by either draw path
+layout(std430, set = 0, binding = 7) CULL_OUTPUT buffer DrawArgs
+{
+    // VkDrawIndirectCommand, instanceCount is the number of visible meshlets
+    uint drawVertexCount;
+    uint numVisibleMeshlets;
+    uint drawFirstVertex;
+    uint drawFirstInstance;
+    // VkDrawMeshTasksIndirectCommandEXT
+    uint taskGroupsX;
+    uint taskGroupsY;
+    uint taskGroupsZ;
+} args;
+
+vec3 loadPosition(uint vertex)
+{
+    return vec3(vertices[vertex * 6], vertices[vertex * 6 + 1], vertices[vertex * 6 + 2]);
+}
+
+vec3 loadNormal(uint vertex)
+{
+    return vec3(vertices[vertex * 6 + 3], vertices[vertex * 6 + 4], vertices[vertex * 6 + 5]);
+}
+
+uvec3 unpackTriangle(uint packed)
+{
+    return uvec3(packed & 0xff, (packed >> 8) & 0xff, (packed >> 16) & 0xff);
+}
+
+vec3 meshletColor(uint meshlet)
+{
+    uint hash = meshlet * 2654435761u;
+    return vec3(hash & 0xff, (hash >> 8) & 0xff, (hash >> 16) & 0xff) / 255.0 * 0.5 + 0.5;
+}
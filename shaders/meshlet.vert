@@ -0,0 +1,32 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "meshlet.glsl"
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) flat out vec3 fragColor;
+
+// Vertex shader path: one instance per visible meshlet, MAX_MESHLET_TRIANGLES * 3 vertices each.
+// Vertices past the meshlet's last triangle are collapsed outside the clip volume.
+void main()
+{
+    uvec2 visible = visibleMeshlets[gl_InstanceIndex];
+    vec4 instance = instances[visible.x];
+    Meshlet meshlet = meshlets[visible.y];
+
+    uint triangle = gl_VertexIndex / 3;
+    if (triangle >= meshlet.numTriangles)
+    {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        fragNormal = vec3(0.0);
+        fragColor = vec3(0.0);
+        return;
+    }
+
+    uint corner = unpackTriangle(meshletTriangles[meshlet.triangleOffset + triangle])[gl_VertexIndex % 3];
+    uint vertex = meshletVertices[meshlet.vertexOffset + corner];
+
+    gl_Position = scene.viewProjection * vec4(instance.xyz + loadPosition(vertex) * instance.w, 1.0);
+    fragNormal = loadNormal(vertex);
+    fragColor = meshletColor(visible.y);
+}
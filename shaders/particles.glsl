@@ -0,0 +1,88 @@
+// Shared between the particle compute passes, see ParticleSample.cpp
+
+struct Particle
+{
+    // xyz position, w age in seconds
+    vec4 positionAge;
+    // xyz velocity, w lifetime in seconds
+    vec4 velocityLifetime;
+};
+
+layout(std430, set = 0, binding = 0) buffer Particles
+{
+    Particle particles[];
+};
+
+// indices of free particles, the first deadCount are valid
+layout(std430, set = 0, binding = 1) buffer DeadList
+{
+    uint deadList[];
+};
+
+// two lists of capacity indices, the frame starts with list parity and the update compacts the
+// survivors into the other one
+layout(std430, set = 0, binding = 2) buffer AliveLists
+{
+    uint aliveLists[];
+};
+
+layout(std430, set = 0, binding = 3) buffer State
+{
+    uint aliveCounts[2];
+    uint deadCount;
+    // particles the emit pass takes from the end of the dead list and appends at emitBase
+    uint emitCount;
+    uint emitBase;
+    // VkDispatchIndirectCommand of the update pass
+    uint updateGroupsX;
+    uint updateGroupsY;
+    uint updateGroupsZ;
+} state;
+
+// Written for the frame in flight that draws them
+layout(std430, set = 0, binding = 4) buffer FrameArgs
+{
+    uint numAlive;
+    // numAlive rounded up to a power of two, at least SORT_BLOCK_SIZE
+    uint sortSize;
+    // VkDispatchIndirectCommand of every sort pass
+    uint sortGroupsX;
+    uint sortGroupsY;
+    uint sortGroupsZ;
+    // VkDrawIndirectCommand, six vertices per particle
+    uint drawVertexCount;
+    uint drawInstanceCount;
+    uint drawFirstVertex;
+    uint drawFirstInstance;
+} frame;
+
+// x is the key, y the particle. Ascending keys are back to front.
+layout(std430, set = 0, binding = 5) buffer SortEntries
+{
+    uvec2 sortEntries[];
+};
+
+// xyz position, w age over lifetime, indexed by particle
+layout(std430, set = 0, binding = 6) buffer RenderParticles
+{
+    vec4 renderParticles[];
+};
+
+layout(push_constant) uniform PushConstants
+{
+    vec4 eye;
+    vec4 forward;
+    float deltaTime;
+    // requested by the CPU, the prepare pass clamps it to the free particles
+    uint requestedEmitCount;
+    uint seed;
+    uint parity;
+    uint capacity;
+    uint sortK;
+    uint sortJ;
+    uint mode;
+};
+
+const uint PARTICLE_GROUP_SIZE = 256;
+// elements one sort workgroup handles in shared memory, two per thread
+const uint SORT_BLOCK_SIZE = 1024;
@@ -0,0 +1,43 @@
+#version 450
+
+layout(std140, set = 0, binding = 0) uniform Camera
+{
+    mat4 viewProjection;
+    vec4 right;
+    vec4 up;
+} camera;
+
+// sorted back to front by the particle passes, x is the key, y the particle
+layout(std430, set = 0, binding = 1) readonly buffer SortEntries
+{
+    uvec2 sortEntries[];
+};
+
+// xyz position, w age over lifetime
+layout(std430, set = 0, binding = 2) readonly buffer RenderParticles
+{
+    vec4 renderParticles[];
+};
+
+layout(location = 0) out vec2 fragCorner;
+layout(location = 1) out vec4 fragColor;
+
+const vec2 corners[6] = vec2[](
+    vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(-1.0, 1.0),
+    vec2(-1.0, 1.0), vec2(1.0, -1.0), vec2(1.0, 1.0));
+
+// Indirect draw of six vertices per alive particle, a camera facing quad each
+void main()
+{
+    uint particle = sortEntries[gl_VertexIndex / 6].y;
+    vec4 render = renderParticles[particle];
+    vec2 corner = corners[gl_VertexIndex % 6];
+
+    float size = 0.02 + 0.03 * fract(float(particle) * 0.618034);
+    vec3 position = render.xyz + (camera.right.xyz * corner.x + camera.up.xyz * corner.y) * size;
+    gl_Position = camera.viewProjection * vec4(position, 1.0);
+
+    float life = render.w;
+    fragCorner = corner;
+    fragColor = vec4(mix(vec3(1.0, 0.6, 0.2), vec3(0.3, 0.4, 0.9), life), 0.8 * (1.0 - life));
+}
@@ -0,0 +1,55 @@
+// Shared between the fused post processing dispatch and its separate pass equivalent
+
+const uint NumBloomLevels = 5;
+const uint NumHistogramBins = 256;
+
+layout(set = 0, binding = 0) uniform sampler2D sceneColor;
+layout(set = 0, binding = 2) coherent buffer Exposure
+{
+    uint histogram[NumHistogramBins];
+    uint numGroupsDone;
+    float averageLuminance;
+    float exposure;
+} state;
+
+float getLuminance(vec3 color)
+{
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+uint getHistogramBin(float luminance, float minLogLuminance, float logLuminanceRange)
+{
+    // bin 0 holds black, which is left out of the average
+    if (luminance < 1e-5)
+    {
+        return 0;
+    }
+
+    float t = clamp((log2(luminance) - minLogLuminance) / logLuminanceRange, 0.0, 1.0);
+    return uint(t * 254.0 + 1.0);
+}
+
+// The average luminance the histogram's non-black bins give, from their summed bin indices and counts
+float getBinLuminance(vec2 sums, float minLogLuminance, float logLuminanceRange)
+{
+    float bin = sums.x / sums.y;
+    return exp2((bin - 1.0) / 254.0 * logLuminanceRange + minLogLuminance);
+}
+
+// Soft threshold with a quadratic knee, on exposed values
+vec3 prefilter(vec3 color, float threshold, float knee)
+{
+    float brightness = max(color.r, max(color.g, color.b));
+    float soft = clamp(brightness - threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 1e-4);
+    float contribution = max(soft, brightness - threshold) / max(brightness, 1e-4);
+    return color * contribution;
+}
+
+// Texels past the rendered part are skipped, as are those past the level when the render extent
+// rounds up beyond it
+bool isInsideLevel(uint level, uvec2 texel, ivec2 levelSize, uvec2 renderSize)
+{
+    uvec2 renderedSize = (renderSize / 2 + (1u << level) - 1) >> level;
+    return all(lessThan(texel, min(renderedSize, uvec2(levelSize))));
+}
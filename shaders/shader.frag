@@ -1,10 +1,25 @@
 #version 450
 
+layout(constant_id = 0) const bool GRAYSCALE = false;
+layout(constant_id = 1) const bool INVERT = false;
+
 layout(location = 0) in vec3 inColor;
 
 layout(location = 0) out vec4 outColor;
 
 void main()
 {
-    outColor = vec4(inColor, 1.0);
+    vec3 color = inColor;
+
+    if (GRAYSCALE)
+    {
+        color = vec3(dot(color, vec3(0.2126, 0.7152, 0.0722)));
+    }
+
+    if (INVERT)
+    {
+        color = vec3(1.0) - color;
+    }
+
+    outColor = vec4(color, 1.0);
 }
@@ -12,10 +12,21 @@ vec3 colors[3] = vec3[] (
     vec3(0.0, 0.0, 1.0)
 );
 
+layout(push_constant) uniform PushConstants
+{
+    vec2 offset;
+    float rotation;
+};
+
 layout(location = 0) out vec3 fragColor;
 
 void main()
 {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+    vec2 position = positions[gl_VertexIndex];
+    float c = cos(rotation);
+    float s = sin(rotation);
+    position = vec2(c * position.x - s * position.y, s * position.x + c * position.y) + offset;
+
+    gl_Position = vec4(position, 0.0, 1.0);
     fragColor = colors[gl_VertexIndex];
 }
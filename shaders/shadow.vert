@@ -0,0 +1,39 @@
+#version 450
+
+// Depth only, shared by every shadow caster. Reads nothing but positions.
+layout(push_constant) uniform Cascade
+{
+    mat4 viewProjection;
+} cascade;
+
+// three floats per vertex
+layout(std430, set = 0, binding = 0) readonly buffer Positions
+{
+    float positions[];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Indices
+{
+    uint indices[];
+};
+
+struct Instance
+{
+    vec4 positionScale;
+    uvec4 vertexOffset;
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Instances
+{
+    Instance instances[];
+};
+
+// Non-indexed draw, firstVertex is the first index of the caster's range for the cascade
+void main()
+{
+    Instance instance = instances[gl_InstanceIndex];
+    uint vertex = (instance.vertexOffset.x + indices[gl_VertexIndex]) * 3;
+    vec3 position = vec3(positions[vertex], positions[vertex + 1], positions[vertex + 2]);
+
+    gl_Position = cascade.viewProjection * vec4(instance.positionScale.xyz + position * instance.positionScale.w, 1.0);
+}
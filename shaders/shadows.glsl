@@ -0,0 +1,67 @@
+// Cascaded shadow map lookups for receivers, see ShadowMaps.h. Define SHADOW_BINDING as the first
+// of the two bindings before including.
+
+layout(std140, set = 0, binding = SHADOW_BINDING) uniform Shadows
+{
+    mat4 viewProjections[4];
+    // view depth at which each cascade ends
+    vec4 splits;
+    // world size of a shadow map texel in each cascade
+    vec4 texelSizes;
+    // w is the number of cascades, 0 when shadows are off
+    vec4 eye;
+    vec4 forward;
+    // towards the light
+    vec4 lightDirection;
+    // x is one over the atlas size in texels, y the size of a cascade in atlas uv
+    vec4 atlas;
+} shadows;
+
+layout(set = 0, binding = SHADOW_BINDING + 1) uniform sampler2DShadow shadowAtlas;
+
+vec3 getShadowLightDirection()
+{
+    return shadows.lightDirection.xyz;
+}
+
+// 1 where the light reaches worldPosition, 0 in full shadow
+float sampleShadow(vec3 worldPosition, vec3 normal)
+{
+    uint numCascades = uint(shadows.eye.w);
+    float viewDepth = dot(worldPosition - shadows.eye.xyz, shadows.forward.xyz);
+
+    uint cascade = 0;
+    while (cascade < numCascades && viewDepth > shadows.splits[cascade])
+    {
+        ++cascade;
+    }
+    if (cascade >= numCascades)
+    {
+        return 1.0;
+    }
+
+    // pushing the lookup out along the normal by about a texel hides acne on surfaces facing the light
+    vec3 offsetPosition = worldPosition + normal * shadows.texelSizes[cascade] * 1.5;
+    vec4 clip = shadows.viewProjections[cascade] * vec4(offsetPosition, 1.0);
+    vec2 uv = clip.xy * 0.5 + 0.5;
+    if (clip.z > 1.0)
+    {
+        return 1.0;
+    }
+
+    // into the cascade's square, staying far enough from its edge that filtering can't reach the next one
+    float texel = shadows.atlas.x;
+    vec2 origin = vec2(cascade & 1u, cascade >> 1u) * shadows.atlas.y;
+    uv = origin + clamp(uv * shadows.atlas.y, vec2(2.0 * texel), vec2(shadows.atlas.y - 2.0 * texel));
+
+    // 3x3 bilinear comparisons, a 4x4 texel filter
+    float lit = 0.0;
+    for (int y = -1; y <= 1; ++y)
+    {
+        for (int x = -1; x <= 1; ++x)
+        {
+            lit += texture(shadowAtlas, vec3(uv + vec2(x, y) * texel, clip.z));
+        }
+    }
+    return lit / 9.0;
+}
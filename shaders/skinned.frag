@@ -0,0 +1,25 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#define SHADOW_BINDING 3
+#include "shadows.glsl"
+
+layout(location = 0) in vec3 fragNormal;
+layout(location = 1) in vec3 fragViewDirection;
+layout(location = 2) flat in uint fragCharacter;
+layout(location = 3) in vec3 fragWorldPosition;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    vec3 normal = normalize(fragNormal);
+    vec3 lightDirection = getShadowLightDirection();
+    float diffuse = max(dot(normal, lightDirection), 0.0) * sampleShadow(fragWorldPosition, normal);
+    float rim = pow(1.0 - max(dot(normal, normalize(fragViewDirection)), 0.0), 3.0);
+
+    // a slightly different tint per character so the crowd doesn't read as one mass
+    float hue = float((fragCharacter * 2654435761u) >> 24) / 255.0;
+    vec3 albedo = mix(vec3(0.7, 0.45, 0.35), vec3(0.35, 0.5, 0.7), hue);
+    outColor = vec4(albedo * (0.15 + diffuse) + rim * 0.1, 1.0);
+}
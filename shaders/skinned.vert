@@ -0,0 +1,40 @@
+#version 450
+
+layout(std140, set = 0, binding = 0) uniform Camera
+{
+    mat4 viewProjection;
+    vec4 eye;
+    // skinned vertices per character
+    uint numVertices;
+} camera;
+
+// world space MeshVertex written by skinning.comp, position then normal
+layout(std430, set = 0, binding = 1) readonly buffer SkinnedVertices
+{
+    float vertices[];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer Indices
+{
+    uint indices[];
+};
+
+layout(location = 0) out vec3 fragNormal;
+layout(location = 1) out vec3 fragViewDirection;
+layout(location = 2) flat out uint fragCharacter;
+layout(location = 3) out vec3 fragWorldPosition;
+
+// Non-indexed draw with one instance per character
+void main()
+{
+    uint vertex = (gl_InstanceIndex * camera.numVertices + indices[gl_VertexIndex]) * 6;
+    vec3 position = vec3(vertices[vertex], vertices[vertex + 1], vertices[vertex + 2]);
+    vec3 normal = vec3(vertices[vertex + 3], vertices[vertex + 4], vertices[vertex + 5]);
+
+    gl_Position = camera.viewProjection * vec4(position, 1.0);
+
+    fragNormal = normal;
+    fragViewDirection = camera.eye.xyz - position;
+    fragCharacter = gl_InstanceIndex;
+    fragWorldPosition = position;
+}
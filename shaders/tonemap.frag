@@ -0,0 +1,76 @@
+#version 450
+
+layout(location = 0) in vec2 fragUv;
+
+layout(location = 0) out vec4 outColor;
+
+// must match postprocess.comp
+const int NumBloomLevels = 5;
+
+const vec3 LumaWeights = vec3(0.2126, 0.7152, 0.0722);
+const float MiddleGray = 0.18;
+
+// the HDR scene target, only its top left part was rendered this frame
+layout(set = 0, binding = 0) uniform sampler2D sceneColor;
+// same layout as the scene target at half its size, one mip level per bloom level
+layout(set = 0, binding = 1) uniform sampler2D bloomLevels;
+layout(set = 0, binding = 2) readonly buffer Exposure
+{
+    uint histogram[256];
+    uint numGroupsDone;
+    float averageLuminance;
+    float exposure;
+} state;
+
+layout(push_constant) uniform Tonemap
+{
+    vec2 uvScale;
+    vec2 uvMax;
+    vec2 bloomSize;
+    float bloomStrength;
+    float saturation;
+    vec3 tint;
+    float contrast;
+} tonemap;
+
+// Four bilinear taps a texel apart per level, a tent that hides the box filtered downsampling. Each
+// level is clamped to its rendered part like the scene.
+vec3 sampleBloom(vec2 uv)
+{
+    vec3 bloom = vec3(0.0);
+    for (int level = 0; level < NumBloomLevels; ++level)
+    {
+        vec2 texelSize = 1.0 / vec2(textureSize(bloomLevels, level));
+        vec2 renderedSize = ceil(tonemap.bloomSize / float(1 << level));
+        vec2 uvMin = 0.5 * texelSize;
+        vec2 uvMax = (renderedSize - 0.5) * texelSize;
+
+        vec3 color = textureLod(bloomLevels, clamp(uv + vec2(-1.0, -1.0) * texelSize, uvMin, uvMax), level).rgb;
+        color += textureLod(bloomLevels, clamp(uv + vec2(1.0, -1.0) * texelSize, uvMin, uvMax), level).rgb;
+        color += textureLod(bloomLevels, clamp(uv + vec2(-1.0, 1.0) * texelSize, uvMin, uvMax), level).rgb;
+        color += textureLod(bloomLevels, clamp(uv + vec2(1.0, 1.0) * texelSize, uvMin, uvMax), level).rgb;
+        bloom += color * 0.25;
+    }
+    return bloom / float(NumBloomLevels);
+}
+
+vec3 gradeAndTonemap(vec3 color)
+{
+    color *= tonemap.tint;
+    // contrast around middle gray, so it doesn't shift the exposure
+    color = MiddleGray * pow(max(color, vec3(0.0)) / MiddleGray, vec3(tonemap.contrast));
+    color = max(mix(vec3(dot(color, LumaWeights)), color, tonemap.saturation), vec3(0.0));
+
+    // Narkowicz's fit of the ACES filmic curve
+    return clamp((color * (2.51 * color + 0.03)) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main()
+{
+    vec2 uv = fragUv * tonemap.uvScale;
+    // bilinear, clamped so the filter never reaches pixels outside the rendered part
+    vec3 color = texture(sceneColor, min(uv, tonemap.uvMax)).rgb;
+    color += sampleBloom(uv) * tonemap.bloomStrength;
+
+    outColor = vec4(gradeAndTonemap(color * state.exposure), 1.0);
+}
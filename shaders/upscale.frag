@@ -0,0 +1,21 @@
+#version 450
+
+layout(location = 0) in vec2 fragUv;
+
+layout(location = 0) out vec4 outColor;
+
+// the scene target, only its top left part was rendered this frame
+layout(set = 0, binding = 0) uniform sampler2D sceneColor;
+
+layout(push_constant) uniform Upscale
+{
+    vec2 uvScale;
+    vec2 uvMax;
+} upscale;
+
+void main()
+{
+    // bilinear, clamped so the filter never reaches pixels outside the rendered part
+    vec2 uv = min(fragUv * upscale.uvScale, upscale.uvMax);
+    outColor = vec4(texture(sceneColor, uv).rgb, 1.0);
+}